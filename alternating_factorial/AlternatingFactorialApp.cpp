@@ -22,10 +22,18 @@
 #endif
 
 #define APP_NAME        "afsieve"
-#define APP_VERSION     "1.2"
+#define APP_VERSION     "1.3"
 
 #define BIT(n)          ((n) - ii_MinN)
 
+// These are run by -0 (--selftest).  The factors were found with one worker.
+static const selftest_t selfTests[] = {
+   { "-n 10 -N 2000 -P 1e6",       1066, 0xfd479c735aaa5b46ULL },
+   { "-n 10 -N 2000 -P 1e6 -m 8",  1066, 0xfd479c735aaa5b46ULL },
+   { "-n 10 -N 2000 -P 1e6 -m 16", 1066, 0xfd479c735aaa5b46ULL },
+   { NULL, 0, 0 }
+};
+
 // This is declared in App.h, but implemented here.  This means that App.h
 // can remain unchanged if using the mtsieve framework for other applications.
 App *get_app(void)
@@ -37,12 +45,19 @@ AlternatingFactorialApp::AlternatingFactorialApp() : FactorApp()
 {
    SetBanner(APP_NAME " v" APP_VERSION ", a program to find factors of alternating factorials");
    SetLogFileName("afsieve.log");
+   SetSelfTests(selfTests);
 
    ii_MinN = 2;
    ii_MaxN = 0;
    
-   // This is because the assembly code is using SSE to do the mulmods
-   SetAppMaxPrime(PMAX_MAX_52BIT);
+   // The assembly code is limited to p < 2^52, but the Montgomery logic is not.
+   SetAppMaxPrime(PMAX_MAX_62BIT);
+   
+#ifdef USE_X86
+   ii_MontgomeryLanes = 0;
+#else
+   ii_MontgomeryLanes = 8;
+#endif
    
    // Override the default
    ii_CpuWorkSize = 10000;
@@ -59,6 +74,12 @@ void AlternatingFactorialApp::Help(void)
 
    printf("-n --minn=n           minimum n to search\n");
    printf("-N --maxn=N           maximum n to search\n");
+#ifdef USE_X86
+   printf("-m --montgomery=m     use Montgomery logic with m (8 or 16) primes per vector\n");
+   printf("                      (default is x86 asm for p < 2^52 and Montgomery for p > 2^52)\n");
+#else
+   printf("-m --montgomery=m     use Montgomery logic with m (8 or 16) primes per vector (default %u)\n", ii_MontgomeryLanes);
+#endif
 
 #if defined(USE_OPENCL) || defined(USE_METAL)
    printf("-S --step=S           max steps iterated per call to GPU (default %d)\n", ii_MaxGpuSteps);
@@ -70,10 +91,11 @@ void  AlternatingFactorialApp::AddCommandLineOptions(std::string &shortOpts, str
 {
    FactorApp::ParentAddCommandLineOptions(shortOpts, longOpts);
 
-   shortOpts += "n:N:";
+   shortOpts += "n:N:m:";
 
    AppendLongOpt(longOpts, "minn",           required_argument, 0, 'n');
    AppendLongOpt(longOpts, "maxn",           required_argument, 0, 'N');
+   AppendLongOpt(longOpts, "montgomery",     required_argument, 0, 'm');
 
 #if defined(USE_OPENCL) || defined(USE_METAL)
    shortOpts += "S:M:";
@@ -100,6 +122,13 @@ parse_t AlternatingFactorialApp::ParseOption(int opt, char *arg, const char *sou
          status = Parser::Parse(arg, 2, 1000000000, ii_MaxN);
          break;
          
+      case 'm':
+         status = Parser::Parse(arg, 8, 16, ii_MontgomeryLanes);
+         
+         if (status == P_SUCCESS && ii_MontgomeryLanes != 8 && ii_MontgomeryLanes != 16)
+            status = P_OUT_OF_RANGE;
+         break;
+         
 #if defined(USE_OPENCL) || defined(USE_METAL)
       case 'S':
          status = Parser::Parse(arg, 1, 1000000000, ii_MaxGpuSteps);
@@ -142,7 +171,8 @@ void AlternatingFactorialApp::ValidateOptions(void)
 
    FactorApp::ParentValidateOptions();
 
-   while (ii_CpuWorkSize % 4 != 0)
+   // We want worksize to be divisible by 16 as that is the largest vector size
+   while (ii_CpuWorkSize % 16 != 0)
       ii_CpuWorkSize++;
 }
 
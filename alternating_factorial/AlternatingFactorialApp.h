@@ -31,6 +31,7 @@ public:
    
    uint32_t          GetMinN(void) { return ii_MinN; };
    uint32_t          GetMaxN(void) { return ii_MaxN; };
+   uint32_t          GetMontgomeryLanes(void) { return ii_MontgomeryLanes; };
 
 #if defined(USE_OPENCL) || defined(USE_METAL)
    uint32_t          GetMaxGpuSteps(void) { return ii_MaxGpuSteps; };
@@ -59,6 +60,7 @@ private:
  
    uint32_t          ii_MinN;
    uint32_t          ii_MaxN;
+   uint32_t          ii_MontgomeryLanes;
 
 #if defined(USE_OPENCL) || defined(USE_METAL)
    uint32_t          ii_MaxGpuSteps;
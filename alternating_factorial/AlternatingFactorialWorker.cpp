@@ -8,15 +8,21 @@
 
 #include <cinttypes>
 #include "AlternatingFactorialWorker.h"
+#include "../core/MpArithVector.h"
 
+#ifdef USE_X86
 extern "C" {
    int afsieve(const uint32_t nmax, const uint64_t *P);
 }
+#endif
 
 AlternatingFactorialWorker::AlternatingFactorialWorker(uint32_t myId, App *theApp) : Worker(myId, theApp)
 {
    ip_AlternatingFactorialApp = (AlternatingFactorialApp *) theApp;
    
+   ii_MaxN = ip_AlternatingFactorialApp->GetMaxN();
+   ii_MontgomeryLanes = ip_AlternatingFactorialApp->GetMontgomeryLanes();
+   
    // The thread can't start until initialization is done
    ib_Initialized = true;
 }
@@ -27,38 +33,97 @@ void  AlternatingFactorialWorker::CleanUp(void)
 
 void  AlternatingFactorialWorker::TestMegaPrimeChunk(void)
 {
-   uint64_t  ps[4], maxPrime = ip_App->GetMaxPrime();
-   uint32_t  gotFactor, maxN = ip_AlternatingFactorialApp->GetMaxN();
+   uint64_t  maxPrime = ip_App->GetMaxPrime();
+   uint32_t  primesPerVector = (ii_MontgomeryLanes == 16 ? 16 : 8);
+   uint64_t *ps;
       
-   for (uint32_t pIdx=0; pIdx<ii_PrimesInList; pIdx+=4)
+   for (uint32_t pIdx=0; pIdx<ii_PrimesInList; pIdx+=primesPerVector)
    {
-      ps[0] = il_PrimeList[pIdx+0];
-      ps[1] = il_PrimeList[pIdx+1];
-      ps[2] = il_PrimeList[pIdx+2];
-      ps[3] = il_PrimeList[pIdx+3];
-            
-      gotFactor = afsieve(maxN, ps);
-
-      if (gotFactor)
+      ps = &il_PrimeList[pIdx];
+
+#ifdef USE_X86
+      // The assembly code is limited to p < 2^52.
+      if (ii_MontgomeryLanes == 0 && ps[primesPerVector-1] < PMAX_MAX_52BIT)
       {
-         ExtractFactors(ps[0]);
-         ExtractFactors(ps[1]);
-         ExtractFactors(ps[2]);
-         ExtractFactors(ps[3]);
+         for (uint32_t idx=0; idx<primesPerVector; idx+=4)
+            TestPrimesAsm(&ps[idx]);
       }
+      else
+#endif
+      if (primesPerVector == 16)
+         TestPrimesMp<16>(ps);
+      else
+         TestPrimesMp<8>(ps);
       
-      SetLargestPrimeTested(ps[3], 4);
+      SetLargestPrimeTested(ps[primesPerVector-1], primesPerVector);
       
-      if (ps[3] >= maxPrime)
+      if (ps[primesPerVector-1] >= maxPrime)
          break;
    }
 }
 
+#ifdef USE_X86
+void  AlternatingFactorialWorker::TestPrimesAsm(uint64_t *ps)
+{
+   if (afsieve(ii_MaxN, ps))
+   {
+      ExtractFactors(ps[0]);
+      ExtractFactors(ps[1]);
+      ExtractFactors(ps[2]);
+      ExtractFactors(ps[3]);
+   }
+}
+#endif
+
+// af(n) = n! - af(n-1), so p divides af(n) when n! = af(n-1) (mod p).  Unlike the
+// assembly code, factors are reported as they are found, so there is no need to
+// extract them afterwards.
+template <size_t N>
+void  AlternatingFactorialWorker::TestPrimesMp(uint64_t *ps)
+{
+   uint64_t          vps[N];
+   uint32_t          firstLane = 0;
+   
+   for (uint32_t k=0; k<N; k++)
+      vps[k] = ps[k];
+
+   // Montgomery arithmetic needs an odd modulus.  Since af(n) is odd for all n,
+   // 2 cannot be a factor.  The first lane repeats the next prime, so that lane
+   // is not reported.
+   if (vps[0] == 2)
+   {
+      vps[0] = vps[1];
+      firstLane = 1;
+   }
+   
+   MpArithVector<N>  mp(vps);
+   MpResVector<N>    one = mp.one();
+   MpResVector<N>    nRes = one;
+   MpResVector<N>    nFact = one;
+   MpResVector<N>    afnm1 = one;
+
+   for (uint32_t n=2; n<=ii_MaxN; n++)
+   {
+      nRes = mp.add(nRes, one);
+      nFact = mp.mul(nFact, nRes);
+      
+      if (mp.at_least_one_is_equal(nFact, afnm1))
+      {
+         for (uint32_t k=firstLane; k<N; k++)
+            if (nFact[k] == afnm1[k])
+               ip_AlternatingFactorialApp->ReportFactor(vps[k], n);
+      }
+      
+      afnm1 = mp.sub(nFact, afnm1);
+   }
+}
+
 void  AlternatingFactorialWorker::TestMiniPrimeChunk(uint64_t *miniPrimeChunk)
 {
    FatalError("AlternatingFactorialWorker::TestMiniPrimeChunk not implemented");
 }
 
+#ifdef USE_X86
 void  AlternatingFactorialWorker::ExtractFactors(uint64_t p)
 {
    // Note that p is limited to 2^52, so we are not using extended precision
@@ -78,7 +143,7 @@ void  AlternatingFactorialWorker::ExtractFactors(uint64_t p)
    nm1term = 1;
    rem = 1;
    
-   for (n=2; n<=ip_AlternatingFactorialApp->GetMaxN(); n++)
+   for (n=2; n<=ii_MaxN; n++)
    {
       qd = ((double) rem * (double) n);
 
@@ -104,3 +169,4 @@ void  AlternatingFactorialWorker::ExtractFactors(uint64_t p)
       
    }
 }
+#endif
@@ -31,7 +31,16 @@ protected:
 private:
    AlternatingFactorialApp      *ip_AlternatingFactorialApp;
    
+#ifdef USE_X86
+   void              TestPrimesAsm(uint64_t *ps);
    void              ExtractFactors(uint64_t p);
+#endif
+
+   template <size_t N>
+   void              TestPrimesMp(uint64_t *ps);
+   
+   uint32_t          ii_MontgomeryLanes;
+   uint32_t          ii_MaxN;
 };
 
 #endif
@@ -0,0 +1,368 @@
+#!/usr/bin/perl
+# benchmark.pl -- (C) Mark Rodenkirch, October 2026
+#
+# Run a fixed set of workloads with each program and compare the results to a
+# baseline.  This is run by "make benchmark", which builds the programs first:
+#
+#    make benchmark_baseline
+#    ... change the code, upgrade primesieve, or change OPT_CPP_FLAGS ...
+#    make benchmark
+#
+# It can also be run directly from the directory with the programs:
+#
+#    perl benchmark.pl [-r results] [-b baseline] [-t tolerance] [-n runs] [-f filter] [-l label] programs
+#
+#    -r  file to write the results to (default benchmark_results.txt)
+#    -b  file with the results to compare to.  Nothing is compared if it doesn't exist.
+#    -t  percent that a result can be worse than the baseline (default 5)
+#    -n  number of times to run each workload (default 3).  The best primes per second,
+#        memory and startup time of those runs are kept since a single run can be 10%
+#        slower when the computer is running other programs.
+#    -f  only run the workloads whose name matches this regular expression
+#    -l  label written to the results file, such as the compiler flags
+#
+# Each workload is run with one worker and a fixed worksize so that the results
+# only change when the code or the compiler changes.  The workloads for each program
+# are named for what they measure:
+#
+#    small_p   a new sieve to 1e6 which has many terms and finds many factors
+#    large_p   a new sieve near 1e12 where almost every term remains
+#    sparse    terms sieved to 1e6 first, then sieved near 1e12
+#    few       a large_p workload with only a few terms
+#    many      a large_p workload with many more terms
+#
+# Primes per second, peak resident memory, and startup time (building or reading
+# the terms) are read from the statistics file written with -9.  A result is a
+# regression if primes per second is lower or memory or startup time is higher than
+# the baseline by more than the tolerance.  Memory and startup time must also grow
+# by at least 1 MB and 20 ms since small values are not measured precisely.  The
+# exit status is 1 if there is a regression or if a workload fails.
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+use strict;
+use warnings;
+use Cwd;
+use File::Path qw(rmtree);
+use Getopt::Std;
+use Time::HiRes qw(time);
+
+# name, arguments to create the terms file for sparse workloads, arguments to sieve
+my @workloads = (
+   [ 'afsieve/small_p',   '', '-n 10 -N 2000 -P 1e6' ],
+   [ 'afsieve/large_p',   '', '-n 10 -N 2000 -p 1e12 -P 1000004e6' ],
+   [ 'afsieve/few',       '', '-n 10 -N 200 -p 1e12 -P 1000020e6' ],
+
+   [ 'ccsieve/small_p',   '', '-c 1 -t 1 -k 1 -K 20000 -l 3 -b 2 -n 1000 -P 1e6' ],
+   [ 'ccsieve/large_p',   '', '-c 1 -t 1 -k 1 -K 20000 -l 3 -b 2 -n 1000 -p 1e12 -P 1000300e6' ],
+   [ 'ccsieve/many',      '', '-c 1 -t 1 -k 1 -K 10000000 -l 3 -b 2 -n 1000 -p 1e12 -P 1000060e6' ],
+
+   [ 'cksieve/small_p',   '', '-b 2 -n 1000 -N 5000 -P 1e6' ],
+   [ 'cksieve/large_p',   '', '-b 2 -n 1000 -N 5000 -p 1e12 -P 1000002e6' ],
+
+   [ 'dmdsieve/small_p',  '', '-k 1 -K 5000 -n 61 -P 1e5' ],
+   [ 'dmdsieve/large_p',  '', '-k 1 -K 5000 -n 61 -p 1e9 -P 1100e6' ],
+
+   [ 'fbncsieve/small_p', '', '-k 3 -K 100000 -s k*2^1000+1 -P 1e6' ],
+   [ 'fbncsieve/large_p', '', '-k 3 -K 100000 -s k*2^1000+1 -p 1e12 -P 1000300e6' ],
+   [ 'fbncsieve/sparse',  '-k 3 -K 100000000 -s k*2^1000+1 -P 1e6', '-p 1e12 -P 1000040e6' ],
+   [ 'fbncsieve/many',    '', '-k 3 -K 100000000 -s k*2^1000+1 -p 1e12 -P 1000040e6' ],
+
+   [ 'fkbnsieve/small_p', '', '-c -1000 -C 1000 -s 1*2^1000+c -P 1e6' ],
+   [ 'fkbnsieve/large_p', '', '-c -1000 -C 1000 -s 1*2^1000+c -p 1e12 -P 1000300e6' ],
+
+   [ 'gcwsieve/small_p',  '', '-b 2 -n 1000 -N 5000 -s b -P 1e6' ],
+   [ 'gcwsieve/large_p',  '', '-b 2 -n 1000 -N 5000 -s b -p 1e12 -P 1000003e6' ],
+   [ 'gcwsieve/sparse',   '-b 2 -n 1000 -N 50000 -s b -P 1e6', '-p 1e12 -P 1000002e6' ],
+
+   [ 'gfndsieve/small_p', '', '-k 3 -K 1000 -n 100 -N 200 -P 1e6' ],
+   [ 'gfndsieve/large_p', '', '-k 3 -K 1000 -n 100 -N 200 -p 1e12 -P 1000200e6' ],
+
+   [ 'hcwsieve/small_p',  '', '-b 2 -B 50 -n 3 -N 100 -s + -P 1e6' ],
+   [ 'hcwsieve/large_p',  '', '-b 2 -B 50 -n 3 -N 100 -s + -p 1e12 -P 1000002e6' ],
+
+   [ 'k1b2sieve/small_p', '', '-n 100 -N 200 -c -1000 -C 1000 -P 1e6' ],
+   [ 'k1b2sieve/large_p', '', '-n 100 -N 200 -c -1000 -C 1000 -p 1e12 -P 1000040e6' ],
+
+   [ 'kbbsieve/small_p',  '', '-k 3 -b 2 -B 2000 -P 1e6' ],
+   [ 'kbbsieve/large_p',  '', '-k 3 -b 2 -B 2000 -p 1e12 -P 1000003e6' ],
+
+   [ 'lifsieve/small_p',  '', '-x 20 -X 200 -y 20 -Y 200 -s b -P 1e6' ],
+   [ 'lifsieve/large_p',  '', '-x 20 -X 200 -y 20 -Y 200 -s b -p 1e12 -P 1000006e6' ],
+
+   [ 'mfsieve/small_p',   '', '-n 100 -N 10000 -m 2 -P 1e6' ],
+   [ 'mfsieve/large_p',   '', '-n 100 -N 10000 -m 2 -p 1e12 -P 1000005e6' ],
+
+   [ 'pixsieve/small_p',  '', '-s benchmark_string.txt -l 10 -L 2000 -P 1e6' ],
+   [ 'pixsieve/large_p',  '', '-s benchmark_string.txt -l 10 -L 2000 -p 1e12 -P 1000010e6' ],
+
+   [ 'psieve/small_p',    '', '-n 100 -N 10000 -P 1e6' ],
+   [ 'psieve/large_p',    '', '-n 100 -N 10000 -p 1e12 -P 1000003e6' ],
+
+   [ 'sgsieve/small_p',   '', '-k 1 -K 100000 -b 2 -n 1000 -P 1e6' ],
+   [ 'sgsieve/large_p',   '', '-k 1 -K 100000 -b 2 -n 1000 -p 1e12 -P 1000250e6' ],
+
+   [ 'smsieve/small_p',   '', '-n 100000 -N 101000 -P 1e6' ],
+   [ 'smsieve/large_p',   '', '-n 100000 -N 101000 -p 1e12 -P 1000030e6' ],
+
+   [ 'smwsieve/small_p',  '', '-n 10000 -N 11000 -P 1e6' ],
+   [ 'smwsieve/large_p',  '', '-n 10000 -N 11000 -p 1e12 -P 1000014e6' ],
+
+   [ 'srsieve2/small_p',  '', '-n 1000 -N 5000 -s 3*2^n-1 -s 5*2^n+1 -P 1e6' ],
+   [ 'srsieve2/sparse',   '-n 1000 -N 5000 -s 3*2^n-1 -s 5*2^n+1 -P 1e6', '-p 1e12 -P 1000035e6' ],
+   [ 'srsieve2/few',      '-n 1000 -N 5000 -s 3*2^n-1 -P 1e6', '-p 1e12 -P 1000035e6' ],
+   [ 'srsieve2/generic',  '-n 1000 -N 4000 -s 3*2^n+7 -s 5*2^n-7 -P 1e6', '-p 1e12 -P 1000030e6' ],
+
+   [ 'twinsieve/small_p', '', '-k 1 -K 100000 -t 1 -b 2 -n 1000 -P 1e6' ],
+   [ 'twinsieve/large_p', '', '-k 1 -K 100000 -t 1 -b 2 -n 1000 -p 1e12 -P 1000300e6' ],
+   [ 'twinsieve/sparse',  '-k 1 -K 100000000 -t 1 -b 2 -n 1000 -P 1e6', '-p 1e12 -P 1000120e6' ],
+
+   [ 'xyyxsieve/small_p', '', '-x 10 -X 200 -y 10 -Y 200 -s + -P 1e6' ],
+   [ 'xyyxsieve/large_p', '', '-x 10 -X 200 -y 10 -Y 200 -s + -p 1e12 -P 10000007e5' ],
+);
+
+my $work_directory = 'benchmark_work';
+my $input_file = 'benchmark_input.txt';
+my $terms_file = 'benchmark_terms.txt';
+my $factors_file = 'benchmark_factors.txt';
+my $stats_file = 'benchmark_stats.json';
+my $string_file = 'benchmark_string.txt';
+
+my %options;
+getopts('r:b:t:n:f:l:', \%options) or die "Usage: perl benchmark.pl [-r results] [-b baseline] [-t tolerance] [-n runs] [-f filter] [-l label] programs\n";
+
+my $results_file = $options{'r'} // 'benchmark_results.txt';
+my $baseline_file = $options{'b'};
+my $tolerance = $options{'t'} // 5;
+my $runs = $options{'n'} // 3;
+my $filter = $options{'f'};
+my $label = $options{'l'} // '';
+
+die "No programs were given\n" if (scalar(@ARGV) == 0);
+die "The number of runs must be at least 1\n" if ($runs < 1);
+
+my %programs = map { $_ => 1 } @ARGV;
+my $program_directory = getcwd();
+
+# The results for the baseline must be read before the results file is written
+# since they could be the same file
+my %baseline;
+%baseline = read_results($baseline_file) if (defined($baseline_file) && -e $baseline_file);
+
+rmtree($work_directory);
+mkdir($work_directory) or die "Unable to create $work_directory: $!\n";
+chdir($work_directory) or die "Unable to change to $work_directory: $!\n";
+
+write_string_file();
+
+my %results;
+my @names;
+my $failed = 0;
+
+foreach my $workload (@workloads) {
+   my ($name, $create_arguments, $sieve_arguments) = @$workload;
+   my ($program) = ($name =~ /^([^\/]+)\//);
+
+   next if (!exists($programs{$program}));
+   next if (defined($filter) && $name !~ /$filter/);
+
+   push @names, $name;
+
+   for (my $run=0; $run<$runs; $run++) {
+      my $result = run_workload($program, $create_arguments, $sieve_arguments);
+
+      if (!defined($result)) {
+         print "$name failed\n";
+         $results{$name} = undef;
+         $failed++;
+         last;
+      }
+
+      printf("%-20s %12.1f primes/sec %8u KB %8.3f sec startup %8.3f sec\n", $name, @$result);
+
+      if (!defined($results{$name})) {
+         $results{$name} = $result;
+         next;
+      }
+
+      # Keep the best of each measurement.  Elapsed time goes with primes per second.
+      my $best = $results{$name};
+      @$best[0, 3] = @$result[0, 3] if ($result->[0] > $best->[0]);
+      $best->[1] = $result->[1] if ($result->[1] < $best->[1]);
+      $best->[2] = $result->[2] if ($result->[2] < $best->[2]);
+   }
+}
+
+chdir($program_directory);
+rmtree($work_directory);
+
+open(my $out, '>', $results_file) or die "Unable to open $results_file: $!\n";
+
+print $out "# benchmark.pl results written " . localtime() . "\n";
+print $out "# label: $label\n" if ($label ne '');
+print $out "# workload primes_per_second peak_resident_kb startup_seconds elapsed_seconds\n";
+
+foreach my $name (@names) {
+   next if (!defined($results{$name}));
+
+   printf $out ("%s %.1f %u %.3f %.3f\n", $name, @{$results{$name}});
+}
+
+close($out);
+
+print "Results written to $results_file\n";
+
+my $regressions = 0;
+
+if (scalar(keys %baseline) > 0) {
+   $regressions = compare_results();
+}
+elsif (defined($baseline_file)) {
+   print "There is no baseline in $baseline_file to compare to\n";
+}
+
+print "$failed workloads failed\n" if ($failed > 0);
+
+exit(($failed > 0 || $regressions > 0) ? 1 : 0);
+
+# Return primes per second, peak resident memory in KB, startup seconds, and elapsed
+# seconds or undef if the program fails
+sub run_workload {
+   my ($program, $create_arguments, $sieve_arguments) = @_;
+   my $command = "\"$program_directory/$program\"";
+
+   unlink($input_file, $terms_file, $factors_file, $stats_file);
+
+   if ($create_arguments ne '') {
+      if (system("$command $create_arguments -W 1 -o $input_file > benchmark_create.log 2>&1") != 0) {
+         print_log_tail('benchmark_create.log');
+         return undef;
+      }
+
+      $sieve_arguments = "-i $input_file $sieve_arguments";
+   }
+
+   my $start_time = time();
+
+   if (system("$command $sieve_arguments -W 1 -w 16000F -o $terms_file -O $factors_file -9 $stats_file > benchmark_sieve.log 2>&1") != 0) {
+      print_log_tail('benchmark_sieve.log');
+      return undef;
+   }
+
+   my $elapsed_seconds = time() - $start_time;
+
+   open(my $in, '<', $stats_file) or return undef;
+   my $stats = join('', <$in>);
+   close($in);
+
+   my ($status) = ($stats =~ /"status": "(\w+)"/);
+   my ($primes_per_second) = ($stats =~ /"primes_per_second": ([\d.]+)/);
+   my ($peak_resident_bytes) = ($stats =~ /"peak_resident_bytes": (\d+)/);
+   my ($startup_seconds) = ($stats =~ /"startup_seconds": ([\d.]+)/);
+
+   return undef if (!defined($status) || $status ne 'completed');
+   return undef if (!defined($primes_per_second) || !defined($peak_resident_bytes) || !defined($startup_seconds));
+
+   return [$primes_per_second, int($peak_resident_bytes / 1024), $startup_seconds, $elapsed_seconds];
+}
+
+sub print_log_tail {
+   my ($log_file) = @_;
+
+   open(my $in, '<', $log_file) or return;
+   my @lines = <$in>;
+   close($in);
+
+   splice(@lines, 0, -3);
+   print "   $_" foreach (@lines);
+}
+
+sub read_results {
+   my ($file_name) = @_;
+   my %file_results;
+
+   open(my $in, '<', $file_name) or die "Unable to open $file_name: $!\n";
+
+   while (my $line = <$in>) {
+      $line =~ s/[\r\n]*$//;
+      next if ($line eq '' || $line =~ /^#/);
+
+      my ($name, @values) = split(/\s+/, $line);
+      die "Line $line in $file_name is malformed\n" if (scalar(@values) != 4);
+
+      $file_results{$name} = \@values;
+   }
+
+   close($in);
+
+   return %file_results;
+}
+
+# Each line shows the new result and its change from the baseline for primes per second,
+# memory, and startup time
+sub compare_results {
+   my $regressions = 0;
+
+   print "\nCompared to $baseline_file with a tolerance of $tolerance%:\n";
+
+   foreach my $name (@names) {
+      next if (!defined($results{$name}));
+
+      if (!exists($baseline{$name})) {
+         printf("%-20s is not in the baseline\n", $name);
+         next;
+      }
+
+      my ($pps, $kb, $startup) = @{$results{$name}};
+      my ($base_pps, $base_kb, $base_startup) = @{$baseline{$name}};
+      my @worse;
+
+      push @worse, 'primes/sec' if ($pps < $base_pps * (1 - $tolerance / 100));
+      push @worse, 'memory' if ($kb > $base_kb * (1 + $tolerance / 100) && $kb - $base_kb >= 1024);
+      push @worse, 'startup' if ($startup > $base_startup * (1 + $tolerance / 100) && $startup - $base_startup >= 0.020);
+
+      printf("%-20s %12.1f primes/sec (%+6.1f%%) %8u KB (%+6.1f%%) %8.3f sec startup (%+.3f)%s\n",
+             $name, $pps, percent_change($base_pps, $pps), $kb, percent_change($base_kb, $kb),
+             $startup, $startup - $base_startup, (scalar(@worse) > 0 ? '  REGRESSION: ' . join(', ', @worse) : ''));
+
+      $regressions++ if (scalar(@worse) > 0);
+   }
+
+   if ($regressions > 0) {
+      print "$regressions workloads are slower or use more memory than the baseline\n";
+   }
+   else {
+      print "No workloads are slower or use more memory than the baseline\n";
+   }
+
+   return $regressions;
+}
+
+sub percent_change {
+   my ($old, $new) = @_;
+
+   return 0 if ($old == 0);
+
+   return ($new - $old) * 100 / $old;
+}
+
+# pixsieve needs a string of digits.  They come from the MINSTD generator, whose
+# products fit in 47 bits, so the string is the same on every computer.
+sub write_string_file {
+   my $x = 1;
+   my $digits = '';
+
+   for (my $idx=0; $idx<5000; $idx++) {
+      $x = ($x * 48271) % 2147483647;
+
+      my $digit = $x % 10;
+      $digit = 1 if ($idx == 0 && $digit == 0);
+      $digits .= $digit;
+   }
+
+   open(my $out, '>', $string_file) or die "Unable to open $string_file: $!\n";
+   print $out "$digits\n";
+   close($out);
+}
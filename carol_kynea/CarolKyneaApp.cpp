@@ -27,6 +27,13 @@
 
 #define BIT(n)          ((n) - ii_MinN)
 
+// These are run by -0 (--selftest).  The factors were found with one worker.
+static const selftest_t selfTests[] = {
+   { "-b 2 -n 1000 -N 5000 -P 1e6", 6481, 0x938a77f4202c318bULL },
+   { "-b 6 -n 1000 -N 2000 -P 1e6", 1508, 0x13eaea1157951ad0ULL },
+   { NULL, 0, 0 }
+};
+
 // This is declared in App.h, but implemented here.  This means that App.h
 // can remain unchanged if using the mtsieve framework for other applications.
 App *get_app(void)
@@ -38,6 +45,7 @@ CarolKyneaApp::CarolKyneaApp() : FactorApp()
 {
    SetBanner(APP_NAME " v" APP_VERSION ", a program to find factors of (b^n+/-1)^2-2 numbers");
    SetLogFileName("cksieve.log");
+   SetSelfTests(selfTests);
 
    ii_Base = 0;
    ii_MinN = 1;
@@ -15,19 +15,14 @@
 #include "Clock.h"
 #include "AlgebraicFactorApp.h"
 
-#include "../primesieve/include/primesieve.hpp"
-
-#define SMALL_PRIME_COUNT  100000
-
 AlgebraicFactorApp::AlgebraicFactorApp(void)
 {
-   // Generate primes for this worker
-   primesieve::generate_n_primes(SMALL_PRIME_COUNT, 1, &iv_SmallPrimes);
+   ip_FactorIndex = new SmallFactorIndex();
 }
 
 AlgebraicFactorApp::~AlgebraicFactorApp(void)
 {
-
+   delete ip_FactorIndex;
 }
 
 // Find root and power such that root^power = number
@@ -54,48 +49,10 @@ void  AlgebraicFactorApp::GetRoot(uint64_t theNumber, uint64_t *root, uint32_t *
    *power = rpow;
 }
 
+// Note that some numbers might not get fully factored.
 uint32_t AlgebraicFactorApp::GetFactorList(uint64_t theNumber, uint64_t *factorList, uint32_t *powerList)
 {
-   uint32_t  distinctFactors = 0;
-   uint32_t  power;
-   uint64_t  thePrime;
-
-   std::vector<uint64_t>::iterator it = iv_SmallPrimes.begin(); 
-         
-   // Get the prime factorization of the input number.  Note that since the vector only has
-   // 100000 primes, some numbers might not get fully factored.
-   while (it != iv_SmallPrimes.end())
-   {
-      thePrime = *it;
-      it++;
-      
-      power = 0;
-      while (theNumber % thePrime == 0)
-      {
-         theNumber /= thePrime;
-         power++;
-      }
-
-      if (power > 0)
-      {
-         factorList[distinctFactors] = thePrime;
-         powerList[distinctFactors] = power;
-         distinctFactors++;
-         
-         if (theNumber < thePrime * thePrime)
-            break;
-      }
-   }
-
-   // If then number wasn't fully factored, that's fine.
-   if (theNumber > 1)
-   {
-      factorList[distinctFactors] = theNumber;
-      powerList[distinctFactors] = 1;
-      distinctFactors++;
-   }
-
-   return distinctFactors;
+   return ip_FactorIndex->Factor(theNumber, factorList, powerList);
 }
 
 // If c = -1 and k=2^f and b=2^g for any f and g, then this is a Mersenne number.
@@ -13,6 +13,7 @@
 
 #include "FactorApp.h"
 #include "SharedMemoryItem.h"
+#include "SmallFactorIndex.h"
 
 
 class AlgebraicFactorApp : public FactorApp
@@ -29,10 +30,9 @@ protected:
    void              GetRoot(uint64_t theNumber, uint64_t *root, uint32_t *power);
    
 private:   
-   // These variables are used by this class when looking for algebraic factors.
-   std::vector<uint64_t>  iv_SmallPrimes;
+   // This is used by this class when looking for algebraic factors.
+   SmallFactorIndex *ip_FactorIndex;
    
-   void              GetSmallPrimes(void);
    uint32_t          GetFactorList(uint64_t the_number, uint64_t *factor_list, uint32_t *power_list);
 };
 
@@ -35,6 +35,7 @@
 
 // Do not change this as some parts of the framework assume that this is set to 60 seconds
 #define REPORT_SECONDS        60
+#define STATS_SECONDS         10
 #define REPORT_STRFTIME_FORMAT "ETC %Y-%m-%d %H:%M"
 #define LOG_STRFTIME_FORMAT    "%Y-%m-%d %H:%M:%S"
 
@@ -78,11 +79,22 @@ App::App(void)
    
    // We won't know this until we create a kernel in the GPU
    il_MinGpuPrime = 0;
+   il_CreatedUS = Clock::GetCurrentMicrosecond();
+   il_StartupUS = 0;
    ib_HaveCreatedWorkers = false;
    ib_SetMinPrimeFromCommandLine = false;
    ib_FixedCpuWorkSize = false;
+   ib_SelfTest = false;
+   ip_SelfTests = NULL;
 
    ip_Workers = (Worker **) xmalloc(MAX_WORKERS + 1, sizeof(Worker *), "workers");
+   ip_CpuAffinity = NULL;
+   ip_WorkSizeTuner = new WorkSizeTuner(this);
+
+#ifdef USE_PHASE_PROFILER
+   for (uint32_t phase=0; phase<PP_PHASES; phase++)
+      il_PhaseTicks[phase] = 0;
+#endif
    
 #if defined(USE_OPENCL)
    ip_GpuDevice = new OpenCLDevice();
@@ -101,6 +113,11 @@ App::~App(void)
 
    xfree(ip_Workers);
    
+   if (ip_CpuAffinity != NULL)
+      delete ip_CpuAffinity;
+   
+   delete ip_WorkSizeTuner;
+   
    delete ip_Console;
    delete ip_AppStatus;
    delete ip_SievingStatus;
@@ -131,6 +148,10 @@ void App::ParentHelp(void)
    printf("-P --pmax=P1          sieve end: p < P1 (default %s)\n", maxPrime);
    printf("-w --worksize=w       initial primes per chunk of work (default %u)\n", ii_CpuWorkSize);
    printf("-W --workers=W        start W workers (default %u)\n", ii_CpuWorkerCount);
+   printf("-1 --pin              bind each worker to one CPU\n");
+   printf("-2 --numa             spread workers across NUMA nodes and allocate their memory on their node\n");
+   printf("-9 --statsfile=s      rewrite statistics in JSON to file s every %u seconds\n", STATS_SECONDS);
+   printf("-0 --selftest         run the built-in tests and verify the factors that they find\n");
 
 #if defined(USE_OPENCL) || defined(USE_METAL)
    printf("-g --gpuworkgroups=g  work groups per call to GPU (default %u)\n", ii_GpuWorkGroups);
@@ -142,12 +163,16 @@ void App::ParentHelp(void)
 
 void  App::ParentAddCommandLineOptions(std::string &shortOpts, struct option *longOpts)
 {
-   shortOpts += "p:P:w:W:";
+   shortOpts += "p:P:w:W:129:0";
 
    AppendLongOpt(longOpts, "pmin",          required_argument, 0, 'p');
    AppendLongOpt(longOpts, "pmax",          required_argument, 0, 'P');
    AppendLongOpt(longOpts, "worksize",      required_argument, 0, 'w');
    AppendLongOpt(longOpts, "workers",       required_argument, 0, 'W');
+   AppendLongOpt(longOpts, "pin",           no_argument,       0, '1');
+   AppendLongOpt(longOpts, "numa",          no_argument,       0, '2');
+   AppendLongOpt(longOpts, "statsfile",     required_argument, 0, '9');
+   AppendLongOpt(longOpts, "selftest",      no_argument,       0, '0');
    
 #if defined(USE_OPENCL) || defined(USE_METAL)
    shortOpts += "g:G:";
@@ -198,6 +223,29 @@ parse_t App::ParentParseOption(int opt, char *arg, const char *source)
          status = Parser::Parse(arg, 12, 1000000000, ii_CpuWorkSize);
          break;
 
+      case '1':
+      case '2':
+         if (ip_CpuAffinity == NULL)
+            ip_CpuAffinity = new CpuAffinity();
+         
+         if (opt == '1')
+            ip_CpuAffinity->SetPinWorkers(true);
+         else
+            ip_CpuAffinity->SetUseNodes(true);
+         
+         status = P_SUCCESS;
+         break;
+
+      case '9':
+         is_StatsFileName = arg;
+         status = P_SUCCESS;
+         break;
+
+      case '0':
+         ib_SelfTest = true;
+         status = P_SUCCESS;
+         break;
+
 #if defined(USE_OPENCL) || defined(USE_METAL)
       case 'g':
          status = Parser::Parse(arg, 1, 1000000, ii_GpuWorkGroups);
@@ -242,6 +290,22 @@ void App::ParentValidateOptions(void)
 
    ii_TotalWorkerCount = ii_CpuWorkerCount + ii_GpuWorkerCount;
    
+   if (ip_CpuAffinity != NULL)
+   {
+      if (!ip_CpuAffinity->IsSupported())
+      {
+         WriteToConsole(COT_OTHER, "Options -1 and -2 are ignored as they are not supported on this platform");
+         
+         delete ip_CpuAffinity;
+         ip_CpuAffinity = NULL;
+      }
+      else
+         WriteToConsole(COT_OTHER, "Placing %u workers on %u CPUs in %u NUMA node%s%s",
+                        ii_TotalWorkerCount, ip_CpuAffinity->GetCpuCount(), ip_CpuAffinity->GetNodeCount(),
+                        (ip_CpuAffinity->GetNodeCount() == 1 ? "" : "s"),
+                        (ip_CpuAffinity->IsPinningWorkers() ? " with one CPU per worker" : ""));
+   }
+   
 #if defined(USE_OPENCL) || defined(USE_METAL)
    ip_GpuDevice->ValidateOptions();
 #endif
@@ -420,6 +484,14 @@ void  App::SetMaxPrime(uint64_t maxPrime, const char *why)
    il_MaxPrime = maxPrime;
 }
  
+// The other options are ignored since each test has its own options
+bool  App::RunSelfTests(const char *programName)
+{
+   SelfTest selfTest(programName, ip_SelfTests);
+   
+   return selfTest.Run();
+}
+
 void  App::Run(void)
 {
    bool isDone;
@@ -447,7 +519,13 @@ void  App::Run(void)
       isDone = PostSieveHook();
 
       if (!isDone)
+      {
          DeleteWorkers();
+         
+         // Reset the sieving status since Sieve() had changed it to SS_DONE.  If this
+         // isn't done the new workers exit as soon as they start.
+         ip_SievingStatus->SetValueNoLock(SS_NOT_STARTED);
+      }
    } while (!isDone);
 }
 
@@ -471,8 +549,12 @@ void  App::Sieve(void)
    il_StartSievingProcessUS = Clock::GetProcessMicroseconds();
    il_StartSievingUS = Clock::GetCurrentMicrosecond();
 
+   if (il_StartupUS == 0)
+      il_StartupUS = il_StartSievingUS - il_CreatedUS;
+
    it_StartTime = time(NULL);
    it_ReportTime = it_StartTime + REPORT_SECONDS;
+   it_StatsTime = it_StartTime + STATS_SECONDS;
    
    useSingleThread = (il_LargestPrimeSieved < il_MaxPrimeForSingleWorker);
    
@@ -626,7 +708,7 @@ uint64_t  App::GetPrimesForWorker(uint32_t th)
 {
    uint64_t  sieveStartUS = Clock::GetThreadMicroseconds();
       
-   uint32_t  maxPrimesInList = ip_Workers[th]->GetMaxWorkSize();
+   uint32_t  maxPrimesInList = ip_Workers[th]->GetWorkSize();
    uint64_t *primeList = ip_Workers[th]->GetPrimeList();
    uint32_t  pIdx = 0;
 
@@ -685,6 +767,9 @@ uint64_t  App::PauseSievingAndRebuild(void)
    // Reset the sieving status since StopWorkers had changed to SS_DONE
    ip_SievingStatus->SetValueNoLock(SS_SIEVING);
    
+   // The workers might use different logic after the rebuild
+   ip_WorkSizeTuner->Reset();
+   
    CreateWorkers(largestPrimeTested);
    
    ResetFactorStats();
@@ -703,6 +788,12 @@ void  App::CheckReportStatus(void)
       ReportStatus();
       it_ReportTime = theTime + REPORT_SECONDS;
    }
+   
+   if (is_StatsFileName.length() > 0 && theTime > it_StatsTime)
+   {
+      WriteStatsFile("sieving");
+      it_StatsTime = theTime + STATS_SECONDS;
+   }
 }
 
 void  App::DeleteWorkers(void)
@@ -712,6 +803,11 @@ void  App::DeleteWorkers(void)
       // ip_Worker[0] is the special CPU worker (if we need one)
       if (ii == 0 && ip_Workers[0] == NULL)
          continue;
+
+#ifdef USE_PHASE_PROFILER
+      for (uint32_t phase=0; phase<PP_PHASES; phase++)
+         il_PhaseTicks[phase] += ip_Workers[ii]->GetPhaseTicks(phase);
+#endif
             
       ip_Workers[ii]->CleanUp();
 
@@ -736,6 +832,10 @@ void  App::CreateWorkers(uint64_t largestPrimeTested)
       //    the next prime tested cannot be tested on a GPU
       WriteToConsole(COT_OTHER, "Creating CPU worker to use until p >= %" PRIu64"", il_MinGpuPrime);
       
+      // The memory allocated by the constructor of each worker is first touched
+      // by this thread, so it is moved to that worker's NUMA node for -2.
+      PlaceWorkerThread(0);
+      
       ip_Workers[0] = CreateWorker(0, false, largestPrimeTested);
    }
 
@@ -744,10 +844,18 @@ void  App::CreateWorkers(uint64_t largestPrimeTested)
    // This will create the workers and start executing them
    // Create the CPU workers first, then the GPU workers
    for (w=0; w<ii_CpuWorkerCount; w++, th++)
+   {
+      PlaceWorkerThread(th);
       ip_Workers[th] = CreateWorker(th, false, largestPrimeTested);
+   }
    
    for (w=0; w<ii_GpuWorkerCount; w++, th++)
+   {
+      PlaceWorkerThread(th);
       ip_Workers[th] = CreateWorker(th, true, largestPrimeTested);
+   }
+   
+   RestoreThreadPlacement();
       
    ib_HaveCreatedWorkers = true;
    
@@ -812,10 +920,145 @@ void  App::Finish(void)
 #endif
 
    Finish(finishMethod, elapsedTimeUS, largestPrimeTested, primesTested);
+
+#ifdef USE_PHASE_PROFILER
+   ReportPhases();
+#endif
+   
+   if (is_StatsFileName.length() > 0)
+      WriteStatsFile(finishMethod);
    
    ip_AppStatus->SetValueNoLock(AS_FINISHED);
 }
 
+#ifdef USE_PHASE_PROFILER
+// This includes the workers that were deleted when rebuilding
+void  App::ReportPhases(void)
+{
+   uint64_t phaseTicks[PP_PHASES];
+   uint64_t totalTicks = 0;
+   uint32_t phase;
+   
+   for (phase=0; phase<PP_PHASES; phase++)
+   {
+      phaseTicks[phase] = il_PhaseTicks[phase];
+      
+      for (uint32_t th=0; th<=ii_TotalWorkerCount; th++)
+         if (ip_Workers[th] != NULL)
+            phaseTicks[phase] += ip_Workers[th]->GetPhaseTicks(phase);
+      
+      totalTicks += phaseTicks[phase];
+   }
+   
+   if (totalTicks == 0)
+      return;
+   
+   WriteToConsole(COT_OTHER, "Time in each phase of the workers (%s):", PhaseProfiler::GetTickName());
+   
+   for (phase=0; phase<PP_PHASES; phase++)
+      WriteToConsole(COT_OTHER, "  %-12s %20" PRIu64"  %6.2f%%", PhaseProfiler::GetPhaseName(phase),
+                     phaseTicks[phase], 100.0 * (double) phaseTicks[phase] / (double) totalTicks);
+}
+#endif
+
+// This is for a supervisor of the program, so it is rewritten with a temporary file
+// so that a reader never sees a partial file.
+void  App::WriteStatsFile(const char *sievingStatus)
+{
+   uint64_t    largestPrimeTestedNoGaps, largestPrimeTested, primesTested;
+   uint64_t    workerCpuUS, elapsedTimeUS, currentUS;
+   uint64_t    workerPrimesTested, workerWorkingUS, workerElapsedUS;
+   const char *workerStatus;
+   std::string tempFileName = is_StatsFileName + ".tmp";
+   FILE       *statsFile;
+   bool        firstWorker = true;
+   
+   currentUS = Clock::GetCurrentMicrosecond();
+   elapsedTimeUS = currentUS - il_StartSievingUS;
+   
+   if (elapsedTimeUS == 0)
+      elapsedTimeUS = 1;
+   
+   GetWorkerStats(workerCpuUS, largestPrimeTestedNoGaps, largestPrimeTested, primesTested);
+   
+   if ((statsFile = fopen(tempFileName.c_str(), "w")) == NULL)
+   {
+      WriteToConsole(COT_OTHER, "Unable to open stats file %s", tempFileName.c_str());
+      is_StatsFileName = "";
+      return;
+   }
+   
+   fprintf(statsFile, "{\n");
+   fprintf(statsFile, "   \"time\": %" PRIu64",\n", (uint64_t) time(NULL));
+   fprintf(statsFile, "   \"status\": \"%s\",\n", sievingStatus);
+   fprintf(statsFile, "   \"elapsed_seconds\": %.3f,\n", (double) elapsedTimeUS / 1000000.0);
+   fprintf(statsFile, "   \"min_prime\": %" PRIu64",\n", il_MinPrime);
+   fprintf(statsFile, "   \"max_prime\": %" PRIu64",\n", il_MaxPrime);
+   fprintf(statsFile, "   \"largest_prime_tested\": %" PRIu64",\n", largestPrimeTested);
+   fprintf(statsFile, "   \"largest_prime_tested_no_gaps\": %" PRIu64",\n", largestPrimeTestedNoGaps);
+   fprintf(statsFile, "   \"primes_tested\": %" PRIu64",\n", primesTested);
+   fprintf(statsFile, "   \"primes_per_second\": %.1f,\n", (double) primesTested * 1000000.0 / (double) elapsedTimeUS);
+   fprintf(statsFile, "   \"cpu_utilization\": %.3f,\n", (double) (Clock::GetProcessMicroseconds() - il_StartSievingProcessUS) / (double) elapsedTimeUS);
+   fprintf(statsFile, "   \"cpu_worksize\": %u,\n", GetCpuWorkSize());
+   fprintf(statsFile, "   \"memory_bytes\": %" PRIu64",\n", GetCpuMemoryUsage());
+   fprintf(statsFile, "   \"peak_resident_bytes\": %" PRIu64",\n", GetPeakResidentBytes());
+   fprintf(statsFile, "   \"startup_seconds\": %.3f,\n", (double) il_StartupUS / 1000000.0);
+   fprintf(statsFile, "   \"workers\": [");
+   
+   for (uint32_t th=0; th<=ii_TotalWorkerCount; th++)
+   {
+      if (ip_Workers[th] == NULL)
+         continue;
+      
+      switch (ip_Workers[th]->GetStatus())
+      {
+         case WS_WAITING_FOR_WORK: workerStatus = "waiting";      break;
+         case WS_HAS_WORK_TO_DO:   workerStatus = "has_work";     break;
+         case WS_WORKING:          workerStatus = "working";      break;
+         case WS_STOPPED:          workerStatus = "stopped";      break;
+         default:                  workerStatus = "initializing"; break;
+      }
+      
+      ip_Workers[th]->LockStats();
+      
+      workerPrimesTested = ip_Workers[th]->GetPrimesTested();
+      workerWorkingUS = ip_Workers[th]->GetWorkerCpuUS();
+      workerElapsedUS = currentUS - ip_Workers[th]->GetStartProcessingUS();
+      
+      // The time of the chunk being tested is not yet in workerWorkingUS
+      if (workerElapsedUS < workerWorkingUS)
+         workerElapsedUS = workerWorkingUS;
+      
+      fprintf(statsFile, "%s\n      {\"id\": %u, \"gpu\": %s, \"status\": \"%s\", \"chunk_size\": %u, \"chunks_tested\": %" PRIu64", ",
+              (firstWorker ? "" : ","), th, (ip_Workers[th]->IsGpuWorker() ? "true" : "false"), workerStatus,
+              ip_Workers[th]->GetWorkSize(), ip_Workers[th]->GetChunksTested());
+      fprintf(statsFile, "\"primes_tested\": %" PRIu64", \"primes_per_second\": %.1f, \"working_seconds\": %.3f, \"waiting_seconds\": %.3f, \"largest_prime_tested\": %" PRIu64"}",
+              workerPrimesTested, (workerWorkingUS == 0 ? 0.0 : (double) workerPrimesTested * 1000000.0 / (double) workerWorkingUS),
+              (double) workerWorkingUS / 1000000.0, (double) (workerElapsedUS - workerWorkingUS) / 1000000.0,
+              ip_Workers[th]->GetLargestPrimeTested());
+      
+      ip_Workers[th]->ReleaseStats();
+      
+      firstWorker = false;
+   }
+   
+   fprintf(statsFile, "\n   ]");
+   
+   WriteStatsFileFields(statsFile, elapsedTimeUS);
+   
+   fprintf(statsFile, "\n}\n");
+   
+   fclose(statsFile);
+
+#ifdef WIN32
+   // rename() will not replace an existing file on Windows
+   remove(is_StatsFileName.c_str());
+#endif
+
+   if (rename(tempFileName.c_str(), is_StatsFileName.c_str()) != 0)
+      WriteToConsole(COT_OTHER, "Unable to rename %s to %s", tempFileName.c_str(), is_StatsFileName.c_str());
+}
+
 void  App::ReportStatus(void)
 {
    double   percentDone;
@@ -36,6 +36,10 @@ class App;
 
 #include "Worker.h"
 #include "SharedMemoryItem.h"
+#include "CpuAffinity.h"
+#include "PhaseProfiler.h"
+#include "WorkSizeTuner.h"
+#include "SelfTest.h"
 
 #include "../primesieve/include/primesieve.hpp"
 
@@ -65,8 +69,13 @@ public:
    virtual parse_t   ParseOption(int opt, char *arg, const char *source) = 0;
    virtual void      ValidateOptions(void) = 0;
    
-   uint32_t          GetCpuWorkSize(void) { return ii_CpuWorkSize; };
+   // Once the workers have tested a chunk, this is the worksize chosen by the tuner
+   uint32_t          GetCpuWorkSize(void) { return (ip_WorkSizeTuner->GetWorkSize() > 0 ? ip_WorkSizeTuner->GetWorkSize() : ii_CpuWorkSize); };
    bool              IsFixedCpuWorkSize(void) { return ib_FixedCpuWorkSize; };
+   
+   // This is called by the CPU workers after each chunk unless the worksize is fixed
+   uint32_t          TuneCpuWorkSize(uint32_t workSize, uint32_t primesTested, uint64_t chunkUS, uint64_t largestPrime, bool miniChunks)
+                        { return ip_WorkSizeTuner->AddSample(workSize, primesTested, chunkUS, largestPrime, miniChunks); };
    uint32_t          GetTotalWorkers(void) { return ii_TotalWorkerCount; };
    uint64_t          GetMaxPrimeForSingleWorker(void) { return il_MaxPrimeForSingleWorker; };
    
@@ -74,6 +83,13 @@ public:
    
    uint32_t          GetCpuWorkerCount(void) { return ii_CpuWorkerCount; };
    uint32_t          GetGpuWorkerCount(void) { return ii_GpuWorkerCount; };
+
+   // These are for -1 and -2.  Without -2 there is one NUMA node.
+   uint32_t          GetNumaNodeCount(void) { return (ip_CpuAffinity == NULL ? 1 : ip_CpuAffinity->GetNodeCount()); };
+   uint32_t          GetNumaNodeForWorker(uint32_t workerId) { return (ip_CpuAffinity == NULL ? 0 : ip_CpuAffinity->GetNodeForWorker(workerId)); };
+   void              PlaceWorkerThread(uint32_t workerId) { if (ip_CpuAffinity != NULL) ip_CpuAffinity->MoveThreadToWorker(workerId); };
+   void              MoveThreadToNumaNode(uint32_t node) { if (ip_CpuAffinity != NULL) ip_CpuAffinity->MoveThreadToNode(node); };
+   void              RestoreThreadPlacement(void) { if (ip_CpuAffinity != NULL) ip_CpuAffinity->RestoreThread(); };
    
 #if defined(USE_OPENCL) || defined(USE_METAL)
    uint32_t          GetGpuPrimesPerWorker(void) { return ii_GpuWorkGroupSize * ii_GpuWorkGroups; };
@@ -98,6 +114,10 @@ public:
    void              Interrupt(const char *fmt, ...);
 
    void              Run(void);
+   
+   // This is for -0.  It runs the tests of the app and returns true if all of them pass.
+   bool              IsSelfTest(void) { return ib_SelfTest; };
+   virtual bool      RunSelfTests(const char *programName);
 
 #ifdef __MINGW_PRINTF_FORMAT
    void              WriteToConsole(cotype_t consoleOutputType, const char *fmt, ...) __attribute__ ((format (__MINGW_PRINTF_FORMAT, 3, 4)));
@@ -119,8 +139,13 @@ protected:
    
    virtual void      PreSieveHook(void) = 0;
    virtual bool      PostSieveHook(void) = 0;
+   
+   // Apps can add fields to the JSON object written for -9.  Each field is written
+   // as ",\n   \"name\": value".
+   virtual void      WriteStatsFileFields(FILE *statsFile, uint64_t elapsedTimeUS) {};
 
    void              SetBanner(std::string banner) { is_Banner = banner; };
+   void              SetSelfTests(const selftest_t *selfTests) { ip_SelfTests = selfTests; };
    void              SetLogFileName(std::string logFileName);
    void              SetMaxPrimeForSingleWorker(uint64_t maxPrimeForSingleWorker)
    {
@@ -170,6 +195,11 @@ protected:
    uint64_t          il_StartSievingProcessUS;
    uint64_t          il_StartSievingUS;
    
+   // This is the time from when the app was created until it first started sieving,
+   // which includes reading or building the terms and the tables that the app needs
+   uint64_t          il_CreatedUS;
+   uint64_t          il_StartupUS;
+   
    uint32_t          ii_CpuWorkSize;
    
 #if defined(USE_OPENCL) || defined(USE_METAL)
@@ -195,6 +225,14 @@ private:
    
    void              Finish(void);
    void              GetPrimeStats(char *primeStats, uint64_t primesTested);
+   void              WriteStatsFile(const char *sievingStatus);
+
+#ifdef USE_PHASE_PROFILER
+   void              ReportPhases(void);
+   
+   // These are the phase times of workers that have been deleted
+   uint64_t          il_PhaseTicks[PP_PHASES];
+#endif
 
 #ifdef USE_X86
    uint32_t          ii_SavedSseMode;
@@ -211,15 +249,22 @@ private:
    SharedMemoryItem *ip_NeedToRebuild;
    
    Worker          **ip_Workers;
+
+   CpuAffinity      *ip_CpuAffinity;
+   WorkSizeTuner    *ip_WorkSizeTuner;
    
    bool              ib_FixedCpuWorkSize;
    bool              ib_SetMinPrimeFromCommandLine;
+   bool              ib_SelfTest;
+   
+   const selftest_t *ip_SelfTests;
    
    uint32_t          ii_CpuWorkerCount;
    uint32_t          ii_GpuWorkerCount;
    uint32_t          ii_TotalWorkerCount;
    
    std::string       is_LogFileName;
+   std::string       is_StatsFileName;
    std::string       is_Banner;
    
    // These represent a number of milli-seconds
@@ -236,6 +281,7 @@ private:
    uint64_t          il_TotalSieveUS;
 
    time_t            it_ReportTime;
+   time_t            it_StatsTime;
 };                
 
 #endif
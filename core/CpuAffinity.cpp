@@ -0,0 +1,230 @@
+/* CpuAffinity.cpp -- (C) Mark Rodenkirch, October 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "CpuAffinity.h"
+
+#ifdef WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <sched.h>
+#include <pthread.h>
+#endif
+
+#ifdef __linux__
+// This parses a list of CPUs or nodes such as "0-3,8-11" from a file in /sys
+static bool ReadList(const char *fileName, std::vector<uint32_t> &list)
+{
+   FILE    *fPtr = fopen(fileName, "r");
+   char     buffer[4000];
+   char    *pos;
+   uint32_t first, last;
+
+   list.clear();
+
+   if (fPtr == NULL)
+      return false;
+
+   if (fgets(buffer, sizeof(buffer), fPtr) == NULL)
+   {
+      fclose(fPtr);
+      return false;
+   }
+
+   fclose(fPtr);
+
+   pos = buffer;
+
+   while (*pos >= '0' && *pos <= '9')
+   {
+      first = last = (uint32_t) strtoul(pos, &pos, 10);
+
+      if (*pos == '-')
+         last = (uint32_t) strtoul(pos + 1, &pos, 10);
+
+      for ( ; first<=last; first++)
+         list.push_back(first);
+
+      if (*pos == ',')
+         pos++;
+   }
+
+   return true;
+}
+#endif
+
+CpuAffinity::CpuAffinity(void)
+{
+   ib_Supported = false;
+   ib_PinWorkers = false;
+   ib_UseNodes = false;
+
+#ifdef WIN32
+   DWORD_PTR processMask, systemMask;
+
+   if (GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+   {
+      for (uint32_t cpu=0; cpu<8*sizeof(DWORD_PTR); cpu++)
+         if (processMask & ((DWORD_PTR) 1 << cpu))
+            iv_AllowedCpus.push_back(cpu);
+   }
+#elif defined(__linux__)
+   cpu_set_t cpuSet;
+
+   CPU_ZERO(&cpuSet);
+
+   if (sched_getaffinity(0, sizeof(cpuSet), &cpuSet) == 0)
+   {
+      for (uint32_t cpu=0; cpu<CPU_SETSIZE; cpu++)
+         if (CPU_ISSET(cpu, &cpuSet))
+            iv_AllowedCpus.push_back(cpu);
+   }
+#endif
+
+   if (iv_AllowedCpus.size() == 0)
+      return;
+
+   ib_Supported = true;
+
+   ReadNodes();
+}
+
+void  CpuAffinity::ReadNodes(void)
+{
+   std::vector<uint32_t> nodeCpus;
+   size_t   idx;
+
+#ifdef WIN32
+   ULONG     highestNode;
+   ULONGLONG nodeMask;
+
+   if (GetNumaHighestNodeNumber(&highestNode))
+   {
+      for (ULONG node=0; node<=highestNode; node++)
+      {
+         nodeCpus.clear();
+
+         if (!GetNumaNodeProcessorMask((UCHAR) node, &nodeMask))
+            continue;
+
+         for (idx=0; idx<iv_AllowedCpus.size(); idx++)
+            if (iv_AllowedCpus[idx] < 64 && (nodeMask & ((ULONGLONG) 1 << iv_AllowedCpus[idx])))
+               nodeCpus.push_back(iv_AllowedCpus[idx]);
+
+         if (nodeCpus.size() > 0)
+            iv_NodeCpus.push_back(nodeCpus);
+      }
+   }
+#elif defined(__linux__)
+   std::vector<uint32_t> nodes, cpus;
+   char     fileName[100];
+
+   if (ReadList("/sys/devices/system/node/online", nodes))
+   {
+      for (uint32_t node : nodes)
+      {
+         snprintf(fileName, sizeof(fileName), "/sys/devices/system/node/node%u/cpulist", node);
+
+         if (!ReadList(fileName, cpus))
+            continue;
+
+         nodeCpus.clear();
+
+         for (idx=0; idx<cpus.size(); idx++)
+            for (size_t allowedIdx=0; allowedIdx<iv_AllowedCpus.size(); allowedIdx++)
+               if (cpus[idx] == iv_AllowedCpus[allowedIdx])
+                  nodeCpus.push_back(cpus[idx]);
+
+         if (nodeCpus.size() > 0)
+            iv_NodeCpus.push_back(nodeCpus);
+      }
+   }
+#endif
+
+   // If the nodes are unknown, then treat all CPUs as one node
+   if (iv_NodeCpus.size() == 0)
+      iv_NodeCpus.push_back(iv_AllowedCpus);
+}
+
+// Worker 0 is only used when there are no CPU workers, so it is placed like worker 1.
+// With -2 consecutive workers are on different nodes.
+uint32_t  CpuAffinity::GetNodeForWorker(uint32_t workerId)
+{
+   uint32_t workerIdx = (workerId > 0 ? workerId - 1 : 0);
+
+   if (!ib_Supported || !ib_UseNodes)
+      return 0;
+
+   return workerIdx % (uint32_t) iv_NodeCpus.size();
+}
+
+void  CpuAffinity::MoveThreadToWorker(uint32_t workerId)
+{
+   uint32_t workerIdx = (workerId > 0 ? workerId - 1 : 0);
+   std::vector<uint32_t> cpus;
+
+   if (!ib_Supported)
+      return;
+
+   if (ib_UseNodes)
+   {
+      const std::vector<uint32_t> &nodeCpus = iv_NodeCpus[GetNodeForWorker(workerId)];
+
+      if (ib_PinWorkers)
+         cpus.push_back(nodeCpus[(workerIdx / iv_NodeCpus.size()) % nodeCpus.size()]);
+      else
+         cpus = nodeCpus;
+   }
+   else
+   {
+      if (ib_PinWorkers)
+         cpus.push_back(iv_AllowedCpus[workerIdx % iv_AllowedCpus.size()]);
+      else
+         cpus = iv_AllowedCpus;
+   }
+
+   SetThreadCpus(cpus);
+}
+
+void  CpuAffinity::MoveThreadToNode(uint32_t node)
+{
+   if (!ib_Supported || node >= iv_NodeCpus.size())
+      return;
+
+   SetThreadCpus(iv_NodeCpus[node]);
+}
+
+void  CpuAffinity::RestoreThread(void)
+{
+   if (!ib_Supported)
+      return;
+
+   SetThreadCpus(iv_AllowedCpus);
+}
+
+void  CpuAffinity::SetThreadCpus(const std::vector<uint32_t> &cpus)
+{
+#ifdef WIN32
+   DWORD_PTR mask = 0;
+
+   for (size_t idx=0; idx<cpus.size(); idx++)
+      mask |= ((DWORD_PTR) 1 << cpus[idx]);
+
+   SetThreadAffinityMask(GetCurrentThread(), mask);
+#elif defined(__linux__)
+   cpu_set_t cpuSet;
+
+   CPU_ZERO(&cpuSet);
+
+   for (size_t idx=0; idx<cpus.size(); idx++)
+      CPU_SET(cpus[idx], &cpuSet);
+
+   pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+#endif
+}
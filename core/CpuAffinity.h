@@ -0,0 +1,70 @@
+/* CpuAffinity.h -- (C) Mark Rodenkirch, October 2026
+
+   This places worker threads on CPUs and NUMA nodes for -1 (--pin) and -2 (--numa).
+
+   With -2 the workers are spread across the NUMA nodes and each worker can only run
+   on the CPUs of its node.  With -1 each worker can only run on one CPU.  With both
+   each worker runs on one CPU of its node.
+
+   Memory is put on the node of the thread that first writes to it.  Since xmalloc
+   clears the small blocks that it allocates, the main thread is moved to the node of
+   each worker while that worker is created so that the memory allocated by the worker's
+   constructor is on the worker's node.  Large blocks are not touched by xmalloc, so
+   they go to the node of the thread that first uses them.  Tables that are shared by
+   the workers can be copied to each node by the app.
+
+   The NUMA nodes are read from /sys/devices/system/node on Linux.  On Windows only
+   the CPUs in the first processor group are used.  This is not supported on OS X since
+   it doesn't allow threads to be bound to CPUs.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+*/
+
+#ifndef _CPUAFFINITY_H
+#define _CPUAFFINITY_H
+
+#include <inttypes.h>
+#include <vector>
+
+class CpuAffinity
+{
+public:
+   CpuAffinity(void);
+
+   ~CpuAffinity(void) {};
+
+   void              SetPinWorkers(bool pinWorkers) { ib_PinWorkers = pinWorkers; };
+   void              SetUseNodes(bool useNodes) { ib_UseNodes = useNodes; };
+
+   bool              IsSupported(void) { return ib_Supported; };
+   bool              IsPinningWorkers(void) { return ib_PinWorkers; };
+   uint32_t          GetCpuCount(void) { return (uint32_t) iv_AllowedCpus.size(); };
+
+   // Without -2 all workers are on node 0
+   uint32_t          GetNodeCount(void) { return (ib_UseNodes ? (uint32_t) iv_NodeCpus.size() : 1); };
+   uint32_t          GetNodeForWorker(uint32_t workerId);
+
+   // These only change the CPUs of the calling thread
+   void              MoveThreadToWorker(uint32_t workerId);
+   void              MoveThreadToNode(uint32_t node);
+   void              RestoreThread(void);
+
+private:
+   void              ReadNodes(void);
+   void              SetThreadCpus(const std::vector<uint32_t> &cpus);
+
+   bool              ib_Supported;
+   bool              ib_PinWorkers;
+   bool              ib_UseNodes;
+
+   // These are the CPUs that the process was allowed to run on when it started
+   std::vector<uint32_t>               iv_AllowedCpus;
+
+   // These are the allowed CPUs of each node that has at least one of them
+   std::vector<std::vector<uint32_t>>  iv_NodeCpus;
+};
+
+#endif
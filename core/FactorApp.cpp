@@ -13,6 +13,7 @@
 #include <stdarg.h>
 #include "Clock.h"
 #include "FactorApp.h"
+#include "PRPTester.h"
 
 #define CHECKPOINT_SECONDS    3600
 
@@ -30,14 +31,25 @@ FactorApp::FactorApp(void)
    il_PreviousFactorCount = 0;
    il_TermCount = 0;
    if_FactorFile = 0;
+   ib_BatchingFactors = false;
    
    id_FPSTarget = 0.0;
    id_SPFTarget = 0.0;
    
    ii_MinutesForStatus = 0;
    
+   ib_PRPStop = false;
+   ii_PRPLocalMinutes = 0;
+   id_SecondsPerPRPTest = 0.0;
+   ip_PRPTester = NULL;
+   ib_StoppedForRemovalRate = false;
+   
    ib_ApplyAndExit = false;
    
+   ii_ShardIndex = 0;
+   ii_ShardCount = 1;
+   ii_ShardBits = 0;
+   
    ResetFactorStats();
 }
 
@@ -46,6 +58,9 @@ FactorApp::~FactorApp(void)
    if (if_FactorFile)
       fclose(if_FactorFile);
 
+   if (ip_PRPTester != NULL)
+      delete ip_PRPTester;
+
    delete ip_FactorAppLock;
 }
 
@@ -61,6 +76,12 @@ void FactorApp::ParentHelp(void)
    printf("-4 --fpstarget=4      stop sieving ASAP when factors per second falls below this value\n");
    printf("-5 --spftarget=5      stop sieving ASAP when seconds per factor goes above this value\n");
    printf("-6 --minutesforspf=6  maximum number of minutes to use for computed seconds per factor\n");
+   
+   if (SupportsPRPTest())
+   {
+      printf("-7 --prpstop          stop sieving ASAP when finding a factor takes longer than a PRP test\n");
+      printf("-8 --prplocal=8       after sieving PRP test the remaining terms if that takes at most this many minutes\n");
+   }
 }
 
 void  FactorApp::ParentAddCommandLineOptions(std::string &shortOpts, struct option *longOpts)
@@ -77,6 +98,14 @@ void  FactorApp::ParentAddCommandLineOptions(std::string &shortOpts, struct opti
    AppendLongOpt(longOpts, "fpstarget",      required_argument, 0, '4');
    AppendLongOpt(longOpts, "spftarget",      required_argument, 0, '5');
    AppendLongOpt(longOpts, "minutesforspf",  required_argument, 0, '6');
+   
+   if (!SupportsPRPTest())
+      return;
+   
+   shortOpts += "78:";
+   
+   AppendLongOpt(longOpts, "prpstop",        no_argument, 0, '7');
+   AppendLongOpt(longOpts, "prplocal",       required_argument, 0, '8');
 }
 
 parse_t FactorApp::ParentParseOption(int opt, char *arg, const char *source)
@@ -126,6 +155,15 @@ parse_t FactorApp::ParentParseOption(int opt, char *arg, const char *source)
       case '6':
          status = Parser::Parse(arg, 1, MAX_FACTOR_REPORT_COUNT, ii_MinutesForStatus);
          break;
+
+      case '7':
+         ib_PRPStop = true;
+         status = P_SUCCESS;
+         break;
+
+      case '8':
+         status = Parser::Parse(arg, 1, 1000000, ii_PRPLocalMinutes);
+         break;
    }
 
    return status;
@@ -141,6 +179,9 @@ void  FactorApp::ParentValidateOptions(void)
    if (id_FPSTarget > 0.0 && id_SPFTarget > 0.0)
       FatalError("Cannot specify both -4 and -5");
    
+   if (ib_PRPStop && (id_FPSTarget > 0.0 || id_SPFTarget > 0.0))
+      FatalError("Cannot specify -7 with -4 or -5");
+   
    if (id_FPSTarget > 0 && id_FPSTarget < 1.0)
       FatalError("Factors per second must be greater than or equal to 1.0");
    
@@ -204,6 +245,17 @@ void  FactorApp::ParentValidateOptions(void)
       WriteToLog("%s", buffer);
    }
    
+   // There is nothing to sieve if the shard has no k or if the input factors removed
+   // all of its terms.
+   if (IsSharded() && il_TermCount == 0)
+   {
+      WriteOutputTermsFile(il_MinPrime);
+      
+      WriteToConsole(COT_OTHER, "Shard %u of %u has no terms.  An empty terms file was written", ii_ShardIndex + 1, ii_ShardCount);
+      
+      exit(0);
+   }
+   
    // I know this is dirty, but it is much easier than other options.
    if (ib_ApplyAndExit)
    {
@@ -252,6 +304,98 @@ bool  FactorApp::StripCRLF(char *line)
    return true;
 }
 
+std::string  FactorApp::GetOutputTermsFileNameForN(uint32_t n)
+{
+   char        suffix[20];
+   
+   snprintf(suffix, sizeof(suffix), "_n%u", n);
+   
+   return GetFileNameWithSuffix(is_OutputTermsFileName, suffix);
+}
+
+std::string  FactorApp::GetFileNameWithSuffix(std::string fileName, const char *suffix)
+{
+   size_t      dot = fileName.find_last_of('.');
+   size_t      slash = fileName.find_last_of("/\\");
+   
+   // Don't treat a dot in a directory name as the start of the extension
+   if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+      return fileName + suffix;
+   
+   return fileName.insert(dot, suffix);
+}
+
+// The argument is i/m where 1 <= i <= m
+parse_t  FactorApp::ParseShardOption(char *arg)
+{
+   uint32_t index, count;
+   
+   if (sscanf(arg, "%u/%u", &index, &count) != 2)
+      return P_FAILURE;
+   
+   if (count < 2 || count > (1 << 16) || (count & (count - 1)) != 0)
+      return P_OUT_OF_RANGE;
+   
+   if (index < 1 || index > count)
+      return P_OUT_OF_RANGE;
+   
+   ii_ShardIndex = index - 1;
+   ii_ShardCount = count;
+   
+   for (ii_ShardBits=0; (1U << ii_ShardBits) < count; ii_ShardBits++)
+      ;
+   
+   return P_SUCCESS;
+}
+
+// This must be called after the app has set the names of the output files and before
+// FactorApp::ParentValidateOptions() opens the factors file.  For shard 3 of 8 it changes
+// "terms.txt" to "terms_s3of8.txt".
+void  FactorApp::ValidateShardOption(void)
+{
+   char suffix[30];
+   
+   if (!IsSharded())
+      return;
+   
+   snprintf(suffix, sizeof(suffix), "_s%uof%u", ii_ShardIndex + 1, ii_ShardCount);
+   
+   is_OutputTermsFileName = GetFileNameWithSuffix(is_OutputTermsFileName, suffix);
+   
+   if (is_OutputFactorsFileName.length() > 0)
+      is_OutputFactorsFileName = GetFileNameWithSuffix(is_OutputFactorsFileName, suffix);
+   
+   WriteToConsole(COT_OTHER, "Sieving shard %u of %u.  Use mergeshards.pl to combine the terms files of all shards",
+                  ii_ShardIndex + 1, ii_ShardCount);
+}
+
+// If the app would put the k = minK + j*2^kShift into its bitmap, then this shard gets the k
+// where j = ii_ShardIndex (mod ii_ShardCount).  Those are also k = minK + j*2^kShift, but
+// with a larger minK and kShift.  This must be called before the wheel is created.
+void  FactorApp::ApplyShardToK(uint64_t &minK, uint64_t maxK, uint32_t &kShift)
+{
+   if (!IsSharded())
+      return;
+   
+   minK += ((uint64_t) ii_ShardIndex << kShift);
+   kShift += ii_ShardBits;
+   
+   // If minK > maxK, then the shard has no k and the wheel will be empty
+}
+
+// A shard without terms still writes its terms file so that mergeshards.pl can be
+// given the terms file of every shard.  The file is empty since the header of some
+// formats has the first k.
+void  FactorApp::WriteEmptyTermsFile(const char *fileName)
+{
+   FILE *termsFile = fopen(fileName, "w");
+   
+   if (!termsFile)
+      FatalError("Unable to open output file %s", fileName);
+   
+   fclose(termsFile);
+}
+
 void  FactorApp::LogStartSievingMessage(void)
 {
    char  minPrime[30];
@@ -293,6 +437,79 @@ void  FactorApp::LogStartSievingMessage(void)
    WriteToConsole(COT_OTHER, "%s", fullMessage);
 
    WriteToLog("%s", fullMessage);
+   
+   if (ib_PRPStop || ii_PRPLocalMinutes > 0)
+      BenchmarkPRPTest();
+}
+
+void  FactorApp::BenchmarkPRPTest(void)
+{
+   if (ip_PRPTester == NULL)
+      ip_PRPTester = CreatePRPTester();
+   
+   if (ip_PRPTester == NULL)
+      FatalError("-7 and -8 are not supported by this program");
+   
+   id_SecondsPerPRPTest = ip_PRPTester->BenchmarkTest();
+   
+   if (id_SecondsPerPRPTest <= 0.0)
+   {
+      WriteToConsole(COT_OTHER, "Could not benchmark a PRP test since there are no terms");
+      return;
+   }
+   
+   WriteToConsole(COT_OTHER, "A PRP test of a remaining term takes about %.6f seconds on one core", id_SecondsPerPRPTest);
+
+   WriteToLog("A PRP test of a remaining term takes about %.6f seconds on one core", id_SecondsPerPRPTest);
+   
+   if (!ib_PRPStop)
+      return;
+   
+   // Both removal rates are per core, so a factor is worth finding as long as it takes
+   // less time than the PRP test that it saves.
+   if (id_SecondsPerPRPTest >= 1.0)
+   {
+      id_SPFTarget = id_SecondsPerPRPTest;
+      
+      WriteToConsole(COT_OTHER, "Sieving will stop when the removal rate is slower than %.2lf sec/f", id_SPFTarget);
+   }
+   else
+   {
+      id_FPSTarget = 1.0 / id_SecondsPerPRPTest;
+      
+      WriteToConsole(COT_OTHER, "Sieving will stop when the removal rate is slower than %.2lf f/sec", id_FPSTarget);
+   }
+}
+
+void  FactorApp::PRPTestRemainingTerms(void)
+{
+   uint32_t    threadCount = (GetCpuWorkerCount() > 0 ? GetCpuWorkerCount() : 1);
+   std::string prpFileName = GetFileNameWithSuffix(is_OutputTermsFileName, "_prp");
+   double      estimatedSeconds;
+   uint64_t    startUS, prpsFound;
+   
+   if (ip_PRPTester == NULL || id_SecondsPerPRPTest <= 0.0 || il_TermCount == 0)
+      return;
+   
+   estimatedSeconds = (id_SecondsPerPRPTest * (double) il_TermCount) / (double) threadCount;
+   
+   if (estimatedSeconds > 60.0 * (double) ii_PRPLocalMinutes)
+   {
+      WriteToConsole(COT_OTHER, "Not PRP testing the %" PRIu64" remaining terms since that would take about %.0f minutes",
+                     il_TermCount, estimatedSeconds / 60.0);
+      return;
+   }
+   
+   WriteToConsole(COT_OTHER, "PRP testing the %" PRIu64" remaining terms.  This should take about %.0f seconds", il_TermCount, estimatedSeconds);
+   
+   startUS = Clock::GetCurrentMicrosecond();
+   
+   prpsFound = ip_PRPTester->TestRemainingTerms(prpFileName.c_str(), il_TermCount);
+
+   WriteToConsole(COT_OTHER, "PRP testing completed in %.2f seconds.  %" PRIu64" PRPs written to %s                    ",
+                  (double) (Clock::GetCurrentMicrosecond() - startUS) / 1000000.0, prpsFound, prpFileName.c_str());
+   
+   WriteToLog("PRP tested %" PRIu64" terms.  %" PRIu64" PRPs written to %s", il_TermCount, prpsFound, prpFileName.c_str());
 }
 
 void  FactorApp::Finish(const char *finishMethod, uint64_t elapsedTimeUS, uint64_t largestPrimeTested, uint64_t primesTested)
@@ -316,6 +533,33 @@ void  FactorApp::Finish(const char *finishMethod, uint64_t elapsedTimeUS, uint64
            
    if (IsWritingOutputTermsFile())
       OuptutAdditionalConsoleMessagesUponFinish();
+   
+   // Don't PRP test if the user stopped sieving
+   if (ii_PRPLocalMinutes > 0 && (!IsInterrupted() || ib_StoppedForRemovalRate))
+      PRPTestRemainingTerms();
+}
+
+void  FactorApp::WriteStatsFileFields(FILE *statsFile, uint64_t elapsedTimeUS)
+{
+   uint64_t factorCount, previousFactorCount, termCount;
+   uint64_t lockCount, contendedLockCount;
+   
+   // Lock because workers can update il_FactorCount
+   ip_FactorAppLock->Lock();
+   
+   factorCount = il_FactorCount;
+   previousFactorCount = il_PreviousFactorCount;
+   termCount = il_TermCount;
+   lockCount = ip_FactorAppLock->GetLockCount();
+   contendedLockCount = ip_FactorAppLock->GetContendedLockCount();
+   
+   ip_FactorAppLock->Release();
+   
+   fprintf(statsFile, ",\n   \"terms\": %" PRIu64"", termCount);
+   fprintf(statsFile, ",\n   \"factors_found\": %" PRIu64"", previousFactorCount + factorCount);
+   fprintf(statsFile, ",\n   \"factors_per_second\": %.4f", (double) factorCount * 1000000.0 / (double) elapsedTimeUS);
+   fprintf(statsFile, ",\n   \"factor_lock_count\": %" PRIu64"", lockCount);
+   fprintf(statsFile, ",\n   \"factor_lock_contended\": %" PRIu64"", contendedLockCount);
 }
 
 void  FactorApp::GetReportStats(char *reportStats, uint32_t maxStatsLength, double cpuUtilization)
@@ -403,6 +647,7 @@ bool  FactorApp::BuildFactorsPerSecondRateString(uint32_t currentStatusEntry, do
    {
       if (id_FPSTarget > factorsPerSecond)
       {
+         ib_StoppedForRemovalRate = true;
          WriteToLog("Stopped due to removal rate");
          Interrupt("Removal rate, %.2lf f/sec, is slower than target of %.2lf f/sec", factorsPerSecond, id_FPSTarget);
       }
@@ -497,6 +742,7 @@ bool  FactorApp::BuildSecondsPerFactorRateString(uint32_t currentStatusEntry, do
    
    if (id_SPFTarget > 0.0 && id_SPFTarget < secondsPerFactor)
    {
+      ib_StoppedForRemovalRate = true;
       WriteToLog("Stopped due to removal rate");
       Interrupt("Removal rate, %.2lf sec/f, is slower than target of %.2lf sec/f", secondsPerFactor, id_SPFTarget);
    }
@@ -509,6 +755,14 @@ bool  FactorApp::BuildSecondsPerFactorRateString(uint32_t currentStatusEntry, do
    return true;      
 }
 
+void  FactorApp::EndFactorBatch(void)
+{
+   ib_BatchingFactors = false;
+   
+   if (if_FactorFile != 0)
+      fflush(if_FactorFile);
+}
+
 void  FactorApp::LogFactor(uint64_t p, const char *fmt, ...)
 {
    if (if_FactorFile == 0)
@@ -523,7 +777,9 @@ void  FactorApp::LogFactor(uint64_t p, const char *fmt, ...)
    va_end(args);
    
    fprintf(if_FactorFile, "\n");
-   fflush(if_FactorFile);
+   
+   if (!ib_BatchingFactors)
+      fflush(if_FactorFile);
 }
 
 void  FactorApp::LogFactor(char *factor, const char *fmt, ...)
@@ -540,5 +796,7 @@ void  FactorApp::LogFactor(char *factor, const char *fmt, ...)
    va_end(args);
    
    fprintf(if_FactorFile, "\n");
-   fflush(if_FactorFile);
+   
+   if (!ib_BatchingFactors)
+      fflush(if_FactorFile);
 }
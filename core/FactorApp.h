@@ -18,6 +18,8 @@
 // then this should be sufficient to capture the rate.
 #define MAX_FACTOR_REPORT_COUNT  60 * 5 * 24
 
+class PRPTester;
+
 typedef struct {
    uint64_t reportTimeUS;
    uint64_t factorsFound;
@@ -37,6 +39,12 @@ protected:
    virtual bool      ApplyFactor(uint64_t theFactor, const char *term) = 0;
    virtual void      GetExtraTextForSieveStartedMessage(char *extraText, uint32_t maxTextLength) = 0;
    
+   // Apps that support -7 and -8 return true from SupportsPRPTest and a PRPTester for
+   // their terms from CreatePRPTester.  The options are only accepted by those apps.
+   // CreatePRPTester is called when sieving starts, after the terms are known.
+   virtual bool      SupportsPRPTest(void) { return false; };
+   virtual PRPTester *CreatePRPTester(void) { return NULL; };
+   
    void              ParentHelp(void);
    void              ParentAddCommandLineOptions(std::string &shortOpts, struct option *longOpts);
    parse_t           ParentParseOption(int opt, char *arg, const char *source);
@@ -45,8 +53,22 @@ protected:
    void              LogStartSievingMessage(void);
    void              Finish(const char *finishMethod, uint64_t elapsedTimeUS, uint64_t largestPrimeTested, uint64_t primesTested);
    void              GetReportStats(char *reportStats, uint32_t maxStatsLength, double cpuUtilization);
+   void              WriteStatsFileFields(FILE *statsFile, uint64_t elapsedTimeUS);
    bool              StripCRLF(char *line);
    
+   // This is for apps that sieve more than one n and write one terms file per n.
+   // For n = 1000 it changes "terms.txt" to "terms_n1000.txt".
+   std::string       GetOutputTermsFileNameForN(uint32_t n);
+   
+   // These are for apps that sieve a range of k for a fixed n and support -z i/m so that
+   // m processes can sieve the range together.  Each process only sieves the i-th of every
+   // m k that would be in the bitmap and writes its own terms and factors files.
+   parse_t           ParseShardOption(char *arg);
+   void              ValidateShardOption(void);
+   void              ApplyShardToK(uint64_t &minK, uint64_t maxK, uint32_t &kShift);
+   bool              IsSharded(void) { return (ii_ShardCount > 1); };
+   void              WriteEmptyTermsFile(const char *fileName);
+   
    void              ResetFactorStats(void);
    
    // Only call this if ip_FactorAppLock has been locked, then release upon return
@@ -57,12 +79,18 @@ protected:
    void              LogFactor(uint64_t p, const char *fmt, ...) __attribute__ ((format (printf, 3, 4)));
    void              LogFactor(char *factor, const char *fmt, ...) __attribute__ ((format (printf, 3, 4)));
 #endif
+
+   // Only call this if ip_FactorAppLock has been locked.  While logging a batch of factors
+   // the factor file is flushed once at the end of the batch rather than for each factor.
+   void              StartFactorBatch(void) { ib_BatchingFactors = true; };
+   void              EndFactorBatch(void);
    
    bool              ib_ApplyAndExit;
    
    SharedMemoryItem *ip_FactorAppLock;
    
    FILE             *if_FactorFile;
+   bool              ib_BatchingFactors;
    
    // These are only updated by the child class, but any reads/writes of these
    // variables must use ip_FactorAppLock to lock them. 
@@ -74,17 +102,36 @@ protected:
    double            id_SPFTarget;
    uint32_t          ii_MinutesForStatus;
    
+   // With -7 the target for -4 or -5 is set from the time for a PRP test
+   bool              ib_PRPStop;
+   uint32_t          ii_PRPLocalMinutes;
+   double            id_SecondsPerPRPTest;
+   PRPTester        *ip_PRPTester;
+   
    std::string       is_InputTermsFileName;
    std::string       is_InputFactorsFileName;
    std::string       is_OutputTermsFileName;
    std::string       is_OutputFactorsFileName;
    
+   // ii_ShardIndex is 0 based and ii_ShardCount is a power of 2
+   uint32_t          ii_ShardIndex;
+   uint32_t          ii_ShardCount;
+   uint32_t          ii_ShardBits;
+   
 private:
+   std::string       GetFileNameWithSuffix(std::string fileName, const char *suffix);
+   
+   void              BenchmarkPRPTest(void);
+   void              PRPTestRemainingTerms(void);
+   
    bool              BuildFactorsPerSecondRateString(uint32_t currentStatusEntry, double cpuUtilization, char *factoringRate);
    bool              BuildSecondsPerFactorRateString(uint32_t currentStatusEntry, double cpuUtilization, char *factoringRate);
    
    time_t            it_CheckpointTime;
    
+   // This is set when sieving is stopped by -4, -5, or -7
+   bool              ib_StoppedForRemovalRate;
+   
    // I could use a vector, but I'm lazy
    factor_report_t   ir_ReportStatus[MAX_FACTOR_REPORT_COUNT];
    uint32_t          ii_NextStatusEntry;
@@ -0,0 +1,236 @@
+/* KSegmentSieve.cpp -- (C) Mark Rodenkirch, October 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+*/
+
+#include <algorithm>
+#include "KSegmentSieve.h"
+
+static bool CompareByIndex(const ksieve_entry_t &a, const ksieve_entry_t &b)
+{
+   return (a.index < b.index);
+}
+
+KSegmentSieve::KSegmentSieve(KWheel *wheel)
+{
+   ip_Wheel = wheel;
+   
+   il_PositionCount = ip_Wheel->GetPositionCount();
+   il_BitCount = ip_Wheel->GetBitCount();
+   ii_Modulus = ip_Wheel->GetModulus();
+   ii_ResidueCount = ip_Wheel->GetResidueCount();
+   
+   il_SegmentBlocks = KSS_SEGMENT_BITS / ii_ResidueCount;
+   il_SegmentPositions = il_SegmentBlocks * ii_Modulus;
+   il_SegmentBits = il_SegmentBlocks * ii_ResidueCount;
+   
+   ii_SegmentCount = (uint32_t) ((il_PositionCount + il_SegmentPositions - 1) / il_SegmentPositions);
+   
+   iv_Buckets.resize(ii_SegmentCount);
+   
+   Clear();
+}
+
+void  KSegmentSieve::Clear(void)
+{
+   iv_Primes.clear();
+   iv_SmallPrimes.clear();
+   iv_Hits.clear();
+   
+   for (uint32_t segment=0; segment<ii_SegmentCount; segment++)
+      iv_Buckets[segment].clear();
+   
+   il_LargestPendingPrime = 0;
+   ii_PendingPrimeCount = 0;
+   ib_Distributed = false;
+}
+
+void  KSegmentSieve::AddPrime(uint64_t prime, uint64_t k, uint32_t bitmapIdx, uint32_t tag)
+{
+   ksieve_entry_t entry;
+   
+   entry.prime = prime;
+   entry.bit = (k - ip_Wheel->GetMinK()) >> ip_Wheel->GetKShift();
+   entry.bitmapIdx = bitmapIdx;
+   entry.tag = tag;
+   entry.index = (uint32_t) iv_Primes.size();
+   
+   iv_Primes.push_back(entry);
+}
+
+// Primes smaller than a segment will hit every segment so they are in one list.
+// Larger primes are put into the bucket of the first segment that they hit.
+void  KSegmentSieve::DistributePrimes(void)
+{
+   std::vector<ksieve_entry_t>::iterator it = iv_Primes.begin();
+   
+   while (it != iv_Primes.end())
+   {
+      // These only divide terms that were excluded by the wheel
+      if (ip_Wheel->IsPrimeInWheel(it->prime))
+         ;
+      else if (it->prime < il_SegmentBlocks)
+         AddSmallPrime(*it);
+      else if (it->bit < il_PositionCount)
+         iv_Buckets[it->bit / il_SegmentPositions].push_back(*it);
+   
+      it++;
+   }
+   
+   ib_Distributed = true;
+}
+
+// Convert the position of the first k to a bit.  With a wheel each residue has its
+// own progression.  If position = residue (mod M), then the next position with the
+// same residue is position + M*p, which is R*p bits later.
+void  KSegmentSieve::AddSmallPrime(const ksieve_entry_t &entry)
+{
+   ksieve_entry_t smallEntry = entry;
+   uint64_t position, inverse, offset;
+   
+   if (ii_Modulus == 1)
+   {
+      iv_SmallPrimes.push_back(entry);
+      return;
+   }
+   
+   inverse = ip_Wheel->GetInverse(entry.prime);
+   offset = entry.bit % ii_Modulus;
+   
+   for (uint32_t idx=0; idx<ii_ResidueCount; idx++)
+   {
+      // Find j such that position + j*p = residue (mod M)
+      position = ((ip_Wheel->GetResidue(idx) + ii_Modulus - offset) * inverse) % ii_Modulus;
+      position = entry.bit + position * entry.prime;
+   
+      if (position >= il_PositionCount)
+         continue;
+   
+      smallEntry.bit = (position / ii_Modulus) * ii_ResidueCount + idx;
+   
+      iv_SmallPrimes.push_back(smallEntry);
+   }
+}
+
+// Small primes hit every segment.  Other primes are only in the bucket of the
+// next segment that they hit.
+bool  KSegmentSieve::HasSegmentPrimes(uint32_t segment)
+{
+   if (!ib_Distributed)
+      DistributePrimes();
+   
+   return (iv_SmallPrimes.size() > 0 || iv_Buckets[segment].size() > 0);
+}
+
+void  KSegmentSieve::SieveSegment(uint32_t segment, std::vector<bool> **bitmaps, uint8_t *levels)
+{
+   uint64_t segmentEnd = ((uint64_t) segment + 1) * il_SegmentBits;
+   uint64_t positionEnd = ((uint64_t) segment + 1) * il_SegmentPositions;
+   uint64_t bit, step, position, nextSegment;
+   
+   if (!ib_Distributed)
+      DistributePrimes();
+   
+   if (segmentEnd > il_BitCount)
+      segmentEnd = il_BitCount;
+   
+   if (positionEnd > il_PositionCount)
+      positionEnd = il_PositionCount;
+   
+   iv_Hits.clear();
+   
+   std::vector<ksieve_entry_t>::iterator it = iv_SmallPrimes.begin();
+   
+   while (it != iv_SmallPrimes.end())
+   {
+      std::vector<bool> *terms = bitmaps[it->bitmapIdx];
+   
+      step = it->prime * ii_ResidueCount;
+   
+      if (terms == NULL)
+      {
+         for (bit=it->bit; bit<segmentEnd; bit+=step)
+         {
+            if (levels[bit] >= it->tag)
+            {
+               levels[bit] = (uint8_t) (it->tag - 1);
+   
+               iv_Hits.push_back(*it);
+               iv_Hits.back().bit = bit;
+            }
+         }
+      }
+      else
+      {
+         for (bit=it->bit; bit<segmentEnd; bit+=step)
+         {
+            if ((*terms)[bit])
+            {
+               (*terms)[bit] = false;
+   
+               iv_Hits.push_back(*it);
+               iv_Hits.back().bit = bit;
+            }
+         }
+      }
+   
+      it->bit = bit;
+      it++;
+   }
+   
+   // Each of these primes hits this segment once, or a few times if there is a
+   // wheel.  Move it to the bucket for the next segment that it will hit.  The
+   // bucket is sorted so that a term is removed by the same prime that would
+   // remove it if each prime were applied to the entire bitmap in the order that
+   // they were added.
+   std::vector<ksieve_entry_t> &bucket = iv_Buckets[segment];
+   
+   std::sort(bucket.begin(), bucket.end(), CompareByIndex);
+   
+   it = bucket.begin();
+   
+   while (it != bucket.end())
+   {
+      std::vector<bool> *terms = bitmaps[it->bitmapIdx];
+   
+      for (position=it->bit; position<positionEnd; position+=it->prime)
+      {
+         if (!ip_Wheel->GetBitForPosition(position, bit))
+            continue;
+   
+         if (terms == NULL)
+         {
+            if (levels[bit] < it->tag)
+               continue;
+   
+            levels[bit] = (uint8_t) (it->tag - 1);
+         }
+         else
+         {
+            if (!(*terms)[bit])
+               continue;
+   
+            (*terms)[bit] = false;
+         }
+   
+         iv_Hits.push_back(*it);
+         iv_Hits.back().bit = bit;
+      }
+   
+      it->bit = position;
+   
+      if (it->bit < il_PositionCount)
+      {
+         nextSegment = it->bit / il_SegmentPositions;
+   
+         iv_Buckets[nextSegment].push_back(*it);
+      }
+   
+      it++;
+   }
+   
+   bucket.clear();
+}
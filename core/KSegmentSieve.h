@@ -0,0 +1,115 @@
+/* KSegmentSieve.h -- (C) Mark Rodenkirch, October 2026
+
+   This is used by sieves with a fixed n and a range of k to remove terms for
+   primes p <= kmax.  Each of those primes divides a term for every p-th k, so
+   sweeping the entire bitmap of k for one prime at a time is mostly cache misses.
+
+   Instead the worker adds the first k for each small prime in its chunk of primes.
+   The app then walks its bitmap of k one segment at a time and applies every prime
+   to that segment before moving to the next segment.  This is similar to what
+   primesieve does with EratSmall, EratMedium and EratBig.  Primes that hit the
+   segment more than once are kept in one list.  Primes that are larger than a
+   segment are kept in a bucket for the next segment that they hit.
+
+   If the bitmap uses a wheel (see KWheel.h), then the k for a small prime are split
+   into one progression per residue of the wheel, each with a fixed step between bits,
+   so that k excluded by the wheel are never visited.  Other primes step through the
+   positions of k and skip those that are excluded.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+*/
+
+#ifndef _KSEGMENTSIEVE_H
+#define _KSEGMENTSIEVE_H
+
+#include <inttypes.h>
+#include <vector>
+
+#include "KWheel.h"
+
+// 2^20 bits is 128 KB of std::vector<bool> which should fit in L2 cache.
+#define KSS_SEGMENT_BITS   (1 << 20)
+
+// For small primes bit is the bit in the bitmap.  For other primes it is the
+// position of k (see KWheel.h).  When there is no wheel they are the same.
+typedef struct {
+   uint64_t prime;
+   uint64_t bit;
+   uint32_t bitmapIdx;
+   uint32_t tag;
+   uint32_t index;
+} ksieve_entry_t;
+
+class KSegmentSieve
+{
+public:
+   KSegmentSieve(KWheel *wheel);
+   
+   ~KSegmentSieve(void) {};
+   
+   void              Clear(void);
+   
+   // k must be >= minK, be in the bitmap, and be the first k with a factor of prime.
+   // The tag is not used by this class.  The app uses it to know which term the
+   // prime is a factor of, for example +1 or -1.
+   void              AddPrime(uint64_t prime, uint64_t k, uint32_t bitmapIdx, uint32_t tag);
+   
+   uint32_t          GetPrimeCount(void) { return (uint32_t) iv_Primes.size(); };
+   const ksieve_entry_t *GetPrime(uint32_t idx) { return &iv_Primes[idx]; };
+   uint64_t          GetPrimeK(uint32_t idx) { return ip_Wheel->GetMinK() + (iv_Primes[idx].bit << ip_Wheel->GetKShift()); };
+   
+   uint64_t          GetK(uint64_t bit) { return ip_Wheel->GetK(bit); };
+   
+   // Segments must be sieved in order starting with segment 0.  Only bits that
+   // were set before clearing them are added to the list of hits.
+   //
+   // If the bitmap of an entry is NULL, then the entry is applied to levels, which
+   // has one byte per bit.  It hits k if the level of k is at least the tag of the
+   // entry and then sets the level to one less than the tag.  ccsieve uses this for
+   // the length of the chain for each k.
+   uint32_t          GetSegmentCount(void) { return ii_SegmentCount; };
+   void              SieveSegment(uint32_t segment, std::vector<bool> **bitmaps, uint8_t *levels = NULL);
+   
+   // Returns false if no prime hits the segment.  The app can skip the segment
+   // without locking the bitmap since sieving it would not change anything.
+   bool              HasSegmentPrimes(uint32_t segment);
+   
+   const std::vector<ksieve_entry_t> &GetHits(void) { return iv_Hits; };
+   
+   // These are used by the worker so that it does not report the largest prime tested
+   // until the factors for the primes it added have been applied.
+   void              AddPendingPrimes(uint64_t largestPrime, uint32_t primeCount) { il_LargestPendingPrime = largestPrime; ii_PendingPrimeCount += primeCount; };
+   uint64_t          GetLargestPendingPrime(void) { return il_LargestPendingPrime; };
+   uint32_t          GetPendingPrimeCount(void) { return ii_PendingPrimeCount; };
+   
+private:
+   void              DistributePrimes(void);
+   void              AddSmallPrime(const ksieve_entry_t &entry);
+   
+   KWheel           *ip_Wheel;
+   
+   std::vector<ksieve_entry_t>  iv_Primes;
+   std::vector<ksieve_entry_t>  iv_SmallPrimes;
+   std::vector<std::vector<ksieve_entry_t>> iv_Buckets;
+   std::vector<ksieve_entry_t>  iv_Hits;
+   
+   uint64_t          il_PositionCount;
+   uint64_t          il_BitCount;
+   uint32_t          ii_Modulus;
+   uint32_t          ii_ResidueCount;
+   
+   // Each segment is a whole number of blocks of the wheel.
+   uint64_t          il_SegmentBlocks;
+   uint64_t          il_SegmentPositions;
+   uint64_t          il_SegmentBits;
+   uint32_t          ii_SegmentCount;
+   bool              ib_Distributed;
+   
+   uint64_t          il_LargestPendingPrime;
+   uint32_t          ii_PendingPrimeCount;
+};
+
+#endif
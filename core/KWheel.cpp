@@ -0,0 +1,154 @@
+/* KWheel.cpp -- (C) Mark Rodenkirch, October 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+*/
+
+#include "KWheel.h"
+
+static const uint32_t wheelPrimes[] = { 3, 5, 7, 11, 0 };
+
+KWheel::KWheel(uint64_t minK, uint64_t maxK, uint32_t kShift)
+{
+   il_MinK = minK;
+   il_MaxK = maxK;
+   ii_KShift = kShift;
+   ii_ShiftMask = (1 << kShift) - 1;
+   
+   // minK > maxK for a shard that has no k
+   il_PositionCount = (minK > maxK ? 0 : ((maxK - minK) >> kShift) + 1);
+   
+   for (uint32_t idx=0; idx<=KW_MAX_PRIME; idx++)
+      ii_ExcludedMask[idx] = 0;
+   
+   Build();
+}
+
+uint32_t KWheel::GetPrime(uint32_t idx)
+{
+   return wheelPrimes[idx];
+}
+
+uint32_t KWheel::PowMod(uint64_t base, uint32_t n, uint32_t prime)
+{
+   uint64_t result = 1;
+   
+   base %= prime;
+   
+   while (n > 0)
+   {
+      if (n & 1)
+         result = (result * base) % prime;
+   
+      base = (base * base) % prime;
+      n >>= 1;
+   }
+   
+   return (uint32_t) result;
+}
+
+void  KWheel::ExcludeTerm(uint32_t prime, uint64_t multiplier, int64_t c)
+{
+   uint32_t m = (uint32_t) (multiplier % prime);
+   uint32_t negC = (uint32_t) ((c >= 0) ? (prime - (c % prime)) % prime : (-c) % prime);
+   
+   if (m == 0)
+      return;
+   
+   // k = -c/multiplier (mod prime)
+   for (uint32_t k=0; k<prime; k++)
+   {
+      if ((k * m) % prime == negC)
+      {
+         ExcludeK(prime, k);
+         return;
+      }
+   }
+}
+
+void  KWheel::ExcludeK(uint32_t prime, uint64_t kResidue)
+{
+   uint64_t position;
+   
+   // Find the position mod prime for this k.  Since k = kmin + position*2^kShift,
+   // position = (k - kmin) * (1/2^kShift) (mod prime).
+   position = (kResidue % prime) + prime - (il_MinK % prime);
+   
+   for (uint32_t shift=0; shift<ii_KShift; shift++)
+      position = (position * ((prime + 1) / 2)) % prime;
+   
+   ii_ExcludedMask[prime] |= (1 << (position % prime));
+}
+
+void  KWheel::Build(void)
+{
+   uint32_t idx, prime, residue;
+   bool     isExcluded;
+   
+   ii_Modulus = 1;
+   
+   for (idx=0; wheelPrimes[idx] > 0; idx++)
+   {
+      prime = wheelPrimes[idx];
+   
+      // Ignore primes that would exclude all k
+      if (ii_ExcludedMask[prime] > 0 && ii_ExcludedMask[prime] != (uint32_t) ((1 << prime) - 1))
+         ii_Modulus *= prime;
+   }
+   
+   iv_Ranks.resize(ii_Modulus);
+   iv_Residues.clear();
+   
+   for (residue=0; residue<ii_Modulus; residue++)
+   {
+      isExcluded = false;
+   
+      for (idx=0; wheelPrimes[idx] > 0; idx++)
+      {
+         prime = wheelPrimes[idx];
+   
+         if (ii_Modulus % prime == 0 && (ii_ExcludedMask[prime] & (1 << (residue % prime))))
+            isExcluded = true;
+      }
+   
+      if (isExcluded)
+         iv_Ranks[residue] = -1;
+      else
+      {
+         iv_Ranks[residue] = (int32_t) iv_Residues.size();
+         iv_Residues.push_back(residue);
+      }
+   }
+   
+   ii_ResidueCount = (uint32_t) iv_Residues.size();
+   
+   il_BitCount = (il_PositionCount / ii_Modulus) * ii_ResidueCount;
+   
+   for (residue=0; residue<il_PositionCount % ii_Modulus; residue++)
+      if (iv_Ranks[residue] >= 0)
+         il_BitCount++;
+}
+
+// Compute 1/value (mod M).  value must not be divisible by any prime in the wheel.
+uint32_t KWheel::GetInverse(uint64_t value)
+{
+   int64_t  u = 0, d = ii_Modulus, v1 = 1, v3 = value % ii_Modulus;
+   int64_t  q, t1, t3;
+   
+   while (v3)
+   {
+      q = d/v3;
+      t3 = d - (q*v3);
+      t1 = u - (q*v1);
+   
+      u = v1;
+      d = v3;
+   
+      v1 = t1;
+      v3 = t3;
+   }
+   
+   return (uint32_t) ((u < 0) ? u + ii_Modulus : u);
+}
@@ -0,0 +1,160 @@
+/* KWheel.h -- (C) Mark Rodenkirch, October 2026
+
+   This is used by sieves with a fixed n and a range of k to map k to a bit in the
+   bitmap of terms.  The position of k is (k - kmin) >> kShift where kShift is 1 if
+   only odd k or only even k are in the bitmap.  Without a wheel the bit is the
+   position.
+
+   With a wheel the app excludes k where a prime <= KW_MAX_PRIME always divides the
+   term, for example k where 3 divides k*b^n+1 or k*b^n-1.  The positions are split
+   into blocks of M, the product of the primes that exclude something, and only the
+   R positions in each block that are not excluded have a bit.  The bitmap is then
+   R/M the size it would be without the wheel.  For twins that is 1/7.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+*/
+
+#ifndef _KWHEEL_H
+#define _KWHEEL_H
+
+#include <inttypes.h>
+#include <vector>
+
+#define KW_MAX_PRIME    11
+
+class KWheel
+{
+public:
+   KWheel(uint64_t minK, uint64_t maxK, uint32_t kShift);
+   
+   ~KWheel(void) {};
+   
+   // These are the primes that can be in the wheel.  This returns 0 after the last one.
+   static uint32_t   GetPrime(uint32_t idx);
+   static uint32_t   PowMod(uint64_t base, uint32_t n, uint32_t prime);
+   
+   // Exclude k where k = kResidue (mod prime).  This must be called before Build().
+   void              ExcludeK(uint32_t prime, uint64_t kResidue);
+   
+   // Exclude k where prime divides k*multiplier+c.  Nothing is excluded if prime
+   // divides the multiplier.  This must be called before Build().
+   void              ExcludeTerm(uint32_t prime, uint64_t multiplier, int64_t c);
+   
+   void              Build(void);
+   
+   bool              IsEnabled(void) { return (ii_Modulus > 1); };
+   
+   uint64_t          GetMinK(void) { return il_MinK; };
+   uint32_t          GetKShift(void) { return ii_KShift; };
+   uint32_t          GetModulus(void) { return ii_Modulus; };
+   uint32_t          GetResidueCount(void) { return ii_ResidueCount; };
+   uint32_t          GetResidue(uint32_t idx) { return iv_Residues[idx]; };
+   bool              IsPrimeInWheel(uint64_t prime) { return (prime <= KW_MAX_PRIME && ii_Modulus % prime == 0); };
+   
+   // This is the number of k from kmin to kmax before and after removing excluded k.
+   uint64_t          GetPositionCount(void) { return il_PositionCount; };
+   uint64_t          GetBitCount(void) { return il_BitCount; };
+   
+   uint32_t          GetInverse(uint64_t value);
+   
+   // This returns false if k is excluded by the wheel or does not have the correct parity.
+   // The caller must verify that k is between kmin and kmax.
+   inline bool       GetBit(uint64_t k, uint64_t &bit)
+   {
+      uint64_t position = k - il_MinK;
+   
+      if (position & ii_ShiftMask)
+         return false;
+   
+      return GetBitForPosition(position >> ii_KShift, bit);
+   };
+   
+   inline bool       GetBitForPosition(uint64_t position, uint64_t &bit)
+   {
+      if (ii_Modulus == 1)
+      {
+         bit = position;
+         return true;
+      }
+   
+      uint64_t block = position / ii_Modulus;
+      int32_t  rank = iv_Ranks[position - block * ii_Modulus];
+   
+      if (rank < 0)
+         return false;
+   
+      bit = block * ii_ResidueCount + rank;
+      return true;
+   };
+   
+   inline uint64_t   GetK(uint64_t bit)
+   {
+      uint64_t position = bit;
+   
+      if (ii_Modulus > 1)
+      {
+         uint64_t block = bit / ii_ResidueCount;
+   
+         position = block * ii_Modulus + iv_Residues[bit - block * ii_ResidueCount];
+      }
+   
+      return il_MinK + (position << ii_KShift);
+   };
+   
+   // Given the first k >= kmin where prime divides the term, this changes k to the first
+   // k that is in the bitmap where prime divides the term, ignoring the wheel.  The caller
+   // must have already fixed the parity of k if kShift > 0.  For a sharded range (see
+   // FactorApp::ApplyShardToK) kShift can be larger than 1 so k is increased by j*prime
+   // where j*prime = kmin - k (mod 2^kShift).  This returns false if that k > kmax.
+   inline bool       AlignK(uint64_t prime, uint64_t &k)
+   {
+      uint64_t offset, inverse, j;
+      
+      if (k > il_MaxK)
+         return false;
+      
+      offset = (il_MinK - k) & ii_ShiftMask;
+      
+      if (offset == 0)
+         return true;
+      
+      // prime is odd so Newton's method gives 1/prime (mod 2^64)
+      inverse = prime;
+      for (uint32_t idx=0; idx<5; idx++)
+         inverse *= 2 - prime * inverse;
+      
+      j = (offset * inverse) & ii_ShiftMask;
+      
+      if (j > (il_MaxK - k) / prime)
+         return false;
+      
+      k += j * prime;
+      return true;
+   };
+   
+   // For the rank, -1 means that the position is excluded
+   const int32_t    *GetRanks(void) { return &iv_Ranks[0]; };
+   
+private:
+   uint64_t          il_MinK;
+   uint64_t          il_MaxK;
+   uint32_t          ii_KShift;
+   uint32_t          ii_ShiftMask;
+   
+   uint64_t          il_PositionCount;
+   uint64_t          il_BitCount;
+   
+   uint32_t          ii_Modulus;
+   uint32_t          ii_ResidueCount;
+   
+   // Bit i is set if (position mod prime) = i is excluded
+   uint32_t          ii_ExcludedMask[KW_MAX_PRIME+1];
+   
+   std::vector<int32_t>  iv_Ranks;
+   std::vector<uint32_t> iv_Residues;
+};
+
+#endif
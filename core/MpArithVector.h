@@ -15,6 +15,7 @@
 #include <cstdlib>
 
 #define		VECTOR_SIZE		4		// must be a power of two
+#define		WIDE_VECTOR_SIZE	8		// must be a power of two
 
 // Arithmetic on vectors: hide the latency of the MUL instruction.
 
@@ -121,6 +122,18 @@ public:
 		return r;
 	}
 
+	// Add the same value to each element.  b must be less than every p.
+	MpResVector<N> add(const MpResVector<N> & a, const uint64_t b) const
+	{
+		MpResVector<N> r;
+		for (size_t k = 0; k < N; ++k)
+		{
+			const uint64_t c = (a[k] >= _p[k] - b) ? _p[k] : 0;
+			r[k] = a[k] + b - c;
+		}
+		return r;
+	}
+
 	MpResVector<N> sub(const MpResVector<N> & a, const MpResVector<N> & b) const
 	{
 		MpResVector<N> r;
@@ -225,4 +238,7 @@ public:
 typedef MpResVector<VECTOR_SIZE> MpResVec;
 typedef MpArithVector<VECTOR_SIZE> MpArithVec;
 
+typedef MpResVector<WIDE_VECTOR_SIZE> MpResVec8;
+typedef MpArithVector<WIDE_VECTOR_SIZE> MpArithVec8;
+
 #endif
@@ -0,0 +1,135 @@
+/* MpPowerChain.h -- (C) Mark Rodenkirch, October 2026
+
+   This is used by sieves that compute x^n (mod p) for every prime where n is the
+   same for the entire run, for example (1/b)^n (mod p) for a fixed n.  The chain of
+   squarings and multiplications is built once for n using a sliding window so that
+   computing the power for a vector of primes does not have to test the bits of n.
+
+   For a window of w bits the odd powers x, x^3, ..., x^(2^w-1) are computed first.
+   The chain is then about log2(n) squarings and log2(n)/(w+1) multiplications instead
+   of the log2(n)/2 multiplications of MpArithVector::pow().
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+*/
+
+#ifndef _MPPOWERCHAIN_H
+#define _MPPOWERCHAIN_H
+
+#include <inttypes.h>
+#include <vector>
+
+#include "MpArithVector.h"
+
+#define MPC_MAX_WINDOW_BITS   4
+
+// For a step, 0 means to square and i > 0 means to multiply by x^(2i-1)
+#define MPC_SQUARE            0
+
+class MpPowerChain
+{
+public:
+   MpPowerChain(uint64_t exponent)
+   {
+      uint32_t bits = 0;
+      int32_t  bit, lowBit;
+
+      il_Exponent = exponent;
+
+      while (bits < 64 && (exponent >> bits) > 0)
+         bits++;
+
+      // A larger window saves multiplications, but each odd power in the window
+      // costs one multiplication to compute.
+      ii_WindowBits = 1;
+      if (bits > 6)  ii_WindowBits = 2;
+      if (bits > 16) ii_WindowBits = 3;
+      if (bits > 48) ii_WindowBits = MPC_MAX_WINDOW_BITS;
+
+      ii_FirstPower = 0;
+      iv_Steps.clear();
+
+      if (exponent == 0)
+         return;
+
+      bit = bits - 1;
+
+      while (bit >= 0)
+      {
+         if (((exponent >> bit) & 1) == 0)
+         {
+            iv_Steps.push_back(MPC_SQUARE);
+            bit--;
+            continue;
+         }
+
+         // Take the longest window starting at this bit that ends with a 1 bit
+         lowBit = (bit + 1 > (int32_t) ii_WindowBits ? bit + 1 - ii_WindowBits : 0);
+
+         while (((exponent >> lowBit) & 1) == 0)
+            lowBit++;
+
+         uint32_t window = (uint32_t) ((exponent >> lowBit) & ((1ULL << (bit - lowBit + 1)) - 1));
+
+         if (bit == (int32_t) bits - 1)
+            ii_FirstPower = window;
+         else
+         {
+            for (int32_t idx=lowBit; idx<=bit; idx++)
+               iv_Steps.push_back(MPC_SQUARE);
+
+            iv_Steps.push_back((window + 1) >> 1);
+         }
+
+         bit = lowBit - 1;
+      }
+   };
+
+   ~MpPowerChain(void) {};
+
+   uint64_t          GetExponent(void) { return il_Exponent; };
+
+   // x and the result are in Montgomery form
+   template <size_t N>
+   MpResVector<N>    pow(const MpArithVector<N> &mp, const MpResVector<N> &x) const
+   {
+      MpResVector<N> oddPowers[1 << (MPC_MAX_WINDOW_BITS - 1)];
+      MpResVector<N> x2, y;
+
+      if (il_Exponent == 0)
+         return mp.one();
+
+      oddPowers[0] = x;
+
+      if (ii_WindowBits > 1)
+      {
+         x2 = mp.mul(x, x);
+
+         for (uint32_t idx=1; idx<(1U << (ii_WindowBits - 1)); idx++)
+            oddPowers[idx] = mp.mul(oddPowers[idx-1], x2);
+      }
+
+      y = oddPowers[ii_FirstPower >> 1];
+
+      for (size_t idx=0; idx<iv_Steps.size(); idx++)
+      {
+         if (iv_Steps[idx] == MPC_SQUARE)
+            y = mp.mul(y, y);
+         else
+            y = mp.mul(y, oddPowers[iv_Steps[idx] - 1]);
+      }
+
+      return y;
+   };
+
+private:
+   uint64_t          il_Exponent;
+   uint32_t          ii_WindowBits;
+   uint32_t          ii_FirstPower;
+
+   std::vector<uint8_t>  iv_Steps;
+};
+
+#endif
@@ -0,0 +1,256 @@
+/* PRPTester.cpp -- (C) Mark Rodenkirch, October 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+*/
+
+#include <cinttypes>
+#include <vector>
+#include "PRPTester.h"
+#include "Clock.h"
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#ifdef WIN32
+static DWORD WINAPI WindowsThreadEntryPoint(LPVOID data)
+{
+   PRPTester::TesterThreadEntryPoint(data);
+
+   return 0;
+}
+#endif
+
+PRPTester::PRPTester(App *theApp)
+{
+   ip_App = theApp;
+
+   ip_TesterLock = new SharedMemoryItem("prp_tester");
+
+   ip_PRPFile = NULL;
+}
+
+PRPTester::~PRPTester(void)
+{
+   if (ip_PRPFile != NULL)
+      fclose(ip_PRPFile);
+
+   delete ip_TesterLock;
+}
+
+double  PRPTester::BenchmarkTest(void)
+{
+   mpz_t    term, nMinus1, exponent, residue, three;
+   uint32_t termIdx, termBits, exponentBits, iterations, idx;
+   uint64_t startUS, elapsedUS;
+   double   totalSeconds = 0.0;
+
+   mpz_init(term);
+   mpz_init(nMinus1);
+   mpz_init(exponent);
+   mpz_init(residue);
+   mpz_init_set_ui(three, 3);
+
+   for (termIdx=0; termIdx<PRP_BENCHMARK_TERMS; termIdx++)
+   {
+      if (!GetBenchmarkTerm(termIdx, term))
+         break;
+
+      mpz_sub_ui(nMinus1, term, 1);
+
+      termBits = (uint32_t) mpz_sizeinbase(nMinus1, 2);
+      exponentBits = 64;
+      iterations = 1;
+
+      // Use more bits of the exponent until the time can be measured.  If all of the
+      // bits are used, then do more than one test.
+      while (true)
+      {
+         if (exponentBits > termBits)
+            exponentBits = termBits;
+
+         mpz_tdiv_q_2exp(exponent, nMinus1, termBits - exponentBits);
+
+         startUS = Clock::GetCurrentMicrosecond();
+
+         for (idx=0; idx<iterations; idx++)
+            mpz_powm(residue, three, exponent, term);
+
+         elapsedUS = Clock::GetCurrentMicrosecond() - startUS;
+
+         if (elapsedUS >= PRP_BENCHMARK_US)
+            break;
+
+         if (exponentBits < termBits)
+            exponentBits *= 2;
+         else
+            iterations *= 2;
+      }
+
+      totalSeconds += ((double) elapsedUS / 1000000.0) * ((double) termBits / (double) exponentBits) / (double) iterations;
+   }
+
+   mpz_clear(term);
+   mpz_clear(nMinus1);
+   mpz_clear(exponent);
+   mpz_clear(residue);
+   mpz_clear(three);
+
+   if (termIdx == 0)
+      return 0.0;
+
+   return totalSeconds / (double) termIdx;
+}
+
+uint64_t  PRPTester::TestRemainingTerms(const char *fileName, uint64_t termCount)
+{
+   uint32_t threadCount = ip_App->GetCpuWorkerCount();
+
+   if (threadCount == 0)
+      threadCount = 1;
+
+   ip_PRPFile = fopen(fileName, "a");
+
+   if (ip_PRPFile == NULL)
+      FatalError("Could not open file %s for output", fileName);
+
+   ib_FirstTerm = true;
+   ib_NoMoreTerms = false;
+   il_TermCount = termCount;
+   il_TermsTested = 0;
+   il_PRPsFound = 0;
+
+   it_StartTime = it_LastCheckPointTime = time(NULL);
+
+#ifdef WIN32
+   std::vector<HANDLE>    threads(threadCount);
+#else
+   std::vector<pthread_t> threads(threadCount);
+#endif
+
+   // The last thread is this thread
+   for (uint32_t idx=0; idx<threadCount-1; idx++)
+   {
+#ifdef WIN32
+      threads[idx] = CreateThread(0, 0, WindowsThreadEntryPoint, this, 0, 0);
+#else
+      pthread_create(&threads[idx], NULL, &TesterThreadEntryPoint, this);
+#endif
+   }
+
+   TestTerms();
+
+   for (uint32_t idx=0; idx<threadCount-1; idx++)
+   {
+#ifdef WIN32
+      WaitForSingleObject(threads[idx], INFINITE);
+      CloseHandle(threads[idx]);
+#else
+      pthread_join(threads[idx], NULL);
+#endif
+   }
+
+   fclose(ip_PRPFile);
+   ip_PRPFile = NULL;
+
+   return il_PRPsFound;
+}
+
+void *PRPTester::TesterThreadEntryPoint(void *data)
+{
+   PRPTester *tester = (PRPTester *) data;
+
+   tester->TestTerms();
+
+   return 0;
+}
+
+void  PRPTester::TestTerms(void)
+{
+   mpz_t    term, nMinus1, residue, three;
+   char     termText[PRP_TERM_TEXT_LENGTH];
+   time_t   currentTime;
+   bool     isPRP;
+
+   mpz_init(term);
+   mpz_init(nMinus1);
+   mpz_init(residue);
+   mpz_init_set_ui(three, 3);
+
+   ip_TesterLock->Lock();
+
+   while (!ib_NoMoreTerms)
+   {
+      if (!GetNextTerm(ib_FirstTerm, term, termText))
+      {
+         ib_NoMoreTerms = true;
+         break;
+      }
+
+      ib_FirstTerm = false;
+
+      ip_TesterLock->Release();
+
+      mpz_sub_ui(nMinus1, term, 1);
+      mpz_powm(residue, three, nMinus1, term);
+
+      isPRP = (mpz_cmp_ui(residue, 1) == 0);
+
+      ip_TesterLock->Lock();
+
+      il_TermsTested++;
+
+      // PRPs are rare, so the file is flushed for each one so that none are lost
+      // if the program is stopped.
+      if (isPRP)
+      {
+         il_PRPsFound++;
+
+         ip_App->WriteToConsole(COT_OTHER, "%s is PRP", termText);
+
+         fprintf(ip_PRPFile, "%s\n", termText);
+         fflush(ip_PRPFile);
+      }
+
+      currentTime = time(NULL);
+
+      // Report once every 10 seconds.
+      if (currentTime >= it_LastCheckPointTime + 10)
+         ReportProgress(currentTime);
+   }
+
+   ip_TesterLock->Release();
+
+   mpz_clear(term);
+   mpz_clear(nMinus1);
+   mpz_clear(residue);
+   mpz_clear(three);
+}
+
+// This is called while holding the lock
+void  PRPTester::ReportProgress(time_t currentTime)
+{
+   time_t   estimatedFinishTime;
+   double   percentCompleted;
+   char     finishTimeBuffer[40];
+   struct tm   *finish_tm;
+
+   it_LastCheckPointTime = currentTime;
+
+   if (il_TermsTested == 0 || il_TermCount == 0)
+      return;
+
+   percentCompleted = ((double) il_TermsTested) / ((double) il_TermCount);
+
+   estimatedFinishTime = it_StartTime + (currentTime - it_StartTime)/percentCompleted;
+   finish_tm = localtime(&estimatedFinishTime);
+   strftime(finishTimeBuffer, sizeof(finishTimeBuffer), "%Y-%m-%d %H:%M", finish_tm);
+
+   ip_App->WriteToConsole(COT_SIEVE, " PRP tested %" PRIu64" of %" PRIu64" terms (%5.2f pct).  %" PRIu64" PRPs found.  ETC %s",
+                          il_TermsTested, il_TermCount, percentCompleted * 100.0, il_PRPsFound, finishTimeBuffer);
+}
@@ -0,0 +1,88 @@
+/* PRPTester.h -- (C) Mark Rodenkirch, October 2026
+
+   This is used by apps that support -7 and -8.  The child class provides the terms
+   and this does a base 3 Fermat PRP test of them with GMP.  The x86_asm_ext kernels
+   handle Proth moduli such as k*2^n+1, but they have a fixed width of at most 768 bits
+   and the terms to be PRP tested are usually much larger than that.
+
+   BenchmarkTest() estimates how long one PRP test of a remaining term takes on one
+   core.  It does not do a full test since that could take hours for large terms.
+   Instead it times mpz_powm with an exponent that has only the top bits of N-1, doubling
+   the number of bits until the time is long enough to be measured.  Since the time is
+   proportional to the number of bits in the exponent, that is scaled to the size of N.
+
+   TestRemainingTerms() PRP tests all of the remaining terms using multiple threads and
+   writes the terms that are PRP to a file.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+*/
+
+#ifndef _PRPTESTER_H
+#define _PRPTESTER_H
+
+#include <stdio.h>
+#include <gmp.h>
+#include <time.h>
+
+#include "App.h"
+#include "SharedMemoryItem.h"
+
+// The number of terms used for the benchmark
+#define PRP_BENCHMARK_TERMS   5
+
+// The benchmark of one term stops when it has taken at least this long
+#define PRP_BENCHMARK_US      250000
+
+#define PRP_TERM_TEXT_LENGTH  200
+
+class PRPTester
+{
+public:
+   PRPTester(App *theApp);
+
+   // FactorApp only calls the virtual functions so that apps that do not support
+   // the PRP stage do not need to link with GMP.
+   virtual ~PRPTester(void);
+
+   // This returns the average seconds for one PRP test on one core
+   virtual double    BenchmarkTest(void);
+
+   // This returns the number of terms that are PRP.  The PRPs are appended to the file.
+   virtual uint64_t  TestRemainingTerms(const char *fileName, uint64_t termCount);
+
+   static void      *TesterThreadEntryPoint(void *data);
+
+protected:
+   // This returns false if there are fewer than termIdx+1 terms for the benchmark.  The
+   // terms should be spread across the remaining terms.
+   virtual bool      GetBenchmarkTerm(uint32_t termIdx, mpz_t term) = 0;
+
+   // This returns false when there are no more terms.  The first call is with first = true.
+   // This is called while holding the lock so only one thread calls it at a time.
+   virtual bool      GetNextTerm(bool first, mpz_t term, char *termText) = 0;
+
+   App              *ip_App;
+
+private:
+   void              TestTerms(void);
+   void              ReportProgress(time_t currentTime);
+
+   // This guards everything below it
+   SharedMemoryItem *ip_TesterLock;
+
+   bool              ib_FirstTerm;
+   bool              ib_NoMoreTerms;
+   uint64_t          il_TermCount;
+   uint64_t          il_TermsTested;
+   uint64_t          il_PRPsFound;
+
+   time_t            it_StartTime;
+   time_t            it_LastCheckPointTime;
+
+   FILE             *ip_PRPFile;
+};
+
+#endif
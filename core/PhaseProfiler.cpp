@@ -0,0 +1,100 @@
+/* PhaseProfiler.cpp -- (C) Mark Rodenkirch, October 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+*/
+
+#include "PhaseProfiler.h"
+
+#ifdef USE_PHASE_PROFILER
+
+#ifdef USE_X86
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+thread_local PhaseProfiler *PhaseProfiler::ip_ThreadProfiler = 0;
+
+PhaseProfiler::PhaseProfiler(void)
+{
+   for (uint32_t phase=0; phase<PP_PHASES; phase++)
+      il_Ticks[phase] = 0;
+
+   it_CurrentPhase = PP_OTHER;
+   il_PhaseStartTick = 0;
+}
+
+void  PhaseProfiler::Start(void)
+{
+   ip_ThreadProfiler = this;
+
+   it_CurrentPhase = PP_OTHER;
+   il_PhaseStartTick = GetTick();
+}
+
+void  PhaseProfiler::Stop(void)
+{
+   il_Ticks[it_CurrentPhase] += GetTick() - il_PhaseStartTick;
+
+   ip_ThreadProfiler = 0;
+}
+
+phase_t  PhaseProfiler::SwitchTo(phase_t phase)
+{
+   PhaseProfiler *profiler = ip_ThreadProfiler;
+   phase_t        previousPhase;
+   uint64_t       currentTick;
+
+   if (profiler == 0)
+      return PP_OTHER;
+
+   previousPhase = profiler->it_CurrentPhase;
+
+   if (phase == previousPhase)
+      return previousPhase;
+
+   currentTick = GetTick();
+
+   profiler->il_Ticks[previousPhase] += currentTick - profiler->il_PhaseStartTick;
+   profiler->it_CurrentPhase = phase;
+   profiler->il_PhaseStartTick = currentTick;
+
+   return previousPhase;
+}
+
+const char *PhaseProfiler::GetPhaseName(uint32_t phase)
+{
+   switch (phase)
+   {
+      case PP_PRIME_SETUP:  return "prime setup";
+      case PP_POWMOD:       return "powmod";
+      case PP_BABY_STEPS:   return "baby steps";
+      case PP_GIANT_STEPS:  return "giant steps";
+      case PP_HASH_LOOKUP:  return "hash lookup";
+      case PP_FACTORS:      return "factors";
+      default:              return "other";
+   }
+}
+
+const char *PhaseProfiler::GetTickName(void)
+{
+#ifdef USE_X86
+   return "cycles";
+#else
+   return "ns";
+#endif
+}
+
+uint64_t  PhaseProfiler::GetTick(void)
+{
+#ifdef USE_X86
+   return __rdtsc();
+#else
+   return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+#endif
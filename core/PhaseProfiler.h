@@ -0,0 +1,92 @@
+/* PhaseProfiler.h -- (C) Mark Rodenkirch, October 2026
+
+   This counts the time that workers spend in each phase of testing a prime.  It is only
+   built when the makefile is run with PROFILE=yes, which defines USE_PHASE_PROFILER.
+   Otherwise PROFILE_SCOPE and PROFILE_SWITCH do nothing.
+
+   Each worker thread has one current phase.  PROFILE_SWITCH(phase) adds the time since
+   the last switch to the current phase and then makes phase the current phase.
+   PROFILE_SCOPE(phase) does the same, but switches back to the previous phase when the
+   scope is exited.  Since only one phase is current at a time, nested phases are not
+   counted twice.
+
+   On x86 the time is counted in cycles of the time stamp counter.  Otherwise it is
+   counted in nanoseconds.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+*/
+
+#ifndef _PHASEPROFILER_H
+#define _PHASEPROFILER_H
+
+#include <inttypes.h>
+
+typedef enum { PP_OTHER = 0,
+               PP_PRIME_SETUP,      // inverses and other values computed for each prime
+               PP_POWMOD,           // exponentiations
+               PP_BABY_STEPS,       // building the hash table
+               PP_GIANT_STEPS,      // the giant steps, including their hash lookups
+               PP_HASH_LOOKUP,      // hash lookups that are not part of a giant step
+               PP_FACTORS,          // reporting factors, including waiting for the lock
+               PP_PHASES
+             } phase_t;
+
+#ifdef USE_PHASE_PROFILER
+
+class PhaseProfiler
+{
+public:
+   PhaseProfiler(void);
+
+   ~PhaseProfiler(void) {};
+
+   // These are called by the worker thread before and after it tests a chunk of primes.
+   // Time is only counted between them.
+   void              Start(void);
+   void              Stop(void);
+
+   uint64_t          GetTicks(uint32_t phase) { return il_Ticks[phase]; };
+
+   // This switches the phase of the profiler of the calling thread and returns the
+   // previous phase.  It does nothing if the thread is not a worker.
+   static phase_t    SwitchTo(phase_t phase);
+
+   static const char *GetPhaseName(uint32_t phase);
+   static const char *GetTickName(void);
+
+private:
+   static uint64_t   GetTick(void);
+
+   uint64_t          il_Ticks[PP_PHASES];
+
+   phase_t           it_CurrentPhase;
+   uint64_t          il_PhaseStartTick;
+
+   static thread_local PhaseProfiler *ip_ThreadProfiler;
+};
+
+class PhaseScope
+{
+public:
+   PhaseScope(phase_t phase) { it_PreviousPhase = PhaseProfiler::SwitchTo(phase); };
+
+   ~PhaseScope(void) { PhaseProfiler::SwitchTo(it_PreviousPhase); };
+
+private:
+   phase_t           it_PreviousPhase;
+};
+
+#define PROFILE_SCOPE(phase)     PhaseScope phaseScope(phase)
+#define PROFILE_SWITCH(phase)    PhaseProfiler::SwitchTo(phase)
+
+#else
+
+#define PROFILE_SCOPE(phase)
+#define PROFILE_SWITCH(phase)
+
+#endif
+
+#endif
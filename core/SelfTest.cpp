@@ -0,0 +1,180 @@
+/* SelfTest.cpp -- (C) Mark Rodenkirch, October 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+#include "SelfTest.h"
+
+#define SELFTEST_TERMS_FILE     "selftest_terms.txt"
+#define SELFTEST_FACTORS_FILE   "selftest_factors.txt"
+
+// Some programs add an extension to the name of the terms file given with -o
+static const char *termsFileExtensions[] = { "", ".abcd", ".cc", ".npg", NULL };
+
+#ifdef WIN32
+#define SELFTEST_NULL_FILE      "NUL"
+#else
+#define SELFTEST_NULL_FILE      "/dev/null"
+#endif
+
+// Since the last chunk of primes can go past -P, the factors found above -P depend
+// upon the size of each chunk.  The CPU worksize is fixed so that the tuner does not
+// change the size of the chunks.
+#if defined(USE_OPENCL) || defined(USE_METAL)
+#define SELFTEST_OPTIONS        "-G 1"
+#else
+#define SELFTEST_OPTIONS        "-W 1 -w 16000F"
+#endif
+
+// These are the offset basis and prime of the 64-bit FNV-1a hash
+#define FNV_OFFSET_BASIS        0xcbf29ce484222325ULL
+#define FNV_PRIME               0x100000001b3ULL
+
+SelfTest::SelfTest(const char *programName, const selftest_t *selfTests)
+{
+   is_ProgramName = programName;
+   ip_SelfTests = selfTests;
+}
+
+bool  SelfTest::Run(void)
+{
+   uint32_t  testCount = 0;
+   uint32_t  failedCount = 0;
+
+   if (ip_SelfTests == NULL || ip_SelfTests[0].arguments == NULL)
+   {
+      printf("There are no self tests for this program\n");
+      return false;
+   }
+
+   while (ip_SelfTests[testCount].arguments != NULL)
+      testCount++;
+
+   for (uint32_t testIdx=0; testIdx<testCount; testIdx++)
+      if (!RunTest(testIdx, testCount))
+         failedCount++;
+
+   RemoveFiles();
+
+   if (failedCount > 0)
+   {
+      printf("%u of %u self tests failed\n", failedCount, testCount);
+      return false;
+   }
+
+   printf("All %u self tests passed\n", testCount);
+   return true;
+}
+
+bool  SelfTest::RunTest(uint32_t testIdx, uint32_t testCount)
+{
+   const selftest_t *selfTest = &ip_SelfTests[testIdx];
+   std::string       command;
+   uint32_t          factorCount;
+   uint64_t          factorChecksum;
+   int               status;
+
+   printf("Self test %u of %u: %s\n", testIdx + 1, testCount, selfTest->arguments);
+   fflush(stdout);
+
+   RemoveFiles();
+
+   command = "\"" + is_ProgramName + "\" " + selfTest->arguments + " " SELFTEST_OPTIONS;
+   command += " -o " SELFTEST_TERMS_FILE " -O " SELFTEST_FACTORS_FILE;
+   command += " > " SELFTEST_NULL_FILE " 2>&1";
+
+   status = system(command.c_str());
+
+   if (status != 0)
+   {
+      printf("   FAILED: the program ended with status %d\n", status);
+      return false;
+   }
+
+   if (!ReadFactors(factorCount, factorChecksum))
+   {
+      printf("   FAILED: the factor file could not be read\n");
+      return false;
+   }
+
+   if (factorCount != selfTest->factorCount || factorChecksum != selfTest->factorChecksum)
+   {
+      printf("   FAILED: expected %u factors with checksum 0x%016" PRIx64", found %u factors with checksum 0x%016" PRIx64"\n",
+               selfTest->factorCount, selfTest->factorChecksum, factorCount, factorChecksum);
+      return false;
+   }
+
+   printf("   passed with %u factors\n", factorCount);
+   return true;
+}
+
+void  SelfTest::RemoveFiles(void)
+{
+   std::string  fileName;
+
+   for (uint32_t idx=0; termsFileExtensions[idx] != NULL; idx++)
+   {
+      fileName = SELFTEST_TERMS_FILE;
+      fileName += termsFileExtensions[idx];
+
+      remove(fileName.c_str());
+   }
+
+   remove(SELFTEST_FACTORS_FILE);
+}
+
+// The checksum is the FNV-1a hash of the sorted lines of the factor file
+bool  SelfTest::ReadFactors(uint32_t &factorCount, uint64_t &factorChecksum)
+{
+   std::vector<std::string> factors;
+   char     buffer[5000];
+   FILE    *fPtr;
+
+   factorCount = 0;
+   factorChecksum = FNV_OFFSET_BASIS;
+
+   fPtr = fopen(SELFTEST_FACTORS_FILE, "r");
+
+   // The factor file might not be created if no factors are found
+   if (fPtr == NULL)
+      return true;
+
+   while (fgets(buffer, sizeof(buffer), fPtr) != NULL)
+   {
+      buffer[strcspn(buffer, "\r\n")] = 0;
+
+      if (buffer[0] != 0)
+         factors.push_back(buffer);
+   }
+
+   if (ferror(fPtr))
+   {
+      fclose(fPtr);
+      return false;
+   }
+
+   fclose(fPtr);
+
+   std::sort(factors.begin(), factors.end());
+
+   for (std::string &factor : factors)
+   {
+      for (char ch : factor + "\n")
+      {
+         factorChecksum ^= (uint8_t) ch;
+         factorChecksum *= FNV_PRIME;
+      }
+   }
+
+   factorCount = (uint32_t) factors.size();
+   return true;
+}
@@ -0,0 +1,52 @@
+/* SelfTest.h -- (C) Mark Rodenkirch, October 2026
+
+   This runs the tests of -0 (--selftest).  Each app has a list of small ranges
+   with the number of factors that must be found for each and a checksum of them.
+
+   Each test runs the program again with the arguments of the test, one worker and
+   a fixed worksize so that the same factors are found on every run.  The lines of the factor
+   file are sorted before they are counted and summed, so a test only fails if a
+   factor is missing, a factor is not expected, or a factor line is not formatted
+   the same.  The list of tests should exercise each logic that the app can use
+   for sieving, such as small and large primes and the options that select other
+   logic.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+*/
+
+#ifndef _SELFTEST_H
+#define _SELFTEST_H
+
+#include <inttypes.h>
+#include <string>
+
+// The list of tests is ended by an entry with NULL arguments
+typedef struct {
+   const char *arguments;
+   uint32_t    factorCount;
+   uint64_t    factorChecksum;
+} selftest_t;
+
+class SelfTest
+{
+public:
+   SelfTest(const char *programName, const selftest_t *selfTests);
+
+   ~SelfTest(void) {};
+
+   // Returns true if every test finds the expected factors
+   bool              Run(void);
+
+private:
+   bool              RunTest(uint32_t testIdx, uint32_t testCount);
+   void              RemoveFiles(void);
+   bool              ReadFactors(uint32_t &factorCount, uint64_t &factorChecksum);
+
+   std::string       is_ProgramName;
+   const selftest_t *ip_SelfTests;
+};
+
+#endif
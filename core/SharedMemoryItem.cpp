@@ -20,6 +20,8 @@
 SharedMemoryItem::SharedMemoryItem(const char *itemName, bool withCondition)
 {
    il_Value = 0;
+   il_LockCount = 0;
+   il_ContendedLockCount = 0;
    is_ItemName = itemName;
    ib_HasCondition = withCondition;
 
@@ -74,16 +76,26 @@ bool     SharedMemoryItem::TryLock(void)
 
 void     SharedMemoryItem::Lock(void)
 {
-
+   bool contended = !TryLock();
+   
+   if (contended)
+   {
 #ifdef WIN32
-   EnterCriticalSection(ih_CriticalSection);
+      EnterCriticalSection(ih_CriticalSection);
 #else
-   if (pthread_mutex_lock(&ih_PthreadMutex) != 0)
-   {
-      printf("Unable to lock mutex %s.  Exiting.\n", is_ItemName.c_str());
-      exit(0);
-   }
+      if (pthread_mutex_lock(&ih_PthreadMutex) != 0)
+      {
+         printf("Unable to lock mutex %s.  Exiting.\n", is_ItemName.c_str());
+         exit(0);
+      }
 #endif
+   }
+
+   // These are updated while holding the lock
+   il_LockCount++;
+   
+   if (contended)
+      il_ContendedLockCount++;
 }
 
 void     SharedMemoryItem::Release(void)
@@ -50,10 +50,16 @@ public:
    void        SetCondition(void);
    void        ClearCondition(void);
 
+   // These count the calls to Lock() and how many of them had to wait for another thread
+   uint64_t    GetLockCount(void) { return il_LockCount; };
+   uint64_t    GetContendedLockCount(void) { return il_ContendedLockCount; };
+
 private:
    std::string is_ItemName;
    bool        ib_HasCondition;
    int64_t     il_Value;
+   uint64_t    il_LockCount;
+   uint64_t    il_ContendedLockCount;
 
 #ifdef WIN32
    uint32_t    ii_CountWaiting;
@@ -0,0 +1,246 @@
+/* SmallFactorIndex.cpp -- (C) Mark Rodenkirch, October 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+*/
+
+#include <algorithm>
+#include "SmallFactorIndex.h"
+
+#include "../primesieve/include/primesieve.hpp"
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+typedef struct {
+   SmallFactorIndex *index;
+   uint32_t          threadIdx;
+   uint32_t          threadCount;
+} factor_job_t;
+
+#ifdef WIN32
+static DWORD WINAPI WindowsThreadEntryPoint(LPVOID data)
+{
+   SmallFactorIndex::FactorThreadEntryPoint(data);
+
+   return 0;
+}
+#endif
+
+static bool CompareByNumber(const sfi_factored_t &a, const sfi_factored_t &b)
+{
+   return (a.number < b.number);
+}
+
+SmallFactorIndex::SmallFactorIndex(void)
+{
+   uint64_t prime, composite, inverse;
+
+   primesieve::generate_n_primes(SFI_PRIME_COUNT, 1, &iv_Primes);
+
+   ii_Limit = (uint32_t) iv_Primes.back();
+
+   for (size_t idx=0; idx<iv_Primes.size(); idx++)
+   {
+      prime = iv_Primes[idx];
+
+      // Newton's iteration doubles the number of correct bits of the inverse each time
+      inverse = prime;
+      for (uint32_t bits=3; bits<64; bits*=2)
+         inverse *= 2 - prime * inverse;
+
+      iv_Inverses.push_back(prime == 2 ? 0 : inverse);
+      iv_MaxQuotients.push_back(UINT64_MAX / prime);
+   }
+
+   iv_SmallestFactor.resize(ii_Limit + 1, 0);
+
+   std::vector<uint64_t>::iterator it = iv_Primes.begin();
+
+   while (it != iv_Primes.end())
+   {
+      prime = *it;
+      it++;
+
+      iv_SmallestFactor[prime] = (uint32_t) prime;
+
+      for (composite=prime*prime; composite<=ii_Limit; composite+=prime)
+      {
+         if (iv_SmallestFactor[composite] == 0)
+            iv_SmallestFactor[composite] = (uint32_t) prime;
+      }
+   }
+}
+
+void  SmallFactorIndex::FactorNumbers(const std::vector<uint64_t> &numbers, uint32_t threadCount)
+{
+   std::vector<uint64_t> sortedNumbers = numbers;
+   std::vector<factor_job_t> jobs;
+   uint32_t idx;
+
+   std::sort(sortedNumbers.begin(), sortedNumbers.end());
+   sortedNumbers.erase(std::unique(sortedNumbers.begin(), sortedNumbers.end()), sortedNumbers.end());
+
+   iv_Factored.clear();
+   iv_Factored.resize(sortedNumbers.size());
+
+   for (idx=0; idx<sortedNumbers.size(); idx++)
+      iv_Factored[idx].number = sortedNumbers[idx];
+
+   if (threadCount == 0)
+      threadCount = 1;
+
+   if (threadCount > iv_Factored.size())
+      threadCount = (uint32_t) (iv_Factored.size() > 0 ? iv_Factored.size() : 1);
+
+   jobs.resize(threadCount);
+
+#ifdef WIN32
+   std::vector<HANDLE>    threads(threadCount);
+#else
+   std::vector<pthread_t> threads(threadCount);
+#endif
+
+   for (idx=0; idx<threadCount; idx++)
+   {
+      jobs[idx].index = this;
+      jobs[idx].threadIdx = idx;
+      jobs[idx].threadCount = threadCount;
+
+      // The last thread's numbers are factored by this thread
+      if (idx == threadCount - 1)
+         break;
+
+#ifdef WIN32
+      threads[idx] = CreateThread(0, 0, WindowsThreadEntryPoint, &jobs[idx], 0, 0);
+#else
+      pthread_create(&threads[idx], NULL, &FactorThreadEntryPoint, &jobs[idx]);
+#endif
+   }
+
+   FactorThreadEntryPoint(&jobs[threadCount - 1]);
+
+   for (idx=0; idx<threadCount - 1; idx++)
+   {
+#ifdef WIN32
+      WaitForSingleObject(threads[idx], INFINITE);
+      CloseHandle(threads[idx]);
+#else
+      pthread_join(threads[idx], NULL);
+#endif
+   }
+}
+
+void *SmallFactorIndex::FactorThreadEntryPoint(void *data)
+{
+   factor_job_t     *job = (factor_job_t *) data;
+   SmallFactorIndex *index = job->index;
+
+   for (size_t idx=job->threadIdx; idx<index->iv_Factored.size(); idx+=job->threadCount)
+   {
+      sfi_factored_t &factored = index->iv_Factored[idx];
+
+      factored.factorCount = index->FactorNumber(factored.number, factored.factors, factored.powers);
+   }
+
+   return 0;
+}
+
+uint32_t  SmallFactorIndex::Factor(uint64_t theNumber, uint64_t *factorList, uint32_t *powerList)
+{
+   sfi_factored_t key;
+
+   key.number = theNumber;
+
+   std::vector<sfi_factored_t>::iterator it = std::lower_bound(iv_Factored.begin(), iv_Factored.end(), key, CompareByNumber);
+
+   if (it == iv_Factored.end() || it->number != theNumber)
+      return FactorNumber(theNumber, factorList, powerList);
+
+   for (uint32_t idx=0; idx<it->factorCount; idx++)
+   {
+      factorList[idx] = it->factors[idx];
+      powerList[idx] = it->powers[idx];
+   }
+
+   return it->factorCount;
+}
+
+uint32_t  SmallFactorIndex::FactorNumber(uint64_t theNumber, uint64_t *factorList, uint32_t *powerList)
+{
+   uint32_t  distinctFactors = 0;
+   uint32_t  power;
+   uint64_t  thePrime;
+
+   size_t    idx = 0;
+
+   // Factors of 2 are removed first so that the inverse can be used for the other primes
+   if (theNumber > ii_Limit && (theNumber & 1) == 0)
+   {
+      power = 0;
+      while ((theNumber & 1) == 0)
+      {
+         theNumber >>= 1;
+         power++;
+      }
+
+      factorList[distinctFactors] = 2;
+      powerList[distinctFactors] = power;
+      distinctFactors++;
+   }
+
+   // Divide by the primes until what is left is in the index.  If what is left has no
+   // factor <= its square root, then it is prime.
+   for (idx=1; theNumber > ii_Limit && idx<iv_Primes.size(); idx++)
+   {
+      thePrime = iv_Primes[idx];
+
+      if (thePrime * thePrime > theNumber)
+         break;
+
+      if (theNumber * iv_Inverses[idx] > iv_MaxQuotients[idx])
+         continue;
+
+      power = 0;
+      while (theNumber * iv_Inverses[idx] <= iv_MaxQuotients[idx])
+      {
+         theNumber *= iv_Inverses[idx];
+         power++;
+      }
+
+      factorList[distinctFactors] = thePrime;
+      powerList[distinctFactors] = power;
+      distinctFactors++;
+   }
+
+   // If the number wasn't fully factored, that's fine.
+   if (theNumber > ii_Limit)
+   {
+      factorList[distinctFactors] = theNumber;
+      powerList[distinctFactors] = 1;
+      return distinctFactors + 1;
+   }
+
+   while (theNumber > 1)
+   {
+      thePrime = iv_SmallestFactor[theNumber];
+
+      power = 0;
+      while (theNumber % thePrime == 0)
+      {
+         theNumber /= thePrime;
+         power++;
+      }
+
+      factorList[distinctFactors] = thePrime;
+      powerList[distinctFactors] = power;
+      distinctFactors++;
+   }
+
+   return distinctFactors;
+}
@@ -0,0 +1,67 @@
+/* SmallFactorIndex.h -- (C) Mark Rodenkirch, October 2026
+
+   This is used to factor k, b, and n when looking for algebraic factors.  It has the
+   smallest prime factor of every number up to the 100000th prime, so numbers up to that
+   are factored with one lookup per factor.  Larger numbers are divided by the primes
+   until what is left is prime or small enough to be in the index.  As before, numbers
+   that have two or more factors larger than the 100000th prime are not fully factored.
+   The unfactored part is returned as if it were prime.
+
+   When there are many sequences FactorNumbers() factors all of them at once using
+   multiple threads.  Factor() then returns the saved factorization.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+*/
+
+#ifndef _SMALLFACTORINDEX_H
+#define _SMALLFACTORINDEX_H
+
+#include <inttypes.h>
+#include <vector>
+
+#define SFI_PRIME_COUNT    100000
+
+// A 64-bit number cannot have more than 15 distinct prime factors
+#define SFI_MAX_FACTORS    16
+
+typedef struct {
+   uint64_t          number;
+   uint32_t          factorCount;
+   uint64_t          factors[SFI_MAX_FACTORS];
+   uint32_t          powers[SFI_MAX_FACTORS];
+} sfi_factored_t;
+
+class SmallFactorIndex
+{
+public:
+   SmallFactorIndex(void);
+
+   ~SmallFactorIndex(void) {};
+
+   // Factor all of these numbers using multiple threads and save the factorizations.
+   void              FactorNumbers(const std::vector<uint64_t> &numbers, uint32_t threadCount);
+
+   // The factors are returned in ascending order.  This returns the number of factors.
+   uint32_t          Factor(uint64_t theNumber, uint64_t *factorList, uint32_t *powerList);
+
+   // Each thread factors every threadCount-th saved number starting with threadIdx
+   static void      *FactorThreadEntryPoint(void *data);
+
+private:
+   uint32_t          ii_Limit;
+
+   // For an odd prime p, n is divisible by p if n * p^-1 (mod 2^64) <= (2^64-1)/p.
+   // This is much faster than computing n % p.
+   std::vector<uint64_t>        iv_Primes;
+   std::vector<uint64_t>        iv_Inverses;
+   std::vector<uint64_t>        iv_MaxQuotients;
+   std::vector<uint32_t>        iv_SmallestFactor;
+   std::vector<sfi_factored_t>  iv_Factored;
+
+   uint32_t          FactorNumber(uint64_t theNumber, uint64_t *factorList, uint32_t *powerList);
+};
+
+#endif
@@ -0,0 +1,290 @@
+/* TermsFileWriter.cpp -- (C) Mark Rodenkirch, October 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+*/
+
+#include <stdio.h>
+#include <stdarg.h>
+#include "main.h"
+#include "TermsFileWriter.h"
+
+// This is used when there is no term before a chunk
+#define TFW_NO_BIT      0xffffffffffffffffULL
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+typedef struct {
+   format_chunk_t formatChunk;
+   void          *owner;
+   uint64_t       chunk;
+   TermsBuffer   *buffer;
+   uint64_t       termCount;
+} format_job_t;
+
+#ifdef WIN32
+static DWORD WINAPI FormatThreadEntryPoint(LPVOID data)
+#else
+static void *FormatThreadEntryPoint(void *data)
+#endif
+{
+   format_job_t *job = (format_job_t *) data;
+
+   job->termCount = job->formatChunk(job->owner, job->chunk, job->buffer);
+
+   return 0;
+}
+
+void  TermsBuffer::AppendFormat(const char *fmt, ...)
+{
+   char     text[1000];
+   va_list  args;
+
+   va_start(args, fmt);
+   vsnprintf(text, sizeof(text), fmt, args);
+   va_end(args);
+
+   is_Text.append(text);
+}
+
+TermsFileWriter::TermsFileWriter(uint32_t threadCount)
+{
+   ii_ThreadCount = (threadCount > 0 ? threadCount : 1);
+}
+
+uint64_t  TermsFileWriter::WriteFile(const char *fileName, uint64_t chunkCount, format_chunk_t formatChunk, void *owner)
+{
+   std::string tempFileName = std::string(fileName) + ".tmp";
+   std::vector<TermsBuffer> buffers(ii_ThreadCount);
+   std::vector<format_job_t> jobs(ii_ThreadCount);
+   uint64_t    chunk, termCount = 0;
+   uint32_t    idx, jobCount;
+
+   FILE *termsFile = fopen(tempFileName.c_str(), "w");
+
+   if (!termsFile)
+      FatalError("Unable to open output file %s", tempFileName.c_str());
+
+   // Each thread formats one chunk, then the buffers are written in order
+   for (chunk=0; chunk<chunkCount; chunk+=jobCount)
+   {
+      jobCount = ii_ThreadCount;
+
+      if (chunk + jobCount > chunkCount)
+         jobCount = (uint32_t) (chunkCount - chunk);
+
+#ifdef WIN32
+      std::vector<HANDLE>    threads(jobCount);
+#else
+      std::vector<pthread_t> threads(jobCount);
+#endif
+
+      for (idx=0; idx<jobCount; idx++)
+      {
+         buffers[idx].Clear();
+
+         jobs[idx].formatChunk = formatChunk;
+         jobs[idx].owner = owner;
+         jobs[idx].chunk = chunk + idx;
+         jobs[idx].buffer = &buffers[idx];
+         jobs[idx].termCount = 0;
+
+         // The last chunk is formatted by this thread
+         if (idx == jobCount - 1)
+            break;
+
+#ifdef WIN32
+         threads[idx] = CreateThread(0, 0, FormatThreadEntryPoint, &jobs[idx], 0, 0);
+#else
+         pthread_create(&threads[idx], NULL, &FormatThreadEntryPoint, &jobs[idx]);
+#endif
+      }
+
+      FormatThreadEntryPoint(&jobs[jobCount - 1]);
+
+      for (idx=0; idx<jobCount; idx++)
+      {
+         if (idx < jobCount - 1)
+         {
+#ifdef WIN32
+            WaitForSingleObject(threads[idx], INFINITE);
+            CloseHandle(threads[idx]);
+#else
+            pthread_join(threads[idx], NULL);
+#endif
+         }
+
+         const std::string &text = buffers[idx].GetText();
+
+         if (text.length() > 0 && fwrite(text.data(), 1, text.length(), termsFile) != text.length())
+            FatalError("Unable to write to output file %s", tempFileName.c_str());
+
+         termCount += jobs[idx].termCount;
+      }
+   }
+
+   if (fclose(termsFile) != 0)
+      FatalError("Unable to write to output file %s", tempFileName.c_str());
+
+#ifdef WIN32
+   // rename() will not replace an existing file on Windows
+   remove(fileName);
+#endif
+
+   if (rename(tempFileName.c_str(), fileName) != 0)
+      FatalError("Unable to rename %s to %s", tempFileName.c_str(), fileName);
+
+   return termCount;
+}
+
+KTermsFileWriter::KTermsFileWriter(KWheel *wheel, uint32_t threadCount) : TermsFileWriter(threadCount)
+{
+   ip_Wheel = wheel;
+
+   il_BitCount = ip_Wheel->GetBitCount();
+   il_ChunkCount = (il_BitCount + TFW_CHUNK_BITS - 1) / TFW_CHUNK_BITS;
+}
+
+void  KTermsFileWriter::AddBitmap(const std::vector<bool> &terms, const char *suffix)
+{
+   iv_Terms.push_back(terms);
+   iv_Suffixes.push_back(suffix);
+}
+
+uint64_t  KTermsFileWriter::WriteABCD(const char *fileName, const char *headerPrefix, const char *headerSuffix)
+{
+   const std::vector<bool> &terms = iv_Terms[0];
+   uint64_t chunk, bit, startBit, lastBit = TFW_NO_BIT;
+
+   is_Header = headerPrefix;
+   is_HeaderSuffix = headerSuffix;
+
+   // The first k of each chunk is written as the difference from the last k before the
+   // chunk, so find the last term of each chunk first.  Each chunk is searched from its
+   // end, so only chunks with few terms are scanned far.
+   iv_PreviousBits.resize(il_ChunkCount);
+
+   for (chunk=0; chunk<il_ChunkCount; chunk++)
+   {
+      iv_PreviousBits[chunk] = lastBit;
+
+      startBit = chunk * TFW_CHUNK_BITS;
+      bit = startBit + TFW_CHUNK_BITS;
+
+      if (bit > il_BitCount)
+         bit = il_BitCount;
+
+      for ( ; bit>startBit; bit--)
+      {
+         if (terms[bit - 1])
+         {
+            lastBit = bit - 1;
+            break;
+         }
+      }
+   }
+
+   return WriteFile(fileName, il_ChunkCount, FormatABCDChunk, this);
+}
+
+uint64_t  KTermsFileWriter::WriteList(const char *fileName, const char *header)
+{
+   is_Header = header;
+
+   return WriteFile(fileName, il_ChunkCount, FormatListChunk, this);
+}
+
+// The first k in the chunk is written as the difference from the last k in the previous
+// chunks, which WriteABCD() found.  If there is no such k, then this chunk has the first
+// term so it has the header.
+uint64_t  KTermsFileWriter::FormatABCDChunk(void *owner, uint64_t chunk, TermsBuffer *buffer)
+{
+   KTermsFileWriter *writer = (KTermsFileWriter *) owner;
+   const std::vector<bool> &terms = writer->iv_Terms[0];
+   KWheel  *wheel = writer->ip_Wheel;
+   uint64_t bit = chunk * TFW_CHUNK_BITS;
+   uint64_t endBit = bit + TFW_CHUNK_BITS;
+   uint64_t previousBit = writer->iv_PreviousBits[chunk];
+   uint64_t k, previousK = 0, termCount = 0;
+   bool     havePreviousK = false;
+
+   if (endBit > writer->il_BitCount)
+      endBit = writer->il_BitCount;
+
+   if (previousBit != TFW_NO_BIT)
+   {
+      previousK = wheel->GetK(previousBit);
+      havePreviousK = true;
+   }
+
+   for ( ; bit<endBit; bit++)
+   {
+      if (!terms[bit])
+         continue;
+
+      k = wheel->GetK(bit);
+
+      if (havePreviousK)
+         buffer->AppendU64(k - previousK);
+      else
+      {
+         buffer->AppendText(writer->is_Header.c_str());
+         buffer->AppendChar('[');
+         buffer->AppendU64(k);
+         buffer->AppendChar(']');
+         buffer->AppendText(writer->is_HeaderSuffix.c_str());
+      }
+
+      buffer->AppendChar('\n');
+
+      previousK = k;
+      havePreviousK = true;
+      termCount++;
+   }
+
+   return termCount;
+}
+
+uint64_t  KTermsFileWriter::FormatListChunk(void *owner, uint64_t chunk, TermsBuffer *buffer)
+{
+   KTermsFileWriter *writer = (KTermsFileWriter *) owner;
+   KWheel  *wheel = writer->ip_Wheel;
+   uint64_t bit = chunk * TFW_CHUNK_BITS;
+   uint64_t endBit = bit + TFW_CHUNK_BITS;
+   uint64_t k, termCount = 0;
+   uint32_t idx, bitmapCount = (uint32_t) writer->iv_Terms.size();
+
+   if (endBit > writer->il_BitCount)
+      endBit = writer->il_BitCount;
+
+   if (chunk == 0)
+   {
+      buffer->AppendText(writer->is_Header.c_str());
+      buffer->AppendChar('\n');
+   }
+
+   for ( ; bit<endBit; bit++)
+   {
+      for (idx=0; idx<bitmapCount; idx++)
+      {
+         if (!writer->iv_Terms[idx][bit])
+            continue;
+
+         k = wheel->GetK(bit);
+
+         buffer->AppendU64(k);
+         buffer->AppendText(writer->iv_Suffixes[idx].c_str());
+         buffer->AppendChar('\n');
+
+         termCount++;
+      }
+   }
+
+   return termCount;
+}
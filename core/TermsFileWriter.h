@@ -0,0 +1,140 @@
+/* TermsFileWriter.h -- (C) Mark Rodenkirch, October 2026
+
+   This is used by sieves that can have hundreds of millions of remaining terms.  Writing
+   those with one fprintf per term while holding the lock for the terms stops all workers
+   for a long time at each checkpoint.
+
+   Instead the app copies its terms while holding the lock and releases it.  The terms are
+   then split into chunks that are formatted by multiple threads into buffers using a fast
+   integer to decimal conversion.  The buffers are written in order to a temporary file
+   which is renamed to the terms file when done, so a terms file is never left partially
+   written.  Only a few chunks are held in memory at a time.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+*/
+
+#ifndef _TERMSFILEWRITER_H
+#define _TERMSFILEWRITER_H
+
+#include <inttypes.h>
+#include <string>
+#include <vector>
+
+#include "KWheel.h"
+
+// This is the number of bits of a bitmap that are formatted by a thread at a time
+#define TFW_CHUNK_BITS     (1 << 20)
+
+class TermsBuffer
+{
+public:
+   TermsBuffer(void) {};
+
+   ~TermsBuffer(void) {};
+
+   void              Clear(void) { is_Text.clear(); };
+   const std::string &GetText(void) { return is_Text; };
+
+   void              AppendChar(char c) { is_Text.push_back(c); };
+   void              AppendText(const char *text) { is_Text.append(text); };
+   void              AppendFormat(const char *fmt, ...);
+
+   inline void       AppendU64(uint64_t value)
+   {
+      static const char digitPairs[] =
+         "0001020304050607080910111213141516171819"
+         "2021222324252627282930313233343536373839"
+         "4041424344454647484950515253545556575859"
+         "6061626364656667686970717273747576777879"
+         "8081828384858687888990919293949596979899";
+      char     digits[20];
+      char    *ptr = digits + sizeof(digits);
+      uint32_t pair;
+
+      while (value >= 100)
+      {
+         pair = (uint32_t) (value % 100);
+         value /= 100;
+
+         ptr -= 2;
+         ptr[0] = digitPairs[2*pair];
+         ptr[1] = digitPairs[2*pair + 1];
+      }
+
+      if (value >= 10)
+      {
+         ptr -= 2;
+         ptr[0] = digitPairs[2*value];
+         ptr[1] = digitPairs[2*value + 1];
+      }
+      else
+         *(--ptr) = (char) ('0' + value);
+
+      is_Text.append(ptr, digits + sizeof(digits) - ptr);
+   };
+
+private:
+   std::string       is_Text;
+};
+
+// This formats one chunk into the buffer and returns the number of terms in the chunk.
+// It is called by multiple threads at the same time for different chunks.
+typedef uint64_t (*format_chunk_t)(void *owner, uint64_t chunk, TermsBuffer *buffer);
+
+class TermsFileWriter
+{
+public:
+   TermsFileWriter(uint32_t threadCount);
+
+   virtual ~TermsFileWriter(void) {};
+
+   // This returns the number of terms written.
+   uint64_t          WriteFile(const char *fileName, uint64_t chunkCount, format_chunk_t formatChunk, void *owner);
+
+private:
+   uint32_t          ii_ThreadCount;
+};
+
+// This is for apps with a bitmap of k (see KWheel.h).  There can be more than one bitmap
+// for the same k, for example one for +1 and one for -1.  The bitmaps are copied when
+// they are added so that the app can release its lock before writing the file.
+class KTermsFileWriter : public TermsFileWriter
+{
+public:
+   KTermsFileWriter(KWheel *wheel, uint32_t threadCount);
+
+   ~KTermsFileWriter(void) {};
+
+   // The suffix is written after k on each line by WriteList().
+   void              AddBitmap(const std::vector<bool> &terms, const char *suffix);
+
+   // Write "<prefix>[k] <suffix>" then the difference between each k and the previous k.
+   // Only the first bitmap is written.  Nothing is written if there are no terms.
+   uint64_t          WriteABCD(const char *fileName, const char *headerPrefix, const char *headerSuffix);
+
+   // Write the header then one line per term with k followed by the suffix of the bitmap.
+   // For each k the bitmaps are written in the order they were added.
+   uint64_t          WriteList(const char *fileName, const char *header);
+
+private:
+   static uint64_t   FormatABCDChunk(void *owner, uint64_t chunk, TermsBuffer *buffer);
+   static uint64_t   FormatListChunk(void *owner, uint64_t chunk, TermsBuffer *buffer);
+
+   KWheel           *ip_Wheel;
+   uint64_t          il_BitCount;
+   uint64_t          il_ChunkCount;
+
+   std::vector<std::vector<bool>>  iv_Terms;
+   std::vector<std::string>        iv_Suffixes;
+
+   // For WriteABCD() this is the last bit with a term before each chunk
+   std::vector<uint64_t>           iv_PreviousBits;
+
+   std::string       is_Header;
+   std::string       is_HeaderSuffix;
+};
+
+#endif
@@ -0,0 +1,250 @@
+/* WorkSizeTuner.cpp -- (C) Mark Rodenkirch, October 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+*/
+
+#include "WorkSizeTuner.h"
+#include "App.h"
+#include "SharedMemoryItem.h"
+
+#define NO_RANGE              0xffffffff
+
+// A worksize is tested until its chunks take at least this long in total
+#define TUNER_MIN_SAMPLE_US   1000000
+
+#define TUNER_MAX_CHUNK_US    5000000
+
+// Rates that differ by less than 3% are treated as the same
+#define TUNER_TOLERANCE       0.03
+
+// AVX requires a multiple of 16.  All other CPU workers want a multiple of 4.
+#define TUNER_MIN_WORKSIZE    1600
+
+// This is the hard-coded limit in App.cpp
+#define TUNER_MAX_WORKSIZE    1000000000
+
+WorkSizeTuner::WorkSizeTuner(App *theApp)
+{
+   ip_App = theApp;
+   ip_TunerLocker = new SharedMemoryItem("worksize_tuner");
+
+   ii_WorkSize = 0;
+   ii_ReportedWorkSize = 0;
+
+   Reset();
+}
+
+WorkSizeTuner::~WorkSizeTuner(void)
+{
+   delete ip_TunerLocker;
+}
+
+void  WorkSizeTuner::Reset(void)
+{
+   ip_TunerLocker->Lock();
+
+   for (uint32_t range=0; range<TUNER_RANGES; range++)
+      ii_BestWorkSizes[range] = 0;
+
+   ii_Range = NO_RANGE;
+
+   ip_TunerLocker->Release();
+}
+
+uint32_t  WorkSizeTuner::AddSample(uint32_t workSize, uint32_t primesTested, uint64_t chunkUS, uint64_t largestPrime, bool miniChunks)
+{
+   uint32_t  bits = 0;
+   uint32_t  range;
+   uint32_t  minChunks = ip_App->GetCpuWorkerCount();
+   uint32_t  nextWorkSize;
+
+   while ((largestPrime >> bits) > 1)
+      bits++;
+
+   range = (bits / 4) * 2 + (miniChunks ? 1 : 0);
+
+   // Stay in the current range for the same kind of chunk until p is clearly past the
+   // start of the next range.  A worker that is behind the others could still report
+   // a prime from the lower range.
+   if (ii_Range != NO_RANGE && (range & 1) == (ii_Range & 1))
+   {
+      if (range < ii_Range || (range > ii_Range && bits % 4 == 0))
+         range = ii_Range;
+   }
+
+   if (chunkUS == 0)
+      chunkUS = 1;
+
+   if (minChunks == 0)
+      minChunks = 1;
+
+   ip_TunerLocker->Lock();
+
+   if (ii_WorkSize == 0)
+      ii_WorkSize = RoundWorkSize(workSize);
+
+   if (range != ii_Range)
+   {
+      StartTuning(range, ii_WorkSize);
+
+      nextWorkSize = ii_WorkSize;
+      ip_TunerLocker->Release();
+      return nextWorkSize;
+   }
+
+   // Ignore samples for a worksize that is no longer being tried
+   if (workSize != ii_WorkSize)
+   {
+      nextWorkSize = ii_WorkSize;
+      ip_TunerLocker->Release();
+      return nextWorkSize;
+   }
+
+   if (ib_Tuned)
+   {
+      // The chunks might get slower as p gets larger
+      if (chunkUS > TUNER_MAX_CHUNK_US && ii_WorkSize > TUNER_MIN_WORKSIZE)
+      {
+         ii_WorkSize = RoundWorkSize(ii_WorkSize / 2);
+         ii_BestWorkSizes[ii_Range] = ii_WorkSize;
+      }
+
+      nextWorkSize = ii_WorkSize;
+      ip_TunerLocker->Release();
+      return nextWorkSize;
+   }
+
+   ii_SampleChunks++;
+   il_SamplePrimes += primesTested;
+   il_SampleUS += chunkUS;
+
+   if (ii_SampleChunks >= minChunks && il_SampleUS >= TUNER_MIN_SAMPLE_US)
+   {
+      ii_WorkSize = GetNextWorkSize((double) il_SamplePrimes * 1000000.0 / (double) il_SampleUS, il_SampleUS / ii_SampleChunks);
+
+      ii_SampleChunks = 0;
+      il_SamplePrimes = 0;
+      il_SampleUS = 0;
+   }
+
+   nextWorkSize = ii_WorkSize;
+
+   ip_TunerLocker->Release();
+
+   return nextWorkSize;
+}
+
+// If this range was tuned before the last rebuild, then use that worksize
+void  WorkSizeTuner::StartTuning(uint32_t range, uint32_t workSize)
+{
+   ii_Range = range;
+
+   ii_SampleChunks = 0;
+   il_SamplePrimes = 0;
+   il_SampleUS = 0;
+
+   if (ii_BestWorkSizes[range] > 0)
+   {
+      ii_WorkSize = ii_BestWorkSizes[range];
+      ib_Tuned = true;
+      return;
+   }
+
+   ii_WorkSize = workSize;
+   ib_Tuned = false;
+   ii_Direction = 1;
+   ib_Improved = false;
+   ib_ChangedDirection = false;
+
+   ii_BestWorkSize = workSize;
+   id_BestRate = 0.0;
+   il_BestChunkUS = 0;
+}
+
+uint32_t  WorkSizeTuner::GetNextWorkSize(double rate, uint64_t averageChunkUS)
+{
+   bool  isBetter;
+
+   // A larger worksize is kept if its rate is about the same as the best rate since it
+   // needs less of the main thread, which isn't measured.  A smaller worksize has to
+   // be faster.  The first worksize is always better unless its chunks are too slow.
+   if (ii_Direction > 0)
+      isBetter = (rate >= id_BestRate * (1.0 - TUNER_TOLERANCE));
+   else
+      isBetter = (rate > id_BestRate * (1.0 + TUNER_TOLERANCE));
+
+   if (averageChunkUS > TUNER_MAX_CHUNK_US)
+      isBetter = false;
+
+   if (isBetter)
+   {
+      if (id_BestRate > 0.0)
+         ib_Improved = true;
+
+      ii_BestWorkSize = ii_WorkSize;
+      il_BestChunkUS = averageChunkUS;
+
+      // Compare to the fastest rate so that the rate cannot drift lower
+      if (rate > id_BestRate)
+         id_BestRate = rate;
+   }
+   else
+   {
+      if (ib_Improved || ib_ChangedDirection)
+         return SetBestWorkSize();
+
+      ii_Direction = -1;
+      ib_ChangedDirection = true;
+   }
+
+   if (ii_Direction > 0 && (ii_BestWorkSize >= TUNER_MAX_WORKSIZE || il_BestChunkUS * 2 > TUNER_MAX_CHUNK_US))
+   {
+      if (ib_Improved || ib_ChangedDirection)
+         return SetBestWorkSize();
+
+      ii_Direction = -1;
+      ib_ChangedDirection = true;
+   }
+
+   if (ii_Direction < 0 && ii_BestWorkSize <= TUNER_MIN_WORKSIZE)
+      return SetBestWorkSize();
+
+   if (ii_Direction > 0)
+      return RoundWorkSize((uint64_t) ii_BestWorkSize * 2);
+
+   return RoundWorkSize(ii_BestWorkSize / 2);
+}
+
+uint32_t  WorkSizeTuner::SetBestWorkSize(void)
+{
+   // If every worksize was too slow, then use the last (smallest) one
+   uint32_t  workSize = (id_BestRate > 0.0 ? ii_BestWorkSize : ii_WorkSize);
+
+   ii_BestWorkSizes[ii_Range] = workSize;
+   ib_Tuned = true;
+
+   if (workSize != ii_ReportedWorkSize)
+   {
+      ip_App->WriteToConsole(COT_OTHER, "Worksize set to %u since it tests the most primes per second", workSize);
+      ii_ReportedWorkSize = workSize;
+   }
+
+   return workSize;
+}
+
+uint32_t  WorkSizeTuner::RoundWorkSize(uint64_t workSize)
+{
+   if (workSize < TUNER_MIN_WORKSIZE)
+      workSize = TUNER_MIN_WORKSIZE;
+
+   if (workSize > TUNER_MAX_WORKSIZE)
+      workSize = TUNER_MAX_WORKSIZE;
+
+   while (workSize % 32)
+      workSize++;
+
+   return (uint32_t) workSize;
+}
@@ -0,0 +1,87 @@
+/* WorkSizeTuner.h -- (C) Mark Rodenkirch, October 2026
+
+   This chooses the number of primes in each chunk of work given to the CPU workers.
+
+   The workers send the number of primes and the time of each chunk that they test.
+   The time starts when the worker finished its previous chunk, so it includes the time
+   waiting for the main thread to give it primes and the time to grow its prime list.
+   The samples of all workers for the current worksize are combined until there are
+   enough of them, then the rate (primes per second) is compared to the best so far.
+   The worksize is doubled until the rate gets worse.  If the first doubling makes the
+   rate worse, then it is halved while that makes the rate better.  The worksize with
+   the best rate is used until the largest prime tested grows by a factor of 16 or the
+   worker switches between mini chunks and mega chunks, then it is tuned again from that
+   worksize.  A worksize is not used if it takes more than 5 seconds to test a chunk.
+
+   Since the workers test their chunks at the same time, the samples near the start of
+   a range can come from either side of it.  The tuner only moves to the next range once
+   the largest prime is at least twice the start of that range and it never moves back
+   to a lower range, so tuning does not restart back and forth at the boundary.
+
+   The app calls Reset() after a rebuild since the workers might use different logic.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+*/
+
+#ifndef _WORKSIZETUNER_H
+#define _WORKSIZETUNER_H
+
+#include <inttypes.h>
+
+class App;
+class SharedMemoryItem;
+
+// The largest prime is split into ranges of 4 bits for both mini and mega chunks
+#define TUNER_RANGES    32
+
+class WorkSizeTuner
+{
+public:
+   WorkSizeTuner(App *theApp);
+
+   ~WorkSizeTuner(void);
+
+   // This is called by a worker thread after it tests a chunk of primes.  It returns
+   // the number of primes that the worker should get for its next chunk.
+   uint32_t          AddSample(uint32_t workSize, uint32_t primesTested, uint64_t chunkUS, uint64_t largestPrime, bool miniChunks);
+
+   // This is 0 until the first sample is added
+   uint32_t          GetWorkSize(void) { return ii_WorkSize; };
+
+   void              Reset(void);
+
+private:
+   void              StartTuning(uint32_t range, uint32_t workSize);
+   uint32_t          GetNextWorkSize(double rate, uint64_t averageChunkUS);
+   uint32_t          SetBestWorkSize(void);
+   uint32_t          RoundWorkSize(uint64_t workSize);
+
+   App              *ip_App;
+   SharedMemoryItem *ip_TunerLocker;
+
+   // This is the worksize of the next chunk given to each worker
+   uint32_t          ii_WorkSize;
+
+   uint32_t          ii_Range;
+   uint32_t          ii_BestWorkSizes[TUNER_RANGES];
+
+   bool              ib_Tuned;
+   int32_t           ii_Direction;
+   bool              ib_Improved;
+   bool              ib_ChangedDirection;
+
+   uint32_t          ii_BestWorkSize;
+   double            id_BestRate;
+   uint64_t          il_BestChunkUS;
+   uint32_t          ii_ReportedWorkSize;
+
+   // These are the samples of the workers for ii_WorkSize
+   uint32_t          ii_SampleChunks;
+   uint64_t          il_SamplePrimes;
+   uint64_t          il_SampleUS;
+};
+
+#endif
@@ -43,10 +43,12 @@ Worker::Worker(uint32_t myId, App *theApp)
    il_PrimesTested = 0;
    il_LargestPrimeTested = 0;
    il_WorkerCpuUS = 0;
+   il_ChunksTested = 0;
+   il_StartProcessingUS = Clock::GetCurrentMicrosecond();
 
    ib_GpuWorker = false;
 
-   ii_MaxWorkSize = ip_App->GetCpuWorkSize();
+   ii_WorkSize = ii_MaxWorkSize = ip_App->GetCpuWorkSize();
    
    il_PrimeList = NULL;
 
@@ -107,7 +109,7 @@ void  Worker::AllocatePrimeList(void)
 {
 #if defined(USE_OPENCL) || defined(USE_METAL)
    if (ib_GpuWorker)
-      ii_MaxWorkSize = ip_App->GetGpuPrimesPerWorker();
+      ii_WorkSize = ii_MaxWorkSize = ip_App->GetGpuPrimesPerWorker();
 #endif
 
    NotifyPrimeListAllocated(ii_MaxWorkSize);
@@ -115,21 +117,30 @@ void  Worker::AllocatePrimeList(void)
    if (il_PrimeList != NULL)
       return;
    
-   // Get a little extra space because we want to use 0 to end the list.
-   il_PrimeList = (uint64_t *) xmalloc(ii_MaxWorkSize + 2, sizeof(uint64_t), "primeList");
+   // Get a little extra space because we want to use 0 to end the list.  This is
+   // reallocated when the worksize changes, so it comes from the pool of the NUMA
+   // node of this worker.
+   il_PrimeList = (uint64_t *) xmalloc_pooled(ii_MaxWorkSize + 2, sizeof(uint64_t), "primeList", ip_App->GetNumaNodeForWorker(ii_MyId));
 }
 
 // This is executed in a thread that is not the main thread
 void  Worker::StartProcessing(void)
 {
-   uint64_t startTime, endTime;
+   uint64_t startTime, endTime, lastEndTime, waitTime;
+   bool     miniChunks;
 
 #ifdef USE_X86
    uint16_t savedFpuMode;
 #endif
    
+   // For -1 and -2, move this thread to its CPUs before allocating its memory
+   ip_App->PlaceWorkerThread(ii_MyId);
+   
    AllocatePrimeList();
    
+   il_StartProcessingUS = Clock::GetCurrentMicrosecond();
+   lastEndTime = 0;
+   
    SetStatusWaitingForWork();
    
    while (true)
@@ -152,13 +163,23 @@ void  Worker::StartProcessing(void)
       savedFpuMode = fpu_mod_init();
 #endif
 
-      if (ii_MiniChunkSize > 0 && 
-         il_PrimeList[0] > il_MinPrimeForMiniChunkMode &&
-         il_PrimeList[ii_PrimesInList-1] < il_MaxPrimeForMiniChunkMode)      
+#ifdef USE_PHASE_PROFILER
+      ir_PhaseProfiler.Start();
+#endif
+
+      miniChunks = (ii_MiniChunkSize > 0 && 
+                    il_PrimeList[0] > il_MinPrimeForMiniChunkMode &&
+                    il_PrimeList[ii_PrimesInList-1] < il_MaxPrimeForMiniChunkMode);
+                    
+      if (miniChunks)
          TestWithMiniChunks();
       else
          TestMegaPrimeChunk();
 
+#ifdef USE_PHASE_PROFILER
+      ir_PhaseProfiler.Stop();
+#endif
+
 #ifdef USE_X86
       fpu_mod_fini(savedFpuMode);
 #endif
@@ -169,38 +190,26 @@ void  Worker::StartProcessing(void)
       endTime = Clock::GetCurrentMicrosecond();
 
       il_WorkerCpuUS += (endTime - startTime);
+      il_ChunksTested++;
       
       ip_StatsLocker->Release();
 
+      // This includes the time waiting for this chunk and the time since the last chunk
+      // to resize the prime list, so larger chunks are better if those take a while.
+      // A wait longer than the chunk means that this worker was idle for another reason,
+      // such as only one worker testing the small primes, so no more than that is counted.
       if (!ib_GpuWorker && il_LargestPrimeTested > 100000 && !ip_App->IsFixedCpuWorkSize())
       {
-         uint64_t newWorkSize = ComputeOptimalWorkSize(startTime, endTime);
-
-         // AVX requires a multiple of 16.  All other CPU workers want a multiple of 4.
-         if (newWorkSize < 1600)
-            newWorkSize = 1600;
-
-         // This is the hard-coded limit in App.cpp
-         if (newWorkSize > 1000000000)
-            newWorkSize = 1000000000;
-            
-         if (ii_MyId == 1 && newWorkSize > ii_MaxWorkSize)
-            ip_App->WriteToConsole(COT_OTHER, "Increasing worksize to %llu since each chunk is tested in less than a second", newWorkSize);
-            
-         if (ii_MyId == 1 && newWorkSize < ii_MaxWorkSize)
-            ip_App->WriteToConsole(COT_OTHER, "Decreasing worksize to %llu since each chunk needs more than 5 seconds to test", newWorkSize);
-         
-         if (newWorkSize != ii_MaxWorkSize)
-         {
-            ii_MaxWorkSize = (uint32_t) newWorkSize;
+         waitTime = (lastEndTime == 0 ? 0 : startTime - lastEndTime);
          
-            xfree(il_PrimeList);
-            il_PrimeList = NULL;
+         if (waitTime > endTime - startTime)
+            waitTime = endTime - startTime;
             
-            AllocatePrimeList();
-         }
+         TuneWorkSize(endTime - startTime + waitTime, miniChunks);
       }
 
+      lastEndTime = endTime;
+      
       SetStatusWaitingForWork();
    }
 
@@ -254,42 +263,20 @@ void    Worker::TestWithMiniChunks(void)
    }
 }
 
-uint64_t Worker::ComputeOptimalWorkSize(uint64_t startTime, uint64_t endTime)
+void  Worker::TuneWorkSize(uint64_t chunkUS, bool miniChunks)
 {
-   uint64_t optimalWorkSize = ii_MaxWorkSize;
-   
-   if (endTime - startTime == 0)
-      return optimalWorkSize * 100;
-
-   uint64_t microSeconds = endTime - startTime;
+   ii_WorkSize = ip_App->TuneCpuWorkSize(ii_WorkSize, ii_PrimesInList, chunkUS, il_LargestPrimeTested, miniChunks);
 
-   if (microSeconds < 1000000)
-   {
-      while (microSeconds < 1000000)
-      {
-         microSeconds *= 5;
-         optimalWorkSize *= 5;
-      }
-
-      return optimalWorkSize;
-   }
+   // The prime list is only reallocated if it is too small
+   if (ii_WorkSize <= ii_MaxWorkSize)
+      return;
    
-   if (microSeconds > 5000000)
-   {
-      while (microSeconds > 5000000)
-      {
-         microSeconds /= 2;
-         optimalWorkSize /= 2;
-      }
-      
-      // AVX requires a multiple of 16.  All other CPU workers want a multiple of 4.
-      while (optimalWorkSize % 32)
-         optimalWorkSize++;
+   ii_MaxWorkSize = ii_WorkSize;
 
-      return optimalWorkSize;
-   }
+   xfree(il_PrimeList);
+   il_PrimeList = NULL;
    
-   return optimalWorkSize;
+   AllocatePrimeList();
 }
 
 // Determine if there is a value x such that x^2 = 2 (mod p).
@@ -23,6 +23,7 @@ class Worker;
 
 #include "App.h"
 #include "SharedMemoryItem.h"
+#include "PhaseProfiler.h"
 
 typedef enum { WS_INITIALIZING,
                WS_WAITING_FOR_WORK, // Indicates this thread is initialized and waiting for work
@@ -56,12 +57,15 @@ public:
    
    void              AllocatePrimeList(void);
 
+   uint32_t          GetWorkSize(void) { return ii_WorkSize; };
    uint32_t          GetMaxWorkSize(void) { return ii_MaxWorkSize; };
    uint64_t         *GetPrimeList(void) { return il_PrimeList; };
    
    uint64_t          GetWorkerCpuUS(void)  { return il_WorkerCpuUS; }
    uint64_t          GetPrimesTested(void)    { return il_PrimesTested; }
    uint64_t          GetLargestPrimeTested(void)  { return il_LargestPrimeTested; }
+   uint64_t          GetChunksTested(void)  { return il_ChunksTested; }
+   uint64_t          GetStartProcessingUS(void)  { return il_StartProcessingUS; }
  
    bool              IsInitialized(void) { return ib_Initialized; };
    
@@ -69,6 +73,7 @@ public:
    bool              IsStatusWaitingForWork(void) { return (((workerstatus_t) ip_WorkerStatus->GetValueNoLock()) == WS_WAITING_FOR_WORK); };
    bool              IsStatusWorking(void) { return (((workerstatus_t) ip_WorkerStatus->GetValueNoLock()) == WS_WORKING); };
    bool              IsStatusStopped(void) { return (((workerstatus_t) ip_WorkerStatus->GetValueNoLock()) == WS_STOPPED); };
+   workerstatus_t    GetStatus(void) { return (workerstatus_t) ip_WorkerStatus->GetValueNoLock(); };
    
    void              SetPrimesInList(uint32_t primesInList) { ii_PrimesInList = primesInList; };
    
@@ -77,6 +82,10 @@ public:
    void              StartProcessing(void);
 
    bool              IsGpuWorker(void) { return ib_GpuWorker; };
+
+#ifdef USE_PHASE_PROFILER
+   uint64_t          GetPhaseTicks(uint32_t phase) { return ir_PhaseProfiler.GetTicks(phase); };
+#endif
    
 protected:
    bool              IsQuadraticResidue(uint64_t n, uint64_t p);
@@ -123,9 +132,13 @@ private:
    
    void              TestWithMiniChunks(void);
    
-   uint64_t          ComputeOptimalWorkSize(uint64_t startTime, uint64_t endTime);
+   void              TuneWorkSize(uint64_t chunkUS, bool miniChunks);
+   
+   // The number of primes in the next chunk
+   uint32_t          ii_WorkSize;
    
-   // The maximum number of primes per chunk
+   // The maximum number of primes per chunk, which is the size of the prime list.  It
+   // only grows so that the prime list isn't reallocated when the worksize shrinks.
    uint32_t          ii_MaxWorkSize;
    
    uint32_t          ii_MiniChunkSize;
@@ -134,8 +147,16 @@ private:
    
    // Total number of milliseconds spent in the thread.
    uint64_t          il_WorkerCpuUS;
+   uint64_t          il_ChunksTested;
    uint64_t          il_PrimesTested;
    uint64_t          il_LargestPrimeTested;
+   
+   // The time spent waiting for work is the time since this minus il_WorkerCpuUS
+   uint64_t          il_StartProcessingUS;
+
+#ifdef USE_PHASE_PROFILER
+   PhaseProfiler     ir_PhaseProfiler;
+#endif
 };
 
 #endif
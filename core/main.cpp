@@ -12,8 +12,10 @@
 */
 
 #include <stdarg.h>
+#include <atomic>
 #ifndef WIN32
 #include <sys/resource.h>
+#include <sys/mman.h>
 #endif
 #include <time.h>
 #include <signal.h>
@@ -21,6 +23,7 @@
 
 #if defined (WIN32)
 #include <Windows.h>
+#include <psapi.h>
 #if defined (_MSC_VER) && defined (MEMLEAK)
    _CrtMemState mem_dbg1;
    HANDLE hLogFile;
@@ -36,9 +39,36 @@ void  MemoryLeakExit(void);
 // Local variables
 bool  help_opt = false;
 
-uint64_t cpuBytes = 0;
+std::atomic<uint64_t> cpuBytes(0);
 App     *theApp = 0;
 
+// The header in front of the memory returned by xmalloc has these
+#define XM_HDR_ALLOCATED_PTR     0
+#define XM_HDR_REQUESTED_BYTES   8
+#define XM_HDR_ALLOCATED_BYTES  16
+#define XM_HDR_FLAGS            24
+#define XM_HDR_NEXT_FREE        32
+
+#define XM_FLAG_MAPPED           0x01
+#define XM_FLAG_POOLED           0x02
+
+// Allocations of at least XM_MAP_MIN_BYTES are mapped directly and use huge pages
+#define XM_HUGE_PAGE_BYTES       (2 << 20)
+#define XM_MAP_MIN_BYTES         (2 * XM_HUGE_PAGE_BYTES)
+
+// Pooled memory is allocated in powers of 2 and up to XM_POOL_MAX_PER_CLASS
+// freed buffers of each size are kept.  There is one pool per NUMA node so that
+// a buffer is only reused on the node where its pages were first touched.
+// Memory for a node beyond XM_POOL_NODES is not pooled.
+#define XM_POOL_MIN_SHIFT        12
+#define XM_POOL_CLASSES          40
+#define XM_POOL_MAX_PER_CLASS    8
+#define XM_POOL_NODES            16
+
+static std::atomic_flag  xm_PoolLock = ATOMIC_FLAG_INIT;
+static char             *xm_PoolFree[XM_POOL_NODES][XM_POOL_CLASSES];
+static uint32_t          xm_PoolFreeCount[XM_POOL_NODES][XM_POOL_CLASSES];
+
 volatile bool gb_ForceQuit = false;
 
 void SetQuitting(int sig)
@@ -57,14 +87,22 @@ int   main(int argc, char *argv[])
 {
    MemoryLeakEnter();
 
-   cpuBytes = 0;
-
    theApp = get_app();
 
    theApp->Banner();
    
    ProcessArgs(theApp, argc, argv);
 
+   if (theApp->IsSelfTest())
+   {
+      bool passed = theApp->RunSelfTests(argv[0]);
+      
+      delete theApp;
+      
+      MemoryLeakExit();
+      return (passed ? 0 : 1);
+   }
+
    // Ignore SIGHUP, as to not die on logout.
    // We log to file in most cases anyway.
 #ifdef SIGHUP
@@ -212,75 +250,246 @@ void  AppendLongOpt(struct option *longOpts, const char *name, int has_arg, int
    longOpts->val = charSwitch;
 }
 
-void *xmalloc(uint64_t count, uint32_t size, const char *what)
+// Allocations that are large enough to span huge pages are mapped directly so that
+// the kernel can back them with 2 MB pages.  This reduces TLB misses for the large term
+// bitmaps and hash tables.  Mapped memory is already zeroed, so it is not cleared here,
+// which also means that its pages are not touched until their first use.
+static char *AllocateMemory(size_t bytesToAllocate, size_t &bytesAllocated, uint64_t &flags)
+{
+   char     *allocatedPtr;
+
+   bytesAllocated = bytesToAllocate;
+   flags = 0;
+
+#ifndef WIN32
+   if (bytesToAllocate >= XM_MAP_MIN_BYTES)
+   {
+      size_t    bytesToMap;
+      uintptr_t alignedPtr;
+
+      // Round up to a multiple of the huge page size and map one more so that
+      // the start can be aligned to a huge page.
+      bytesAllocated = (bytesToAllocate + XM_HUGE_PAGE_BYTES - 1) & ~((size_t) XM_HUGE_PAGE_BYTES - 1);
+      bytesToMap = bytesAllocated + XM_HUGE_PAGE_BYTES;
+
+      allocatedPtr = (char *) mmap(NULL, bytesToMap, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+      if (allocatedPtr != (char *) MAP_FAILED)
+      {
+         alignedPtr = ((uintptr_t) allocatedPtr + XM_HUGE_PAGE_BYTES - 1) & ~((uintptr_t) XM_HUGE_PAGE_BYTES - 1);
+
+         // Give back what is before and after the aligned range
+         if (alignedPtr > (uintptr_t) allocatedPtr)
+            munmap(allocatedPtr, alignedPtr - (uintptr_t) allocatedPtr);
+
+         if ((uintptr_t) allocatedPtr + bytesToMap > alignedPtr + bytesAllocated)
+            munmap((char *) alignedPtr + bytesAllocated, (uintptr_t) allocatedPtr + bytesToMap - alignedPtr - bytesAllocated);
+
+#ifdef MADV_HUGEPAGE
+         madvise((char *) alignedPtr, bytesAllocated, MADV_HUGEPAGE);
+#endif
+
+         flags = XM_FLAG_MAPPED;
+         return (char *) alignedPtr;
+      }
+
+      bytesAllocated = bytesToAllocate;
+   }
+#endif
+
+   if ((allocatedPtr = (char *) malloc(bytesToAllocate)) == NULL)
+      return NULL;
+
+   memset(allocatedPtr, 0x00, bytesToAllocate);
+
+   return allocatedPtr;
+}
+
+static void  FreeMemory(char *allocatedPtr, size_t bytesAllocated, uint64_t flags)
+{
+#ifndef WIN32
+   if (flags & XM_FLAG_MAPPED)
+   {
+      munmap(allocatedPtr, bytesAllocated);
+      return;
+   }
+#endif
+
+   free(allocatedPtr);
+}
+
+// Returns a buffer that was freed by xfree or NULL if there isn't one
+static char *GetPooledMemory(uint32_t node, uint32_t poolClass)
+{
+   char *currentPtr;
+
+   while (xm_PoolLock.test_and_set(std::memory_order_acquire))
+      ;
+
+   currentPtr = xm_PoolFree[node][poolClass];
+
+   if (currentPtr != NULL)
+   {
+      xm_PoolFree[node][poolClass] = *(char **) (currentPtr + XM_HDR_NEXT_FREE);
+      xm_PoolFreeCount[node][poolClass]--;
+   }
+
+   xm_PoolLock.clear(std::memory_order_release);
+
+   return currentPtr;
+}
+
+// Returns false if there are already enough buffers of this size in the pool
+static bool  PutPooledMemory(uint32_t node, uint32_t poolClass, char *currentPtr)
 {
-   void     *allocatedPtr;
+   bool  pooled = false;
+
+   while (xm_PoolLock.test_and_set(std::memory_order_acquire))
+      ;
+
+   if (xm_PoolFreeCount[node][poolClass] < XM_POOL_MAX_PER_CLASS)
+   {
+      *(char **) (currentPtr + XM_HDR_NEXT_FREE) = xm_PoolFree[node][poolClass];
+      xm_PoolFree[node][poolClass] = currentPtr;
+      xm_PoolFreeCount[node][poolClass]++;
+      pooled = true;
+   }
+
+   xm_PoolLock.clear(std::memory_order_release);
+
+   return pooled;
+}
+
+static void *AllocateWithHeader(uint64_t count, uint32_t size, const char *what, bool pooled, uint32_t node)
+{
+   char     *allocatedPtr;
    char     *currentPtr;
    size_t    bytesToAllocate = (size * count) + 128;
-   uint64_t  temp;
+   size_t    bytesAllocated;
+   uint64_t  flags;
+   uint32_t  poolClass = XM_POOL_MIN_SHIFT;
+
+   if (node >= XM_POOL_NODES)
+      pooled = false;
+
+   if (pooled)
+   {
+      while (poolClass < XM_POOL_CLASSES - 1 && ((size_t) 1 << poolClass) < bytesToAllocate)
+         poolClass++;
+
+      bytesToAllocate = ((size_t) 1 << poolClass);
+
+      // A reused buffer is not cleared, so it has what its previous owner left in it
+      if ((currentPtr = GetPooledMemory(node, poolClass)) != NULL)
+      {
+         *(uint64_t *) (currentPtr + XM_HDR_REQUESTED_BYTES) = (uint64_t) (size * count);
+
+         currentPtr += 64;
+         *(currentPtr + (size * count)) = 0xff;
+
+         return (void *) currentPtr;
+      }
+   }
 
    // Allocate extra memory because we need to align to a 64-byte boundary
    // as the memory might be referenced by AVX instructions.  We will also
    // put the original pointer for the allocated memory and the orignal size
    // for the allocated memory at the front of this and follow by 0xff to
    // verify that someone isn't running past the end of their allocated memory.
-   if ((allocatedPtr = malloc(bytesToAllocate)) == NULL)
-      FatalError("Unable to allocate %" PRIu64" bytes of memory for %s.  %" PRIu64" bytes already allocated", (uint64_t) (size * count), what, cpuBytes);
+   if ((allocatedPtr = AllocateMemory(bytesToAllocate, bytesAllocated, flags)) == NULL)
+      FatalError("Unable to allocate %" PRIu64" bytes of memory for %s.  %" PRIu64" bytes already allocated", (uint64_t) (size * count), what, cpuBytes.load());
 
    //printf("%x allocating %" PRIu64" bytes for %s\n", (uint64_t) allocatedPtr, (size * count), what);
 
-   cpuBytes += bytesToAllocate;
+   cpuBytes += bytesAllocated;
 
-   memset(allocatedPtr, 0x00, bytesToAllocate);
-   
-   temp = (uint64_t) allocatedPtr;
-      
-   // We want temp divisible by 64 and within the allocated area
-   while (temp % 64 != 0)
-      temp++;
-      
-   // Align to a 32-byte boundary
-   currentPtr = (char *) temp;
+   // We want currentPtr divisible by 64 and within the allocated area
+   currentPtr = (char *) (((uintptr_t) allocatedPtr + 63) & ~((uintptr_t) 63));
 
    // Put the pointer to the allocated memory here
-   *(uint64_t *) currentPtr = (uint64_t) allocatedPtr;
-      
+   *(uint64_t *) (currentPtr + XM_HDR_ALLOCATED_PTR) = (uint64_t) allocatedPtr;
+
    // Put the size of the  to what was actually allocated here
-   *(uint64_t *) (currentPtr + 8) = (uint64_t) (size * count);
+   *(uint64_t *) (currentPtr + XM_HDR_REQUESTED_BYTES) = (uint64_t) (size * count);
+   *(uint64_t *) (currentPtr + XM_HDR_ALLOCATED_BYTES) = (uint64_t) bytesAllocated;
+
+   if (pooled)
+      flags |= XM_FLAG_POOLED | ((uint64_t) poolClass << 8) | ((uint64_t) node << 16);
+
+   *(uint64_t *) (currentPtr + XM_HDR_FLAGS) = flags;
 
    // Get to the next boundary
    currentPtr += 64;
-   
+
    // This will help us detect someone going past what they are supposed to
    *(currentPtr + (size * count)) = 0xff;
 
    return (void *) currentPtr;
 }
 
+void *xmalloc(uint64_t count, uint32_t size, const char *what)
+{
+   return AllocateWithHeader(count, size, what, false, 0);
+}
+
+void *xmalloc_pooled(uint64_t count, uint32_t size, const char *what, uint32_t node)
+{
+   return AllocateWithHeader(count, size, what, true, node);
+}
+
 void xfree(void *memoryPtr)
 {
-   uint64_t  currentPtr;
-   void     *allocatedPtr;
+   char     *currentPtr;
+   char     *allocatedPtr;
    size_t    allocatedSize;
-      
-   currentPtr = ((uint64_t) memoryPtr) - 64;
-     
+   uint64_t  flags;
+
+   currentPtr = ((char *) memoryPtr) - 64;
+
+   allocatedSize = (size_t) *((uint64_t *) (currentPtr + XM_HDR_ALLOCATED_BYTES));
+   flags = *((uint64_t *) (currentPtr + XM_HDR_FLAGS));
+
+   // Pooled memory is still counted in cpuBytes while it is in the pool
+   if ((flags & XM_FLAG_POOLED) && PutPooledMemory((uint32_t) (flags >> 16) & 0xff, (uint32_t) (flags >> 8) & 0xff, currentPtr))
+      return;
+
    // Reduce by what we actually allocated
-   allocatedSize = *((uint64_t *) (currentPtr + 8));
-   
    cpuBytes -= allocatedSize;
-   cpuBytes -= 128;
 
    //printf("%x freeing %" PRIu64" bytes\n", (uint64_t) currentPtr, allocatedSize);
-   
-   allocatedPtr =  (void *) *((uint64_t *) currentPtr);
-   
-   free(allocatedPtr);
+
+   allocatedPtr = (char *) *((uint64_t *) (currentPtr + XM_HDR_ALLOCATED_PTR));
+
+   FreeMemory(allocatedPtr, allocatedSize, flags);
 }
 
 uint64_t GetCpuMemoryUsage(void)
 {
-   return cpuBytes;
+   return cpuBytes.load();
+}
+
+uint64_t GetPeakResidentBytes(void)
+{
+#ifdef WIN32
+   PROCESS_MEMORY_COUNTERS counters;
+
+   if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+      return 0;
+
+   return (uint64_t) counters.PeakWorkingSetSize;
+#else
+   struct rusage usage;
+
+   if (getrusage(RUSAGE_SELF, &usage) != 0)
+      return 0;
+
+#ifdef __APPLE__
+   // OS X reports bytes, Linux reports KB
+   return (uint64_t) usage.ru_maxrss;
+#else
+   return (uint64_t) usage.ru_maxrss * 1024;
+#endif
+#endif
 }
 
 void  MemoryLeakEnter(void)
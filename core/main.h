@@ -61,8 +61,16 @@ void     AppendLongOpt(struct option *longOpts, const char *name, int has_arg, i
 
 void    *xmalloc(uint64_t count, uint32_t size, const char *what);
 void     xfree(void *mem);
+
+// This memory is kept for reuse when freed and is only cleared when first allocated.
+// It is only reused for allocations on the same NUMA node.
+void    *xmalloc_pooled(uint64_t count, uint32_t size, const char *what, uint32_t node);
 uint64_t GetCpuMemoryUsage(void);
 
+// This is the largest resident set size of the process, which includes memory
+// that wasn't allocated with xmalloc
+uint64_t GetPeakResidentBytes(void);
+
 #ifdef __cplusplus
 }
 #endif
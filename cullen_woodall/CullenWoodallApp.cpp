@@ -23,10 +23,19 @@
 #define APP_NAME        "gcwsieve"
 #endif
 
-#define APP_VERSION     "1.5.5"
+#define APP_VERSION     "1.6"
 
 #define BIT(n)        ((n) - ii_MinN)
 
+// These are run by -0 (--selftest).  The factors were found with one worker.
+static const selftest_t selfTests[] = {
+   { "-b 2 -n 1000 -N 5000 -s b -P 1e6",    7627, 0xd273aedab4a3109cULL },
+   { "-b 2 -n 1000 -N 5000 -s b -P 1e6 -m", 7627, 0xd273aedab4a3109cULL },
+   { "-b 2 -n 1000 -N 5000 -s b -P 1e6 -a", 7627, 0xd273aedab4a3109cULL },
+   { "-b 5 -n 1000 -N 5000 -s + -P 1e6",    1873, 0xf1ce6bdc2ab8e687ULL },
+   { NULL, 0, 0 }
+};
+
 // This is declared in App.h, but implemented here.  This means that App.h
 // can remain unchanged if using the GPUSieve framework for other applications.
 App *get_app(void)
@@ -38,11 +47,13 @@ CullenWoodallApp::CullenWoodallApp(void) : AlgebraicFactorApp()
 {
    SetBanner(APP_NAME " v" APP_VERSION ", a program to find factors numbers of the form n*b^n+1 and n*b^n-1");
    SetLogFileName("gcwsieve.log");
+   SetSelfTests(selfTests);
 
    ii_Base = 0;
    ii_MinN = 0;
    ii_MaxN = 0;
    ib_UseAvx = false;
+   ib_UseMontgomery = false;
    ib_Cullen = false;
    ib_Woodall = false;
    it_Format = FF_ABC;
@@ -63,6 +74,12 @@ void CullenWoodallApp::Help(void)
    printf("-n --min_n=n          Minimum n to search\n");
    printf("-N --max_n=N          Maximum N to search\n");
    printf("-a --useavx           Use AVX routines (if available)\n");
+#ifdef USE_X86
+   printf("-m --montgomery       Always use Montgomery logic.  By default it is only used\n");
+   printf("                      when it is faster than the FPU/AVX logic\n");
+#else
+   printf("-m --montgomery       Has no effect since this CPU always uses Montgomery logic\n");
+#endif
    printf("-s --sign=+/-/b       Sign to sieve for (+ = Cullen, - = Woodall)\n");
    printf("-f --format=f         Format of output file (A=ABC (default), L=LLR\n");
 #if defined(USE_OPENCL) || defined(USE_METAL)
@@ -75,12 +92,13 @@ void  CullenWoodallApp::AddCommandLineOptions(std::string &shortOpts, struct opt
 {
    FactorApp::ParentAddCommandLineOptions(shortOpts, longOpts);
 
-   shortOpts += "aDb:n:N:s:f:";
+   shortOpts += "aDmb:n:N:s:f:";
 
    AppendLongOpt(longOpts, "base",           required_argument, 0, 'b');
    AppendLongOpt(longOpts, "min_n",          required_argument, 0, 'n');
    AppendLongOpt(longOpts, "max_n",          required_argument, 0, 'N');
    AppendLongOpt(longOpts, "useavx",         no_argument,       0, 'a');
+   AppendLongOpt(longOpts, "montgomery",     no_argument,       0, 'm');
    AppendLongOpt(longOpts, "sign",           required_argument, 0, 's');
    AppendLongOpt(longOpts, "format",         required_argument, 0, 'f');
    
@@ -120,6 +138,11 @@ parse_t CullenWoodallApp::ParseOption(int opt, char *arg, const char *source)
          status = P_SUCCESS;
          break;
          
+      case 'm':
+         ib_UseMontgomery = true;
+         status = P_SUCCESS;
+         break;
+         
       case 'f':
          status = Parser::Parse(arg, "AL", value);
          
@@ -644,6 +667,8 @@ bool CullenWoodallApp::ReportFactor(uint64_t theFactor, uint32_t n, int32_t c)
    uint64_t bit;
    bool     removedTerm = false;
    
+   PROFILE_SCOPE(PP_FACTORS);
+   
    if (n < ii_MinN || n > ii_MaxN)
       return false;
       
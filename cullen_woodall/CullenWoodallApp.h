@@ -40,6 +40,7 @@ public:
    int32_t           GetMinN(void) { return ii_MinN; };
    int32_t           GetMaxN(void) { return ii_MaxN; };
    bool              UseAvxIfAvailable(void) { return ib_UseAvx; };
+   bool              UseMontgomery(void) { return ib_UseMontgomery; };
    
 #if defined(USE_OPENCL) || defined(USE_METAL)
    uint32_t          GetMaxGpuSteps(void) { return ii_MaxGpuSteps; };
@@ -85,6 +86,7 @@ private:
    uint32_t          ii_MinN;
    uint32_t          ii_MaxN;
    bool              ib_UseAvx;
+   bool              ib_UseMontgomery;
    bool              ib_Woodall;
    bool              ib_Cullen;
    
@@ -10,6 +10,7 @@
 #include <time.h>
 
 #include "CullenWoodallWorker.h"
+#include "../core/Clock.h"
 
 #ifdef USE_X86
 #include "../x86_asm/fpu-asm-x86.h"
@@ -36,6 +37,11 @@ CullenWoodallWorker::CullenWoodallWorker(uint32_t myId, App *theApp) : Worker(my
    ii_Terms = (uint32_t *) xmalloc(ii_MaxTermCount, sizeof(int32_t), "terms");
 
 #ifdef USE_X86
+   ib_AlwaysUseMontgomery = ip_CullenWoodallApp->UseMontgomery();
+   ib_UseMontgomery = ib_AlwaysUseMontgomery;
+   
+   ResetCostSamples();
+   
    if (ip_CullenWoodallApp->UseAvxIfAvailable() && CpuSupportsAvx())
    {
       if (ii_Base < ii_MaxN)
@@ -75,6 +81,10 @@ void  CullenWoodallWorker::TestMegaPrimeChunk(void)
          ip_CullenWoodallApp->GetTerms(ii_Terms, ii_MaxTermCount, ii_MaxTermCount);
          
          il_NextTermsBuild = (ps[3] << 1);
+         
+#ifdef USE_X86
+         ResetCostSamples();
+#endif
       }
       
       if (ps[0] < maxPForSmallPrimeLogic)
@@ -82,7 +92,18 @@ void  CullenWoodallWorker::TestMegaPrimeChunk(void)
       else
       {
 #ifdef USE_X86
-         TestLargePrimesFPU(ps);
+         bool useMontgomery = UseMontgomeryLogic();
+         uint64_t startUS = Clock::GetCurrentMicrosecond();
+         
+         if (useMontgomery)
+         {
+            MpArithVec mp(ps);
+            TestLargePrimes(ps, mp);
+         }
+         else
+            TestLargePrimesFPU(ps);
+         
+         AddCostSample(useMontgomery, startUS, 4);
 #else
          MpArithVec mp(ps);
          TestLargePrimes(ps, mp);
@@ -107,9 +128,25 @@ void  CullenWoodallWorker::TestMiniPrimeChunk(uint64_t *miniPrimeChunk)
       ip_CullenWoodallApp->GetTerms(ii_Terms, ii_MaxTermCount, ii_MaxTermCount);
       
       il_NextTermsBuild = (miniPrimeChunk[AVX_ARRAY_SIZE-1] << 1);
+      
+      ResetCostSamples();
    }
 
-   TestPrimesAVX(miniPrimeChunk);
+   bool useMontgomery = UseMontgomeryLogic();
+   uint64_t startUS = Clock::GetCurrentMicrosecond();
+   
+   if (useMontgomery)
+   {
+      for (uint32_t idx=0; idx<AVX_ARRAY_SIZE; idx+=VECTOR_SIZE)
+      {
+         MpArithVec mp(&miniPrimeChunk[idx]);
+         TestLargePrimes(&miniPrimeChunk[idx], mp);
+      }
+   }
+   else
+      TestPrimesAVX(miniPrimeChunk);
+   
+   AddCostSample(useMontgomery, startUS, AVX_ARRAY_SIZE);
 #else
    FatalError("CullenWoodallWorker::TestMiniPrimeChunk not implemented");
 #endif
@@ -130,6 +167,8 @@ void  CullenWoodallWorker::TestSmallPrimes(uint64_t *ps)
    if (ip_CullenWoodallApp->GetTermCount() == 0)
       return;
    
+   PROFILE_SCOPE(PP_POWMOD);
+   
    maxIndex = 0;
    while (ii_Terms[maxIndex] > 0)
       maxIndex++;
@@ -227,14 +266,20 @@ void  CullenWoodallWorker::TestLargePrimes(uint64_t *ps, MpArithVec mp)
    if (ip_CullenWoodallApp->GetTermCount() == 0)
       return;
    
+   PROFILE_SCOPE(PP_PRIME_SETUP);
+   
    // compute the inverse of b (mod p)
    powInv[0] = InvMod32(ii_Base, ps[0]);
    powInv[1] = InvMod32(ii_Base, ps[1]);
    powInv[2] = InvMod32(ii_Base, ps[2]);
    powInv[3] = InvMod32(ii_Base, ps[3]);
    
+   PROFILE_SWITCH(PP_POWMOD);
+   
    res = mp.pow(mp.nToRes(powInv), ii_Terms[0]);
    
+   PROFILE_SWITCH(PP_OTHER);
+   
    theN = ii_Terms[0];
 
    // res = b^minN % p
@@ -355,14 +400,20 @@ void  CullenWoodallWorker::TestLargePrimesFPU(uint64_t *ps)
    if (ip_CullenWoodallApp->GetTermCount() == 0)
       return;
    
+   PROFILE_SCOPE(PP_PRIME_SETUP);
+   
    // compute the inverse of b (mod p)
    powinvs[0] = InvMod32(ii_Base, ps[0]);
    powinvs[1] = InvMod32(ii_Base, ps[1]);
    powinvs[2] = InvMod32(ii_Base, ps[2]);
    powinvs[3] = InvMod32(ii_Base, ps[3]);
 
+   PROFILE_SWITCH(PP_POWMOD);
+   
    fpu_powmod_4b_1n_4p(powinvs, ii_Terms[0], ps);
    
+   PROFILE_SWITCH(PP_OTHER);
+   
    for (int i=0; i<4; i++)
    {
       thePrime = ps[i];
@@ -488,6 +539,8 @@ void  CullenWoodallWorker::TestPrimesAVX(uint64_t *ps)
    double __attribute__((aligned(32))) reciprocals[AVX_ARRAY_SIZE];
    double __attribute__((aligned(32))) multinvs[AVX_ARRAY_SIZE];
    
+   PROFILE_SCOPE(PP_PRIME_SETUP);
+   
    // compute the inverse of b (mod p)
    for (int i=0; i<AVX_ARRAY_SIZE; i++)
    {      
@@ -498,8 +551,12 @@ void  CullenWoodallWorker::TestPrimesAVX(uint64_t *ps)
    
    avx_compute_reciprocal(dps, reciprocals);
    
+   PROFILE_SWITCH(PP_POWMOD);
+   
    avx_powmod(multinvs, ii_Terms[0], dps, reciprocals);
 
+   PROFILE_SWITCH(PP_OTHER);
+   
    CheckAVXResult(ii_Terms[0], ps, dps);
    
    // Multiply successive terms by a (mod p)
@@ -560,6 +617,52 @@ void  CullenWoodallWorker::TestPrimesAVX(uint64_t *ps)
    };
 }
 
+// Returns true if the Montgomery logic should be used for the next set of primes.
+// After the terms are rebuilt, primes are tested with the FPU/AVX logic until it has
+// been timed for COST_SAMPLE_US, then with the Montgomery logic for as long.  The
+// faster of the two is then used until the terms are rebuilt again.
+bool  CullenWoodallWorker::UseMontgomeryLogic(void)
+{
+   if (ib_AlwaysUseMontgomery)
+      return true;
+   
+   if (il_NativeSampleUS < COST_SAMPLE_US)
+      return false;
+      
+   if (il_MontgomerySampleUS < COST_SAMPLE_US)
+      return true;
+   
+   return ib_UseMontgomery;
+}
+
+void  CullenWoodallWorker::AddCostSample(bool montgomery, uint64_t startUS, uint32_t primeCount)
+{
+   uint64_t elapsedUS = Clock::GetCurrentMicrosecond() - startUS;
+   
+   if (ib_AlwaysUseMontgomery || il_MontgomerySampleUS >= COST_SAMPLE_US)
+      return;
+   
+   if (montgomery)
+   {
+      il_MontgomerySampleUS += elapsedUS;
+      ii_MontgomerySamplePrimes += primeCount;
+   
+      if (il_MontgomerySampleUS >= COST_SAMPLE_US)
+         ib_UseMontgomery = (il_MontgomerySampleUS * ii_NativeSamplePrimes < il_NativeSampleUS * ii_MontgomerySamplePrimes);
+   }
+   else
+   {
+      il_NativeSampleUS += elapsedUS;
+      ii_NativeSamplePrimes += primeCount;
+   }
+}
+
+void  CullenWoodallWorker::ResetCostSamples(void)
+{
+   ii_NativeSamplePrimes = ii_MontgomerySamplePrimes = 0;
+   il_NativeSampleUS = il_MontgomerySampleUS = 0;
+}
+
 void  CullenWoodallWorker::CheckAVXResult(uint32_t theN, uint64_t *ps, double *dps)
 {
    uint32_t idx;
@@ -15,6 +15,10 @@
 
 using namespace std;
 
+// The FPU/AVX logic is timed against the Montgomery logic for this many microseconds
+// each time the terms are rebuilt.
+#define COST_SAMPLE_US        10000
+
 class CullenWoodallWorker : public Worker
 {
 public:
@@ -37,6 +41,10 @@ private:
    void              TestLargePrimesFPU(uint64_t *ps);
    void              TestPrimesAVX(uint64_t *ps);
    void              CheckAVXResult(uint32_t theN, uint64_t *ps, double *dps);
+   
+   bool              UseMontgomeryLogic(void);
+   void              AddCostSample(bool montgomery, uint64_t startUS, uint32_t primeCount);
+   void              ResetCostSamples(void);
 #endif
 
    void              BuildListOfPowers(MpRes a, uint64_t p, MpArith mp, uint32_t count, MpRes *powers);
@@ -50,6 +58,15 @@ private:
    uint32_t          ii_MaxTermCount;
    uint32_t         *ii_Terms;
    uint64_t          il_NextTermsBuild;
+
+#ifdef USE_X86
+   bool              ib_UseMontgomery;
+   bool              ib_AlwaysUseMontgomery;
+   uint32_t          ii_NativeSamplePrimes;
+   uint32_t          ii_MontgomerySamplePrimes;
+   uint64_t          il_NativeSampleUS;
+   uint64_t          il_MontgomerySampleUS;
+#endif
 };
 
 #endif
@@ -17,14 +17,22 @@
 #include "CunninghamChainWorker.h"
 
 #define APP_NAME        "ccsieve"
-#define APP_VERSION     "1.2"
+#define APP_VERSION     "1.3"
 
 #define MAX_LENGTH      30
 #define NMAX_MAX        (1 << 31)
 #define MAX_FILES       9999
 
-#define BIT_HK(k)       (((k) - il_MinK) >> 1)
-#define BIT_AK(k)       ((k) - il_MinK)
+
+// These are run by -0 (--selftest).  The factors were found with one worker.
+static const selftest_t selfTests[] = {
+   { "-c 1 -t 1 -k 1 -K 20000 -l 3 -b 2 -n 1000 -P 1e6",     9999, 0x2d3941eb39e83dd5ULL },
+   { "-c 1 -t 1 -k 1 -K 20000 -l 3 -b 2 -n 1000 -P 1e6 -x",   554, 0xcf035cb0b17eb7d5ULL },
+   { "-c 1 -t 1 -k 1 -K 20000 -l 6 -m 3 -b 2 -n 1000 -P 1e6", 10007, 0x2a0648d5538a52e6ULL },
+   { "-c 2 -t 2 -k 1 -K 20000 -l 3 -n 1009 -P 1e6",         17631, 0xe089ee04c2fc6ee8ULL },
+   { "-c 1 -t 3 -k 1 -K 20000 -l 3 -n 500 -P 1e6",          18162, 0x4cb2c7f4b013de18ULL },
+   { NULL, 0, 0 }
+};
 
 // This is declared in App.h, but implemented here.  This means that App.h
 // can remain unchanged if using the mtsieve framework for other applications.
@@ -37,6 +45,7 @@ CunninghamChainApp::CunninghamChainApp() : FactorApp()
 {
    SetBanner(APP_NAME " v" APP_VERSION ", a program to eliminate terms for Cunningham Chain prime searches");
    SetLogFileName("ccsieve.log");
+   SetSelfTests(selfTests);
    
    it_Format = FF_CC;
    
@@ -48,9 +57,12 @@ CunninghamChainApp::CunninghamChainApp() : FactorApp()
    il_MaxK = 0;
    ii_N = 0;
    ii_ChainLength = 0;
+   ii_MinLength = 0;
    il_Terms = NULL;
    ii_Primes = NULL;
    ib_HalfK = false;
+   ib_UseWheel = false;
+   ip_Wheel = NULL;
    ii_NumberOfFiles = 1;
  
    SetAppMinPrime(3);
@@ -65,6 +77,9 @@ CunninghamChainApp::~CunninghamChainApp()
    
    if (il_Terms != 0)
       xfree(il_Terms);
+   
+   if (ip_Wheel != NULL)
+      delete ip_Wheel;
 }
 
 void CunninghamChainApp::Help(void)
@@ -76,27 +91,33 @@ void CunninghamChainApp::Help(void)
    printf("-k --kmin=k           Minimum k to search\n");
    printf("-K --kmax=K           Maximum k to search\n");
    printf("-l --length=l         Cunningham chain length\n");
+   printf("-m --minlength=m      Keep k where the first m terms have no factor and write the chain length of each k\n");
    printf("-b --base=b           Base to search\n");
    printf("-n --n=n              n of b^n, n# for primorial, n! for factorial\n");
    printf("-f --format=f         Format of output file (C=CC (default), N=NEWPGEN)\n");
    printf("-N --numberOfFiles=N  Number of files to split k across\n");
+   printf("-x --wheel            Use a wheel to exclude k where 3, 5, 7, or 11 divides a term\n");
+   printf("-z --shard=i/m        Sieve only shard i of m (m is a power of 2)\n");
 }
 
 void  CunninghamChainApp::AddCommandLineOptions(std::string &shortOpts, struct option *longOpts)
 {
    FactorApp::ParentAddCommandLineOptions(shortOpts, longOpts);
 
-   shortOpts += "b:k:K:m:n:f:c:t:N:l:";
+   shortOpts += "b:k:K:m:n:f:c:t:N:l:xz:";
 
    AppendLongOpt(longOpts, "chainkind",      required_argument, 0, 'c');
    AppendLongOpt(longOpts, "kmin",           required_argument, 0, 'k');
    AppendLongOpt(longOpts, "kmax",           required_argument, 0, 'K');
    AppendLongOpt(longOpts, "length",         required_argument, 0, 'l');
+   AppendLongOpt(longOpts, "minlength",      required_argument, 0, 'm');
    AppendLongOpt(longOpts, "termtype",       required_argument, 0, 't');
    AppendLongOpt(longOpts, "base",           required_argument, 0, 'b');
    AppendLongOpt(longOpts, "n",              required_argument, 0, 'n');
    AppendLongOpt(longOpts, "format",         required_argument, 0, 'f');
    AppendLongOpt(longOpts, "numberOfFiles",  required_argument, 0, 'N');
+   AppendLongOpt(longOpts, "wheel",          no_argument,       0, 'x');
+   AppendLongOpt(longOpts, "shard",          required_argument, 0, 'z');
 }
 
 parse_t CunninghamChainApp::ParseOption(int opt, char *arg, const char *source)
@@ -145,6 +166,10 @@ parse_t CunninghamChainApp::ParseOption(int opt, char *arg, const char *source)
          status = Parser::Parse(arg, 2, MAX_LENGTH, ii_ChainLength);
          break;
          
+      case 'm':
+         status = Parser::Parse(arg, 2, MAX_LENGTH, ii_MinLength);
+         break;
+         
       case 'b':
          status = Parser::Parse(arg, 2, 1 << 15, ii_Base);
          break;
@@ -167,6 +192,15 @@ parse_t CunninghamChainApp::ParseOption(int opt, char *arg, const char *source)
          if (value == 'N')
             it_Format = FF_NEWPGEN;
          break;
+         
+      case 'x':
+         ib_UseWheel = true;
+         status = P_SUCCESS;
+         break;
+         
+      case 'z':
+         status = ParseShardOption(arg);
+         break;
    }
 
    return status;
@@ -181,6 +215,8 @@ void CunninghamChainApp::ValidateOptions(void)
    {
       ProcessInputTermsFile(false);
 
+      ValidateMinLength();
+      
       // We only care about odd k or even k, but not both
       if (it_TermType == TT_BN && (ii_Base == 2 || ii_Base & 1))
          ib_HalfK = true;
@@ -191,13 +227,13 @@ void CunninghamChainApp::ValidateOptions(void)
       if (it_TermType == TT_FACTORIAL)
          BuildFactorialTerms();
 
-      if (ib_HalfK)
-         iv_Terms.resize(((il_MaxK - il_MinK) >> 1) + 1);
-      else
-         iv_Terms.resize((il_MaxK - il_MinK) + 1);
+      CreateWheel();
       
+      iv_Terms.resize(ip_Wheel->GetBitCount());
       std::fill(iv_Terms.begin(), iv_Terms.end(), false);
 
+      CreateChainLengths();
+      
       ProcessInputTermsFile(true);
    }
    else
@@ -211,6 +247,8 @@ void CunninghamChainApp::ValidateOptions(void)
       if (ii_ChainLength == 0)
          FatalError("Length must be specified");
       
+      ValidateMinLength();
+      
       if (il_MinK == 0)
          FatalError("kmin must be specified");
 
@@ -228,8 +266,6 @@ void CunninghamChainApp::ValidateOptions(void)
       
       if (il_MaxK < ii_N)
          FatalError("n must be less then maxk");
-      
-      il_TermCount = (il_MaxK - il_MinK) + 1;
          
       if (it_TermType == TT_BN)
       {
@@ -240,7 +276,6 @@ void CunninghamChainApp::ValidateOptions(void)
          {
             // We only care about odd k
             ib_HalfK = true;
-            il_TermCount = (il_MaxK - il_MinK)/2 + 1;
          
             // Make minK odd
             if (!(il_MinK & 1))
@@ -255,7 +290,6 @@ void CunninghamChainApp::ValidateOptions(void)
          {
             // We only care about even k
             ib_HalfK = true;
-            il_TermCount = (il_MaxK - il_MinK)/2 + 1;
          
             // Make minK even
             if (il_MinK & 1)
@@ -281,8 +315,14 @@ void CunninghamChainApp::ValidateOptions(void)
          }
       }
       
+      CreateWheel();
+      
+      il_TermCount = ip_Wheel->GetBitCount();
+      
       iv_Terms.resize(il_TermCount);
-      std::fill(iv_Terms.begin(), iv_Terms.end(), true);      
+      std::fill(iv_Terms.begin(), iv_Terms.end(), true);
+      
+      CreateChainLengths();
    }
 
    if (is_OutputTermsFileName.length() == 0)
@@ -301,6 +341,8 @@ void CunninghamChainApp::ValidateOptions(void)
       is_OutputTermsFileName = filePrefix;
    }
 
+   ValidateShardOption();
+   
    FactorApp::ParentValidateOptions();
 
    // Since the worker wants primes in groups of 4
@@ -406,10 +448,10 @@ void CunninghamChainApp::ProcessInputTermsFile(bool haveBitMap, FILE *fPtr, char
 {
    char       buffer[1000], *pos;
    int32_t    c = 2;
-   uint32_t   base = 0, n = 0, chainLength, ck;
+   uint32_t   base = 0, n = 0, chainLength, ck, minLength, length;
    chainkind_t chainKind = CCT_UNKNOWN;
    termtype_t  termType = TT_UNKNOWN;
-   uint64_t   k, lastPrime;
+   uint64_t   bit, k, lastPrime;
    format_t   format = FF_UNKNOWN;
 
    if (fgets(buffer, sizeof(buffer), fPtr) == NULL)
@@ -420,8 +462,14 @@ void CunninghamChainApp::ProcessInputTermsFile(bool haveBitMap, FILE *fPtr, char
    {
       *pos = 0;
       pos++;
-      if (sscanf(pos, "// Sieved to %" SCNu64"", &lastPrime) == 1)
+      minLength = 0;
+      
+      if (sscanf(pos, "// Sieved to %" SCNu64", minimum length %u", &lastPrime, &minLength) >= 1)
          SetMinPrime(lastPrime);
+      
+      // -m on the command line overrides what is in the file
+      if (!haveBitMap && firstFile && ii_MinLength == 0)
+         ii_MinLength = minLength;
    }
    
    if (sscanf(buffer, "CC %u,%u,$a*%u^%u%d", &ck, &chainLength, &base, &n, &c) == 5)
@@ -536,9 +584,12 @@ void CunninghamChainApp::ProcessInputTermsFile(bool haveBitMap, FILE *fPtr, char
    
    while (fgets(buffer, sizeof(buffer), fPtr) != NULL)
    {
+      length = ii_ChainLength;
+      
       if (format == FF_CC)
       {
-         if (sscanf(buffer, "%" SCNu64"" , &k) != 1)
+         // The length of the chain is only there if the file was written with -m
+         if (sscanf(buffer, "%" SCNu64" %u" , &k, &length) < 1)
             FatalError("Line %s is malformed", buffer);
       }
       else
@@ -555,12 +606,19 @@ void CunninghamChainApp::ProcessInputTermsFile(bool haveBitMap, FILE *fPtr, char
             
       if (haveBitMap)
       {
-         if (ib_HalfK)
-            iv_Terms[BIT_HK(k)] = true;
-         else
-            iv_Terms[BIT_AK(k)] = true;
+         // Skip k with a factor in the first ii_MinLength terms
+         if (length < ii_MinLength)
+            continue;
          
-         il_TermCount++;
+         // Skip k that were excluded by the wheel
+         if (ip_Wheel->GetBit(k, bit))
+         {
+            iv_Terms[bit] = true;
+            il_TermCount++;
+            
+            if (iv_ChainLengths.size() > 0)
+               iv_ChainLengths[bit] = (uint8_t) (length < ii_ChainLength ? length : ii_ChainLength);
+         }
       }
       else
       {
@@ -568,8 +626,105 @@ void CunninghamChainApp::ProcessInputTermsFile(bool haveBitMap, FILE *fPtr, char
          if (il_MaxK < k) il_MaxK = k;
       }
    }
+}
+
+// Without -m every term of the chain must be free of known factors.
+void CunninghamChainApp::ValidateMinLength(void)
+{
+   if (ii_MinLength == 0)
+      ii_MinLength = ii_ChainLength;
+   
+   if (ii_MinLength > ii_ChainLength)
+      FatalError("minlength must be less than or equal to length");
+   
+   if (ii_MinLength < ii_ChainLength && it_Format == FF_NEWPGEN)
+      FatalError("minlength is not supported for newpgen format");
+   
+   if (ii_MinLength < ii_ChainLength && ib_UseWheel)
+      FatalError("-x is not supported with minlength");
+}
+
+// This is called after kmin, kmax, and ib_HalfK are known.  Without -x the wheel
+// is empty and the bit for k is just its position in the range of k.
+void CunninghamChainApp::CreateWheel(void)
+{
+   double   minTerm = (double) il_MinK;
+   int32_t  c = (it_ChainKind == CCT_FIRSTKIND ? -1 : +1);
+   uint64_t minK = il_MinK;
+   uint32_t kShift = (ib_HalfK ? 1 : 0);
+   uint32_t idx, prime, multiplier, termInChain;
+   
+   ApplyShardToK(minK, il_MaxK, kShift);
+   
+   ip_Wheel = new KWheel(minK, il_MaxK, kShift);
+   
+   if (!ib_UseWheel)
+      return;
+   
+   if (it_TermType == TT_BN)
+      minTerm *= pow((double) ii_Base, (double) ii_N);
+   
+   if (it_TermType == TT_PRIMORIAL || it_TermType == TT_FACTORIAL)
+      minTerm *= (double) il_Terms[0];
+   
+   // A term could be one of the primes in the wheel
+   if (minTerm <= (double) (KW_MAX_PRIME + 1))
+   {
+      WriteToConsole(COT_OTHER, "Ignoring -x since the smallest term is too small");
+      return;
+   }
+   
+   for (idx=0; KWheel::GetPrime(idx) > 0; idx++)
+   {
+      prime = KWheel::GetPrime(idx);
+      multiplier = GetMultiplierModP(prime);
+      
+      // The i-th term in the chain is 2^(i-1)*k*b^n+c
+      for (termInChain=1; termInChain<=ii_ChainLength; termInChain++)
+      {
+         ip_Wheel->ExcludeTerm(prime, multiplier, c);
+         
+         multiplier = (multiplier * 2) % prime;
+      }
+   }
    
-   fclose(fPtr);
+   ip_Wheel->Build();
+   
+   WriteToConsole(COT_OTHER, "Wheel of size %u removed %" PRIu64" of %" PRIu64" k", ip_Wheel->GetModulus(), 
+                  ip_Wheel->GetPositionCount() - ip_Wheel->GetBitCount(), ip_Wheel->GetPositionCount());
+}
+
+// MAX_LENGTH is small enough for the length of the chain to fit into a byte.
+void CunninghamChainApp::CreateChainLengths(void)
+{
+   if (ii_MinLength < ii_ChainLength)
+      iv_ChainLengths.assign(ip_Wheel->GetBitCount(), (uint8_t) ii_ChainLength);
+   else
+      iv_ChainLengths.clear();
+}
+
+// This is only valid if iv_Terms[bit] is set.
+uint32_t CunninghamChainApp::GetLengthForBit(uint64_t bit)
+{
+   if (iv_ChainLengths.size() == 0)
+      return ii_ChainLength;
+   
+   return iv_ChainLengths[bit];
+}
+
+// Compute b^n, n#, or n! mod a small prime
+uint32_t CunninghamChainApp::GetMultiplierModP(uint32_t prime)
+{
+   uint64_t multiplier = 1;
+   uint32_t idx;
+   
+   if (it_TermType == TT_BN)
+      return KWheel::PowMod(ii_Base, ii_N, prime);
+   
+   for (idx=0; il_Terms[idx] > 0; idx++)
+      multiplier = (multiplier * (il_Terms[idx] % prime)) % prime;
+   
+   return (uint32_t) multiplier;
 }
 
 void CunninghamChainApp::BuildPrimorialTerms(void)
@@ -655,12 +810,20 @@ bool CunninghamChainApp::ApplyFactor(uint64_t theFactor, const char *term)
 void CunninghamChainApp::WriteOutputTermsFile(uint64_t largestPrime)
 {
    uint64_t termsCounted = 0;
-   uint64_t k = il_MinK;
+   uint64_t bit = 0;
    
    ip_FactorAppLock->Lock();
    
    if (il_TermCount == 0)
-      FatalError("No remaining terms");
+   {
+      if (!IsSharded())
+         FatalError("No remaining terms");
+      
+      WriteEmptyTermsFile((is_OutputTermsFileName + (it_Format == FF_CC ? ".cc" : ".npg")).c_str());
+      
+      ip_FactorAppLock->Release();
+      return;
+   }
 
    if (ii_NumberOfFiles > 1 && il_TermCount < 10 * ii_NumberOfFiles)
    {
@@ -683,14 +846,14 @@ void CunninghamChainApp::WriteOutputTermsFile(uint64_t largestPrime)
          FatalError("Unable to open output file %s", is_OutputTermsFileName.c_str());
       
       if (it_Format == FF_CC)
-         termsCounted += WriteCCTermsFile(largestPrime, termsFile, k);
+         termsCounted += WriteCCTermsFile(largestPrime, termsFile, bit);
       
       if (it_Format == FF_NEWPGEN)
-         termsCounted += WriteNewPGenTermsFile(largestPrime, termsFile, k);
+         termsCounted += WriteNewPGenTermsFile(largestPrime, termsFile, bit);
       
       fclose(termsFile);
       
-      if (k == 0)
+      if (bit >= ip_Wheel->GetBitCount())
          break;
    }
    
@@ -700,9 +863,9 @@ void CunninghamChainApp::WriteOutputTermsFile(uint64_t largestPrime)
    ip_FactorAppLock->Release();
 }
 
-uint64_t CunninghamChainApp::WriteCCTermsFile(uint64_t largestPrime, FILE *termsFile, uint64_t &nextK)
+uint64_t CunninghamChainApp::WriteCCTermsFile(uint64_t largestPrime, FILE *termsFile, uint64_t &nextBit)
 {
-   uint64_t k, kCount = 0;
+   uint64_t bit, bitCount = ip_Wheel->GetBitCount(), kCount = 0;
    uint64_t kToWrite = 1 + (il_TermCount / ii_NumberOfFiles);
    char     term[50];
 
@@ -715,52 +878,37 @@ uint64_t CunninghamChainApp::WriteCCTermsFile(uint64_t largestPrime, FILE *terms
    if (it_TermType == TT_FACTORIAL)
       snprintf(term, sizeof(term), "$a*%u!%+d", ii_N, (it_ChainKind == CCT_FIRSTKIND ? -1 : +1));
       
-   fprintf(termsFile, "CC %u,%u,%s // Sieved to %" SCNu64"\n", it_ChainKind, ii_ChainLength, term, largestPrime);
+   if (ii_MinLength < ii_ChainLength)
+      fprintf(termsFile, "CC %u,%u,%s // Sieved to %" SCNu64", minimum length %u\n", it_ChainKind, ii_ChainLength, term, largestPrime, ii_MinLength);
+   else
+      fprintf(termsFile, "CC %u,%u,%s // Sieved to %" SCNu64"\n", it_ChainKind, ii_ChainLength, term, largestPrime);
 
-   if (ib_HalfK)
+   for (bit=nextBit; bit<bitCount; bit++)
    {
-      for (k=nextK; k<=il_MaxK; k+=2)
+      if (iv_Terms[bit])
       {
-         if (iv_Terms[BIT_HK(k)])
+         if (kCount == kToWrite)
          {
-            if (kCount == kToWrite)
-            {
-               nextK = k;
-               return kCount;
-            }
-         
-            fprintf(termsFile, "%" PRIu64"\n", k);
-            
-            kCount++;
+            nextBit = bit;
+            return kCount;
          }
-      }
-   }
-   else
-   {
-      for (k=nextK; k<=il_MaxK; k++)
-      {
-         if (iv_Terms[BIT_AK(k)])
-         {
-            if (kCount == kToWrite)
-            {
-               nextK = k;
-               return kCount;
-            }
+      
+         if (ii_MinLength < ii_ChainLength)
+            fprintf(termsFile, "%" PRIu64" %u\n", ip_Wheel->GetK(bit), GetLengthForBit(bit));
+         else
+            fprintf(termsFile, "%" PRIu64"\n", ip_Wheel->GetK(bit));
          
-            fprintf(termsFile, "%" PRIu64"\n", k);
-            
-            kCount++;
-         }
+         kCount++;
       }
    }
 
-   nextK = 0;
+   nextBit = bitCount;
    return kCount;
 }
 
-uint64_t CunninghamChainApp::WriteNewPGenTermsFile(uint64_t largestPrime, FILE *termsFile, uint64_t &nextK)
+uint64_t CunninghamChainApp::WriteNewPGenTermsFile(uint64_t largestPrime, FILE *termsFile, uint64_t &nextBit)
 {
-   uint64_t k, kCount = 0;
+   uint64_t bit, bitCount = ip_Wheel->GetBitCount(), kCount = 0;
    uint64_t kToWrite = 1 + (il_TermCount / ii_NumberOfFiles);
 
    if (ii_Base > 0)
@@ -790,59 +938,44 @@ uint64_t CunninghamChainApp::WriteNewPGenTermsFile(uint64_t largestPrime, FILE *
          fprintf(termsFile, "%" PRIu64":2:%u:2:85", largestPrime, ii_ChainLength);
    }   
 
-   if (ib_HalfK)
+   for (bit=nextBit; bit<bitCount; bit++)
    {
-      for (k=il_MinK; k<=il_MaxK; k+=2)
+      if (iv_Terms[bit])
       {
-         if (iv_Terms[BIT_HK(k)])
+         if (kCount == kToWrite)
          {
-            if (kCount == kToWrite)
-            {
-               nextK = k;
-               return kCount;
-            }
-         
-            fprintf(termsFile, "%" PRIu64" %u\n", k, ii_N);
-            
-            kCount++;
+            nextBit = bit;
+            return kCount;
          }
-      }
-   }
-   else
-   {
-      for (k=il_MinK; k<=il_MaxK; k++)
-      {
-         if (iv_Terms[BIT_AK(k)])
-         {
-            if (kCount == kToWrite)
-            {
-               nextK = k;
-               return kCount;
-            }
+      
+         fprintf(termsFile, "%" PRIu64" %u\n", ip_Wheel->GetK(bit), ii_N);
          
-            fprintf(termsFile, "%" PRIu64" %u\n", k, ii_N);
-            
-            kCount++;
-         }
+         kCount++;
       }
    }
    
-   nextK = 0;
+   nextBit = bitCount;
    return kCount;
 }
 
 void  CunninghamChainApp::GetExtraTextForSieveStartedMessage(char *extraText, uint32_t maxTextLength)
 {
    int c = (it_ChainKind == 1 ? -1 : +1);
+   char minLength[50];
+   
+   minLength[0] = 0;
+   
+   if (ii_MinLength < ii_ChainLength)
+      snprintf(minLength, sizeof(minLength), " (minimum length %u)", ii_MinLength);
    
    if (it_TermType == TT_BN)
-      snprintf(extraText, maxTextLength, "%" PRIu64 " < k < %" PRIu64", first term of k*%u^%u%+d for CC length %u", il_MinK, il_MaxK, ii_Base, ii_N, c, ii_ChainLength);
+      snprintf(extraText, maxTextLength, "%" PRIu64 " < k < %" PRIu64", first term of k*%u^%u%+d for CC length %u%s", il_MinK, il_MaxK, ii_Base, ii_N, c, ii_ChainLength, minLength);
    
    if (it_TermType == TT_PRIMORIAL)
-      snprintf(extraText, maxTextLength, "%" PRIu64 " < k < %" PRIu64", first term of k*%u#%+d for CC length %u", il_MinK, il_MaxK, ii_N, c, ii_ChainLength);
+      snprintf(extraText, maxTextLength, "%" PRIu64 " < k < %" PRIu64", first term of k*%u#%+d for CC length %u%s", il_MinK, il_MaxK, ii_N, c, ii_ChainLength, minLength);
    
    if (it_TermType == TT_FACTORIAL)
-      snprintf(extraText, maxTextLength, "%" PRIu64 " < k < %" PRIu64", first term of k*%u!%+d for CC length %u", il_MinK, il_MaxK, ii_N, c, ii_ChainLength);
+      snprintf(extraText, maxTextLength, "%" PRIu64 " < k < %" PRIu64", first term of k*%u!%+d for CC length %u%s", il_MinK, il_MaxK, ii_N, c, ii_ChainLength, minLength);
 }
 
 void  CunninghamChainApp::ReportFactor(uint64_t theFactor, uint64_t k, uint32_t termInChain)
@@ -855,61 +988,123 @@ void  CunninghamChainApp::ReportFactor(uint64_t theFactor, uint64_t k, uint32_t
    
    do
    {
-      uint64_t bit = (ib_HalfK ? BIT_HK(k) : BIT_AK(k));
+      uint64_t bit;
 
-      if (iv_Terms[bit])
+      // A factor of a term after the first ii_MinLength terms only shortens the chain for k
+      if (ip_Wheel->GetBit(k, bit) && iv_Terms[bit] && (termInChain <= ii_MinLength || iv_ChainLengths[bit] >= termInChain))
       {
-         iv_Terms[bit] = false;
-         
-         if (if_FactorFile != 0)
+         if (termInChain <= ii_MinLength)
          {
-            char     term[50];
-
-            if (termInChain == 1)
-            {
-               if (it_TermType == TT_BN)
-                  snprintf(term, sizeof(term), "%" PRIu64"*%u^%u%+d", k, ii_Base, ii_N, (it_ChainKind == CCT_FIRSTKIND ? -1 : +1));
-                  
-               if (it_TermType == TT_PRIMORIAL)
-                  snprintf(term, sizeof(term), "%" PRIu64"*%u#%+d", k, ii_N, (it_ChainKind == CCT_FIRSTKIND ? -1 : +1));
-            
-               if (it_TermType == TT_PRIMORIAL)
-                  snprintf(term, sizeof(term), "%" PRIu64"*%u#%+d", k, ii_N, (it_ChainKind == CCT_FIRSTKIND ? -1 : +1));
-            }
-            else
-            {
-               uint32_t mult = 1 << (termInChain - 1);
-               int32_t add = (it_ChainKind == CCT_FIRSTKIND ? (mult - 1) : -(mult - 1));
-               
-               if (it_TermType == TT_BN)
-                  snprintf(term, sizeof(term), "%u*(%" PRIu64"*%u^%u%+d)%+d", mult, k, ii_Base, ii_N, (it_ChainKind == CCT_FIRSTKIND ? -1 : +1), add);
-                  
-               if (it_TermType == TT_PRIMORIAL)
-                  snprintf(term, sizeof(term), "%u*(%" PRIu64"*%u#%+d)%+d", mult, k, ii_N, (it_ChainKind == CCT_FIRSTKIND ? -1 : +1), add);
-            
-               if (it_TermType == TT_PRIMORIAL)
-                  snprintf(term, sizeof(term), "%u*(%" PRIu64"*%u#%+d)%+d", mult, k, ii_N, (it_ChainKind == CCT_FIRSTKIND ? -1 : +1), add);
-            }
-            
-            LogFactor(theFactor, "%s", term);
+            iv_Terms[bit] = false;
+            il_TermCount--;
          }
+         else
+            iv_ChainLengths[bit] = (uint8_t) (termInChain - 1);
+         
+         LogTermFactor(theFactor, k, termInChain);
          
          il_FactorCount++;
-         il_TermCount--;
       }
       
-      if (ib_HalfK)
-      {
-         // We only care about every other k
-         k += (theFactor << 1);
-      }
-      else
-         k += theFactor; 
+      // This is the next k in the bitmap that p divides
+      k += (theFactor << ip_Wheel->GetKShift());
    } while (k <= il_MaxK);
    
    ip_FactorAppLock->Release();
 }
 
+// This is used for p <= il_MaxK.  The bitmap is sieved one segment at a time so that
+// other workers can report factors between segments.
+void  CunninghamChainApp::ReportFactors(KSegmentSieve *kSieve)
+{
+   std::vector<bool> *bitmaps[2];
+   std::vector<ksieve_entry_t>::const_iterator it;
+   const ksieve_entry_t *entry;
+   uint32_t idx, segment;
+   
+   // Factors of terms after the first ii_MinLength terms are applied to the length
+   // of the chain for k instead of to a bitmap.
+   bitmaps[0] = &iv_Terms;
+   bitmaps[1] = NULL;
+   
+   // If the first term is valid, then the rest are valid.
+   for (idx=0; idx<kSieve->GetPrimeCount(); idx++)
+   {
+      entry = kSieve->GetPrime(idx);
+      
+      VerifyFactor(entry->prime, kSieve->GetPrimeK(idx), entry->tag);
+   }
+   
+   for (segment=0; segment<kSieve->GetSegmentCount(); segment++)
+   {
+      if (!kSieve->HasSegmentPrimes(segment))
+         continue;
+      
+      ip_FactorAppLock->Lock();
+      
+      kSieve->SieveSegment(segment, bitmaps, iv_ChainLengths.data());
+      
+      const std::vector<ksieve_entry_t> &hits = kSieve->GetHits();
+      
+      StartFactorBatch();
+      
+      for (it=hits.begin(); it!=hits.end(); it++)
+      {
+         // Ignore factors that shorten the chain for k that have been removed
+         if (it->bitmapIdx > 0 && !iv_Terms[it->bit])
+            continue;
+         
+         LogTermFactor(it->prime, kSieve->GetK(it->bit), it->tag);
+         
+         il_FactorCount++;
+         
+         if (it->bitmapIdx == 0)
+            il_TermCount--;
+      }
+      
+      EndFactorBatch();
+      
+      ip_FactorAppLock->Release();
+   }
+}
+
+// The caller must hold ip_FactorAppLock.
+void  CunninghamChainApp::LogTermFactor(uint64_t theFactor, uint64_t k, uint32_t termInChain)
+{
+   char     term[50];
+
+   if (if_FactorFile == 0)
+      return;
+   
+   if (termInChain == 1)
+   {
+      if (it_TermType == TT_BN)
+         snprintf(term, sizeof(term), "%" PRIu64"*%u^%u%+d", k, ii_Base, ii_N, (it_ChainKind == CCT_FIRSTKIND ? -1 : +1));
+         
+      if (it_TermType == TT_PRIMORIAL)
+         snprintf(term, sizeof(term), "%" PRIu64"*%u#%+d", k, ii_N, (it_ChainKind == CCT_FIRSTKIND ? -1 : +1));
+   
+      if (it_TermType == TT_FACTORIAL)
+         snprintf(term, sizeof(term), "%" PRIu64"*%u!%+d", k, ii_N, (it_ChainKind == CCT_FIRSTKIND ? -1 : +1));
+   }
+   else
+   {
+      uint32_t mult = 1 << (termInChain - 1);
+      int32_t add = (it_ChainKind == CCT_FIRSTKIND ? (mult - 1) : -(mult - 1));
+      
+      if (it_TermType == TT_BN)
+         snprintf(term, sizeof(term), "%u*(%" PRIu64"*%u^%u%+d)%+d", mult, k, ii_Base, ii_N, (it_ChainKind == CCT_FIRSTKIND ? -1 : +1), add);
+         
+      if (it_TermType == TT_PRIMORIAL)
+         snprintf(term, sizeof(term), "%u*(%" PRIu64"*%u#%+d)%+d", mult, k, ii_N, (it_ChainKind == CCT_FIRSTKIND ? -1 : +1), add);
+   
+      if (it_TermType == TT_FACTORIAL)
+         snprintf(term, sizeof(term), "%u*(%" PRIu64"*%u!%+d)%+d", mult, k, ii_N, (it_ChainKind == CCT_FIRSTKIND ? -1 : +1), add);
+   }
+   
+   LogFactor(theFactor, "%s", term);
+}
+
 void  CunninghamChainApp::VerifyFactor(uint64_t theFactor, uint64_t k, uint32_t termInChain)
 {
    MpArith  mp(theFactor);
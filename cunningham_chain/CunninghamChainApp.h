@@ -12,6 +12,7 @@
 #define _CunninghamChainApp_H
 
 #include "../core/FactorApp.h"
+#include "../core/KSegmentSieve.h"
 
 #define KMAX_MAX (UINT64_C(1)<<62)
 #define NMAX_MAX (1 << 31)
@@ -37,6 +38,7 @@ public:
    chainkind_t       GetChainKind(void) { return it_ChainKind; };
    termtype_t        GetTermType(void) { return it_TermType; };
    uint32_t          GetChainLength(void) { return ii_ChainLength; };
+   uint32_t          GetMinLength(void) { return ii_MinLength; };
    
    bool              IsHalfK(void) { return ib_HalfK; };
    uint64_t          GetMinK(void) { return il_MinK; };
@@ -44,8 +46,10 @@ public:
    uint32_t          GetBase(void) { return ii_Base; };
    uint32_t          GetN(void) { return ii_N; };
    uint64_t         *GetTerms(void) { return il_Terms; };
+   KWheel           *GetWheel(void) { return ip_Wheel; };
    
    void              ReportFactor(uint64_t theFactor, uint64_t k, uint32_t termInChain);
+   void              ReportFactors(KSegmentSieve *kSieve);
 
 protected:
    void              PreSieveHook(void) {};
@@ -64,20 +68,34 @@ protected:
 
 private:
    void              ProcessInputTermsFile(bool haveBitMap, FILE *fPtr, char *fileName, bool firstFile);
-   uint64_t          WriteCCTermsFile(uint64_t largestPrime, FILE *termsFile, uint64_t &nextK);
-   uint64_t          WriteNewPGenTermsFile(uint64_t largestPrime, FILE *termsFile, uint64_t &nextK);
+   uint64_t          WriteCCTermsFile(uint64_t largestPrime, FILE *termsFile, uint64_t &nextBit);
+   uint64_t          WriteNewPGenTermsFile(uint64_t largestPrime, FILE *termsFile, uint64_t &nextBit);
    
+   void              ValidateMinLength(void);
+   void              CreateWheel(void);
+   void              CreateChainLengths(void);
+   uint32_t          GetLengthForBit(uint64_t bit);
+   uint32_t          GetMultiplierModP(uint32_t prime);
    void              VerifyFactor(uint64_t theFactor, uint64_t k, uint32_t termInChain);
+   void              LogTermFactor(uint64_t theFactor, uint64_t k, uint32_t termInChain);
    
    std::vector<bool> iv_Terms;
    
+   // With -m, iv_Terms has the k where the first ii_MinLength terms of the chain do
+   // not have a known factor.  iv_ChainLengths has one byte per bit of iv_Terms with
+   // the length of the chain for k, which is one less than the position of the first
+   // term in the chain that has a factor.  It is empty without -m.
+   std::vector<uint8_t> iv_ChainLengths;
+   
    format_t          it_Format;
 
    chainkind_t       it_ChainKind;
    termtype_t        it_TermType;
    uint32_t          ii_ChainLength;
+   uint32_t          ii_MinLength;
    
    bool              ib_HalfK;
+   bool              ib_UseWheel;
    uint64_t          il_MinK;
    uint64_t          il_MaxK;
    uint32_t          ii_Base;
@@ -86,6 +104,8 @@ private:
    
    uint32_t         *ii_Primes;
    uint64_t         *il_Terms;
+   
+   KWheel           *ip_Wheel;
 };
 
 #endif
@@ -21,6 +21,7 @@ CunninghamChainWorker::CunninghamChainWorker(uint32_t myId, App *theApp) : Worke
    it_ChainKind = ip_CunninghamChainApp->GetChainKind();
    it_TermType = ip_CunninghamChainApp->GetTermType();
    ii_ChainLength = ip_CunninghamChainApp->GetChainLength();
+   ii_MinLength = ip_CunninghamChainApp->GetMinLength();
    
    ib_HalfK = ip_CunninghamChainApp->IsHalfK();
    il_MinK = ip_CunninghamChainApp->GetMinK();
@@ -29,15 +30,23 @@ CunninghamChainWorker::CunninghamChainWorker(uint32_t myId, App *theApp) : Worke
    ii_N = ip_CunninghamChainApp->GetN();
    
    il_Terms = ip_CunninghamChainApp->GetTerms();
+   
+   ip_KSieve = new KSegmentSieve(ip_CunninghamChainApp->GetWheel());
 
    ii_BaseInverses = NULL;
    il_MyPrimeList = NULL;
    ii_InverseList = NULL;
+   ip_PowerChain = NULL;
    
    // This limit comes from newpgen, but is not documented why it exists.
    // I do know that larger bases yield incorrect factors if we use the wrong logic.
    if (it_TermType == TT_BN && ii_Base > 2 && ii_Base < 255256)
+   {
       BuildBaseInverses();
+      
+      // n is the same for every prime so the chain for (1/b)^n is only built once
+      ip_PowerChain = new MpPowerChain(ii_N);
+   }
 
    // The thread can't start until initialization is done
    ib_Initialized = true;
@@ -45,6 +54,8 @@ CunninghamChainWorker::CunninghamChainWorker(uint32_t myId, App *theApp) : Worke
 
 void  CunninghamChainWorker::CleanUp(void)
 {
+   delete ip_KSieve;
+   
    if (il_MyPrimeList != NULL)
    {
       xfree(il_MyPrimeList);
@@ -53,6 +64,9 @@ void  CunninghamChainWorker::CleanUp(void)
    
    if (ii_BaseInverses != NULL)
       xfree(ii_BaseInverses);
+   
+   if (ip_PowerChain != NULL)
+      delete ip_PowerChain;
 }
 
 void  CunninghamChainWorker::NotifyPrimeListAllocated(uint32_t primesInList)
@@ -88,6 +102,10 @@ void  CunninghamChainWorker::TestMegaPrimeChunk(void)
       ps[1] = il_PrimeList[pIdx+1];
       ps[2] = il_PrimeList[pIdx+2];
       ps[3] = il_PrimeList[pIdx+3];
+
+      // Apply the factors for the small primes before any larger prime can remove a term
+      if (ps[0] > il_MaxK)
+         ApplySmallPrimes();
       
       if (it_TermType == TT_BN)
       {
@@ -140,6 +158,10 @@ void  CunninghamChainWorker::TestMegaPrimeChunk(void)
          ks[3] = ps[3] - ks[3];
       }
       
+      // All four primes are applied to the bitmap in the same way so that terms
+      // are removed by the same prime regardless of how the bitmap is sieved.
+      ib_SmallPrimes = (ps[0] <= il_MaxK);
+      
       // In the first iteration of this loop we have computed k such that k*m# (mod p) = +1 or -1.
       // For subsequent iterations we are computing k such that 2^n*k*m# (mod p) = +1 or -1.
       // In short p divides the first term of the Cunningham Chain for k1 and
@@ -168,8 +190,15 @@ void  CunninghamChainWorker::TestMegaPrimeChunk(void)
          ks[3] >>= 1;
       }
 
-      SetLargestPrimeTested(ps[3], 4);
+      if (ib_SmallPrimes)
+         ip_KSieve->AddPendingPrimes(ps[3], 4);
+      else
+      {
+         SetLargestPrimeTested(ps[3], 4);
+      }
    }
+   
+   ApplySmallPrimes();
 }
 
 void  CunninghamChainWorker::TestMiniPrimeChunk(uint64_t *miniPrimeChunk)
@@ -226,6 +255,10 @@ void  CunninghamChainWorker::TestSmallB(void)
       ps[1] = il_MyPrimeList[idx+1];
       ps[2] = il_MyPrimeList[idx+2];
       ps[3] = il_MyPrimeList[idx+3];
+
+      // Apply the factors for the small primes before any larger prime can remove a term
+      if (ps[0] > il_MaxK)
+         ApplySmallPrimes();
       
       ks[0] = (1+ii_InverseList[idx+0]*ps[0])/ii_Base;
       ks[1] = (1+ii_InverseList[idx+1]*ps[1])/ii_Base;
@@ -235,7 +268,13 @@ void  CunninghamChainWorker::TestSmallB(void)
       // Starting with k*2^n = 1 (mod p) 
       //           --> k = (1/2)^n (mod p)
       //           --> k = inverse^n (mod p)
-      fpu_powmod_4b_1n_4p(ks, ii_N, &il_MyPrimeList[idx+0]);
+      MpArithVec mp(&il_MyPrimeList[idx+0]);
+      MpResVec   resK = mp.resToN(ip_PowerChain->pow(mp, mp.nToRes(ks)));
+      
+      ks[0] = resK[0];
+      ks[1] = resK[1];
+      ks[2] = resK[2];
+      ks[3] = resK[3];
 
       if (it_ChainKind == CCT_SECONDKIND)
       {
@@ -245,6 +284,10 @@ void  CunninghamChainWorker::TestSmallB(void)
          ks[3] = ps[3] - ks[3];
       }
       
+      // All four primes are applied to the bitmap in the same way so that terms
+      // are removed by the same prime regardless of how the bitmap is sieved.
+      ib_SmallPrimes = (ps[0] <= il_MaxK);
+      
       // In the first iteration of this loop we have computed k such that k*m# (mod p) = +1 or -1.
       // For subsequent iterations we are computing k such that 2^n*k*m# (mod p) = +1 or -1.
       // In short p divides the first term of the Cunningham Chain for k1 and
@@ -273,8 +316,15 @@ void  CunninghamChainWorker::TestSmallB(void)
          ks[3] >>= 1;
       }
 
-      SetLargestPrimeTested(ps[3], 4);
+      if (ib_SmallPrimes)
+         ip_KSieve->AddPendingPrimes(ps[3], 4);
+      else
+      {
+         SetLargestPrimeTested(ps[3], 4);
+      }
    }
+   
+   ApplySmallPrimes();
 
    // Adjust for the possibility that we tested the same prime
    // more than once at the end of the list.
@@ -332,10 +382,31 @@ void  CunninghamChainWorker::RemoveTerms(uint64_t thePrime, uint64_t k, uint32_t
       }
    }
 
-   if (k <= il_MaxK)
+   // When sharded, this also moves k into this shard's residue class
+   if (!ip_CunninghamChainApp->GetWheel()->AlignK(thePrime, k))
+      return;
+   
+   // Primes <= il_MaxK are applied one segment of the bitmap at a time
+   if (ib_SmallPrimes)
+      ip_KSieve->AddPrime(thePrime, k, (termInChain <= ii_MinLength ? 0 : 1), termInChain);
+   else
       ip_CunninghamChainApp->ReportFactor(thePrime, k, termInChain);
 }
 
+// The factors for the small primes are not applied until the end of the chunk,
+// so don't report them as tested until then.
+void  CunninghamChainWorker::ApplySmallPrimes(void)
+{
+   if (ip_KSieve->GetPendingPrimeCount() == 0)
+      return;
+   
+   ip_CunninghamChainApp->ReportFactors(ip_KSieve);
+   
+   SetLargestPrimeTested(ip_KSieve->GetLargestPendingPrime(), ip_KSieve->GetPendingPrimeCount());
+   
+   ip_KSieve->Clear();
+}
+
 void    CunninghamChainWorker::BuildBaseInverses(void)
 {
 	ii_BaseInverses = (uint32_t *) xmalloc(ii_Base, sizeof(uint32_t), "baseInverses");
@@ -11,6 +11,7 @@
 
 #include "CunninghamChainApp.h"
 #include "../core/Worker.h"
+#include "../core/MpPowerChain.h"
 
 using namespace std;
 
@@ -32,21 +33,26 @@ private:
    void              TestSmallB(void);
    
    void              RemoveTerms(uint64_t thePrime, uint64_t k, uint32_t termInChain);
+   void              ApplySmallPrimes(void);
 
    void              BuildBaseInverses(void);
    uint32_t          EuclidExtendedGCD(uint32_t a, uint32_t base);
    
    CunninghamChainApp *ip_CunninghamChainApp;
+   KSegmentSieve    *ip_KSieve;
 
    uint32_t         *ii_BaseInverses;
    uint64_t         *il_MyPrimeList;
    uint32_t         *ii_InverseList;
+   MpPowerChain     *ip_PowerChain;
    
    chainkind_t       it_ChainKind;
    termtype_t        it_TermType;
    uint32_t          ii_ChainLength;
+   uint32_t          ii_MinLength;
    
    bool              ib_HalfK;
+   bool              ib_SmallPrimes;
    uint64_t          il_MinK;
    uint64_t          il_MaxK;
    uint32_t          ii_Base;
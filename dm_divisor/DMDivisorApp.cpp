@@ -15,8 +15,10 @@
 #include "../core/Parser.h"
 #include "../core/Clock.h"
 #include "../core/MpArith.h"
+#include "../core/MpArithVector.h"
 #include "DMDivisorApp.h"
 #include "DMDivisorWorker.h"
+#include "DMDivisorTester.h"
 
 #if defined(USE_OPENCL) || defined(USE_METAL)
 #include "DMDivisorGpuWorker.h"
@@ -25,21 +27,7 @@
 #define APP_NAME        "dmdsieve"
 #endif
 
-#define APP_VERSION     "1.8.8"
-
-// Arrays cannot have more than 2^32 elements on some systems.
-// We will limit the vector to have at most 2^30 on all systems.
-#define BITS_PER_ARRAY     30
-#define TERMS_PER_VECTOR   (1 << BITS_PER_ARRAY)
-
-// But we can have a vector of vectors, so that is what we are going
-// to do to get beyond the 2^32 limit for an individual array.
-
-// Only k % 4 = 0 and k % 4 = 1 can be factors
-// Even k are tracked in iv_MMPTermsKm40.
-// Odd k are tracked in iv_MMPTermsKm41.
-#define IDX_K(k)           ((((((k) & 1) ? (k)-1 : (k)) - il_TermsMinK) / 4) >> BITS_PER_ARRAY)
-#define BIT_K(k)           ((((((k) & 1) ? (k)-1 : (k)) - il_TermsMinK) / 4) & (TERMS_PER_VECTOR - 1))
+#define APP_VERSION     "1.8.9"
 
 #define MERSENNE_PRIMES    52
 
@@ -110,6 +98,12 @@ dmd_t  dmdList[MERSENNE_PRIMES] = {
    {136279841,       0,     0,    0}
 };
 
+// These are run by -0 (--selftest).  The factors were found with one worker.
+static const selftest_t selfTests[] = {
+   { "-k 1 -K 5000 -n 61 -P 1e5", 1438, 0x90de3259c4f3b96aULL },
+   { NULL, 0, 0 }
+};
+
 // This is declared in App.h, but implemented here.  This means that App.h
 // can remain unchanged if using the mtsieve framework for other applications.
 App *get_app(void)
@@ -121,6 +115,7 @@ DMDivisorApp::DMDivisorApp() : FactorApp()
 {
    SetBanner(APP_NAME " v" APP_VERSION ", a program to find terms that are potential factors of 2^(2^n-1)-1");
    SetLogFileName("dmdsieve.log");
+   SetSelfTests(selfTests);
    
    it_Format = FF_ABCD;
    SetAppMinPrime(3);
@@ -132,11 +127,23 @@ DMDivisorApp::DMDivisorApp() : FactorApp()
 
    ib_TestTerms = false;
    
+   ip_Wheel[0] = NULL;
+   ip_Wheel[1] = NULL;
+   
 #if defined(USE_OPENCL) || defined(USE_METAL)
    ii_MaxGpuFactors = GetGpuWorkGroups() * 1000;
 #endif
 }
 
+DMDivisorApp::~DMDivisorApp()
+{
+   if (ip_Wheel[0] != NULL)
+      delete ip_Wheel[0];
+   
+   if (ip_Wheel[1] != NULL)
+      delete ip_Wheel[1];
+}
+
 void DMDivisorApp::Help(void)
 {
    FactorApp::ParentHelp();
@@ -147,6 +154,7 @@ void DMDivisorApp::Help(void)
    printf("-f --format=f         Format of output file (A=ABC, D=ABCD (default))\n");
    printf("-x --testterms        Test remaining terms for DM divisibility\n");
    printf("-y --writewhendone    Write output file only when sieving is completed\n");
+   printf("-z --shard=i/m        Sieve only shard i of m (m is a power of 2)\n");
    
 #if defined(USE_OPENCL) || defined(USE_METAL)
    printf("-M --maxfactors=M        max number of factors to support per GPU worker chunk (default %u)\n", ii_MaxGpuFactors);
@@ -157,7 +165,7 @@ void  DMDivisorApp::AddCommandLineOptions(std::string &shortOpts, struct option
 {
    FactorApp::ParentAddCommandLineOptions(shortOpts, longOpts);
 
-   shortOpts += "k:K:b:n:f:xy";
+   shortOpts += "k:K:b:n:f:xyz:";
 
    AppendLongOpt(longOpts, "kmin",              required_argument, 0, 'k');
    AppendLongOpt(longOpts, "kmax",              required_argument, 0, 'K');
@@ -165,6 +173,7 @@ void  DMDivisorApp::AddCommandLineOptions(std::string &shortOpts, struct option
    AppendLongOpt(longOpts, "format",            required_argument, 0, 'f');
    AppendLongOpt(longOpts, "testterms",         no_argument,       0, 'x');
    AppendLongOpt(longOpts, "writewhendone",     no_argument,       0, 'y');
+   AppendLongOpt(longOpts, "shard",             required_argument, 0, 'z');
    
 #if defined(USE_OPENCL) || defined(USE_METAL)
    shortOpts += "M:";
@@ -217,6 +226,10 @@ parse_t DMDivisorApp::ParseOption(int opt, char *arg, const char *source)
          status = P_SUCCESS;
          break;
          
+      case 'z':
+         status = ParseShardOption(arg);
+         break;
+         
 #if defined(USE_OPENCL) || defined(USE_METAL)
       case 'M':
          status = Parser::Parse(arg, 1, 100000000, ii_MaxGpuFactors);
@@ -229,8 +242,6 @@ parse_t DMDivisorApp::ParseOption(int opt, char *arg, const char *source)
 
 void DMDivisorApp::ValidateOptions(void)
 {
-   uint32_t vCount, idx;
-
 #ifdef WIN32
    if (sizeof(unsigned long long) != sizeof(mp_limb_t))
      FatalError("GMP limb size is not 64 bits");
@@ -246,21 +257,7 @@ void DMDivisorApp::ValidateOptions(void)
    {
       ProcessInputTermsFile(false);
 
-      // We need this to be even
-      il_TermsMinK = (il_MinK & 1) ? il_MinK - 1 : il_MinK;
-      
-      vCount = 1 + (1 + il_MaxK - il_TermsMinK) / TERMS_PER_VECTOR;
-
-      iv_MMPTermsKm40.resize(vCount);
-      iv_MMPTermsKm41.resize(vCount);
-      for (idx=0; idx<vCount; idx++)
-      {
-         iv_MMPTermsKm40[idx].resize(20 + TERMS_PER_VECTOR);
-         iv_MMPTermsKm41[idx].resize(20 + TERMS_PER_VECTOR);
-         
-         std::fill(iv_MMPTermsKm40[idx].begin(), iv_MMPTermsKm40[idx].end(), false);
-         std::fill(iv_MMPTermsKm41[idx].begin(), iv_MMPTermsKm41[idx].end(), false);
-      }
+      CreateWheels();
       
       ProcessInputTermsFile(true);
       
@@ -285,21 +282,7 @@ void DMDivisorApp::ValidateOptions(void)
       if (ii_N == 0)
          FatalError("exponent must be specified");
 
-      // We need this to be even
-      il_TermsMinK = (il_MinK & 1) ? il_MinK - 1 : il_MinK;
-
-      vCount = 1 + (1 + il_MaxK - il_TermsMinK) / TERMS_PER_VECTOR;
-
-      iv_MMPTermsKm40.resize(vCount);
-      iv_MMPTermsKm41.resize(vCount);
-      for (uint32_t idx=0; idx<vCount; idx++)
-      {
-         iv_MMPTermsKm40[idx].resize(20 + TERMS_PER_VECTOR);
-         iv_MMPTermsKm41[idx].resize(20 + TERMS_PER_VECTOR);
-         
-         std::fill(iv_MMPTermsKm40[idx].begin(), iv_MMPTermsKm40[idx].end(), false);
-         std::fill(iv_MMPTermsKm41[idx].begin(), iv_MMPTermsKm41[idx].end(), false);
-      }
+      CreateWheels();
 
       // Let d be a prime divisor of MMp. We know that
       //
@@ -310,66 +293,25 @@ void DMDivisorApp::ValidateOptions(void)
       // Chris Nash pointed out on the Mersenne list that k must be 0 or 1 mod 4,
       // since, otherwise, 2 is not a quadratic residue of the supposed factor.
       // The combination of the prior two restrictions limits k to 0, 5, 8, and 9 modulo 12.
-      uint64_t k;
-
-      for (k=il_MinK; k%12>0; k++)
+      //
+      // Those are exactly the k that have a bit, except for a few k at either end of
+      // the bitmaps that are outside of the range of k.
+      for (uint32_t kClass=0; kClass<2; kClass++)
       {
-         uint64_t km12 = k % 12;
-         uint64_t bit = BIT_K(k);
-         uint64_t idx = IDX_K(k);
-
-         if (km12 == 0 || km12 == 8)
-         {
-            iv_MMPTermsKm40[idx][bit] = true;
-            il_TermCount++;
-         }
-
-         if (km12 == 5 || km12 == 9)
-         {
-            iv_MMPTermsKm41[idx][bit] = true;
-            il_TermCount++;
-         }
-      }
-
-      for (; k<il_MaxK-24; k+=12)
-      {         
-         uint64_t bit0 = BIT_K(k+0);
-         uint64_t idx0 = IDX_K(k+0);
-         uint64_t bit5 = BIT_K(k+5);
-         uint64_t idx5 = IDX_K(k+5);
-         uint64_t bit8 = BIT_K(k+8);
-         uint64_t idx8 = IDX_K(k+8);
-         uint64_t bit9 = BIT_K(k+9);
-         uint64_t idx9 = IDX_K(k+9);
-
-         // For terms where k % 4 = 0
-         iv_MMPTermsKm40[idx0][bit0] = true;      // for k = 0 % 12
-         iv_MMPTermsKm40[idx8][bit8] = true;      // for k = 8 % 12
-        
-         // For terms where k % 4 = 1
-         iv_MMPTermsKm41[idx5][bit5] = true;      // for k = 5 % 12
-         iv_MMPTermsKm41[idx9][bit9] = true;      // for k = 9 % 12
+         std::vector<bool> &terms = iv_Terms[kClass];
+         KWheel  *wheel = ip_Wheel[kClass];
+         uint64_t bit, firstBit, lastBit;
          
-         il_TermCount += 4;
-      }
-      
-      for (; k<=il_MaxK; k++)
-      {
-         uint64_t km12 = k % 12;
-         uint64_t bit = BIT_K(k);
-         uint64_t idx = IDX_K(k);
-
-         if (km12 == 0 || km12 == 8)
-         {
-            iv_MMPTermsKm40[idx][bit] = true;
-            il_TermCount++;
-         }
-
-         if (km12 == 5 || km12 == 9)
-         {
-            iv_MMPTermsKm41[idx][bit] = true;
-            il_TermCount++;
-         }
+         for (firstBit=0; firstBit<terms.size() && wheel->GetK(firstBit) < il_MinK; firstBit++)
+            ;
+         
+         for (lastBit=terms.size(); lastBit>firstBit && wheel->GetK(lastBit - 1) > il_MaxK; lastBit--)
+            ;
+         
+         for (bit=firstBit; bit<lastBit; bit++)
+            terms[bit] = true;
+         
+         il_TermCount += (lastBit - firstBit);
       }
    }
             
@@ -384,6 +326,8 @@ void DMDivisorApp::ValidateOptions(void)
       
       is_OutputTermsFileName = fileName;
    }
+   
+   ValidateShardOption();
       
    uint32_t i = 0;
    while (i != MERSENNE_PRIMES && dmdList[i].n != ii_N)
@@ -415,8 +359,8 @@ void DMDivisorApp::ValidateOptions(void)
    if (ib_TestTerms && ii_N > 10000)
       WriteToConsole(COT_OTHER, "It is recommended to PRP test remaining candidates before testing for DM divisibility with other software");
 
-   // Since the worker wants primes in groups of 4
-   while (ii_CpuWorkSize % 4 != 0)
+   // Since the worker wants primes in groups of 8
+   while (ii_CpuWorkSize % WIDE_VECTOR_SIZE != 0)
       ii_CpuWorkSize++;
 
 
@@ -484,13 +428,47 @@ Worker *DMDivisorApp::CreateWorker(uint32_t id, bool gpuWorker, uint64_t largest
    return theWorker;
 }
 
+// The position of k is the same in both classes and is (k - kmin)/4 where kmin is
+// rounded down to an even number.  When sharded (-z i/m), k is in the shard if its
+// position mod m is i-1.  Those are the k that are in the wheel after ApplyShardToK().
+void DMDivisorApp::CreateWheels(void)
+{
+   uint64_t minK, maxK, positions;
+   uint32_t kShift;
+   
+   // We need this to be even
+   il_TermsMinK = (il_MinK & 1) ? il_MinK - 1 : il_MinK;
+   
+   positions = (il_MaxK - il_TermsMinK) / 4 + 1;
+   
+   for (uint32_t kClass=0; kClass<2; kClass++)
+   {
+      // This is the k in this class with position 0.  Both classes have the same number
+      // of positions, so the last k might be larger than kmax.  Those will not be terms.
+      minK = il_TermsMinK + (il_TermsMinK % 4) + kClass;
+      maxK = minK + 4 * (positions - 1);
+      kShift = 2;
+   
+      ApplyShardToK(minK, maxK, kShift);
+   
+      ip_Wheel[kClass] = new KWheel(minK, maxK, kShift);
+   
+      // 2*k*(2^n-1)+1 = 0 (mod 3) when k = 1 (mod 3)
+      ip_Wheel[kClass]->ExcludeK(3, 1);
+      ip_Wheel[kClass]->Build();
+   
+      iv_Terms[kClass].resize(ip_Wheel[kClass]->GetBitCount());
+      std::fill(iv_Terms[kClass].begin(), iv_Terms[kClass].end(), false);
+   }
+}
+
 void DMDivisorApp::ProcessInputTermsFile(bool haveBitMap)
 {
    FILE    *fPtr = fopen(is_InputTermsFileName.c_str(), "r");
    char     buffer[1000];
    bool     isAbcd = false;
-   uint32_t n;
-   uint64_t k, prevk, lastPrime = 0;
+   uint32_t n, kClass;
+   uint64_t k, prevk, bit, lastPrime = 0;
    
    if (!fPtr)
       FatalError("Unable to open input file %s", is_InputTermsFileName.c_str());
@@ -516,15 +494,11 @@ void DMDivisorApp::ProcessInputTermsFile(bool haveBitMap)
          if (k % 4 > 1)
             FatalError("Bad k %llu", k);
          
-         uint64_t bit = BIT_K(k);
-         uint64_t idx = IDX_K(k); 
-         
-         if (k & 1)
-            iv_MMPTermsKm41[idx][bit] = true;
-         else
-            iv_MMPTermsKm40[idx][bit] = true;
-         
-         il_TermCount++;
+         if (GetBit(k, kClass, bit))
+         {
+            iv_Terms[kClass][bit] = true;
+            il_TermCount++;
+         }
       }
       else
          il_MinK = il_MaxK = k;
@@ -562,14 +536,10 @@ void DMDivisorApp::ProcessInputTermsFile(bool haveBitMap)
       
       if (haveBitMap)
       {
-         uint64_t bit = BIT_K(k);
-         uint64_t idx = IDX_K(k); 
-         
-         if (k & 1)
-            iv_MMPTermsKm41[idx][bit] = true;
-         else
-            iv_MMPTermsKm40[idx][bit] = true;
+         if (!GetBit(k, kClass, bit))
+            continue;
          
+         iv_Terms[kClass][bit] = true;
          il_TermCount++;
       }
       else
@@ -587,8 +557,8 @@ void DMDivisorApp::ProcessInputTermsFile(bool haveBitMap)
 
 bool DMDivisorApp::ApplyFactor(uint64_t theFactor, const char *term)
 {
-   uint64_t k;
-   uint32_t n;
+   uint64_t k, bit;
+   uint32_t n, kClass;
       
    if (sscanf(term, "2*%" SCNu64"*(2^%u-1)+1", &k, &n) != 2)
       FatalError("Could not parse term %s", term);
@@ -601,32 +571,16 @@ bool DMDivisorApp::ApplyFactor(uint64_t theFactor, const char *term)
 
    VerifyFactor(theFactor, k);
 
-   if (k % 4 > 1)
+   if (!GetBit(k, kClass, bit))
       return false;
-
-   uint64_t bit = BIT_K(k);
-   uint64_t idx = IDX_K(k); 
          
    // No locking is needed because the Workers aren't running yet
-   if (k & 1)
-   {
-      if (iv_MMPTermsKm41[idx][bit])
-      {
-         iv_MMPTermsKm41[idx][bit] = false;
-         il_TermCount--;
-
-         return true;
-      }
-   }
-   else
+   if (iv_Terms[kClass][bit])
    {
-      if (iv_MMPTermsKm40[idx][bit])
-      {
-         iv_MMPTermsKm40[idx][bit] = false;
-         il_TermCount--;
+      iv_Terms[kClass][bit] = false;
+      il_TermCount--;
 
-         return true;
-      }
+      return true;
    }
       
    return false;
@@ -635,11 +589,21 @@ bool DMDivisorApp::ApplyFactor(uint64_t theFactor, const char *term)
 void DMDivisorApp::WriteOutputTermsFile(uint64_t largestPrime)
 {
    uint64_t termsCounted = 0;
-   uint64_t prevk = 0;
+   uint64_t prevk = 0, bit;
+   uint32_t kClass;
 
    if (ib_TestTerms)
       return;
    
+   // If we have no terms, then we have nothing to write unless this is a shard
+   if (il_TermCount == 0)
+   {
+      if (IsSharded())
+         WriteEmptyTermsFile(is_OutputTermsFileName.c_str());
+      
+      return;
+   }
+   
    // No need to waste time writing to a file if we don't want one until we are done sieving.
    if (!IsSievingDone() && ib_WriteWhenDone)
       return;
@@ -649,10 +613,6 @@ void DMDivisorApp::WriteOutputTermsFile(uint64_t largestPrime)
    if (IsRunning() && largestPrime < GetMaxPrimeForSingleWorker())
       return;
 
-   // If we have no terms, then we have nothing to write
-   if (il_TermCount == 0)
-      return;
-   
    ip_FactorAppLock->Lock();
    
    FILE    *termsFile = fopen(is_OutputTermsFileName.c_str(), "w");
@@ -665,18 +625,7 @@ void DMDivisorApp::WriteOutputTermsFile(uint64_t largestPrime)
 
    for (uint64_t k=il_MinK; k<=il_MaxK; k++)
    {    
-      uint64_t km4 = k % 4;
-
-      if (km4 > 1)
-         continue;
-
-      uint64_t bit = BIT_K(k);
-      uint64_t idx = IDX_K(k); 
-
-      if (km4 == 0 && !iv_MMPTermsKm40[idx][bit])
-         continue;
-
-      if (km4 == 1 && !iv_MMPTermsKm41[idx][bit])
+      if (!GetBit(k, kClass, bit) || !iv_Terms[kClass][bit])
          continue;
       
       if (it_Format == FF_ABC)
@@ -707,50 +656,50 @@ void  DMDivisorApp::GetExtraTextForSieveStartedMessage(char *extraText, uint32_t
    snprintf(extraText, maxTextLength, "%" PRIu64 " <= k <= %" PRIu64", 2*k*(2^%u-1)+1", il_MinK, il_MaxK, ii_N);
 }
 
+// These primes are terms that are known to be factors of 2^(2^n-1)-1, so they must not
+// remove themselves or any other term.
+bool  DMDivisorApp::IsKnownFactor(uint64_t theFactor)
+{
+   if (ii_N >= 62)
+      return false;
+   
+   if (ii_N == 13 && theFactor == 338193759479) return true;
+   if (ii_N == 17 && theFactor == 231733529) return true;
+   if (ii_N == 17 && theFactor == 64296354767) return true;
+   if (ii_N == 19 && theFactor == 62914441) return true;
+   if (ii_N == 19 && theFactor == 5746991873407) return true;
+   if (ii_N == 31 && theFactor == 295257526626031) return true;
+   if (ii_N == 61 && theFactor == 2305843009213693951) return true;
+   
+   return false;
+}
+
 void  DMDivisorApp::ReportFactor(uint64_t theFactor, uint64_t k, bool verifyFactor)
 {
-   uint32_t verifiedCount = 0;
+   uint32_t verifiedCount = 0, kClass;
+   uint64_t bit;
+   
+   if (IsKnownFactor(theFactor))
+      return;
       
    if (theFactor > GetMaxPrimeForSingleWorker())
       ip_FactorAppLock->Lock();
 
-   if (ii_N < 62)
-   {
-      if (ii_N == 13 && theFactor == 338193759479) return;
-      if (ii_N == 17 && theFactor == 231733529) return;
-      if (ii_N == 17 && theFactor == 64296354767) return;
-      if (ii_N == 19 && theFactor == 62914441) return;
-      if (ii_N == 19 && theFactor == 5746991873407) return;
-      if (ii_N == 31 && theFactor == 295257526626031) return;
-      if (ii_N == 61 && theFactor == 2305843009213693951) return;
-   }
-
    // Only k where k%4 < 2 are considered.
    while (k <= il_MaxK)
    {
-      uint64_t km4 = k % 4;
-      
-      if (km4 < 2)
+      if (k >= il_MinK && GetBit(k, kClass, bit) && iv_Terms[kClass][bit])
       {
-         uint64_t bit = BIT_K(k);
-         uint64_t idx = IDX_K(k); 
-
-         if ((km4 == 0 && iv_MMPTermsKm40[idx][bit]) || (km4 == 1 && iv_MMPTermsKm41[idx][bit]))
-         {
-            // We only need to verify the first two
-            if (verifyFactor && ++verifiedCount < 3)
-               VerifyFactor(theFactor, k);
-            
-            if (km4 == 0)
-               iv_MMPTermsKm40[idx][bit] = false;
-            else
-               iv_MMPTermsKm41[idx][bit] = false;
+         // We only need to verify the first two
+         if (verifyFactor && ++verifiedCount < 3)
+            VerifyFactor(theFactor, k);
+         
+         iv_Terms[kClass][bit] = false;
 
-            LogFactor(theFactor, "2*%" PRIu64"*(2^%u-1)+1", k, ii_N);
-            
-            il_FactorCount++;
-            il_TermCount--;
-         }
+         LogFactor(theFactor, "2*%" PRIu64"*(2^%u-1)+1", k, ii_N);
+         
+         il_FactorCount++;
+         il_TermCount--;
       }
       
 		k += theFactor; 
@@ -760,6 +709,50 @@ void  DMDivisorApp::ReportFactor(uint64_t theFactor, uint64_t k, bool verifyFact
       ip_FactorAppLock->Release();
 }
 
+// This is used for p < il_MaxK.  The bitmaps are sieved one segment at a time so that
+// other workers can report factors between segments.
+void  DMDivisorApp::ReportFactors(KSegmentSieve **kSieves)
+{
+   std::vector<ksieve_entry_t>::const_iterator it;
+   std::vector<bool> *bitmaps[1];
+   KSegmentSieve *kSieve;
+   uint32_t idx, kClass, segment;
+   
+   for (kClass=0; kClass<2; kClass++)
+   {
+      kSieve = kSieves[kClass];
+      bitmaps[0] = &iv_Terms[kClass];
+      
+      // If the first term is valid, then the rest are valid.
+      for (idx=0; idx<kSieve->GetPrimeCount(); idx++)
+         VerifyFactor(kSieve->GetPrime(idx)->prime, kSieve->GetPrimeK(idx));
+      
+      for (segment=0; segment<kSieve->GetSegmentCount(); segment++)
+      {
+         if (!kSieve->HasSegmentPrimes(segment))
+            continue;
+         
+         ip_FactorAppLock->Lock();
+         
+         kSieve->SieveSegment(segment, bitmaps);
+         
+         const std::vector<ksieve_entry_t> &hits = kSieve->GetHits();
+         
+         StartFactorBatch();
+         
+         for (it=hits.begin(); it!=hits.end(); it++)
+            LogFactor(it->prime, "2*%" PRIu64"*(2^%u-1)+1", kSieve->GetK(it->bit), ii_N);
+         
+         EndFactorBatch();
+         
+         il_FactorCount += hits.size();
+         il_TermCount -= hits.size();
+         
+         ip_FactorAppLock->Release();
+      }
+   }
+}
+
 void  DMDivisorApp::VerifyFactor(uint64_t theFactor, uint64_t k)
 {
    const MpArith mp(theFactor);
@@ -788,117 +781,26 @@ bool  DMDivisorApp::PostSieveHook(void)
    if (!ib_TestTerms)
       return true;
    
-   time_t   lastCheckPointTime;
-   time_t   startTime, currentTime, estimatedFinishTime;
-   uint64_t kEvaluated = 0, kTested = 0;
-   uint32_t factorsFound = 0;
+   time_t   startTime, currentTime;
+   uint64_t kEvaluated, kTested;
+   uint32_t factorsFound;
    uint64_t kTestedPerSecond;
    uint32_t kSecondsPerTest;
-   double   percentCompleted;
    double   percentTermsRequiringTest;
-   FILE    *fPtr;
-   mpz_t    rem, mTwo, mMp, mMpPlus1, kTemp, factor;
-   char     finishTimeBuffer[40];
-   struct tm   *finish_tm;
 
    WriteToConsole(COT_OTHER, "Starting Double-Mesenne divisibility checking");
 
-   lastCheckPointTime = startTime = currentTime = time(NULL);
-            
-   mpz_init(rem);
-   mpz_init(mTwo);
-   mpz_init(mMp);
-   mpz_init(mMpPlus1);
-   mpz_init(kTemp);
-   mpz_init(factor);
-   
-   mpz_set_ui(mMpPlus1, 2);
-   mpz_pow_ui(mMpPlus1, mMpPlus1, ii_N);
-   mpz_sub_ui(mMp, mMpPlus1, 1);
-   mpz_set_ui(mTwo, 2);
-
-   for (uint64_t k=il_MinK; k<=il_MaxK; k++)
-   {
-      kEvaluated++;
-      
-      uint64_t km4 = k % 4;
-
-      if (km4 > 1)
-         continue;
-
-      uint64_t bit = BIT_K(k);
-      uint64_t idx = IDX_K(k); 
-
-      if (km4 == 0 && !iv_MMPTermsKm40[idx][bit])
-         continue;
-
-      if (km4 == 1 && !iv_MMPTermsKm41[idx][bit])
-         continue;
-
-      currentTime = time(NULL);
-      kTested++;
-      
-#ifdef WIN32
-      // Even though built with 64-bit limbs, mpz_set_ui doesn't
-      // populate kTemp correctly when k > 32 bits.
-      mpz_set_ui(kTemp, k >> 32);
-      mpz_mul_2exp(kTemp, kTemp, 32);
-      mpz_add_ui(kTemp, kTemp, k & (0xffffffff));
-#else
-      mpz_set_ui(kTemp, k);
-#endif
-
-      mpz_mul(factor, kTemp, mMp);
-      mpz_mul_ui(factor, factor, 2);
-      mpz_add_ui(factor, factor, 1);
-
-      // Compute 2^(2^n) % factor.  If == 2, then we have a factor of 2^(2^n-1)-1.
-      mpz_powm(rem, mTwo, mMpPlus1, factor);
-
-      if (mpz_cmp_ui(rem, 2) == 0)
-      {
-         factorsFound++;
-         WriteToConsole(COT_OTHER, "Found factor 2*%" PRIu64"*(2^%u-1)+1 of 2^(2^%u-1)-1", k, ii_N, ii_N);
-         
-         fPtr = fopen("dm_factors.txt", "a+");
-         fprintf(fPtr, "Found factor 2*%" PRIu64"*(2^%u-1)+1 of 2^(2^%u-1)-1\n", k, ii_N, ii_N);
-         fclose(fPtr);
-      }
-
-      // Report once every 10 seconds.
-      if (currentTime >= lastCheckPointTime + 10)
-      {            
-         percentCompleted = ((double) (k - il_MinK)) / ((double) (il_MaxK - il_MinK));
-
-         percentTermsRequiringTest = (100.0 * (double) kTested) / (double) kEvaluated;
-         
-         kTestedPerSecond = kTested / (currentTime - startTime);
-         
-         estimatedFinishTime = startTime + (currentTime - startTime)/percentCompleted;
-         finish_tm = localtime(&estimatedFinishTime);
-         strftime(finishTimeBuffer, sizeof(finishTimeBuffer), "%Y-%m-%d %H:%M", finish_tm);
-         
-         if (kTestedPerSecond >= 1)
-            WriteToConsole(COT_SIEVE, " Tested %5.2f pct of range at %" PRIu64" tests per second (%4.2f pct of all k after sieving) ETC %s", 
-                           percentCompleted * 100.0, kTestedPerSecond, percentTermsRequiringTest, finishTimeBuffer);
-         else 
-         {
-            kSecondsPerTest = (currentTime - startTime) / kTested;
-
-            WriteToConsole(COT_SIEVE, " Tested %5.2f pct of range at %u seconds per test (%4.2f pct of all k after sieving) ETC %s", 
-                           percentCompleted * 100.0, kSecondsPerTest, percentTermsRequiringTest, finishTimeBuffer);
-         }
-
-         lastCheckPointTime = currentTime;
-      }
-   }
-
-   mpz_clear(rem);
-   mpz_clear(mTwo);
-   mpz_clear(mMp);
-   mpz_clear(mMpPlus1);
-   mpz_clear(kTemp);
-   mpz_clear(factor);
+   startTime = time(NULL);
+   
+   DMDivisorTester *tester = new DMDivisorTester(this);
+   
+   kTested = tester->TestRemainingTerms(iv_Terms, il_TermCount);
+   factorsFound = tester->GetFactorsFound();
+   
+   delete tester;
+   
+   currentTime = time(NULL);
+   kEvaluated = il_MaxK - il_MinK + 1;
    
    if (il_TermCount != kTested)
       FatalError("Expected to test %" PRIu64" terms, but tested %" PRIu64" terms                                                  ", il_TermCount, kTested);
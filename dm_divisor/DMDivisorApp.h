@@ -13,6 +13,7 @@
 
 #include <gmp.h>
 #include "../core/FactorApp.h"
+#include "../core/KSegmentSieve.h"
 
 #define KMAX_MAX ((UINT64_C(1)<<62)-1)
 #define NMAX_MAX (1 << 31)
@@ -24,7 +25,7 @@ class DMDivisorApp : public FactorApp
 public:
    DMDivisorApp(void);
 
-   ~DMDivisorApp(void) {};
+   ~DMDivisorApp(void);
 
    void              Help(void);
    void              AddCommandLineOptions(std::string &shortOpts, struct option *longOpts);
@@ -37,8 +38,11 @@ public:
    uint64_t          GetMaxK(void) { return il_MaxK; };
    uint32_t          GetN(void) { return ii_N; };
    uint32_t          GetMaxGpuFactors(void) { return ii_MaxGpuFactors; };
+   KWheel           *GetWheel(uint32_t kClass) { return ip_Wheel[kClass]; };
    
+   bool              IsKnownFactor(uint64_t theFactor);
    void              ReportFactor(uint64_t theFactor, uint64_t k, bool verifyFactor);
+   void              ReportFactors(KSegmentSieve **kSieves);
 
 protected:
    void              PreSieveHook(void) {};
@@ -56,9 +60,24 @@ protected:
 private:
    void              VerifyFactor(uint64_t theFactor, uint64_t k);
    void              TestRemainingTerms(void);
+   void              CreateWheels(void);
    
-   std::vector<std::vector<bool>> iv_MMPTermsKm40;
-   std::vector<std::vector<bool>> iv_MMPTermsKm41;
+   // Only k = 0 (mod 4) and k = 1 (mod 4) can be terms.  This returns false for
+   // other k, k that are excluded by the wheel, and k that are not in this shard.
+   inline bool       GetBit(uint64_t k, uint32_t &kClass, uint64_t &bit)
+   {
+      kClass = (uint32_t) (k & 3);
+      
+      if (kClass > 1)
+         return false;
+      
+      return ip_Wheel[kClass]->GetBit(k, bit);
+   };
+   
+   // Index 0 is for k = 0 (mod 4) and index 1 is for k = 1 (mod 4).  Both
+   // bitmaps use a wheel that excludes k = 1 (mod 3).
+   KWheel           *ip_Wheel[2];
+   std::vector<bool> iv_Terms[2];
    
    std::string       is_InputFileName;
    std::string       is_OutputFileName;
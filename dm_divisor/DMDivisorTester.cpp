@@ -0,0 +1,449 @@
+/* DMDivisorTester.cpp -- (C) Mark Rodenkirch, October 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+*/
+
+#include <cinttypes>
+#include "DMDivisorTester.h"
+#include "DMDivisorApp.h"
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#ifdef WIN32
+static DWORD WINAPI WindowsThreadEntryPoint(LPVOID data)
+{
+   DMDivisorTester::TesterThreadEntryPoint(data);
+
+   return 0;
+}
+#endif
+
+// x = x^2 / 2^(64*L) (mod q) where x < q and qInv = -1/q (mod 2^64).  The square is
+// computed first so that each cross product is only computed once, then it is reduced
+// one limb at a time.  The result is < q.
+template<uint32_t L>
+static inline void MontgomerySquare(mp_limb_t *x, const mp_limb_t *q, mp_limb_t qInv)
+{
+   mp_limb_t   t[2*L];
+   mp_limb_t   m, carry, high;
+   __uint128_t prod, sum;
+   uint32_t    i, j;
+
+   for (j=0; j<2*L; j++)
+      t[j] = 0;
+
+   // The cross products x[i]*x[j] with i < j
+   for (i=0; i<L; i++)
+   {
+      carry = 0;
+      for (j=i+1; j<L; j++)
+      {
+         prod = (__uint128_t) x[j] * x[i] + t[i+j] + carry;
+         t[i+j] = (mp_limb_t) prod;
+         carry = (mp_limb_t) (prod >> 64);
+      }
+
+      t[i+L] = carry;
+   }
+
+   // Double them, then add the squares x[i]*x[i]
+   carry = 0;
+   for (j=0; j<2*L; j++)
+   {
+      high = t[j] >> 63;
+      t[j] = (t[j] << 1) | carry;
+      carry = high;
+   }
+
+   carry = 0;
+   for (i=0; i<L; i++)
+   {
+      prod = (__uint128_t) x[i] * x[i];
+
+      sum = (__uint128_t) t[2*i] + (mp_limb_t) prod + carry;
+      t[2*i] = (mp_limb_t) sum;
+
+      sum = (__uint128_t) t[2*i+1] + (mp_limb_t) (prod >> 64) + (mp_limb_t) (sum >> 64);
+      t[2*i+1] = (mp_limb_t) sum;
+      carry = (mp_limb_t) (sum >> 64);
+   }
+
+   // Each step makes the lowest remaining limb 0.  high is the carry out of the top limb.
+   high = 0;
+   for (i=0; i<L; i++)
+   {
+      m = t[i] * qInv;
+
+      carry = 0;
+      for (j=0; j<L; j++)
+      {
+         prod = (__uint128_t) m * q[j] + t[i+j] + carry;
+         t[i+j] = (mp_limb_t) prod;
+         carry = (mp_limb_t) (prod >> 64);
+      }
+
+      sum = (__uint128_t) t[i+L] + carry + high;
+      t[i+L] = (mp_limb_t) sum;
+      high = (mp_limb_t) (sum >> 64);
+   }
+
+   // The result is < 2q so subtract q at most once
+   bool subtract = (high != 0);
+
+   if (!subtract)
+   {
+      subtract = true;
+
+      for (j=L; j>0; j--)
+      {
+         if (t[L+j-1] != q[j-1])
+         {
+            subtract = (t[L+j-1] > q[j-1]);
+            break;
+         }
+      }
+   }
+
+   if (subtract)
+   {
+      mp_limb_t borrow = 0;
+
+      for (j=0; j<L; j++)
+      {
+         prod = (__uint128_t) t[L+j] - q[j] - borrow;
+         t[L+j] = (mp_limb_t) prod;
+         borrow = (mp_limb_t) (prod >> 64) & 1;
+      }
+   }
+
+   for (j=0; j<L; j++)
+      x[j] = t[L+j];
+}
+
+// Return true if 2^(2^n) = 2 (mod q).  2 in Montgomery form is 2^(64*L+1) mod q.
+// Since the squarings keep x in Montgomery form, x is compared to the starting value.
+template<uint32_t L>
+static bool IsDivisorMontgomery(const mp_limb_t *q, uint32_t n)
+{
+   mp_limb_t   num[L+1], quot[2], x[L], two[L];
+   mp_limb_t   qInv;
+   uint32_t    i;
+
+   for (i=0; i<L; i++)
+      num[i] = 0;
+
+   num[L] = 2;
+
+   mpn_tdiv_qr(quot, two, 0, num, L+1, q, L);
+
+   // Newton's iteration doubles the number of correct bits of the inverse each time
+   qInv = q[0];
+   for (i=0; i<5; i++)
+      qInv *= 2 - q[0] * qInv;
+
+   qInv = -qInv;
+
+   for (i=0; i<L; i++)
+      x[i] = two[i];
+
+   for (i=0; i<n; i++)
+      MontgomerySquare<L>(x, q, qInv);
+
+   for (i=0; i<L; i++)
+      if (x[i] != two[i])
+         return false;
+
+   return true;
+}
+
+DMDivisorTester::DMDivisorTester(DMDivisorApp *theApp)
+{
+   ip_DMDivisorApp = theApp;
+
+   ii_N = ip_DMDivisorApp->GetN();
+   il_MinK = ip_DMDivisorApp->GetMinK();
+   il_MaxK = ip_DMDivisorApp->GetMaxK();
+
+   mpz_init(im_Mp);
+   mpz_init(im_MpPlus1);
+   mpz_init(im_Two);
+
+   mpz_set_ui(im_MpPlus1, 2);
+   mpz_pow_ui(im_MpPlus1, im_MpPlus1, ii_N);
+   mpz_sub_ui(im_Mp, im_MpPlus1, 1);
+   mpz_set_ui(im_Two, 2);
+
+   ii_MpLimbCount = (ii_N + 63) / 64;
+
+   for (uint32_t i=0; i<DMT_MAX_LIMBS; i++)
+      im_MpLimbs[i] = (i < ii_MpLimbCount ? mpz_getlimbn(im_Mp, i) : 0);
+
+   ip_TesterLock = new SharedMemoryItem("dmd_tester");
+
+   ip_FactorsFile = NULL;
+   ii_FactorsFound = 0;
+}
+
+DMDivisorTester::~DMDivisorTester(void)
+{
+   mpz_clear(im_Mp);
+   mpz_clear(im_MpPlus1);
+   mpz_clear(im_Two);
+
+   if (ip_FactorsFile != NULL)
+      fclose(ip_FactorsFile);
+
+   delete ip_TesterLock;
+}
+
+uint64_t  DMDivisorTester::TestRemainingTerms(const std::vector<bool> *terms, uint64_t termCount)
+{
+   uint32_t threadCount = ip_DMDivisorApp->GetCpuWorkerCount();
+   uint64_t bitCount;
+
+   if (threadCount == 0)
+      threadCount = 1;
+
+   ip_Terms = terms;
+
+   bitCount = (ip_Terms[0].size() > ip_Terms[1].size() ? ip_Terms[0].size() : ip_Terms[1].size());
+
+   il_UnitsPerClass = (bitCount + DMT_BITS_PER_UNIT - 1) / DMT_BITS_PER_UNIT;
+   il_NextUnit = 0;
+   il_UnitsDone = 0;
+
+   il_TermCount = termCount;
+   il_TermsTested = 0;
+
+   it_StartTime = it_LastCheckPointTime = time(NULL);
+
+#ifdef WIN32
+   std::vector<HANDLE>    threads(threadCount);
+#else
+   std::vector<pthread_t> threads(threadCount);
+#endif
+
+   // The last thread is this thread
+   for (uint32_t idx=0; idx<threadCount-1; idx++)
+   {
+#ifdef WIN32
+      threads[idx] = CreateThread(0, 0, WindowsThreadEntryPoint, this, 0, 0);
+#else
+      pthread_create(&threads[idx], NULL, &TesterThreadEntryPoint, this);
+#endif
+   }
+
+   TestTerms();
+
+   for (uint32_t idx=0; idx<threadCount-1; idx++)
+   {
+#ifdef WIN32
+      WaitForSingleObject(threads[idx], INFINITE);
+      CloseHandle(threads[idx]);
+#else
+      pthread_join(threads[idx], NULL);
+#endif
+   }
+
+   return il_TermsTested;
+}
+
+void *DMDivisorTester::TesterThreadEntryPoint(void *data)
+{
+   DMDivisorTester *tester = (DMDivisorTester *) data;
+
+   tester->TestTerms();
+
+   return 0;
+}
+
+void  DMDivisorTester::TestTerms(void)
+{
+   uint64_t unit, termsTested;
+   time_t   currentTime;
+   mpz_t    rem, kTemp, factor;
+
+   mpz_init(rem);
+   mpz_init(kTemp);
+   mpz_init(factor);
+
+   ip_TesterLock->Lock();
+
+   while (il_NextUnit < 2 * il_UnitsPerClass)
+   {
+      unit = il_NextUnit;
+      il_NextUnit++;
+
+      ip_TesterLock->Release();
+
+      termsTested = TestUnit(unit, rem, kTemp, factor);
+
+      ip_TesterLock->Lock();
+
+      il_TermsTested += termsTested;
+      il_UnitsDone++;
+
+      currentTime = time(NULL);
+
+      // Report once every 10 seconds.
+      if (currentTime >= it_LastCheckPointTime + 10)
+         ReportProgress(currentTime);
+   }
+
+   ip_TesterLock->Release();
+
+   mpz_clear(rem);
+   mpz_clear(kTemp);
+   mpz_clear(factor);
+}
+
+// This returns the number of terms that were tested
+uint64_t  DMDivisorTester::TestUnit(uint64_t unit, mpz_t rem, mpz_t kTemp, mpz_t factor)
+{
+   uint32_t kClass = (uint32_t) (unit / il_UnitsPerClass);
+   uint64_t bit = (unit % il_UnitsPerClass) * DMT_BITS_PER_UNIT;
+   uint64_t endBit = bit + DMT_BITS_PER_UNIT;
+   uint64_t k, termsTested = 0;
+   KWheel  *wheel = ip_DMDivisorApp->GetWheel(kClass);
+
+   const std::vector<bool> &terms = ip_Terms[kClass];
+
+   if (endBit > terms.size())
+      endBit = terms.size();
+
+   for ( ; bit<endBit; bit++)
+   {
+      if (!terms[bit])
+         continue;
+
+      k = wheel->GetK(bit);
+
+      if (k < il_MinK || k > il_MaxK)
+         continue;
+
+      termsTested++;
+
+      if (IsDivisor(k, rem, kTemp, factor))
+         ReportFactor(k);
+   }
+
+   return termsTested;
+}
+
+// Compute 2^(2^n) % q.  If == 2, then q is a factor of 2^(2^n-1)-1.
+bool  DMDivisorTester::IsDivisor(uint64_t k, mpz_t rem, mpz_t kTemp, mpz_t factor)
+{
+   mp_limb_t q[DMT_MAX_LIMBS+1];
+   mp_limb_t carry;
+   uint32_t  limbs;
+
+   if (ii_MpLimbCount <= DMT_MAX_LIMBS)
+   {
+      // q = 2*k*(2^n-1)+1.  2*k < 2^64 since k < 2^62.
+      carry = mpn_mul_1(q, im_MpLimbs, ii_MpLimbCount, (mp_limb_t) (k << 1));
+
+      limbs = ii_MpLimbCount;
+
+      if (carry != 0)
+         q[limbs++] = carry;
+
+      // q is even before adding 1
+      q[0] |= 1;
+
+      // If the carry made q one limb longer than supported, GMP is used
+
+      switch (limbs)
+      {
+         case  1: return IsDivisorMontgomery<1>(q, ii_N);
+         case  2: return IsDivisorMontgomery<2>(q, ii_N);
+         case  3: return IsDivisorMontgomery<3>(q, ii_N);
+         case  4: return IsDivisorMontgomery<4>(q, ii_N);
+         case  5: return IsDivisorMontgomery<5>(q, ii_N);
+      }
+   }
+
+#ifdef WIN32
+   // Even though built with 64-bit limbs, mpz_set_ui doesn't
+   // populate kTemp correctly when k > 32 bits.
+   mpz_set_ui(kTemp, k >> 32);
+   mpz_mul_2exp(kTemp, kTemp, 32);
+   mpz_add_ui(kTemp, kTemp, k & (0xffffffff));
+#else
+   mpz_set_ui(kTemp, k);
+#endif
+
+   mpz_mul(factor, kTemp, im_Mp);
+   mpz_mul_ui(factor, factor, 2);
+   mpz_add_ui(factor, factor, 1);
+
+   mpz_powm(rem, im_Two, im_MpPlus1, factor);
+
+   return (mpz_cmp_ui(rem, 2) == 0);
+}
+
+// This is called while holding the lock
+void  DMDivisorTester::ReportProgress(time_t currentTime)
+{
+   time_t   estimatedFinishTime;
+   uint64_t kTestedPerSecond;
+   uint32_t kSecondsPerTest;
+   double   percentCompleted;
+   double   percentTermsRequiringTest;
+   char     finishTimeBuffer[40];
+   struct tm   *finish_tm;
+
+   it_LastCheckPointTime = currentTime;
+
+   if (il_TermsTested == 0)
+      return;
+
+   percentCompleted = ((double) il_UnitsDone) / ((double) (2 * il_UnitsPerClass));
+
+   percentTermsRequiringTest = (100.0 * (double) il_TermCount) / (double) (il_MaxK - il_MinK + 1);
+
+   kTestedPerSecond = il_TermsTested / (currentTime - it_StartTime);
+
+   estimatedFinishTime = it_StartTime + (currentTime - it_StartTime)/percentCompleted;
+   finish_tm = localtime(&estimatedFinishTime);
+   strftime(finishTimeBuffer, sizeof(finishTimeBuffer), "%Y-%m-%d %H:%M", finish_tm);
+
+   if (kTestedPerSecond >= 1)
+      ip_DMDivisorApp->WriteToConsole(COT_SIEVE, " Tested %5.2f pct of range at %" PRIu64" tests per second (%4.2f pct of all k after sieving) ETC %s",
+                                      percentCompleted * 100.0, kTestedPerSecond, percentTermsRequiringTest, finishTimeBuffer);
+   else
+   {
+      kSecondsPerTest = (currentTime - it_StartTime) / il_TermsTested;
+
+      ip_DMDivisorApp->WriteToConsole(COT_SIEVE, " Tested %5.2f pct of range at %u seconds per test (%4.2f pct of all k after sieving) ETC %s",
+                                      percentCompleted * 100.0, kSecondsPerTest, percentTermsRequiringTest, finishTimeBuffer);
+   }
+}
+
+// Factors are very rare, so the file is flushed for each one so that none are lost
+// if the program is stopped.
+void  DMDivisorTester::ReportFactor(uint64_t k)
+{
+   ip_TesterLock->Lock();
+
+   ii_FactorsFound++;
+
+   ip_DMDivisorApp->WriteToConsole(COT_OTHER, "Found factor 2*%" PRIu64"*(2^%u-1)+1 of 2^(2^%u-1)-1", k, ii_N, ii_N);
+
+   if (ip_FactorsFile == NULL)
+      ip_FactorsFile = fopen("dm_factors.txt", "a+");
+
+   if (ip_FactorsFile == NULL)
+      FatalError("Unable to open output file dm_factors.txt");
+
+   fprintf(ip_FactorsFile, "Found factor 2*%" PRIu64"*(2^%u-1)+1 of 2^(2^%u-1)-1\n", k, ii_N, ii_N);
+   fflush(ip_FactorsFile);
+
+   ip_TesterLock->Release();
+}
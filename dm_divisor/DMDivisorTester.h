@@ -0,0 +1,88 @@
+/* DMDivisorTester.h -- (C) Mark Rodenkirch, October 2026
+
+   This tests the terms that remain after sieving for divisibility of 2^(2^n-1)-1
+   using multiple threads.  Each thread takes a range of bits of one of the bitmaps.
+
+   For a term q = 2*k*(2^n-1)+1 the test is 2^(2^n) = 2 (mod q), which is n modular
+   squarings.  When q fits in a few 64-bit limbs, the squarings are done with Montgomery
+   multiplication using a fixed number of limbs for q.  For larger q GMP's mpz_powm is
+   faster since its assembly routines are better than what the compiler generates here.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+*/
+
+#ifndef _DMDivisorTester_H
+#define _DMDivisorTester_H
+
+#include <gmp.h>
+#include <time.h>
+#include <vector>
+#include "../core/SharedMemoryItem.h"
+
+// Each thread takes this many bits of a bitmap at a time
+#define DMT_BITS_PER_UNIT  65536
+
+// The largest q that is tested with Montgomery multiplication.  With k < 2^62 this
+// covers n < 256.
+#define DMT_MAX_LIMBS      5
+
+class DMDivisorApp;
+
+class DMDivisorTester
+{
+public:
+   DMDivisorTester(DMDivisorApp *theApp);
+
+   ~DMDivisorTester(void);
+
+   // This returns the number of terms that were tested.
+   uint64_t          TestRemainingTerms(const std::vector<bool> *terms, uint64_t termCount);
+
+   uint32_t          GetFactorsFound(void) { return ii_FactorsFound; };
+
+   static void      *TesterThreadEntryPoint(void *data);
+
+private:
+   void              TestTerms(void);
+   uint64_t          TestUnit(uint64_t unit, mpz_t rem, mpz_t kTemp, mpz_t factor);
+   bool              IsDivisor(uint64_t k, mpz_t rem, mpz_t kTemp, mpz_t factor);
+   void              ReportProgress(time_t currentTime);
+   void              ReportFactor(uint64_t k);
+
+   DMDivisorApp     *ip_DMDivisorApp;
+
+   uint32_t          ii_N;
+   uint64_t          il_MinK;
+   uint64_t          il_MaxK;
+
+   // 2^n-1 as limbs for the Montgomery logic.  2^n-1 and 2^n for GMP.
+   uint32_t          ii_MpLimbCount;
+   mp_limb_t         im_MpLimbs[DMT_MAX_LIMBS];
+   mpz_t             im_Mp;
+   mpz_t             im_MpPlus1;
+   mpz_t             im_Two;
+
+   const std::vector<bool> *ip_Terms;
+
+   // This guards everything below it
+   SharedMemoryItem *ip_TesterLock;
+
+   uint64_t          il_UnitsPerClass;
+   uint64_t          il_NextUnit;
+   uint64_t          il_UnitsDone;
+
+   uint64_t          il_TermCount;
+   uint64_t          il_TermsTested;
+   uint32_t          ii_FactorsFound;
+
+   time_t            it_StartTime;
+   time_t            it_LastCheckPointTime;
+
+   FILE             *ip_FactorsFile;
+};
+
+#endif
+
@@ -20,92 +20,156 @@ DMDivisorWorker::DMDivisorWorker(uint32_t myId, App *theApp) : Worker(myId, theA
    il_MaxK = ip_DMDivisorApp->GetMaxK();
    ii_N = ip_DMDivisorApp->GetN();
    
+   ip_KSieve[0] = new KSegmentSieve(ip_DMDivisorApp->GetWheel(0));
+   ip_KSieve[1] = new KSegmentSieve(ip_DMDivisorApp->GetWheel(1));
+   
    // The thread can't start until initialization is done
    ib_Initialized = true;
 }
 
 void  DMDivisorWorker::CleanUp(void)
 {
+   delete ip_KSieve[0];
+   delete ip_KSieve[1];
 }
 
+// The first k is computed for 8 primes at a time.  Primes < kmax divide many terms so
+// they are added to the segmented sieves and applied at the end of the chunk.  Larger
+// primes divide at most one term.
 void  DMDivisorWorker::TestMegaPrimeChunk(void)
 {
-   uint64_t k1, k2, k3, k4;
-   uint64_t bs[4], ps[4];
+   uint64_t ks[WIDE_VECTOR_SIZE], ps[WIDE_VECTOR_SIZE];
    uint64_t maxPrime = ip_App->GetMaxPrime();
+   bool     smallPrimes = (il_PrimeList[0] < il_MaxK);
+   uint32_t lane;
 
 #if defined(USE_OPENCL) || defined(USE_METAL)
    uint64_t minGpuPrime = ip_App->GetMinGpuPrime();
 #endif
    
-   for (uint32_t pIdx=0; pIdx<ii_PrimesInList; pIdx+=4)
+   for (uint32_t pIdx=0; pIdx<ii_PrimesInList; pIdx+=WIDE_VECTOR_SIZE)
    {
-      ps[0] = il_PrimeList[pIdx+0];
-      ps[1] = il_PrimeList[pIdx+1];
-      ps[2] = il_PrimeList[pIdx+2];
-      ps[3] = il_PrimeList[pIdx+3];
-            
-      bs[0] = bs[1] = bs[2] = bs[3] = 2;
-      
-      MpArithVec mp(ps);
-      MpResVec   two = mp.nToRes(2);
-      MpResVec   res = mp.pow(two, ii_N);
-      
-      res = mp.resToN(res);
-
-      // Now bs = 2^exp-1 (mod p)
-      bs[0] = res[0] - 1;
-      bs[1] = res[1] - 1;
-      bs[2] = res[2] - 1;
-      bs[3] = res[3] - 1;
-      
-      // We are looking for k such that 2*k*bs+1 (mod p) = 0
-      k1 = InvMod64(bs[0], ps[0]);
-      k2 = InvMod64(bs[1], ps[1]);
-      k3 = InvMod64(bs[2], ps[2]);
-      k4 = InvMod64(bs[3], ps[3]);
-      
-      // 2*k*bs+1 = 0 (mod p) --> 2*k = -invbs (mod p)
-      
-      // Now ensure that invbs is positive
-      k1 = ps[0] - k1;
-      k2 = ps[1] - k2;
-      k3 = ps[2] - k3;
-      k4 = ps[3] - k4;
-      
-      // We need invbs to be even so that we can divide by 2
-      if (k1 & 1) k1 += ps[0];
-      if (k2 & 1) k2 += ps[1];
-      if (k3 & 1) k3 += ps[2];
-      if (k4 & 1) k4 += ps[3];
+      for (lane=0; lane<WIDE_VECTOR_SIZE; lane++)
+         ps[lane] = il_PrimeList[pIdx+lane];
       
-      k1 >>= 1;
-      k2 >>= 1;
-      k3 >>= 1;
-      k4 >>= 1;
+      ComputeFirstK(ps, ks);
       
-      // We have now solved for mink
-      if (k1 <= il_MaxK) RemoveTerms(ps[0], k1);
-      if (k2 <= il_MaxK) RemoveTerms(ps[1], k2);
-      if (k3 <= il_MaxK) RemoveTerms(ps[2], k3);
-      if (k4 <= il_MaxK) RemoveTerms(ps[3], k4);
+      if (smallPrimes)
+      {
+         for (lane=0; lane<WIDE_VECTOR_SIZE; lane++)
+            if (ks[lane] <= il_MaxK)
+               RemoveTermsSmallPrime(ps[lane], ks[lane]);
+         
+         // The pending primes are only tracked by the first sieve
+         ip_KSieve[0]->AddPendingPrimes(ps[WIDE_VECTOR_SIZE-1], WIDE_VECTOR_SIZE);
+      }
+      else
+      {
+         for (lane=0; lane<WIDE_VECTOR_SIZE; lane++)
+            if (ks[lane] <= il_MaxK)
+               RemoveTerms(ps[lane], ks[lane]);
 
-      SetLargestPrimeTested(ps[3], 4);
+         SetLargestPrimeTested(ps[WIDE_VECTOR_SIZE-1], WIDE_VECTOR_SIZE);
+      }
 
-      if (ps[3] >= maxPrime)
+      if (ps[WIDE_VECTOR_SIZE-1] >= maxPrime)
          break;
 
       if (ip_App->IsInterrupted())
          break;
       
 #if defined(USE_OPENCL) || defined(USE_METAL)
-      if (ps[3] >= minGpuPrime)
+      if (ps[WIDE_VECTOR_SIZE-1] >= minGpuPrime)
       {
          ip_App->SetRebuildNeeded();
          break;
       }
 #endif
    }
+   
+   if (smallPrimes)
+      ApplySmallPrimes();
+}
+
+// For each prime this sets k to the smallest k >= 0 such that 2*k*(2^n-1)+1 = 0 (mod p).
+// If p divides 2^n-1, then p does not divide any term, so k is set to UINT64_MAX.
+void  DMDivisorWorker::ComputeFirstK(const uint64_t *ps, uint64_t *ks)
+{
+   uint64_t bs[WIDE_VECTOR_SIZE], invs[WIDE_VECTOR_SIZE];
+   uint32_t lane;
+   
+   const MpArithVec8 mp(ps);
+   const MpResVec8   res = mp.resToN(mp.pow(mp.nToRes(2), ii_N));
+
+   // Now bs = 2^n-1 (mod p)
+   for (lane=0; lane<WIDE_VECTOR_SIZE; lane++)
+      bs[lane] = res[lane] - 1;
+   
+   InvertResidues(bs, ps, invs);
+   
+   // 2*k*bs+1 = 0 (mod p) --> 2*k = -1/bs (mod p).  -1/bs must be even
+   // so that we can divide by 2.  There are no branches in this loop so
+   // that the compiler can vectorize it.
+   for (lane=0; lane<WIDE_VECTOR_SIZE; lane++)
+   {
+      ks[lane] = ps[lane] - invs[lane];
+      ks[lane] += (ks[lane] & 1) * ps[lane];
+      ks[lane] >>= 1;
+   }
+   
+   for (lane=0; lane<WIDE_VECTOR_SIZE; lane++)
+      if (bs[lane] == 0)
+         ks[lane] = UINT64_MAX;
+}
+
+// Compute 1/bs (mod p) using the extended Euclidean algorithm.  Each step needs the result
+// of the division in the previous step, so one inverse at a time leaves the divider idle
+// most of the time.  Doing all lanes together keeps it busy.  Once the remainders fit into
+// 32 bits a 32-bit division is used because it is much faster than a 64-bit division on
+// most CPUs.  If bs = 0, then this returns 0.
+void  DMDivisorWorker::InvertResidues(const uint64_t *bs, const uint64_t *ps, uint64_t *invs)
+{
+   int64_t  t[WIDE_VECTOR_SIZE], nt[WIDE_VECTOR_SIZE], tt;
+   uint64_t r[WIDE_VECTOR_SIZE], nr[WIDE_VECTOR_SIZE], rr, q;
+   uint32_t lane;
+   bool     active = true;
+   
+   for (lane=0; lane<WIDE_VECTOR_SIZE; lane++)
+   {
+      t[lane] = 0;
+      nt[lane] = 1;
+      r[lane] = ps[lane];
+      nr[lane] = bs[lane];
+   }
+   
+   while (active)
+   {
+      active = false;
+      
+      for (lane=0; lane<WIDE_VECTOR_SIZE; lane++)
+      {
+         if (nr[lane] == 0)
+            continue;
+         
+         active = true;
+         
+         if (r[lane] >> 32)
+            q = r[lane] / nr[lane];
+         else
+            q = (uint32_t) r[lane] / (uint32_t) nr[lane];
+         
+         tt = t[lane] - (int64_t) q * nt[lane];
+         t[lane] = nt[lane];
+         nt[lane] = tt;
+         
+         rr = r[lane] - q * nr[lane];
+         r[lane] = nr[lane];
+         nr[lane] = rr;
+      }
+   }
+   
+   for (lane=0; lane<WIDE_VECTOR_SIZE; lane++)
+      invs[lane] = (t[lane] < 0 ? t[lane] + ps[lane] : t[lane]);
 }
 
 void  DMDivisorWorker::TestMiniPrimeChunk(uint64_t *miniPrimeChunk)
@@ -113,7 +177,7 @@ void  DMDivisorWorker::TestMiniPrimeChunk(uint64_t *miniPrimeChunk)
    FatalError("DMDivisorWorker::TestMiniPrimeChunk not implemented");
 }
 
-// This must be used when prime <= il_MaxK.
+// This is used when prime >= il_MaxK, so it divides at most one term.
 void    DMDivisorWorker::RemoveTerms(uint64_t prime, uint64_t k)
 {
    // Adjust so that k >= il_MinK
@@ -134,3 +198,47 @@ void    DMDivisorWorker::RemoveTerms(uint64_t prime, uint64_t k)
    
    ip_DMDivisorApp->ReportFactor(prime, k, true);
 }
+
+// This is used when prime < il_MaxK.  Only k = 0 (mod 4) and k = 1 (mod 4) can be terms,
+// so p divides the terms for every 4*p-th k in each of those classes.
+void    DMDivisorWorker::RemoveTermsSmallPrime(uint64_t prime, uint64_t k)
+{
+   uint64_t kForClass;
+   
+   // These primes are known to be factors of 2^(2^n-1)-1
+   if (ip_DMDivisorApp->IsKnownFactor(prime))
+      return;
+   
+   // Make sure that k >= il_MinK
+   if (k < il_MinK)
+      k += prime * ((il_MinK - k + prime - 1)/prime);
+   
+   for (uint32_t kClass=0; kClass<2; kClass++)
+   {
+      kForClass = k;
+      
+      // This moves k into this class and also into this shard's residue class
+      if (!ip_DMDivisorApp->GetWheel(kClass)->AlignK(prime, kForClass))
+         continue;
+   
+      if (kForClass > il_MaxK)
+         continue;
+      
+      ip_KSieve[kClass]->AddPrime(prime, kForClass, 0, kClass);
+   }
+}
+
+// The factors for the small primes are not applied until the end of the chunk,
+// so don't report them as tested until then.
+void  DMDivisorWorker::ApplySmallPrimes(void)
+{
+   if (ip_KSieve[0]->GetPendingPrimeCount() == 0)
+      return;
+   
+   ip_DMDivisorApp->ReportFactors(ip_KSieve);
+   
+   SetLargestPrimeTested(ip_KSieve[0]->GetLargestPendingPrime(), ip_KSieve[0]->GetPendingPrimeCount());
+   
+   ip_KSieve[0]->Clear();
+   ip_KSieve[1]->Clear();
+}
@@ -29,9 +29,17 @@ protected:
    void              NotifyPrimeListAllocated(uint32_t primesInList) {}
 
 private:
+   void              ComputeFirstK(const uint64_t *ps, uint64_t *ks);
+   void              InvertResidues(const uint64_t *bs, const uint64_t *ps, uint64_t *invs);
+   
    void              RemoveTerms(uint64_t prime, uint64_t k);
+   void              RemoveTermsSmallPrime(uint64_t prime, uint64_t k);
+   void              ApplySmallPrimes(void);
    
    DMDivisorApp     *ip_DMDivisorApp;
+   
+   // Index 0 is for k = 0 (mod 4) and index 1 is for k = 1 (mod 4)
+   KSegmentSieve    *ip_KSieve[2];
       
    uint64_t          il_MinK;
    uint64_t          il_MaxK;
@@ -14,12 +14,19 @@
 #include "../core/MpArith.h"
 #include "FixedBNCApp.h"
 #include "FixedBNCWorker.h"
+#include "FixedBNCPRPTester.h"
 
 #define APP_NAME        "fbncsieve"
-#define APP_VERSION     "1.7.1"
+#define APP_VERSION     "1.8"
 
-#define BIT_HK(k)       (((k) - il_MinK) >> 1)
-#define BIT_AK(k)       ((k) - il_MinK)
+
+// These are run by -0 (--selftest).  The factors were found with one worker.
+static const selftest_t selfTests[] = {
+   { "-k 3 -K 100000 -s k*2^1000+1 -P 1e6",    91861, 0x104aa694ac11f736ULL },
+   { "-k 3 -K 100000 -s k*2^1000+1 -P 1e6 -x", 33420, 0xfc3996ee49da1d21ULL },
+   { "-k 3 -K 100000 -s k*3^500-1 -P 1e6",     43918, 0x20e94b725452f851ULL },
+   { NULL, 0, 0 }
+};
 
 // This is declared in App.h, but implemented here.  This means that App.h
 // can remain unchanged if using the mtsieve framework for other applications.
@@ -32,18 +39,29 @@ FixedBNCApp::FixedBNCApp() : FactorApp()
 {
    SetBanner(APP_NAME " v" APP_VERSION ", a program to find factors of k*b^n+c numbers for fixed b, n, and c and variable k");
    SetLogFileName("fbncsieve.log");
+   SetSelfTests(selfTests);
 
    is_Sequence = "";
 
    il_MinK = 0;
    il_MaxK = 0;
+   ii_MaxN = 0;
+   ii_NCount = 1;
    it_Format = FF_ABCD;
    ib_Remove = false;
    ib_HalfK = false;
+   ib_UseWheel = false;
+   ip_Wheel = NULL;
 
    il_MaxPrimeForValidFactor = PMAX_MAX_62BIT;
 }
 
+FixedBNCApp::~FixedBNCApp(void)
+{
+   if (ip_Wheel != NULL)
+      delete ip_Wheel;
+}
+
 void FixedBNCApp::Help(void)
 {
    FactorApp::ParentHelp();
@@ -51,21 +69,27 @@ void FixedBNCApp::Help(void)
    printf("-k --kmin=k           Minimum k to search\n");
    printf("-K --kmax=K           Maximum k to search\n");
    printf("-s --sequence=s       Sequence to find factors of in form k*b^n+c where b, n, and c are integer values\n");
+   printf("-N --nmax=N           Maximum n to search, one output file per n\n");
    printf("-f --format=f         Format of output file (A=ABC, D=ABCD (default), N=NEWPGEN)\n");
    printf("-r --remove           Remove k where k %% base = 0\n");
+   printf("-x --wheel            Use a wheel to exclude k where 3, 5, 7, or 11 divides the term\n");
+   printf("-z --shard=i/m        Sieve only shard i of m (m is a power of 2)\n");
 }
 
 void  FixedBNCApp::AddCommandLineOptions(std::string &shortOpts, struct option *longOpts)
 {
    FactorApp::ParentAddCommandLineOptions(shortOpts, longOpts);
 
-   shortOpts += "rk:K:s:f:";
+   shortOpts += "rxk:K:N:s:f:z:";
 
    AppendLongOpt(longOpts, "kmin",           required_argument, 0, 'k');
    AppendLongOpt(longOpts, "kmax",           required_argument, 0, 'K');
    AppendLongOpt(longOpts, "sequence",       required_argument, 0, 's');
+   AppendLongOpt(longOpts, "nmax",           required_argument, 0, 'N');
    AppendLongOpt(longOpts, "format",         required_argument, 0, 'f');
    AppendLongOpt(longOpts, "remove",         no_argument, 0, 'r');
+   AppendLongOpt(longOpts, "wheel",          no_argument, 0, 'x');
+   AppendLongOpt(longOpts, "shard",          required_argument, 0, 'z');
 }
 
 parse_t FixedBNCApp::ParseOption(int opt, char *arg, const char *source)
@@ -85,6 +109,10 @@ parse_t FixedBNCApp::ParseOption(int opt, char *arg, const char *source)
          status = Parser::Parse(arg, 1, KMAX_MAX, il_MaxK);
          break;
 
+      case 'N':
+         status = Parser::Parse(arg, 1, NMAX_MAX, ii_MaxN);
+         break;
+
       case 'f':
          char value;
          status = Parser::Parse(arg, "ADN", value);
@@ -108,6 +136,15 @@ parse_t FixedBNCApp::ParseOption(int opt, char *arg, const char *source)
          ib_Remove = true;
          status = P_SUCCESS;
          break;
+
+      case 'x':
+         ib_UseWheel = true;
+         status = P_SUCCESS;
+         break;
+
+      case 'z':
+         status = ParseShardOption(arg);
+         break;
    }
 
    return status;
@@ -122,19 +159,20 @@ void FixedBNCApp::ValidateOptions(void)
 
    if (is_InputTermsFileName.length() > 0)
    {
+      if (ii_MaxN > 0)
+         FatalError("-N cannot be used with -i");
+
       ProcessInputTermsFile(false);
 
+      ii_MaxN = ii_N;
+
       // We only care about even k
       if (ii_Base & 1)
          ib_HalfK = true;
 
-      uint32_t termSize = (il_MaxK - il_MinK) + 1;
-
-      if (ib_HalfK)
-         termSize = (il_MaxK - il_MinK)/2 + 1;
+      CreateWheel();
 
-      iv_Terms.resize(termSize);
-      std::fill(iv_Terms.begin(), iv_Terms.end(), false);
+      iv_Terms.assign(1, std::vector<bool>(ip_Wheel->GetBitCount(), false));
 
       ProcessInputTermsFile(true);
    }
@@ -161,6 +199,14 @@ void FixedBNCApp::ValidateOptions(void)
       if (ii_N < 1)
          FatalError("n must be greater than 0");
 
+      if (ii_MaxN == 0)
+         ii_MaxN = ii_N;
+
+      if (ii_MaxN < ii_N)
+         FatalError("nmax must be greater than or equal to n");
+
+      ii_NCount = ii_MaxN - ii_N + 1;
+
       if (ii_C != 1 && ii_C != -1)
          FatalError("c must be -1 or +1");
 
@@ -178,13 +224,11 @@ void FixedBNCApp::ValidateOptions(void)
       if (ii_Base & 1)
          ib_HalfK = true;
 
-      il_TermCount = il_MaxK - il_MinK + 1;
+      CreateWheel();
 
-      if (ib_HalfK)
-         il_TermCount = (il_MaxK - il_MinK)/2 + 1;
+      il_TermCount = ip_Wheel->GetBitCount() * ii_NCount;
 
-      iv_Terms.resize(il_TermCount);
-      std::fill(iv_Terms.begin(), iv_Terms.end(), true);
+      iv_Terms.assign(ii_NCount, std::vector<bool>(ip_Wheel->GetBitCount(), true));
 
       if (ib_Remove)
       {
@@ -197,16 +241,26 @@ void FixedBNCApp::ValidateOptions(void)
          // Remvoe k that are divisible by the base
          for ( ; k<=il_MaxK; k+=adder)
          {
-            uint64_t bit = (ib_HalfK ? BIT_HK(k) : BIT_AK(k));
-            il_TermCount--;
-            iv_Terms[bit] = false;
+            uint64_t bit;
+
+            if (!ip_Wheel->GetBit(k, bit))
+               continue;
+
+            for (uint32_t nIdx=0; nIdx<ii_NCount; nIdx++)
+            {
+               il_TermCount--;
+               iv_Terms[nIdx][bit] = false;
+            }
          }
       }
    }
 
    if (is_OutputTermsFileName.length() == 0)
    {
-      if (it_Format == FF_NEWPGEN)
+      // With more than one n, _n<n> is added to the name of each file
+      if (ii_NCount > 1)
+         snprintf(fileName, sizeof(fileName), "k_b%u%+d.%s", ii_Base, ii_C, (it_Format == FF_NEWPGEN ? "npg" : "pfgw"));
+      else if (it_Format == FF_NEWPGEN)
          snprintf(fileName, sizeof(fileName), "k_b%u_n%u%+d.npg", ii_Base, ii_N, ii_C);
       else
          snprintf(fileName, sizeof(fileName), "k_b%u_n%u%+d.pfgw", ii_Base, ii_N, ii_C);
@@ -216,9 +270,17 @@ void FixedBNCApp::ValidateOptions(void)
 
    if (ii_Base == 2 && ii_N == 1 && ii_C == -1 && il_MinK == 1)
    {
+      uint64_t bit;
+
       WriteToConsole(COT_OTHER, "Changing mink to 2 because 1*2^1-1 = 1");
       il_MinK = 2;
-      il_TermCount--;
+
+      // k = 1 is not in the bitmap of every shard
+      if (ip_Wheel->GetBit(1, bit) && iv_Terms[0][bit])
+      {
+         il_TermCount--;
+         iv_Terms[0][bit] = false;
+      }
    }
 
    snprintf(fileName, sizeof(fileName), "k_b%u_n%u%+d.primes.txt", ii_Base, ii_N, ii_C);
@@ -226,6 +288,8 @@ void FixedBNCApp::ValidateOptions(void)
 
    ComputeBPowN();
 
+   ValidateShardOption();
+
    FactorApp::ParentValidateOptions();
 
    // Since the worker wants primes in groups of 4
@@ -257,6 +321,11 @@ Worker *FixedBNCApp::CreateWorker(uint32_t id, bool gpuWorker, uint64_t largestP
    return theWorker;
 }
 
+PRPTester *FixedBNCApp::CreatePRPTester(void)
+{
+   return new FixedBNCPRPTester(this, &iv_Terms);
+}
+
 void FixedBNCApp::ProcessInputTermsFile(bool haveBitMap)
 {
    FILE    *fPtr = fopen(is_InputTermsFileName.c_str(), "r");
@@ -283,8 +352,11 @@ void FixedBNCApp::ProcessInputTermsFile(bool haveBitMap)
 
       if (haveBitMap)
       {
-         iv_Terms[k-il_MinK] = true;
-         il_TermCount++;
+         if (ip_Wheel->GetBit(k, bit))
+         {
+            iv_Terms[0][bit] = true;
+            il_TermCount++;
+         }
       }
       else
          il_MinK = il_MaxK = k;
@@ -364,9 +436,12 @@ void FixedBNCApp::ProcessInputTermsFile(bool haveBitMap)
 
       if (haveBitMap)
       {
-         bit = (ib_HalfK ? BIT_HK(k) : BIT_AK(k));
-         iv_Terms[bit] = true;
-         il_TermCount++;
+         // Skip k that were excluded by the wheel
+         if (ip_Wheel->GetBit(k, bit))
+         {
+            iv_Terms[0][bit] = true;
+            il_TermCount++;
+         }
       }
       else
       {
@@ -384,6 +459,7 @@ void FixedBNCApp::ComputeBPowN(void)
    double    b = (double) ii_Base;
    double    bpown;
    double    mink = (double) il_MinK;
+   uint64_t  bPowN;
 
    // KMAX_MAX is the same as PMAX_MAX, 2^62.
    if (GetMaxPrime() == 0)
@@ -391,23 +467,68 @@ void FixedBNCApp::ComputeBPowN(void)
    else
       tooBig = (double) GetMaxPrime();
 
-   il_BPowN = 1;
+   iv_BPowN.assign(ii_NCount, 0);
+
+   bPowN = 1;
    bpown = 1.0;
 
-   for (uint32_t i=0; i<ii_N; i++)
+   for (uint32_t n=1; n<=ii_MaxN; n++)
    {
       bpown *= b;
-      il_BPowN *= ii_Base;
+      bPowN *= ii_Base;
 
       // If mink*b^n-1.0 > the max prime to sieve, then we don't need to worry about removing terms that are prime.
       if (mink*bpown-1.0 > tooBig)
-      {
-         il_BPowN = 0;
          return;
-      }
+
+      if (n >= ii_N)
+         iv_BPowN[n - ii_N] = bPowN;
    }
 }
 
+// This is called after kmin, kmax, and ib_HalfK are known.  Without -x the wheel
+// is empty and the bit for k is just its position in the range of k.
+void FixedBNCApp::CreateWheel(void)
+{
+   double   minTerm = (double) il_MinK * pow((double) ii_Base, (double) ii_N) + ii_C;
+   uint64_t minK = il_MinK;
+   uint32_t kShift = (ib_HalfK ? 1 : 0);
+   uint32_t idx, prime;
+
+   ApplyShardToK(minK, il_MaxK, kShift);
+
+   ip_Wheel = new KWheel(minK, il_MaxK, kShift);
+
+   if (!ib_UseWheel)
+      return;
+
+   // The k that are excluded depend upon n
+   if (ii_NCount > 1)
+   {
+      WriteToConsole(COT_OTHER, "Ignoring -x since it is not supported when using -N");
+      return;
+   }
+
+   // A term could be one of the primes in the wheel
+   if (minTerm <= (double) KW_MAX_PRIME)
+   {
+      WriteToConsole(COT_OTHER, "Ignoring -x since the smallest term is too small");
+      return;
+   }
+
+   for (idx=0; KWheel::GetPrime(idx) > 0; idx++)
+   {
+      prime = KWheel::GetPrime(idx);
+
+      ip_Wheel->ExcludeTerm(prime, KWheel::PowMod(ii_Base, ii_N, prime), ii_C);
+   }
+
+   ip_Wheel->Build();
+
+   WriteToConsole(COT_OTHER, "Wheel of size %u removed %" PRIu64" of %" PRIu64" k", ip_Wheel->GetModulus(),
+                  ip_Wheel->GetPositionCount() - ip_Wheel->GetBitCount(), ip_Wheel->GetPositionCount());
+}
+
 bool FixedBNCApp::ApplyFactor(uint64_t theFactor, const char *term)
 {
    uint64_t k;
@@ -420,8 +541,8 @@ bool FixedBNCApp::ApplyFactor(uint64_t theFactor, const char *term)
    if (b != ii_Base)
       FatalError("Expected base %u in factor but found base %u", ii_Base, b);
 
-   if (n != ii_N)
-      FatalError("Expected n %u in factor but found %d", ii_N, n);
+   if (n < ii_N || n > ii_MaxN)
+      FatalError("Expected n between %u and %u in factor but found %d", ii_N, ii_MaxN, n);
 
    if (c != ii_C)
       FatalError("Expected c %+d in factor but found %d", ii_C, c);
@@ -429,12 +550,15 @@ bool FixedBNCApp::ApplyFactor(uint64_t theFactor, const char *term)
    if (k < il_MinK || k > il_MaxK)
       return false;
 
-   uint64_t bit = k - il_MinK;
+   uint64_t bit;
+
+   if (!ip_Wheel->GetBit(k, bit))
+      return false;
 
    // No locking is needed because the Workers aren't running yet
-   if (iv_Terms[bit])
+   if (iv_Terms[n - ii_N][bit])
    {
-      iv_Terms[bit] = false;
+      iv_Terms[n - ii_N][bit] = false;
       il_TermCount--;
 
       return true;
@@ -443,144 +567,90 @@ bool FixedBNCApp::ApplyFactor(uint64_t theFactor, const char *term)
    return false;
 }
 
+// The terms are copied while holding the lock so that the workers are not
+// blocked while the files are formatted and written.
 void FixedBNCApp::WriteOutputTermsFile(uint64_t largestPrime)
 {
-   uint64_t termsCounted = 0;
-
-   FILE    *termsFile = fopen(is_OutputTermsFileName.c_str(), "w");
-
-   if (!termsFile)
-      FatalError("Unable to open output file %s", is_OutputTermsFileName.c_str());
+   std::vector<KTermsFileWriter *> writers;
+   uint64_t termsCounted = 0, expectedTerms;
 
    ip_FactorAppLock->Lock();
 
-   if (it_Format == FF_ABCD)
-      termsCounted = WriteABCDTermsFile(largestPrime, termsFile);
-
-   if (it_Format == FF_ABC)
-      termsCounted = WriteABCTermsFile(largestPrime, termsFile);
-
-   if (it_Format == FF_NEWPGEN)
-      termsCounted = WriteNewPGenTermsFile(largestPrime, termsFile);
-
-   fclose(termsFile);
+   for (uint32_t nIdx=0; nIdx<ii_NCount; nIdx++)
+      writers.push_back(CreateTermsFileWriter(nIdx));
 
-   if (termsCounted != il_TermCount)
-      FatalError("Something is wrong.  Counted terms (%" PRIu64") != expected terms (%" PRIu64")", termsCounted, il_TermCount);
+   expectedTerms = il_TermCount;
 
    ip_FactorAppLock->Release();
-}
 
-uint64_t FixedBNCApp::WriteABCDTermsFile(uint64_t maxPrime, FILE *termsFile)
-{
-   uint64_t k, kCount = 0, previousK;
-   uint64_t bit, adder;
-
-   k = il_MinK;
-
-   bit = (ib_HalfK ? BIT_HK(k) : BIT_AK(k));
-   adder = (ib_HalfK ? 2 : 1);
-
-   for (; k<=il_MaxK; k+=adder)
+   if (ii_NCount == 1)
+      termsCounted = WriteTermsFile(writers[0], largestPrime, 0, is_OutputTermsFileName.c_str());
+   else
    {
-      if (iv_Terms[bit])
-         break;
-
-      bit++;
+      for (uint32_t nIdx=0; nIdx<ii_NCount; nIdx++)
+         termsCounted += WriteTermsFile(writers[nIdx], largestPrime, nIdx, GetOutputTermsFileNameForN(ii_N + nIdx).c_str());
    }
 
-   if (k > il_MaxK)
-      return 0;
-
-   fprintf(termsFile, "ABCD $a*%u^%d%+d [%" PRIu64"] // Sieved to %" PRIu64"\n", ii_Base, ii_N, ii_C, k, maxPrime);
-
-   previousK = k;
-   kCount = 1;
-   k += adder;
+   for (uint32_t nIdx=0; nIdx<ii_NCount; nIdx++)
+      delete writers[nIdx];
 
-   bit = (ib_HalfK ? BIT_HK(k) : BIT_AK(k));
-
-   for (; k<=il_MaxK; k+=adder)
-   {
-      if (iv_Terms[bit])
-      {
-         fprintf(termsFile, "%" PRIu64"\n", k - previousK);
-         previousK = k;
-         kCount++;
-      }
-
-      bit++;
-   }
-
-   return kCount;
+   if (termsCounted != expectedTerms)
+      FatalError("Something is wrong.  Counted terms (%" PRIu64") != expected terms (%" PRIu64")", termsCounted, expectedTerms);
 }
 
-uint64_t FixedBNCApp::WriteABCTermsFile(uint64_t maxPrime, FILE *termsFile)
+KTermsFileWriter *FixedBNCApp::CreateTermsFileWriter(uint32_t nIdx)
 {
-   uint64_t k, kCount = 0;
-   uint64_t bit, adder;
-
-   fprintf(termsFile, "ABC $a*%u^%u%+d // Sieved to %" PRIu64"\n", ii_Base, ii_N, ii_C, maxPrime);
-
-   k = il_MinK;
+   KTermsFileWriter *writer = new KTermsFileWriter(ip_Wheel, GetCpuWorkerCount());
+   char     suffix[20];
 
-   bit = (ib_HalfK ? BIT_HK(k) : BIT_AK(k));
-   adder = (ib_HalfK ? 2 : 1);
-
-   for ( ; k<=il_MaxK; k+=adder)
-   {
-      if (iv_Terms[bit])
-      {
-         fprintf(termsFile, "%" PRIu64"\n", k);
-         kCount++;
-      }
+   // Each line of a NewPGen file has n after k
+   if (it_Format == FF_NEWPGEN)
+      snprintf(suffix, sizeof(suffix), " %u", ii_N + nIdx);
+   else
+      suffix[0] = 0;
 
-      bit++;
-   }
+   writer->AddBitmap(iv_Terms[nIdx], suffix);
 
-   return kCount;
+   return writer;
 }
 
-uint64_t FixedBNCApp::WriteNewPGenTermsFile(uint64_t maxPrime, FILE *termsFile)
+uint64_t FixedBNCApp::WriteTermsFile(KTermsFileWriter *writer, uint64_t maxPrime, uint32_t nIdx, const char *fileName)
 {
-   uint64_t k, kCount = 0;
-   uint64_t bit, adder;
-
-   fprintf(termsFile, "%" PRIu64":%c:1:%u:%u\n", maxPrime, (ii_C == 1 ? 'P' : 'M'), ii_Base, (ii_C == 1 ? 1 : 2));
-
-   k = il_MinK;
+   uint32_t n = ii_N + nIdx;
+   char     header[200], suffix[100];
 
-   bit = (ib_HalfK ? BIT_HK(k) : BIT_AK(k));
-   adder = (ib_HalfK ? 2 : 1);
-
-   for ( ; k<=il_MaxK; k+=adder)
+   if (it_Format == FF_ABCD)
    {
-      if (iv_Terms[bit])
-      {
-         fprintf(termsFile, "%" PRIu64" %u\n", k, ii_N);
-         kCount++;
-      }
+      snprintf(header, sizeof(header), "ABCD $a*%u^%d%+d ", ii_Base, n, ii_C);
+      snprintf(suffix, sizeof(suffix), " // Sieved to %" PRIu64"", maxPrime);
 
-      bit++;
+      return writer->WriteABCD(fileName, header, suffix);
    }
 
-   return kCount;
+   if (it_Format == FF_ABC)
+      snprintf(header, sizeof(header), "ABC $a*%u^%u%+d // Sieved to %" PRIu64"", ii_Base, n, ii_C, maxPrime);
+   else
+      snprintf(header, sizeof(header), "%" PRIu64":%c:1:%u:%u", maxPrime, (ii_C == 1 ? 'P' : 'M'), ii_Base, (ii_C == 1 ? 1 : 2));
+
+   return writer->WriteList(fileName, header);
 }
 
 void  FixedBNCApp::GetExtraTextForSieveStartedMessage(char *extraText, uint32_t maxTextLength)
 {
-   snprintf(extraText, maxTextLength, "%" PRIu64 " <= k <= %" PRIu64", k*%u^%u%+d", il_MinK, il_MaxK, ii_Base, ii_N, ii_C);
+   if (ii_NCount > 1)
+      snprintf(extraText, maxTextLength, "%" PRIu64 " <= k <= %" PRIu64", k*%u^n%+d, %u <= n <= %u", il_MinK, il_MaxK, ii_Base, ii_C, ii_N, ii_MaxN);
+   else
+      snprintf(extraText, maxTextLength, "%" PRIu64 " <= k <= %" PRIu64", k*%u^%u%+d", il_MinK, il_MaxK, ii_Base, ii_N, ii_C);
 }
 
-void  FixedBNCApp::ReportFactor(uint64_t theFactor, uint64_t k)
+void  FixedBNCApp::ReportFactor(uint64_t theFactor, uint64_t k, uint32_t nIdx)
 {
-   if (theFactor > il_MaxPrimeForValidFactor)
-      return;
+   uint32_t n = ii_N + nIdx;
 
-   if (k > il_MaxK)
+   if (!IsFactorInRange(theFactor, k))
       return;
 
-   VerifyFactor(theFactor, k);
+   VerifyFactor(theFactor, k, n);
 
    ip_FactorAppLock->Lock();
 
@@ -588,12 +658,12 @@ void  FixedBNCApp::ReportFactor(uint64_t theFactor, uint64_t k)
    {
       uint64_t termValue = 0;
 
-      if (il_BPowN > 0)
-         termValue = k * il_BPowN + ii_C;
+      if (iv_BPowN[nIdx] > 0)
+         termValue = k * iv_BPowN[nIdx] + ii_C;
 
-      uint64_t bit = (ib_HalfK ? BIT_HK(k) : BIT_AK(k));
+      uint64_t bit;
 
-      if (iv_Terms[bit])
+      if (ip_Wheel->GetBit(k, bit) && iv_Terms[nIdx][bit])
       {
          bool removeTerm = true;
 
@@ -604,40 +674,110 @@ void  FixedBNCApp::ReportFactor(uint64_t theFactor, uint64_t k)
             else
             {
                FILE *fPtr = fopen(is_PrimeFileName.c_str(), "a+");
-               fprintf(fPtr, "%" PRIu64"*%u^%u%+d = %" PRIu64"\n", k, ii_Base, ii_N, ii_C, theFactor);
+               fprintf(fPtr, "%" PRIu64"*%u^%u%+d = %" PRIu64"\n", k, ii_Base, n, ii_C, theFactor);
                fclose(fPtr);
             }
          }
          else
-            LogFactor(theFactor, "%" PRIu64"*%u^%u%+d", k, ii_Base, ii_N, ii_C);
+            LogFactor(theFactor, "%" PRIu64"*%u^%u%+d", k, ii_Base, n, ii_C);
 
          if (removeTerm)
          {
-            iv_Terms[bit] = false;
+            iv_Terms[nIdx][bit] = false;
             il_FactorCount++;
             il_TermCount--;
          }
       }
 
-      if (ib_HalfK)
-      {
-         // We only care about every other k
-         k += (theFactor << 1);
-      }
-      else
-         k += theFactor;
+      // This is the next k in the bitmap that p divides
+      k += (theFactor << ip_Wheel->GetKShift());
    } while (k <= il_MaxK);
 
    ip_FactorAppLock->Release();
 }
 
-void  FixedBNCApp::VerifyFactor(uint64_t theFactor, uint64_t k)
+// This is used for p <= il_MaxK.  The bitmap is sieved one segment at a time so that
+// other workers can report factors between segments.
+void  FixedBNCApp::ReportFactors(KSegmentSieve *kSieve)
+{
+   std::vector<std::vector<bool> *> bitmaps(ii_NCount);
+   std::vector<ksieve_entry_t>::const_iterator it;
+   const ksieve_entry_t *entry;
+   uint32_t idx, nIdx, segment;
+   uint64_t k, termValue, removed;
+
+   // The bitmap index is nIdx
+   for (nIdx=0; nIdx<ii_NCount; nIdx++)
+      bitmaps[nIdx] = &iv_Terms[nIdx];
+
+   // If the first term is valid, then the rest are valid.
+   for (idx=0; idx<kSieve->GetPrimeCount(); idx++)
+   {
+      entry = kSieve->GetPrime(idx);
+
+      VerifyFactor(entry->prime, kSieve->GetPrimeK(idx), ii_N + entry->bitmapIdx);
+   }
+
+   for (segment=0; segment<kSieve->GetSegmentCount(); segment++)
+   {
+      if (!kSieve->HasSegmentPrimes(segment))
+         continue;
+
+      ip_FactorAppLock->Lock();
+
+      kSieve->SieveSegment(segment, &bitmaps[0]);
+
+      const std::vector<ksieve_entry_t> &hits = kSieve->GetHits();
+
+      removed = 0;
+
+      StartFactorBatch();
+
+      for (it=hits.begin(); it!=hits.end(); it++)
+      {
+         k = kSieve->GetK(it->bit);
+         nIdx = it->bitmapIdx;
+
+         termValue = 0;
+
+         if (iv_BPowN[nIdx] > 0)
+            termValue = k * iv_BPowN[nIdx] + ii_C;
+
+         if (termValue == it->prime)
+         {
+            // The term is prime so put it back into the bitmap
+            if (il_MaxPrimeForValidFactor != PMAX_MAX_62BIT)
+            {
+               iv_Terms[nIdx][it->bit] = true;
+               continue;
+            }
+
+            FILE *fPtr = fopen(is_PrimeFileName.c_str(), "a+");
+            fprintf(fPtr, "%" PRIu64"*%u^%u%+d = %" PRIu64"\n", k, ii_Base, ii_N + nIdx, ii_C, it->prime);
+            fclose(fPtr);
+         }
+         else
+            LogFactor(it->prime, "%" PRIu64"*%u^%u%+d", k, ii_Base, ii_N + nIdx, ii_C);
+
+         removed++;
+      }
+
+      EndFactorBatch();
+
+      il_FactorCount += removed;
+      il_TermCount -= removed;
+
+      ip_FactorAppLock->Release();
+   }
+}
+
+void  FixedBNCApp::VerifyFactor(uint64_t theFactor, uint64_t k, uint32_t n)
 {
    MpArith  mp(theFactor);
    MpRes    pOne = mp.one();
    MpRes    resRem = pOne;
 
-   resRem = mp.pow(mp.nToRes(ii_Base), ii_N);
+   resRem = mp.pow(mp.nToRes(ii_Base), n);
    resRem = mp.mul(resRem, mp.nToRes(k));
 
    if (ii_C == +1)
@@ -648,10 +788,10 @@ void  FixedBNCApp::VerifyFactor(uint64_t theFactor, uint64_t k)
    if (resRem == mp.zero())
       return;
 
-   FatalError("Invalid factor: %" PRIu64" is not a factor of %" PRIu64"*%u^%u%+d", theFactor, k, ii_Base, ii_N, ii_C);
+   FatalError("Invalid factor: %" PRIu64" is not a factor of %" PRIu64"*%u^%u%+d", theFactor, k, ii_Base, n, ii_C);
 }
 
-// Don't sieve beyond sqrt(maxk*b^n+c).  The worker will not
+// Don't sieve beyond sqrt(maxk*b^maxn+c).  The worker will not
 // remove terms that are prime, so this means that all remaining
 // terms will be prime when we reach p = sqrt(maxk*b^n+c).
 void  FixedBNCApp::AdjustMaxPrime(void)
@@ -665,7 +805,7 @@ void  FixedBNCApp::AdjustMaxPrime(void)
 
    toobig *= toobig;
 
-   for (uint32_t i=0; i<ii_N; i++)
+   for (uint32_t i=0; i<ii_MaxN; i++)
    {
       bpown *= b;
 
@@ -12,6 +12,8 @@
 #define _FixedBNCApp_H
 
 #include "../core/FactorApp.h"
+#include "../core/KSegmentSieve.h"
+#include "../core/TermsFileWriter.h"
 
 #define KMAX_MAX (UINT64_C(1)<<62)
 #define NMAX_MAX (1 << 31)
@@ -23,7 +25,7 @@ class FixedBNCApp : public FactorApp
 public:
    FixedBNCApp(void);
 
-   ~FixedBNCApp(void) {};
+   ~FixedBNCApp(void);
 
    void              Help(void);
    void              AddCommandLineOptions(std::string &shortOpts, struct option *longOpts);
@@ -36,9 +38,15 @@ public:
    uint64_t          GetMaxK(void) { return il_MaxK; };
    uint32_t          GetBase(void) { return ii_Base; };
    uint32_t          GetN(void) { return ii_N; };
+   uint32_t          GetNCount(void) { return ii_NCount; };
    int32_t           GetC(void) { return ii_C; };
+   bool              IsHalfK(void) { return ib_HalfK; };
+   KWheel           *GetWheel(void) { return ip_Wheel; };
 
-   void              ReportFactor(uint64_t theFactor, uint64_t k);
+   // This also moves k to the first k in the bitmap that theFactor divides
+   bool              IsFactorInRange(uint64_t theFactor, uint64_t &k) { return (theFactor <= il_MaxPrimeForValidFactor && ip_Wheel->AlignK(theFactor, k)); };
+   void              ReportFactor(uint64_t theFactor, uint64_t k, uint32_t nIdx);
+   void              ReportFactors(KSegmentSieve *kSieve);
 
 protected:
    void              PreSieveHook(void) {};
@@ -52,16 +60,19 @@ protected:
    void              OuptutAdditionalConsoleMessagesUponFinish(void) {};
 
    Worker           *CreateWorker(uint32_t id, bool gpuWorker, uint64_t largestPrimeTested);
+   bool              SupportsPRPTest(void) { return true; };
+   PRPTester        *CreatePRPTester(void);
 
 private:
    void              ComputeBPowN(void);
-   uint64_t          WriteABCDTermsFile(uint64_t maxPrime, FILE *termsFile);
-   uint64_t          WriteABCTermsFile(uint64_t maxPrime, FILE *termsFile);
-   uint64_t          WriteNewPGenTermsFile(uint64_t maxPrime, FILE *termsFile);
+   void              CreateWheel(void);
+   KTermsFileWriter *CreateTermsFileWriter(uint32_t nIdx);
+   uint64_t          WriteTermsFile(KTermsFileWriter *writer, uint64_t maxPrime, uint32_t nIdx, const char *fileName);
    void              AdjustMaxPrime(void);
-   void              VerifyFactor(uint64_t theFactor, uint64_t k);
+   void              VerifyFactor(uint64_t theFactor, uint64_t k, uint32_t n);
 
-   std::vector<bool> iv_Terms;
+   // There is one bitmap for each n from ii_N to ii_MaxN
+   std::vector<std::vector<bool>> iv_Terms;
 
    std::string       is_Sequence;
    std::string       is_InputFileName;
@@ -74,11 +85,17 @@ private:
    uint64_t          il_MaxK;
    uint32_t          ii_Base;
    uint32_t          ii_N;
+   uint32_t          ii_MaxN;
+   uint32_t          ii_NCount;
    int32_t           ii_C;
    bool              ib_Remove;
    bool              ib_HalfK;
+   bool              ib_UseWheel;
 
-   uint64_t          il_BPowN;
+   KWheel           *ip_Wheel;
+
+   // b^n for each n or 0 if k*b^n+c is larger than the largest prime to be sieved
+   std::vector<uint64_t> iv_BPowN;
 };
 
 #endif
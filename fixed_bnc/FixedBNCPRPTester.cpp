@@ -0,0 +1,119 @@
+/* FixedBNCPRPTester.cpp -- (C) Mark Rodenkirch, October 2026
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+*/
+
+#include <cinttypes>
+#include "FixedBNCPRPTester.h"
+#include "FixedBNCApp.h"
+
+FixedBNCPRPTester::FixedBNCPRPTester(FixedBNCApp *theApp, const std::vector<std::vector<bool>> *terms) : PRPTester(theApp)
+{
+   ip_Terms = terms;
+   ip_Wheel = theApp->GetWheel();
+
+   ii_Base = theApp->GetBase();
+   ii_N = theApp->GetN();
+   ii_NCount = theApp->GetNCount();
+   ii_C = theApp->GetC();
+
+   ii_BPowNIdx = 0;
+   mpz_init(im_BPowN);
+   mpz_ui_pow_ui(im_BPowN, ii_Base, ii_N);
+
+   ii_NextNIdx = 0;
+   il_NextBit = 0;
+}
+
+FixedBNCPRPTester::~FixedBNCPRPTester(void)
+{
+   mpz_clear(im_BPowN);
+}
+
+// Each benchmark term is the first remaining term after an evenly spaced bit of an
+// evenly spaced n.  If there is none, the k for that bit is used since only the size
+// of the term matters.
+bool  FixedBNCPRPTester::GetBenchmarkTerm(uint32_t termIdx, mpz_t term)
+{
+   uint32_t nIdx = (uint32_t) (((uint64_t) termIdx * ii_NCount) / PRP_BENCHMARK_TERMS);
+   uint64_t bitCount = (*ip_Terms)[nIdx].size();
+   uint64_t bit, startBit;
+
+   if (bitCount == 0)
+      return false;
+
+   startBit = ((2 * (uint64_t) termIdx + 1) * bitCount) / (2 * PRP_BENCHMARK_TERMS);
+
+   for (bit=startBit; bit<bitCount; bit++)
+      if ((*ip_Terms)[nIdx][bit])
+         break;
+
+   if (bit == bitCount)
+      bit = startBit;
+
+   BuildTerm(ip_Wheel->GetK(bit), nIdx, term);
+
+   return true;
+}
+
+bool  FixedBNCPRPTester::GetNextTerm(bool first, mpz_t term, char *termText)
+{
+   uint64_t k;
+
+   if (first)
+   {
+      ii_NextNIdx = 0;
+      il_NextBit = 0;
+   }
+
+   for ( ; ii_NextNIdx<ii_NCount; ii_NextNIdx++, il_NextBit=0)
+   {
+      const std::vector<bool> &terms = (*ip_Terms)[ii_NextNIdx];
+
+      for ( ; il_NextBit<terms.size(); il_NextBit++)
+      {
+         if (!terms[il_NextBit])
+            continue;
+
+         k = ip_Wheel->GetK(il_NextBit);
+
+         BuildTerm(k, ii_NextNIdx, term);
+
+         snprintf(termText, PRP_TERM_TEXT_LENGTH, "%" PRIu64"*%u^%u%+d", k, ii_Base, ii_N + ii_NextNIdx, ii_C);
+
+         il_NextBit++;
+         return true;
+      }
+   }
+
+   return false;
+}
+
+void  FixedBNCPRPTester::BuildTerm(uint64_t k, uint32_t nIdx, mpz_t term)
+{
+   if (nIdx != ii_BPowNIdx)
+   {
+      mpz_ui_pow_ui(im_BPowN, ii_Base, ii_N + nIdx);
+      ii_BPowNIdx = nIdx;
+   }
+
+#ifdef WIN32
+   // Even though built with 64-bit limbs, mpz_set_ui doesn't
+   // populate term correctly when k > 32 bits.
+   mpz_set_ui(term, k >> 32);
+   mpz_mul_2exp(term, term, 32);
+   mpz_add_ui(term, term, k & (0xffffffff));
+#else
+   mpz_set_ui(term, k);
+#endif
+
+   mpz_mul(term, term, im_BPowN);
+
+   if (ii_C > 0)
+      mpz_add_ui(term, term, ii_C);
+   else
+      mpz_sub_ui(term, term, -ii_C);
+}
@@ -0,0 +1,52 @@
+/* FixedBNCPRPTester.h -- (C) Mark Rodenkirch, October 2026
+
+   This gives the remaining terms k*b^n+c to the PRPTester for -7 and -8.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+*/
+
+#ifndef _FixedBNCPRPTester_H
+#define _FixedBNCPRPTester_H
+
+#include <vector>
+#include "../core/PRPTester.h"
+#include "../core/KWheel.h"
+
+class FixedBNCApp;
+
+class FixedBNCPRPTester : public PRPTester
+{
+public:
+   FixedBNCPRPTester(FixedBNCApp *theApp, const std::vector<std::vector<bool>> *terms);
+
+   ~FixedBNCPRPTester(void);
+
+protected:
+   bool              GetBenchmarkTerm(uint32_t termIdx, mpz_t term);
+   bool              GetNextTerm(bool first, mpz_t term, char *termText);
+
+private:
+   void              BuildTerm(uint64_t k, uint32_t nIdx, mpz_t term);
+
+   const std::vector<std::vector<bool>> *ip_Terms;
+   KWheel           *ip_Wheel;
+
+   uint32_t          ii_Base;
+   uint32_t          ii_N;
+   uint32_t          ii_NCount;
+   int32_t           ii_C;
+
+   // b^n for the n of the last term that was built
+   uint32_t          ii_BPowNIdx;
+   mpz_t             im_BPowN;
+
+   // The position of the next term for GetNextTerm()
+   uint32_t          ii_NextNIdx;
+   uint64_t          il_NextBit;
+};
+
+#endif
+
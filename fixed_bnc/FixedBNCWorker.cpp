@@ -10,6 +10,7 @@
 #include <stdint.h>
 
 #include "FixedBNCWorker.h"
+#include "../core/MpArithVector.h"
 #include "../x86_asm/fpu-asm-x86.h"
 
 FixedBNCWorker::FixedBNCWorker(uint32_t myId, App *theApp) : Worker(myId, theApp)
@@ -20,24 +21,34 @@ FixedBNCWorker::FixedBNCWorker(uint32_t myId, App *theApp) : Worker(myId, theApp
    il_MaxK = ip_FixedBNCApp->GetMaxK();
    ii_Base = ip_FixedBNCApp->GetBase();
    ii_N = ip_FixedBNCApp->GetN();
+   ii_NCount = ip_FixedBNCApp->GetNCount();
    ii_C = ip_FixedBNCApp->GetC();
 
+   ip_KSieve = new KSegmentSieve(ip_FixedBNCApp->GetWheel());
 
    ii_BaseInverses = NULL;
    il_MyPrimeList = NULL;
    ii_InverseList = NULL;
+   ip_PowerChain = NULL;
 
    // This limit comes from newpgen, but is not documented why it exists.
    // I do know that larger bases yield incorrect factors if we use the wrong logic.
    if (ii_Base < 255256)
+   {
       BuildBaseInverses();
 
+      // n is the same for every prime so the chain for (1/b)^n is only built once
+      ip_PowerChain = new MpPowerChain(ii_N);
+   }
+
    // The thread can't start until initialization is done
    ib_Initialized = true;
 }
 
 void  FixedBNCWorker::CleanUp(void)
 {
+   delete ip_KSieve;
+
    if (il_MyPrimeList != NULL)
    {
       xfree(il_MyPrimeList);
@@ -46,6 +57,9 @@ void  FixedBNCWorker::CleanUp(void)
 
    if (ii_BaseInverses != NULL)
       xfree(ii_BaseInverses);
+
+   if (ip_PowerChain != NULL)
+      delete ip_PowerChain;
 }
 
 void  FixedBNCWorker::NotifyPrimeListAllocated(uint32_t primesInList)
@@ -79,7 +93,7 @@ void  FixedBNCWorker::TestMiniPrimeChunk(uint64_t *miniPrimeChunk)
 void    FixedBNCWorker::TestSmallB(void)
 {
    uint64_t p1 = 0, p2, p3, p4;
-   uint64_t k1, k2, k3, k4, ks[4];
+   uint64_t ks[4], invB[4];
    uint64_t maxPrime = ip_App->GetMaxPrime();
    int32_t  svb = 0;
    int32_t  pmb, count, idx;
@@ -126,49 +140,38 @@ void    FixedBNCWorker::TestSmallB(void)
       p3 = il_MyPrimeList[idx+2];
       p4 = il_MyPrimeList[idx+3];
 
-      ks[0] = k1 = (1+ii_InverseList[idx+0]*p1)/ii_Base;
-      ks[1] = k2 = (1+ii_InverseList[idx+1]*p2)/ii_Base;
-      ks[2] = k3 = (1+ii_InverseList[idx+2]*p3)/ii_Base;
-      ks[3] = k4 = (1+ii_InverseList[idx+3]*p4)/ii_Base;
+      // Apply the factors for the small primes before any larger prime can remove a term
+      if (p1 > il_MaxK)
+         ApplySmallPrimes();
+
+      invB[0] = ks[0] = (1+ii_InverseList[idx+0]*p1)/ii_Base;
+      invB[1] = ks[1] = (1+ii_InverseList[idx+1]*p2)/ii_Base;
+      invB[2] = ks[2] = (1+ii_InverseList[idx+2]*p3)/ii_Base;
+      invB[3] = ks[3] = (1+ii_InverseList[idx+3]*p4)/ii_Base;
 
       // Starting with k*2^n = 1 (mod p)
       //           --> k = (1/2)^n (mod p)
       //           --> k = inverse^n (mod p)
-      fpu_powmod_4b_1n_4p(ks, ii_N, &il_MyPrimeList[idx+0]);
+      MpArithVec mp(&il_MyPrimeList[idx+0]);
+      MpResVec   resK = mp.resToN(ip_PowerChain->pow(mp, mp.nToRes(ks)));
 
-      if (ii_C == +1)
-      {
-         k1 = p1 - ks[0];
-         k2 = p2 - ks[1];
-         k3 = p3 - ks[2];
-         k4 = p4 - ks[3];
-      }
-      else
-      {
-         k1 = ks[0];
-         k2 = ks[1];
-         k3 = ks[2];
-         k4 = ks[3];
-      }
+      ks[0] = resK[0];
+      ks[1] = resK[1];
+      ks[2] = resK[2];
+      ks[3] = resK[3];
+
+      RemoveTermsForEachN(&il_MyPrimeList[idx+0], ks, invB);
 
       if (p1 <= il_MaxK)
-      {
-         if (k1 <= il_MaxK) RemoveTermsSmallPrime(p1, k1);
-         if (k2 <= il_MaxK) RemoveTermsSmallPrime(p2, k2);
-         if (k3 <= il_MaxK) RemoveTermsSmallPrime(p3, k3);
-         if (k4 <= il_MaxK) RemoveTermsSmallPrime(p4, k4);
-      }
+         ip_KSieve->AddPendingPrimes(p4, 4);
       else
       {
-         if (k1 <= il_MaxK) RemoveTermsBigPrime(p1, k1);
-         if (k2 <= il_MaxK) RemoveTermsBigPrime(p2, k2);
-         if (k3 <= il_MaxK) RemoveTermsBigPrime(p3, k3);
-         if (k4 <= il_MaxK) RemoveTermsBigPrime(p4, k4);
+         SetLargestPrimeTested(p4, 4);
       }
-
-      SetLargestPrimeTested(p4, 4);
    }
 
+   ApplySmallPrimes();
+
    // Adjust for the possibility that we tested the same prime
    // more than once at the end of the list.
    if (p4 == p3)
@@ -181,7 +184,7 @@ void    FixedBNCWorker::TestSmallB(void)
 
 void    FixedBNCWorker::TestLargeB(void)
 {
-   uint64_t ks[4], ps[4];
+   uint64_t ks[4], ps[4], invB[4];
 
    for (uint32_t pIdx=0; pIdx<ii_PrimesInList; pIdx+=4)
    {
@@ -190,43 +193,115 @@ void    FixedBNCWorker::TestLargeB(void)
       ps[2] = il_PrimeList[pIdx+2];
       ps[3] = il_PrimeList[pIdx+3];
 
-      ks[0] = InvMod32(ii_Base, ps[0]);
-      ks[1] = InvMod32(ii_Base, ps[1]);
-      ks[2] = InvMod32(ii_Base, ps[2]);
-      ks[3] = InvMod32(ii_Base, ps[3]);
+      // Apply the factors for the small primes before any larger prime can remove a term
+      if (ps[0] > il_MaxK)
+         ApplySmallPrimes();
+
+      invB[0] = ks[0] = InvMod32(ii_Base, ps[0]);
+      invB[1] = ks[1] = InvMod32(ii_Base, ps[1]);
+      invB[2] = ks[2] = InvMod32(ii_Base, ps[2]);
+      invB[3] = ks[3] = InvMod32(ii_Base, ps[3]);
 
       // ks = (1/b)^n (mod p)
       fpu_powmod_4b_1n_4p(ks, ii_N, ps);
 
-      if (ii_C == +1)
-      {
-         ks[0] = ps[0] - ks[0];
-         ks[1] = ps[1] - ks[1];
-         ks[2] = ps[2] - ks[2];
-         ks[3] = ps[3] - ks[3];
-      }
+      RemoveTermsForEachN(ps, ks, invB);
 
       if (ps[0] <= il_MaxK)
-      {
-         if (ks[0] <= il_MaxK) RemoveTermsSmallPrime(ps[0], ks[0]);
-         if (ks[1] <= il_MaxK) RemoveTermsSmallPrime(ps[1], ks[1]);
-         if (ks[2] <= il_MaxK) RemoveTermsSmallPrime(ps[2], ks[2]);
-         if (ks[3] <= il_MaxK) RemoveTermsSmallPrime(ps[3], ks[3]);
-      }
+         ip_KSieve->AddPendingPrimes(ps[3], 4);
       else
       {
-         if (ks[0] <= il_MaxK) RemoveTermsBigPrime(ps[0], ks[0]);
-         if (ks[1] <= il_MaxK) RemoveTermsBigPrime(ps[1], ks[1]);
-         if (ks[2] <= il_MaxK) RemoveTermsBigPrime(ps[2], ks[2]);
-         if (ks[3] <= il_MaxK) RemoveTermsBigPrime(ps[3], ks[3]);
+         SetLargestPrimeTested(ps[3], 4);
       }
+   }
+
+   ApplySmallPrimes();
+}
+
+// ks = (1/b)^n (mod p) for the first n.  Each subsequent n only needs one more
+// multiplication by 1/b (mod p).
+void  FixedBNCWorker::RemoveTermsForEachN(uint64_t *ps, uint64_t *ks, uint64_t *invB)
+{
+   RemoveTerms(ps, ks, 0);
+
+   if (ii_NCount == 1)
+      return;
 
-      SetLargestPrimeTested(ps[3], 4);
+   MpArithVec mp(ps);
+
+   // Multiplying a number by a residue in Montgomery form yields a number
+   MpResVec   resInvB = mp.nToRes(invB);
+   MpResVec   resK;
+
+   resK[0] = ks[0];
+   resK[1] = ks[1];
+   resK[2] = ks[2];
+   resK[3] = ks[3];
+
+   for (uint32_t nIdx=1; nIdx<ii_NCount; nIdx++)
+   {
+      resK = mp.mul(resK, resInvB);
+
+      ks[0] = resK[0];
+      ks[1] = resK[1];
+      ks[2] = resK[2];
+      ks[3] = resK[3];
+
+      RemoveTerms(ps, ks, nIdx);
+   }
+}
+
+void  FixedBNCWorker::RemoveTerms(uint64_t *ps, uint64_t *ks, uint32_t nIdx)
+{
+   uint64_t k1, k2, k3, k4;
+
+   if (ii_C == +1)
+   {
+      k1 = ps[0] - ks[0];
+      k2 = ps[1] - ks[1];
+      k3 = ps[2] - ks[2];
+      k4 = ps[3] - ks[3];
+   }
+   else
+   {
+      k1 = ks[0];
+      k2 = ks[1];
+      k3 = ks[2];
+      k4 = ks[3];
+   }
+
+   if (ps[0] <= il_MaxK)
+   {
+      if (k1 <= il_MaxK) RemoveTermsSmallPrime(ps[0], k1, nIdx);
+      if (k2 <= il_MaxK) RemoveTermsSmallPrime(ps[1], k2, nIdx);
+      if (k3 <= il_MaxK) RemoveTermsSmallPrime(ps[2], k3, nIdx);
+      if (k4 <= il_MaxK) RemoveTermsSmallPrime(ps[3], k4, nIdx);
+   }
+   else
+   {
+      if (k1 <= il_MaxK) RemoveTermsBigPrime(ps[0], k1, nIdx);
+      if (k2 <= il_MaxK) RemoveTermsBigPrime(ps[1], k2, nIdx);
+      if (k3 <= il_MaxK) RemoveTermsBigPrime(ps[2], k3, nIdx);
+      if (k4 <= il_MaxK) RemoveTermsBigPrime(ps[3], k4, nIdx);
    }
 }
 
+// The factors for the small primes are not applied until the end of the chunk,
+// so don't report them as tested until then.
+void  FixedBNCWorker::ApplySmallPrimes(void)
+{
+   if (ip_KSieve->GetPendingPrimeCount() == 0)
+      return;
+
+   ip_FixedBNCApp->ReportFactors(ip_KSieve);
+
+   SetLargestPrimeTested(ip_KSieve->GetLargestPendingPrime(), ip_KSieve->GetPendingPrimeCount());
+
+   ip_KSieve->Clear();
+}
+
 // This must be used when prime <= il_MaxK.
-void    FixedBNCWorker::RemoveTermsSmallPrime(uint64_t prime, uint64_t k)
+void    FixedBNCWorker::RemoveTermsSmallPrime(uint64_t prime, uint64_t k, uint32_t nIdx)
 {
    // This primes will yield no factor because b^n = 0 (mod p)
    if (ii_Base % prime == 0)
@@ -248,14 +323,14 @@ void    FixedBNCWorker::RemoveTermsSmallPrime(uint64_t prime, uint64_t k)
    if ((ii_Base & 1) && (k & 1))
       k += prime;
 
-   if (k > il_MaxK)
+   if (!ip_FixedBNCApp->IsFactorInRange(prime, k))
       return;
 
-   ip_FixedBNCApp->ReportFactor(prime, k);
+   ip_KSieve->AddPrime(prime, k, nIdx, 0);
 }
 
 // Using this bypasses a number of if checks that can be done when prime > il_MaxK.
-void    FixedBNCWorker::RemoveTermsBigPrime(uint64_t prime, uint64_t k)
+void    FixedBNCWorker::RemoveTermsBigPrime(uint64_t prime, uint64_t k, uint32_t nIdx)
 {
    // If the base is odd, then we want k to start with even k
    if ((ii_Base & 1) && (k & 1))
@@ -265,7 +340,7 @@ void    FixedBNCWorker::RemoveTermsBigPrime(uint64_t prime, uint64_t k)
    if (k < il_MinK)
       return;
 
-   ip_FixedBNCApp->ReportFactor(prime, k);
+   ip_FixedBNCApp->ReportFactor(prime, k, nIdx);
 }
 
 void    FixedBNCWorker::BuildBaseInverses(void)
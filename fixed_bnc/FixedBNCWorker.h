@@ -11,6 +11,7 @@
 
 #include "FixedBNCApp.h"
 #include "../core/Worker.h"
+#include "../core/MpPowerChain.h"
 
 using namespace std;
 
@@ -32,24 +33,30 @@ private:
    void              TestSmallB(void);
    void              TestLargeB(void);
 
-   void              RemoveTermsSmallPrime(uint64_t prime, uint64_t k);
-   void              RemoveTermsBigPrime(uint64_t prime, uint64_t k);
+   void              RemoveTermsForEachN(uint64_t *ps, uint64_t *ks, uint64_t *invB);
+   void              RemoveTerms(uint64_t *ps, uint64_t *ks, uint32_t nIdx);
+   void              RemoveTermsSmallPrime(uint64_t prime, uint64_t k, uint32_t nIdx);
+   void              RemoveTermsBigPrime(uint64_t prime, uint64_t k, uint32_t nIdx);
+   void              ApplySmallPrimes(void);
    void              VerifyFactor(uint64_t prime, uint64_t k, uint64_t bPowNModP);
 
    void              BuildBaseInverses(void);
    uint32_t          EuclidExtendedGCD(uint32_t a, uint32_t base);
 
    FixedBNCApp      *ip_FixedBNCApp;
+   KSegmentSieve    *ip_KSieve;
 
    uint32_t         *ii_BaseInverses;
    uint64_t         *il_MyPrimeList;
    uint32_t         *ii_InverseList;
+   MpPowerChain     *ip_PowerChain;
 
    uint64_t          il_BpowN;
    uint64_t          il_MinK;
    uint64_t          il_MaxK;
    uint32_t          ii_Base;
    uint32_t          ii_N;
+   uint32_t          ii_NCount;
    int32_t           ii_C;
 };
 
@@ -18,6 +18,13 @@
 #define APP_NAME        "fkbnsieve"
 #define APP_VERSION     "1.6.4"
 
+// These are run by -0 (--selftest).  The factors were found with one worker.
+static const selftest_t selfTests[] = {
+   { "-c -1000 -C 1000 -s 1*2^1000+c -P 1e6", 1839, 0xb80ff05ca5996147ULL },
+   { "-c -2000 -C 2000 -s 3*10^300+c -P 1e6", 3679, 0xad100f97178fde4eULL },
+   { NULL, 0, 0 }
+};
+
 // This is declared in App.h, but implemented here.  This means that App.h
 // can remain unchanged if using the mtsieve framework for other applications.
 App *get_app(void)
@@ -29,6 +36,7 @@ FixedKBNApp::FixedKBNApp() : FactorApp()
 {
    SetBanner(APP_NAME " v" APP_VERSION ", a program to find factors of k*b^n+c numbers for fixed k, b, and n and variable c");
    SetLogFileName("fkbnsieve.log");
+   SetSelfTests(selfTests);
 
    SetAppMinPrime(3);
    is_Sequence = "";
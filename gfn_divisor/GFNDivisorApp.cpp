@@ -17,7 +17,7 @@
 #include "GFNDivisorApp.h"
 #include "GFNDivisorWorker.h"
 
-#define APP_VERSION     "2.4.1"
+#define APP_VERSION     "2.5.0"
 
 #if defined(USE_OPENCL) || defined(USE_METAL)
 #include "GFNDivisorGpuWorker.h"
@@ -59,6 +59,13 @@ dmd_t  gfndList[] = {
    {      0,  0,     0,    0}
 };
 
+// These are run by -0 (--selftest).  The factors were found with one worker.
+static const selftest_t selfTests[] = {
+   { "-k 3 -K 1000 -n 100 -N 200 -P 1e6",    46332, 0x0466ed0a3ac0a855ULL },
+   { "-k 3 -K 1000 -n 100 -N 200 -P 1e6 -r",  2487, 0x25813101a0a23098ULL },
+   { NULL, 0, 0 }
+};
+
 // This is declared in App.h, but implemented here.  This means that App.h
 // can remain unchanged if using the mtsieve framework for other applications.
 App *get_app(void)
@@ -70,6 +77,7 @@ GFNDivisorApp::GFNDivisorApp(void) : FactorApp()
 {
    SetBanner(APP_NAME " v" APP_VERSION ", a program to find factors of k*2^n+1 numbers for variable k and n");
    SetLogFileName("gfndsieve.log");
+   SetSelfTests(selfTests);
 
    il_MinKOriginal = il_MinK = 0;
    il_MaxKOriginal = il_MaxK = 0;
@@ -264,15 +272,11 @@ void GFNDivisorApp::ValidateOptions(void)
          
       if (ib_UseTermsBitmap)
       {
-         iv_Terms.resize(nCount);
-         
-         for (uint32_t n=ii_MinN; n<=ii_MaxN; n++)
-         {
-            iv_Terms[n-ii_MinN].resize(kCount);
-            std::fill(iv_Terms[n-ii_MinN].begin(), iv_Terms[n-ii_MinN].end(), false);
-         }
+         AllocateTerms(nCount, kCount, false);
                
          ProcessInputTermsFile(true);
+         
+         BuildFirstKIndex();
       }
    }
    else
@@ -344,8 +348,8 @@ void GFNDivisorApp::ValidateOptions(void)
 
    FactorApp::ParentValidateOptions();
 
-   // Since the worker wants primes in groups of 4
-   while (ii_CpuWorkSize % 4 != 0)
+   // Since the worker wants primes in groups of 8
+   while (ii_CpuWorkSize % WIDE_VECTOR_SIZE != 0)
       ii_CpuWorkSize++;
    
    for (uint32_t i=0; ; i++)
@@ -419,13 +423,9 @@ void  GFNDivisorApp::PreSieveHook(void)
    {      
       il_TermCount = il_TotalTerms;
       
-      iv_Terms.resize(nCount);
+      AllocateTerms(nCount, kCount, true);
       
-      for (uint32_t n=ii_MinN; n<=ii_MaxN; n++)
-      {
-         iv_Terms[n-ii_MinN].resize(kCount);
-         std::fill(iv_Terms[n-ii_MinN].begin(), iv_Terms[n-ii_MinN].end(), true);
-      }
+      BuildFirstKIndex();
 
       return;
    }
@@ -440,11 +440,6 @@ void  GFNDivisorApp::PreSieveHook(void)
    
    if (il_MinKOriginal == 0)
    {
-      iv_Terms.resize(ii_NPerChunk);
-      
-      for (uint32_t n=0; n<ii_NPerChunk; n++)
-         iv_Terms[n].resize(il_KPerChunk);
-      
       il_MinKOriginal = il_MinK;
       il_MaxKOriginal = il_MaxK;
       il_MinKInChunk = il_MinK;
@@ -455,9 +450,6 @@ void  GFNDivisorApp::PreSieveHook(void)
       
    }
    
-   for (uint32_t n=0; n<ii_NPerChunk; n++)
-      std::fill(iv_Terms[0].begin(), iv_Terms[0].end(), true);
-
    // We want il_MinK and il_MaxK to be set to the correct range
    // of k before we start sieving.
    il_MinK = il_MinKInChunk;
@@ -484,6 +476,11 @@ void  GFNDivisorApp::PreSieveHook(void)
    il_TotalTermsInChunk = il_TermCount = kInChunk * nInChunk;
    il_FactorCount = 0;
    
+   // Every n in the chunk starts with all k
+   AllocateTerms(nInChunk, BIT(il_MaxK) + 1, true);
+   
+   BuildFirstKIndex();
+   
    ip_GFNDivisorTester->StartedSieving();
 }
 
@@ -492,7 +489,15 @@ bool  GFNDivisorApp::PostSieveHook(void)
    if (!ib_TestTerms)
       return true;
    
-   ip_GFNDivisorTester->TestRemainingTerms(il_TotalTerms, il_TotalTermsInChunk, il_TermCount);
+   // The terms are tested by the tester threads while the next chunk is sieved.
+   // iv_Terms gets the terms of the previous chunk, which are reused for the next chunk.
+   ip_GFNDivisorTester->TestRemainingTerms(iv_Terms, il_WordsPerN, il_TotalTerms, il_TotalTermsInChunk, il_TermCount);
+   
+   if (IsInterrupted())
+   {
+      ip_GFNDivisorTester->Finish();
+      return true;
+   }
    
    // Set the starting k for the next range to be sieved.
    il_MinKInChunk = il_MaxK;
@@ -503,7 +508,10 @@ bool  GFNDivisorApp::PostSieveHook(void)
    // If we finished all k for this n, then we are done if we finished
    // all n as well
    if (ii_MaxN >= ii_MaxNOriginal)
+   {
+      ip_GFNDivisorTester->Finish();
       return true;
+   }
    
    // Set k and n for the next range
    
@@ -590,7 +598,7 @@ void GFNDivisorApp::ProcessInputTermsFile(bool haveBitMap, FILE *fPtr, char *fil
 {
    char     buffer[1000];
    uint32_t n;
-   uint64_t k, diff, minPrime;
+   uint64_t k, diff, minPrime, bit;
 
    if (fgets(buffer, sizeof(buffer), fPtr) == NULL)
       FatalError("No data in input file %s", fileName);
@@ -604,7 +612,8 @@ void GFNDivisorApp::ProcessInputTermsFile(bool haveBitMap, FILE *fPtr, char *fil
 
       if (haveBitMap)
       {
-         iv_Terms[n-ii_MinN][BIT(k)] = true;
+         bit = BIT(k);
+         iv_Terms[(n-ii_MinN)*il_WordsPerN + (bit >> 6)] |= (1ULL << (bit & 63));
          il_TermCount++;
       }
       else
@@ -635,7 +644,8 @@ void GFNDivisorApp::ProcessInputTermsFile(bool haveBitMap, FILE *fPtr, char *fil
          
          if (haveBitMap)
          {
-            iv_Terms[n-ii_MinN][BIT(k)] = true;
+            bit = BIT(k);
+            iv_Terms[(n-ii_MinN)*il_WordsPerN + (bit >> 6)] |= (1ULL << (bit & 63));
             il_TermCount++;
          }
          else
@@ -656,7 +666,8 @@ void GFNDivisorApp::ProcessInputTermsFile(bool haveBitMap, FILE *fPtr, char *fil
             
       if (haveBitMap)
       {
-         iv_Terms[n-ii_MinN][BIT(k)] = true;
+         bit = BIT(k);
+         iv_Terms[(n-ii_MinN)*il_WordsPerN + (bit >> 6)] |= (1ULL << (bit & 63));
          il_TermCount++;
       }
       else
@@ -673,7 +684,8 @@ bool  GFNDivisorApp::ApplyFactor(uint64_t theFactor, const char *term)
    uint32_t b, n;
    int32_t  c;
    
-   if (!ib_UseTermsBitmap)
+   // The bitmap is not built until sieving starts when the range comes from -k/-K/-n/-N
+   if (!ib_UseTermsBitmap || iv_FirstK.size() == 0)
       return false;
    
    if (sscanf(term, "%" SCNu64"*%u^%u%u", &k, &b, &n, &c) != 4)
@@ -694,12 +706,16 @@ bool  GFNDivisorApp::ApplyFactor(uint64_t theFactor, const char *term)
    VerifyFactor(theFactor, k, n);
       
    uint64_t bit = BIT(k);
+   uint64_t *word = &iv_Terms[(n-ii_MinN)*il_WordsPerN + (bit >> 6)];
    
    // No locking is needed because the Workers aren't running yet
-   if (iv_Terms[n-ii_MinN][bit])
+   if (*word & (1ULL << (bit & 63)))
    {
-      iv_Terms[n-ii_MinN][bit] = false;
+      *word &= ~(1ULL << (bit & 63));
       il_TermCount--;
+      
+      if (iv_FirstK[n-ii_MinN].load(std::memory_order_relaxed) == k)
+         iv_FirstK[n-ii_MinN].store(FindFirstK(n, bit + 1), std::memory_order_relaxed);
 
       return true;
    }
@@ -758,8 +774,8 @@ uint64_t GFNDivisorApp::WriteABCDTermsFile(char *fileName, uint32_t minN, uint64
 {
    FILE    *termsFile;
    uint32_t n, maxN;
-   uint64_t k, bit, termCount = 0, previousK;
-   bool     firstRowInFile = true, addedNToFile;
+   uint64_t k, bit, maxBit, termCount = 0, previousK;
+   bool     firstRowInFile = true;
 
    termsFile = fopen(fileName, "w");
    
@@ -770,45 +786,49 @@ uint64_t GFNDivisorApp::WriteABCDTermsFile(char *fileName, uint32_t minN, uint64
    if (maxN > ii_MaxN)
       maxN = ii_MaxN + 1;
    
+   maxBit = BIT(il_MaxK);
+   
    for (n=minN; n<maxN; n++)
    {
-      addedNToFile = false;
+      k = iv_FirstK[n-ii_MinN].load(std::memory_order_relaxed);
       
-      k = il_MinK;
-      bit = BIT(il_MinK);
-   
-      for (; k<=il_MaxK; k+=2, bit++)
-      {
-         if (iv_Terms[n-ii_MinN][bit])
-         {
-            if (firstRowInFile)
-               fprintf(termsFile, "ABCD $a*2^%d+1 [%" PRIu64"] // Sieved to %" PRIu64"\n", n, k, maxPrime);
-            else
-               fprintf(termsFile, "ABCD $a*2^%d+1 [%" PRIu64"]\n", n, k);
-
-            firstRowInFile = false;
-            addedNToFile = true;
-            previousK = k;
-            termCount++;
-            break;
-         }
-      }
-
       // If all k for this n were sieved out, we'll skip to the next n.
-      if (!addedNToFile)
+      if (k == NO_REMAINING_K)
          continue;
       
-      k += 2;
-      bit++;
+      if (firstRowInFile)
+         fprintf(termsFile, "ABCD $a*2^%d+1 [%" PRIu64"] // Sieved to %" PRIu64"\n", n, k, maxPrime);
+      else
+         fprintf(termsFile, "ABCD $a*2^%d+1 [%" PRIu64"]\n", n, k);
+
+      firstRowInFile = false;
+      previousK = k;
+      termCount++;
+      
+      const uint64_t *row = &iv_Terms[(n-ii_MinN)*il_WordsPerN];
       
-      for (; k<=il_MaxK; k+=2, bit++)
+      // Walk the set bits of each word rather than testing every k
+      for (bit=BIT(k)+1; bit<=maxBit; )
       {
-         if (iv_Terms[n-ii_MinN][bit])
+         uint64_t word = row[bit >> 6] >> (bit & 63);
+         
+         if (word == 0)
          {
-            fprintf(termsFile, "%" PRIu64"\n", k - previousK);
-            previousK = k;
-            termCount++;
+            bit = (bit | 63) + 1;
+            continue;
          }
+         
+         bit += __builtin_ctzll(word);
+         
+         if (bit > maxBit)
+            break;
+         
+         k = il_MinK + (bit << 1);
+         
+         fprintf(termsFile, "%" PRIu64"\n", k - previousK);
+         previousK = k;
+         termCount++;
+         bit++;
       }
    }
 
@@ -855,13 +875,17 @@ void  GFNDivisorApp::ReportFactor(uint64_t theFactor, uint64_t k, uint32_t n)
 
    do {
       uint64_t bit = BIT(k);
+      uint64_t *word = &iv_Terms[(n-ii_MinN)*il_WordsPerN + (bit >> 6)];
          
-      if (iv_Terms[n-ii_MinN][bit])
+      if (*word & (1ULL << (bit & 63)))
       {
-         iv_Terms[n-ii_MinN][bit] = false;
+         *word &= ~(1ULL << (bit & 63));
          
          il_FactorCount++;
          il_TermCount--;
+         
+         if (iv_FirstK[n-ii_MinN].load(std::memory_order_relaxed) == k)
+            iv_FirstK[n-ii_MinN].store(FindFirstK(n, bit + 1), std::memory_order_relaxed);
                   
          if (n < 62)
          {
@@ -884,6 +908,53 @@ void  GFNDivisorApp::ReportFactor(uint64_t theFactor, uint64_t k, uint32_t n)
    ip_FactorAppLock->Release();
 }
 
+void  GFNDivisorApp::AllocateTerms(uint32_t nCount, uint64_t kCount, bool initialValue)
+{
+   il_WordsPerN = (kCount + 63) >> 6;
+   
+   iv_Terms.resize(nCount * il_WordsPerN);
+   
+   // std::atomic cannot be moved, so the index is replaced instead of resized
+   std::vector<std::atomic<uint64_t>> firstK(nCount);
+   iv_FirstK.swap(firstK);
+   
+   std::fill(iv_Terms.begin(), iv_Terms.end(), (initialValue ? 0xffffffffffffffffULL : 0));
+}
+
+// Return the first remaining k for n at or after fromBit.  Bits beyond il_MaxK
+// are ignored since the last word of each n might be partially used.
+uint64_t GFNDivisorApp::FindFirstK(uint32_t n, uint64_t fromBit)
+{
+   const uint64_t *row = &iv_Terms[(n-ii_MinN)*il_WordsPerN];
+   uint64_t maxBit = BIT(il_MaxK);
+   uint64_t word;
+   
+   while (fromBit <= maxBit)
+   {
+      word = row[fromBit >> 6] >> (fromBit & 63);
+      
+      if (word != 0)
+      {
+         fromBit += __builtin_ctzll(word);
+         
+         if (fromBit > maxBit)
+            break;
+         
+         return il_MinK + (fromBit << 1);
+      }
+      
+      fromBit = (fromBit | 63) + 1;
+   }
+
+   return NO_REMAINING_K;
+}
+
+void  GFNDivisorApp::BuildFirstKIndex(void)
+{
+   for (uint32_t n=ii_MinN; n<=ii_MaxN; n++)
+      iv_FirstK[n-ii_MinN].store(FindFirstK(n, 0), std::memory_order_relaxed);
+}
+
 uint32_t GFNDivisorApp::GetSmallPrimeFactor(uint64_t k, uint32_t n)
 {
    uint32_t idx;
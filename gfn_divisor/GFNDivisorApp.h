@@ -9,9 +9,12 @@
 #ifndef _GFNDivisorApp_H
 #define _GFNDivisorApp_H
 
+#include <atomic>
 #include "../core/FactorApp.h"
 #include "GFNDivisorTester.h"
 
+#define NO_REMAINING_K  0xffffffffffffffffULL
+
 class GFNDivisorApp : public FactorApp
 {
 public:
@@ -33,7 +36,18 @@ public:
    uint32_t          GetMaxN(void) { return ii_MaxN; };
    uint32_t          GetNCount(void) { return (ii_MaxN - ii_MinN + 1); };
    
-   std::vector<std::vector<bool>> GetTerms(void) { return iv_Terms; };
+   // The terms are a flat bitmap with il_WordsPerN words for each n.
+   bool              IsTermRemaining(uint64_t k, uint32_t n)
+   {
+      uint64_t bit = (k - il_MinK) >> 1;
+      
+      return (iv_Terms[(n - ii_MinN) * il_WordsPerN + (bit >> 6)] >> (bit & 63)) & 1;
+   };
+   
+   // For each n, the smallest k that has not been removed or NO_REMAINING_K if all
+   // k for that n have been removed.  This returns NULL if there is no bitmap.  The
+   // workers read it without the lock, so the entries are atomic.
+   const std::atomic<uint64_t> *GetFirstKIndex(void) { return (iv_FirstK.size() > 0 ? iv_FirstK.data() : NULL); };
 
    void              ReportFactor(uint64_t theFactor, uint64_t k, uint32_t n);
    
@@ -61,7 +75,13 @@ private:
    uint32_t          GetSmallPrimeFactor(uint64_t k, uint32_t n);
    void              VerifyFactor(uint64_t theFactor, uint64_t k, uint32_t n);
    
-   std::vector<std::vector<bool>>  iv_Terms;
+   void              AllocateTerms(uint32_t nCount, uint64_t kCount, bool initialValue);
+   uint64_t          FindFirstK(uint32_t n, uint64_t fromBit);
+   void              BuildFirstKIndex(void);
+   
+   std::vector<uint64_t>  iv_Terms;
+   std::vector<std::atomic<uint64_t>>  iv_FirstK;
+   uint64_t          il_WordsPerN;
    std::string       is_OutputTermsFilePrefix;
    
    bool              ib_UseTermsBitmap;
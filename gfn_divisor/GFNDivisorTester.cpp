@@ -14,7 +14,14 @@
 #include "../core/inline.h"
 #include "../x86_asm_ext/asm-ext-x86.h"
 
-#define BIT(k)          (((k) - il_MinK) >> 1)
+#ifdef WIN32
+static DWORD WINAPI WindowsThreadEntryPoint(LPVOID data)
+{
+   GFNDivisorTester::TesterThreadEntryPoint(data);
+
+   return 0;
+}
+#endif
 
 // Set PRE_SQUARE=N to compute 2^2^n as (2^2^N)^2^(n-N), which saves N
 // sqrmods at a cost of more time in mpn_tdiv_qr().  N must satisfy 0 <= N <= 5.
@@ -44,16 +51,46 @@ static const unsigned long _MONTGOMERY_DATA[14] = {1,0,0,0,0,0,0,0,0,0,0,0,0,UIN
 GFNDivisorTester::GFNDivisorTester(App *theApp)
 {
    ip_App = theApp;
+   ip_GFNDivisorApp = (GFNDivisorApp *) theApp;
+   
+   il_MinK = ip_GFNDivisorApp->GetMinK();
+   il_MaxK = ip_GFNDivisorApp->GetMaxK();
+   
+   ii_MinN = ip_GFNDivisorApp->GetMinN();
+   ii_MaxN = ip_GFNDivisorApp->GetMaxN();
+   
+   ip_TesterLock = new SharedMemoryItem("tester", true);
+   
+   // The tester threads share the CPU with the workers sieving the next chunk
+   ii_ThreadCount = ip_App->GetCpuWorkerCount();
+   
+   if (ii_ThreadCount == 0)
+      ii_ThreadCount = 1;
    
-   GFNDivisorApp *gfnApp = (GFNDivisorApp *) theApp;
+   ib_Stopping = false;
    
-   il_MinK = gfnApp->GetMinK();
-   il_MaxK = gfnApp->GetMaxK();
+   il_WordsPerN = 0;
+   il_UnitsPerN = 0;
+   il_UnitCount = 0;
+   il_NextUnit = 0;
+   il_UnitsDone = 0;
    
-   ii_MinN = gfnApp->GetMinN();
-   ii_MaxN = gfnApp->GetMaxN();
+   il_TotalTerms = 0;
+   il_TermsInChunk = 0;
+   il_TermCount = 0;
    
-   iv_Terms = gfnApp->GetTerms();
+   il_StartSievingUS = 0;
+   il_SievingUS = 0;
+   il_StartTestingUS = 0;
+   il_TotalTermsEvaluated = 0;
+   il_TermsEvaluatedInChunk = 0;
+   
+   ip_FactorsFile = NULL;
+}
+
+GFNDivisorTester::~GFNDivisorTester(void)
+{
+   delete ip_TesterLock;
 }
 
 void  GFNDivisorTester::StartedSieving(void)
@@ -61,23 +98,107 @@ void  GFNDivisorTester::StartedSieving(void)
    il_StartSievingUS = Clock::GetCurrentMicrosecond();
 }
 
-void  GFNDivisorTester::TestRemainingTerms(uint64_t totalTerms, uint64_t termsInChunk, uint64_t termCount)
+void  GFNDivisorTester::TestRemainingTerms(std::vector<uint64_t> &terms, uint64_t wordsPerN, uint64_t totalTerms, uint64_t termsInChunk, uint64_t termCount)
 {
-   time_t   lastCheckPointTime = time(NULL);
-   uint64_t sievingUS, startTestingUS, currentUS;
-   uint64_t calculationUS;
-   uint64_t termsTested = 0;
-   uint64_t termsEvaluatedInChunk = 0;
-   uint64_t termsTestedPerSecond;
-   double   percentSievingTimeSlice;
-   double   percentTermsRequiringTest;
-   double   percentChunkTested, percentRangeTested;
-   FILE    *fPtr;
-   mpz_t    rem, fermat, nTemp, kTemp, factor, minus1;
+   uint64_t currentUS = Clock::GetCurrentMicrosecond();
+   
+   ip_TesterLock->Lock();
+   
+   // Only one chunk is tested at a time
+   while (il_UnitsDone < il_UnitCount)
+      ip_TesterLock->SetCondition();
+   
+   // The previous chunk's terms are given back to be reused for the next chunk
+   iv_Terms.swap(terms);
+   il_WordsPerN = wordsPerN;
+   
+   // The range of k and n changes with each chunk
+   il_MinK = ip_GFNDivisorApp->GetMinK();
+   il_MaxK = ip_GFNDivisorApp->GetMaxK();
+   
+   ii_MinN = ip_GFNDivisorApp->GetMinN();
+   ii_MaxN = ip_GFNDivisorApp->GetMaxN();
+   
+   il_TotalTerms = totalTerms;
+   il_TermsInChunk = termsInChunk;
+   il_TermCount = termCount;
+   
+   il_SievingUS = currentUS - il_StartSievingUS;
+   il_StartTestingUS = currentUS;
+   il_TermsEvaluatedInChunk = 0;
+   it_LastCheckPointTime = time(NULL);
+   
+   il_UnitsPerN = (il_WordsPerN + TESTER_WORDS_PER_UNIT - 1) / TESTER_WORDS_PER_UNIT;
+   il_UnitCount = il_UnitsPerN * (ii_MaxN - ii_MinN + 1);
+   il_NextUnit = 0;
+   il_UnitsDone = 0;
+   
+   if (iv_Threads.size() == 0)
+   {
+      iv_Threads.resize(ii_ThreadCount);
+      
+      for (uint32_t idx=0; idx<ii_ThreadCount; idx++)
+      {
+#ifdef WIN32
+         iv_Threads[idx] = CreateThread(0, 0, WindowsThreadEntryPoint, this, 0, 0);
+#else
+         pthread_create(&iv_Threads[idx], NULL, &TesterThreadEntryPoint, this);
+#endif
+      }
+   }
+   
+   // Wake up the tester threads
+   ip_TesterLock->ClearCondition();
+   
+   ip_TesterLock->Release();
+}
 
-   startTestingUS = Clock::GetCurrentMicrosecond();
-   sievingUS = startTestingUS - il_StartSievingUS;
-            
+void  GFNDivisorTester::Finish(void)
+{
+   ip_TesterLock->Lock();
+   
+   while (il_UnitsDone < il_UnitCount)
+      ip_TesterLock->SetCondition();
+   
+   ib_Stopping = true;
+   
+   ip_TesterLock->ClearCondition();
+   
+   ip_TesterLock->Release();
+   
+   for (uint32_t idx=0; idx<iv_Threads.size(); idx++)
+   {
+#ifdef WIN32
+      WaitForSingleObject(iv_Threads[idx], INFINITE);
+      CloseHandle(iv_Threads[idx]);
+#else
+      pthread_join(iv_Threads[idx], NULL);
+#endif
+   }
+   
+   iv_Threads.clear();
+   
+   if (ip_FactorsFile != NULL)
+   {
+      fclose(ip_FactorsFile);
+      ip_FactorsFile = NULL;
+   }
+}
+
+void *GFNDivisorTester::TesterThreadEntryPoint(void *data)
+{
+   GFNDivisorTester *tester = (GFNDivisorTester *) data;
+   
+   tester->TestTerms();
+   
+   return 0;
+}
+
+void  GFNDivisorTester::TestTerms(void)
+{
+   uint64_t unit, termsEvaluated;
+   mpz_t    rem, fermat, nTemp, kTemp, factor, minus1;
+   
    mpz_init(rem);
    mpz_init(fermat);
    mpz_init(nTemp);
@@ -87,137 +208,191 @@ void  GFNDivisorTester::TestRemainingTerms(uint64_t totalTerms, uint64_t termsIn
 
    mpz_set_ui(fermat, 2);
    
-   for (uint32_t n=ii_MinN; n<=ii_MaxN; n++)
+   ip_TesterLock->Lock();
+   
+   while (true)
    {
-      uint64_t bit = BIT(il_MinK);
-         
-      mpz_set_ui(nTemp, 2);
-      mpz_pow_ui(nTemp, nTemp, n);
-         
-      for (uint64_t k=il_MinK; k<=il_MaxK; k+=2, bit++)
+      if (il_NextUnit >= il_UnitCount)
       {
-         il_TotalTermsEvaluated++;
-         termsEvaluatedInChunk++;
+         if (ib_Stopping)
+            break;
          
-         if (!iv_Terms[n-ii_MinN][bit])
-            continue;
-
-         termsTested++;
-
-         if (time(NULL) > lastCheckPointTime + 60)
-         {            
-            percentSievingTimeSlice = ((double) termsEvaluatedInChunk) / (double) termsInChunk;
-            percentChunkTested = 100.0 * percentSievingTimeSlice;
-            
-            currentUS = Clock::GetCurrentMicrosecond();
-            
-            // Add the time to test this range to the time to sieve this range.  So if it took 180 seconds
-            // to sieve this chunk and we have tested 20 percent of this chunk then "assign" 36 seconds
-            // (as 36 is 20% of 180) of sieving time to this chunk.
-            calculationUS = (sievingUS * percentSievingTimeSlice) + (currentUS - startTestingUS);
-                        
-            percentTermsRequiringTest = (100.0 * (double) termCount) / (double) termsInChunk;
-            
-            termsTestedPerSecond = termsEvaluatedInChunk / (calculationUS / 1000000);
-            
-            // We really didn't evaluate even k, but we count against the rate anyways.
-            termsTestedPerSecond *= 2;
+         ip_TesterLock->SetCondition();
+         continue;
+      }
+      
+      unit = il_NextUnit;
+      il_NextUnit++;
+      
+      ip_TesterLock->Release();
+      
+      termsEvaluated = TestUnit(unit, rem, fermat, nTemp, kTemp, factor, minus1);
+      
+      ip_TesterLock->Lock();
+      
+      il_TotalTermsEvaluated += termsEvaluated;
+      il_TermsEvaluatedInChunk += termsEvaluated;
+      il_UnitsDone++;
+      
+      if (il_UnitsDone == il_UnitCount || time(NULL) > it_LastCheckPointTime + 60)
+         ReportProgress();
+      
+      // Wake up the main thread if it is waiting for this chunk
+      if (il_UnitsDone == il_UnitCount)
+         ip_TesterLock->ClearCondition();
+   }
+   
+   ip_TesterLock->Release();
+   
+   mpz_clear(rem);
+   mpz_clear(fermat);
+   mpz_clear(nTemp);
+   mpz_clear(kTemp);
+   mpz_clear(factor);
+   mpz_clear(minus1);
+}
 
-            if (termsInChunk == totalTerms)
-               ip_App->WriteToConsole(COT_SIEVE, "Tested %5.2f pct of range at %" PRIu64" terms per second (%5.2f pct terms passed sieving)",
-                                      percentChunkTested, termsTestedPerSecond, percentTermsRequiringTest);
-            else
-            {
-               percentRangeTested = (100.0 * (double) il_TotalTermsEvaluated) / (double) totalTerms;
-            
-               ip_App->WriteToConsole(COT_SIEVE, "Tested %5.2f pct of chunk at %" PRIu64" terms per second (%5.2f pct terms passed sieving) (%5.2f pct of range)",
-                                      percentChunkTested, termsTestedPerSecond, percentTermsRequiringTest, percentRangeTested);
-            }
+// This returns the number of k that were evaluated, including those that were removed
+// by sieving.  The terms cannot change until all units of the chunk have been tested.
+uint64_t  GFNDivisorTester::TestUnit(uint64_t unit, mpz_t rem, mpz_t fermat, mpz_t nTemp, mpz_t kTemp, mpz_t factor, mpz_t minus1)
+{
+   uint32_t n = ii_MinN + (uint32_t) (unit / il_UnitsPerN);
+   uint64_t word = (unit % il_UnitsPerN) * TESTER_WORDS_PER_UNIT;
+   uint64_t endWord = word + TESTER_WORDS_PER_UNIT;
+   uint64_t kBits = (il_MaxK - il_MinK) / 2 + 1;
+   uint64_t bits, k;
+   uint64_t termsEvaluated;
+   
+   if (endWord > il_WordsPerN)
+      endWord = il_WordsPerN;
+   
+   if (endWord * 64 > kBits)
+      termsEvaluated = kBits - word * 64;
+   else
+      termsEvaluated = (endWord - word) * 64;
+   
+   const uint64_t *terms = &iv_Terms[(n - ii_MinN) * il_WordsPerN];
+   
+   mpz_set_ui(nTemp, 2);
+   mpz_pow_ui(nTemp, nTemp, n);
+   
+   for ( ; word<endWord; word++)
+   {
+      bits = terms[word];
       
-            lastCheckPointTime = time(NULL);
-         }
+      while (bits != 0)
+      {
+         k = il_MinK + 2 * (word * 64 + __builtin_ctzll(bits));
+         bits &= (bits - 1);
+         
+         if (k > il_MaxK)
+            break;
+         
+         if (!IsFermatDivisor(k, n))
+            continue;
          
-         if (IsFermatDivisor(k, n))
-         {
 #ifdef WIN32
-            // Even though build with 64-bit limbs, mpz_set_ui doesn't
-            // populate kTemp correctly when k > 32 bits.
-            mpz_set_ui(kTemp, k >> 32);
-            mpz_mul_2exp(kTemp, kTemp, 32);
-            mpz_add_ui(kTemp, kTemp, k & (0xffffffff));
+         // Even though build with 64-bit limbs, mpz_set_ui doesn't
+         // populate kTemp correctly when k > 32 bits.
+         mpz_set_ui(kTemp, k >> 32);
+         mpz_mul_2exp(kTemp, kTemp, 32);
+         mpz_add_ui(kTemp, kTemp, k & (0xffffffff));
 #else
-            mpz_set_ui(kTemp, k);
+         mpz_set_ui(kTemp, k);
 #endif
 
-            mpz_mul_2exp(minus1, kTemp, n);
-            mpz_add_ui(factor, minus1, 1);
+         mpz_mul_2exp(minus1, kTemp, n);
+         mpz_add_ui(factor, minus1, 1);
 
-            mpz_powm(rem, fermat, nTemp, factor);;
-         
-            if (mpz_cmp(rem, minus1) == 0)
-            {
-               ip_App->WriteToConsole(COT_OTHER, "Found factor %" PRIu64"*2^%u+1 of 2^(2^%u)+1", k, n, n-2);
-               
-               fPtr = fopen("gfn_factors.txt", "a+");
-               fprintf(fPtr, "Found factor %" PRIu64"*2^%u+1 of 2^(2^%u)+1\n", k, n, n-2);
-               fclose(fPtr);
-            }
-            else if (mpz_cmp_ui(rem, 1) == 0)
+         mpz_powm(rem, fermat, nTemp, factor);
+      
+         if (mpz_cmp(rem, minus1) == 0)
+            ReportFactor(k, n, n-2);
+         else if (mpz_cmp_ui(rem, 1) == 0)
+         {
+            mpz_set_ui(rem, 2);
+            
+            for (uint32_t m=1; m<=n-2; m++)
             {
-               mpz_set_ui(rem, 2);
+               mpz_powm_ui(rem, rem, 2, factor);
                
-               for (uint32_t m=1; m<=n-2; m++)
-               {
-                  mpz_powm_ui(rem, rem, 2, factor);
-                  
-                  if (mpz_cmp(rem, minus1) == 0)
-                  {
-                     ip_App->WriteToConsole(COT_OTHER, "Found factor %" PRIu64"*2^%u+1 of 2^(2^%u)+1", k, n, m);
-                     
-                     fPtr = fopen("gfn_factors.txt", "a+");
-                     fprintf(fPtr, "Found factor %" PRIu64"*2^%u+1 of 2^(2^%u)+1\n", k, n, m);
-                     fclose(fPtr);
-                  }
-               }
+               if (mpz_cmp(rem, minus1) == 0)
+                  ReportFactor(k, n, m);
             }
          }
       }
    }
    
-   mpz_clear(rem);
-   mpz_clear(fermat);
-   mpz_clear(nTemp);
-   mpz_clear(kTemp);
-   mpz_clear(factor);
-   mpz_clear(minus1);
+   return termsEvaluated;
+}
 
-   currentUS = Clock::GetCurrentMicrosecond();
+// This is called by a tester thread while holding the lock
+void  GFNDivisorTester::ReportProgress(void)
+{
+   uint64_t currentUS = Clock::GetCurrentMicrosecond();
+   uint64_t calculationUS;
+   uint64_t termsTestedPerSecond;
+   double   percentSievingTimeSlice;
+   double   percentTermsRequiringTest;
+   double   percentChunkTested, percentRangeTested;
    
-   // If we took less than 5 seconds to test the range, then the terms per second
+   percentSievingTimeSlice = ((double) il_TermsEvaluatedInChunk) / (double) il_TermsInChunk;
+   percentChunkTested = 100.0 * percentSievingTimeSlice;
+   
+   // Add the time to test this range to the time to sieve this range.  So if it took 180 seconds
+   // to sieve this chunk and we have tested 20 percent of this chunk then "assign" 36 seconds
+   // (as 36 is 20% of 180) of sieving time to this chunk.
+   calculationUS = (il_SievingUS * percentSievingTimeSlice) + (currentUS - il_StartTestingUS);
+   
+   it_LastCheckPointTime = time(NULL);
+   
+   // If we took less than 50 seconds to sieve and test the chunk, then the terms per second
    // calculation is rather meaningless so we won't show it.
-   if (currentUS - il_StartSievingUS > 50000000)
-   {
-      percentChunkTested = (100.0 * (double) termsEvaluatedInChunk) / (double) termsInChunk;
-      percentTermsRequiringTest = (100.0 * (double) termCount) / (double) termsInChunk;
-      
-      termsTestedPerSecond = termsEvaluatedInChunk / ((currentUS - il_StartSievingUS) / 1000000);
+   if (il_UnitsDone == il_UnitCount && il_SievingUS + (currentUS - il_StartTestingUS) <= 50000000)
+      return;
+   
+   if (calculationUS < 1000000)
+      return;
+   
+   percentTermsRequiringTest = (100.0 * (double) il_TermCount) / (double) il_TermsInChunk;
+   
+   termsTestedPerSecond = il_TermsEvaluatedInChunk / (calculationUS / 1000000);
+   
+   // We really didn't evaluate even k, but we count against the rate anyways.
+   termsTestedPerSecond *= 2;
 
-      // We really didn't evaluate even k, but we count against the rate anyways.
-      termsTestedPerSecond *= 2;
-               
-      if (termsInChunk == totalTerms)
-         ip_App->WriteToConsole(COT_SIEVE, "Tested %5.2f pct of range at %" PRIu64" terms per second (%5.2f pct terms passed sieving)",
-                                percentChunkTested, termsTestedPerSecond, percentTermsRequiringTest);
-      else
-      {
-         percentRangeTested = (100.0 * (double) il_TotalTermsEvaluated) / (double) totalTerms;
-      
-         ip_App->WriteToConsole(COT_SIEVE, "Tested %5.2f pct of chunk at %" PRIu64" terms per second (%5.2f pct terms passed sieving) (%5.2f pct of range)",
-                                percentChunkTested, termsTestedPerSecond, percentTermsRequiringTest, percentRangeTested);
-      }
+   if (il_TermsInChunk == il_TotalTerms)
+      ip_App->WriteToConsole(COT_SIEVE, "Tested %5.2f pct of range at %" PRIu64" terms per second (%5.2f pct terms passed sieving)",
+                             percentChunkTested, termsTestedPerSecond, percentTermsRequiringTest);
+   else
+   {
+      percentRangeTested = (100.0 * (double) il_TotalTermsEvaluated) / (double) il_TotalTerms;
+   
+      ip_App->WriteToConsole(COT_SIEVE, "Tested %5.2f pct of chunk at %" PRIu64" terms per second (%5.2f pct terms passed sieving) (%5.2f pct of range)",
+                             percentChunkTested, termsTestedPerSecond, percentTermsRequiringTest, percentRangeTested);
    }
 }
 
+// Factors are very rare, so the file is flushed for each one so that none are lost
+// if the program is stopped.
+void  GFNDivisorTester::ReportFactor(uint64_t k, uint32_t n, uint32_t m)
+{
+   ip_TesterLock->Lock();
+   
+   ip_App->WriteToConsole(COT_OTHER, "Found factor %" PRIu64"*2^%u+1 of 2^(2^%u)+1", k, n, m);
+   
+   if (ip_FactorsFile == NULL)
+      ip_FactorsFile = fopen("gfn_factors.txt", "a+");
+   
+   if (ip_FactorsFile == NULL)
+      FatalError("Unable to open output file gfn_factors.txt");
+   
+   fprintf(ip_FactorsFile, "Found factor %" PRIu64"*2^%u+1 of 2^(2^%u)+1\n", k, n, m);
+   fflush(ip_FactorsFile);
+   
+   ip_TesterLock->Release();
+}
+
 // Return 1 iff k*2^n+1 is a Fermat divisor.
 // This code is from fermat_redc.c of GMP-Fermat
 bool  GFNDivisorTester::IsFermatDivisor(uint64_t k, uint32_t n)
@@ -10,35 +10,94 @@
 #define _GFNDivisorTester_H
 
 #include <gmp.h>
+#include <vector>
 #include "../core/App.h"
+#include "../core/SharedMemoryItem.h"
 
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+// Each thread takes this many words of the bitmap for one n at a time
+#define TESTER_WORDS_PER_UNIT    256
+
+class GFNDivisorApp;
+
+// The terms of a chunk are tested by multiple threads while the next chunk is sieved.
+// The threads take ranges of k for the same n so that they test numbers of the same
+// size at the same time.
 class GFNDivisorTester 
 {
 public:
    GFNDivisorTester(App *theApp);
 
-   ~GFNDivisorTester(void) {};
+   ~GFNDivisorTester(void);
 
    void              StartedSieving(void);
-   void              TestRemainingTerms(uint64_t totalTerms, uint64_t termsInChunk, uint64_t termCount);
+   
+   // This waits for the previous chunk to be tested, then swaps terms with the terms of
+   // the previous chunk and returns.  The terms are then tested by the tester threads.
+   void              TestRemainingTerms(std::vector<uint64_t> &terms, uint64_t wordsPerN, uint64_t totalTerms, uint64_t termsInChunk, uint64_t termCount);
+   
+   // This waits for the last chunk to be tested and stops the tester threads.
+   void              Finish(void);
+   
+   static void      *TesterThreadEntryPoint(void *data);
    
 protected:
 
 private:
+   void              TestTerms(void);
+   uint64_t          TestUnit(uint64_t unit, mpz_t rem, mpz_t fermat, mpz_t nTemp, mpz_t kTemp, mpz_t factor, mpz_t minus1);
+   void              ReportProgress(void);
+   void              ReportFactor(uint64_t k, uint32_t n, uint32_t m);
+   
    bool              IsFermatDivisor(uint64_t k, uint32_t n);
    void              CheckRedc(mp_limb_t *xp, uint32_t xn, uint32_t b, uint32_t m, uint64_t k, uint32_t n);
    void              VerifyFactor(uint64_t thePrime, uint64_t k, uint32_t n);
    
    App              *ip_App;
+   GFNDivisorApp    *ip_GFNDivisorApp;
+   
+   // This guards everything below it.  The condition is used by the tester threads to
+   // wait for a chunk and by the main thread to wait for a chunk to be tested.
+   SharedMemoryItem *ip_TesterLock;
+   
+   uint32_t          ii_ThreadCount;
+   bool              ib_Stopping;
+#ifdef WIN32
+   std::vector<HANDLE>    iv_Threads;
+#else
+   std::vector<pthread_t> iv_Threads;
+#endif
+   
+   std::vector<uint64_t>  iv_Terms;
+   uint64_t          il_WordsPerN;
    
-   std::vector<std::vector<bool>>  iv_Terms;
    uint64_t          il_MinK;
    uint64_t          il_MaxK;
    uint32_t          ii_MinN;
    uint32_t          ii_MaxN;
    
+   uint64_t          il_UnitsPerN;
+   uint64_t          il_UnitCount;
+   uint64_t          il_NextUnit;
+   uint64_t          il_UnitsDone;
+   
+   uint64_t          il_TotalTerms;
+   uint64_t          il_TermsInChunk;
+   uint64_t          il_TermCount;
+   
    uint64_t          il_StartSievingUS;
+   uint64_t          il_SievingUS;
+   uint64_t          il_StartTestingUS;
    uint64_t          il_TotalTermsEvaluated;
+   uint64_t          il_TermsEvaluatedInChunk;
+   time_t            it_LastCheckPointTime;
+   
+   FILE             *ip_FactorsFile;
 };
 
 #endif
@@ -11,6 +11,8 @@
 #include "GFNDivisorWorker.h"
 #include "../core/MpArithVector.h"
 
+#define SHIFTS_PER_CHECK   8
+
 GFNDivisorWorker::GFNDivisorWorker(uint32_t myId, App *theApp) : Worker(myId, theApp)
 {
    ip_GFNDivisorApp = (GFNDivisorApp *) theApp;
@@ -24,6 +26,8 @@ GFNDivisorWorker::GFNDivisorWorker(uint32_t myId, App *theApp) : Worker(myId, th
    ii_MinN = ip_GFNDivisorApp->GetMinN();
    ii_MaxN = ip_GFNDivisorApp->GetMaxN();
    
+   ip_FirstK = NULL;
+   
    // The thread can't start until initialization is done
    ib_Initialized = true;
 }
@@ -104,65 +108,89 @@ void  GFNDivisorWorker::TestMegaPrimeChunkSmall(void)
    }
 }
 
+// The starting k for 8 primes is computed at a time, then the shift window is
+// walked for each group of 4 primes.
 void  GFNDivisorWorker::TestMegaPrimeChunkLarge(void)
 {
-   uint64_t k1, k2, k3, k4, ks[4];
-   uint64_t p1, p2, p3, p4, ps[4];
+   uint64_t ks[WIDE_VECTOR_SIZE], ps[WIDE_VECTOR_SIZE];
    uint64_t maxPrime = ip_App->GetMaxPrime();
-   uint32_t n1, n2, n3, n4;
-   uint32_t bits1, bits2, bits3, bits4;
+   uint32_t lane;
    
-   for (uint32_t pIdx=0; pIdx<ii_PrimesInList; pIdx+=4)
+   ip_FirstK = ip_GFNDivisorApp->GetFirstKIndex();
+   
+   for (uint32_t pIdx=0; pIdx<ii_PrimesInList; pIdx+=WIDE_VECTOR_SIZE)
    {
-      p1 = ps[0] = il_PrimeList[pIdx+0];
-      p2 = ps[1] = il_PrimeList[pIdx+1];
-      p3 = ps[2] = il_PrimeList[pIdx+2];
-      p4 = ps[3] = il_PrimeList[pIdx+3];
+      for (lane=0; lane<WIDE_VECTOR_SIZE; lane++)
+      {
+         ps[lane] = il_PrimeList[pIdx+lane];
+         ks[lane] = (1+ps[lane]) >> 1;
+      }
       
-      const MpArithVec psVec(ps);
-
-      ks[0] = k1 = (1+p1) >> 1;
-      ks[1] = k2 = (1+p2) >> 1;
-      ks[2] = k3 = (1+p3) >> 1;
-      ks[3] = k4 = (1+p4) >> 1;
+      const MpArithVec8 psVec(ps);
 
       // Starting with k*2^n = 1 (mod p)
       //           --> k = (1/2)^n (mod p)
       //           --> k = inverse^n (mod p)
-      const MpResVec ksVec = psVec.nToRes(ks);
-      const MpResVec res = psVec.pow(ksVec, ii_MinN);
-      const MpResVec kToMinN = psVec.resToN(res);
+      const MpResVec8 ksVec = psVec.nToRes(ks);
+      const MpResVec8 res = psVec.pow(ksVec, ii_MinN);
+      const MpResVec8 kToMinN = psVec.resToN(res);
 
-      k1 = p1 - kToMinN[0];
-      k2 = p2 - kToMinN[1];
-      k3 = p3 - kToMinN[2];
-      k4 = p4 - kToMinN[3];
-     
-      n1 = n2 = n3 = n4 = ii_MinN;
+      for (lane=0; lane<WIDE_VECTOR_SIZE; lane++)
+         ks[lane] = ps[lane] - kToMinN[lane];
+      
+      ScanShiftWindow(&ps[0], &ks[0]);
+      ScanShiftWindow(&ps[4], &ks[4]);
+
+      SetLargestPrimeTested(ps[WIDE_VECTOR_SIZE-1], WIDE_VECTOR_SIZE);
+   
+      if (ps[WIDE_VECTOR_SIZE-1] >= maxPrime)
+         break;
+   }
+}
 
-      while (n1 <= ii_MaxN)
+// All four primes are shifted in lock step until every one has passed ii_MaxN.  A
+// prime that finishes early keeps shifting, but nothing is reported for it, so there
+// is no straggler loop for the other three.  Since 0 < k < p and both are odd, k+p
+// is even and (k+p)/2^bits < p, so k can never become 0.
+void  GFNDivisorWorker::ScanShiftWindow(const uint64_t *ps, const uint64_t *ks)
+{
+   uint64_t p1 = ps[0], p2 = ps[1], p3 = ps[2], p4 = ps[3];
+   uint64_t k1 = ks[0], k2 = ks[1], k3 = ks[2], k4 = ks[3];
+   uint64_t minK = il_MinK;
+   uint64_t kWindow = il_MaxK - il_MinK;
+   uint32_t maxN = ii_MaxN;
+   uint32_t n1, n2, n3, n4;
+   uint32_t bits1, bits2, bits3, bits4;
+   
+   n1 = n2 = n3 = n4 = ii_MinN;
+
+   // Checking whether every prime is done is more expensive than shifting, so
+   // only check after every SHIFTS_PER_CHECK shifts.
+   do
+   {
+      for (uint32_t shift=0; shift<SHIFTS_PER_CHECK; shift++)
       {
          // How many bits do we need to shift to make k odd
          bits1 = __builtin_ctzll(k1);
          bits2 = __builtin_ctzll(k2);
          bits3 = __builtin_ctzll(k3);
          bits4 = __builtin_ctzll(k4);
-         
+      
          k1 >>= bits1;
          k2 >>= bits2;
          k3 >>= bits3;
          k4 >>= bits4;
-         
+      
          n1 += bits1;
          n2 += bits2;
          n3 += bits3;
          n4 += bits4;
-          
-         if (k1 >= il_MinK && k1 <= il_MaxK && n1 <= ii_MaxN) RemoveTermsBigPrime(p1, k1, n1);
-         if (k2 >= il_MinK && k2 <= il_MaxK && n2 <= ii_MaxN) RemoveTermsBigPrime(p2, k2, n2);
-         if (k3 >= il_MinK && k3 <= il_MaxK && n3 <= ii_MaxN) RemoveTermsBigPrime(p3, k3, n3);
-         if (k4 >= il_MinK && k4 <= il_MaxK && n4 <= ii_MaxN) RemoveTermsBigPrime(p4, k4, n4);
-         
+      
+         if (k1 - minK <= kWindow) RemoveTermsInWindow(p1, k1, n1);
+         if (k2 - minK <= kWindow) RemoveTermsInWindow(p2, k2, n2);
+         if (k3 - minK <= kWindow) RemoveTermsInWindow(p3, k3, n3);
+         if (k4 - minK <= kWindow) RemoveTermsInWindow(p4, k4, n4);
+      
          // Make k even so that we can guarantee a shift for the next
          // iteration of the loop
          k1 += p1;
@@ -170,55 +198,7 @@ void  GFNDivisorWorker::TestMegaPrimeChunkLarge(void)
          k3 += p3;
          k4 += p4;
       }
-
-      // Pick up any stragglers
-      while (n2 <= ii_MaxN)
-      {
-         bits2 = __builtin_ctzll(k2);
-         
-         if (n2 + bits2 > ii_MaxN) break;
-         
-         k2 >>= bits2;
-         n2 += bits2;
-         
-         if (k2 >= il_MinK && k2 <= il_MaxK) RemoveTermsBigPrime(p2, k2, n2);
-         
-         k2 += p2;
-      }
-
-      while (n3 <= ii_MaxN)
-      {
-         bits3 = __builtin_ctzll(k3);
-         
-         if (n3 + bits3 > ii_MaxN) break;
-         
-         k3 >>= bits3;
-         n3 += bits3;
-         
-         if (k3 >= il_MinK && k3 <= il_MaxK) RemoveTermsBigPrime(p3, k3, n3);
-         
-         k3 += p3;
-      }   
-
-      while (n4 <= ii_MaxN)
-      {
-         bits4 = __builtin_ctzll(k4);
-
-         if (n4 + bits4 > ii_MaxN) break;
-         
-         k4 >>= bits4;
-         n4 += bits4;
-                  
-         if (k4 >= il_MinK && k4 <= il_MaxK) RemoveTermsBigPrime(p4, k4, n4);
-         
-         k4 += p4;
-      }   
-
-      SetLargestPrimeTested(p4, 4);
-   
-      if (p4 >= maxPrime)
-         break;
-   }
+   } while (n1 <= maxN || n2 <= maxN || n3 <= maxN || n4 <= maxN);
 }
 
 void  GFNDivisorWorker::TestMiniPrimeChunk(uint64_t *miniPrimeChunk)
@@ -252,6 +232,14 @@ void    GFNDivisorWorker::RemoveTermsSmallPrime(uint64_t thePrime, uint64_t k, u
 }
 
 
+// Since p > il_MaxK, k is rarely in the window, so the check of n is done here
+// rather than in the shift loop.
+inline void    GFNDivisorWorker::RemoveTermsInWindow(uint64_t thePrime, uint64_t k, uint32_t n)
+{
+   if (n <= ii_MaxN)
+      RemoveTermsBigPrime(thePrime, k, n);
+}
+
 // Using this bypasses a number of if checks that can be done when prime > il_MaxK.
 // Do not report k/n combinations if the k*2^n+1 is divisible by any p < 50
 void    GFNDivisorWorker::RemoveTermsBigPrime(uint64_t thePrime, uint64_t k, uint32_t n)
@@ -259,6 +247,12 @@ void    GFNDivisorWorker::RemoveTermsBigPrime(uint64_t thePrime, uint64_t k, uin
    uint32_t smallN;
    uint64_t smallK;
 
+   // Skip n that have no remaining terms and k below the first remaining k for n.
+   // The index is read without the lock.  A relaxed load is enough since its values
+   // only increase and ReportFactor checks the term again.
+   if (ip_FirstK != NULL && k < ip_FirstK[n - ii_MinN].load(std::memory_order_relaxed))
+      return;
+
    smallN = n % (2);
    smallK = k % (3);
    if ((smallK << smallN) % (3) == 2) return;
@@ -31,10 +31,13 @@ protected:
 private:
    void              TestMegaPrimeChunkSmall(void);
    void              TestMegaPrimeChunkLarge(void);
+   void              ScanShiftWindow(const uint64_t *ps, const uint64_t *ks);
    void              RemoveTermsSmallPrime(uint64_t thePrime, uint64_t k, uint32_t n);
+   void              RemoveTermsInWindow(uint64_t thePrime, uint64_t k, uint32_t n);
    void              RemoveTermsBigPrime(uint64_t thePrime, uint64_t k, uint32_t n);
 
    GFNDivisorApp    *ip_GFNDivisorApp;
+   const std::atomic<uint64_t> *ip_FirstK;
    
    uint64_t          il_KCount;
    uint32_t          ii_NCount;
@@ -26,6 +26,13 @@
 
 #define BIT(b, n)       ((((b) - ii_MinB) * GetNCount()) + ((n) - ii_MinN))
 
+// These are run by -0 (--selftest).  The factors were found with one worker.
+static const selftest_t selfTests[] = {
+   { "-b 2 -B 50 -n 3 -N 100 -s + -P 1e6", 2570, 0xf288298fc239414dULL },
+   { "-b 2 -B 50 -n 3 -N 100 -s - -P 1e6", 1636, 0xb6cafe61f8c80641ULL },
+   { NULL, 0, 0 }
+};
+
 // This is declared in App.h, but implemented here.  This means that App.h
 // can remain unchanged if using the GPUSieve framework for other applications.
 App *get_app(void)
@@ -37,6 +44,7 @@ HyperCullenWoodallApp::HyperCullenWoodallApp(void) : FactorApp()
 {
    SetBanner(APP_NAME " v" APP_VERSION ", a program to find factors numbers of the form b^n*n^b+1 and/or b^n*n^b-1");
    SetLogFileName("hcwsieve.log");
+   SetSelfTests(selfTests);
 
    ii_MinB = 0;
    ii_MaxB = 0;
@@ -23,6 +23,12 @@
 #define APP_NAME        "k1b2sieve"
 #define APP_VERSION     "1.1"
 
+// These are run by -0 (--selftest).  The factors were found with one worker.
+static const selftest_t selfTests[] = {
+   { "-n 100 -N 200 -c -1000 -C 1000 -P 1e6", 92750, 0x2fce077bfd591c3fULL },
+   { NULL, 0, 0 }
+};
+
 // This is declared in App.h, but implemented here.  This means that App.h
 // can remain unchanged if using the mtsieve framework for other applications.
 App *get_app(void)
@@ -34,6 +40,7 @@ K1B2App::K1B2App(void) : FactorApp()
 {
    SetBanner(APP_NAME " v" APP_VERSION ", a program to find factors of 2^n+c numbers for variable n and c");
    SetLogFileName("k1b2sieve.log");
+   SetSelfTests(selfTests);
 
    ii_MinN = 0;
    il_MaxC = 0;
@@ -17,7 +17,13 @@
 #include "KBBWorker.h"
 
 #define APP_NAME        "kbbsieve"
-#define APP_VERSION     "1.1"
+#define APP_VERSION     "1.2"
+
+// These are run by -0 (--selftest).  The factors were found with one worker.
+static const selftest_t selfTests[] = {
+   { "-k 3 -b 2 -B 2000 -P 1e6", 1582, 0x9d29c9cbd7320370ULL },
+   { NULL, 0, 0 }
+};
 
 // This is declared in App.h, but implemented here.  This means that App.h
 // can remain unchanged if using the mtsieve framework for other applications.
@@ -30,6 +36,7 @@ KBBApp::KBBApp() : AlgebraicFactorApp()
 {
    SetBanner(APP_NAME " v" APP_VERSION ", a program to find factors of k*b^b+c numbers for fixed k and c = +1/-1");
    SetLogFileName("kbb.log");
+   SetSelfTests(selfTests);
 
    SetAppMinPrime(3);
    
@@ -12,6 +12,14 @@
 #include "KBBWorker.h"
 #include "../core/MpArithVector.h"
 
+// b^b for b = q*m is (q^q)^m * (m^m)^q.  If m is in the list, then m^m has already
+// been computed for these primes, so b^b needs a few multiplications instead of a
+// full exponentiation.  Only small q are used so that (q^q)^m can be computed by
+// stepping from the previous m.
+#define KBB_SMALL_PRIMES   4
+
+static const uint32_t smallPrimes[KBB_SMALL_PRIMES] = { 2, 3, 5, 7 };
+
 KBBWorker::KBBWorker(uint32_t myId, App *theApp) : Worker(myId, theApp)
 {
    ip_KBBApp = (KBBApp *) theApp;
@@ -23,6 +31,14 @@ KBBWorker::KBBWorker(uint32_t myId, App *theApp) : Worker(myId, theApp)
    
    ip_Bases = (uint32_t *) xmalloc(ii_BaseCount, sizeof(uint32_t), "bases");
    
+   // Only b <= bmax/2 can be m in b*q
+   ii_SavedCount = 0;
+   if (ip_KBBApp->GetMaxB() / 2 >= ip_KBBApp->GetMinB())
+      ii_SavedCount = ip_KBBApp->GetMaxB() / 2 - ip_KBBApp->GetMinB() + 1;
+   
+   ip_InList = (bool *) xmalloc(ii_SavedCount + 1, sizeof(bool), "inList");
+   ip_BToB = (MpResVec *) xmalloc(ii_SavedCount + 1, sizeof(MpResVec), "bToB");
+   
    il_NextBaseBuild = 0;
    
    // The thread can't start until initialization is done
@@ -31,13 +47,20 @@ KBBWorker::KBBWorker(uint32_t myId, App *theApp) : Worker(myId, theApp)
 
 void  KBBWorker::CleanUp(void)
 {
+   xfree(ip_Bases);
+   xfree(ip_InList);
+   xfree(ip_BToB);
 }
 
 void  KBBWorker::TestMegaPrimeChunk(void)
 {
    uint64_t ps[4];
    uint64_t maxPrime = ip_App->GetMaxPrime();
-   uint32_t idx;
+   uint32_t minB = ip_KBBApp->GetMinB();
+   uint32_t idx, sIdx, b, m, q;
+   uint32_t stepM[KBB_SMALL_PRIMES];
+   MpResVec qToQ[KBB_SMALL_PRIMES], step[KBB_SMALL_PRIMES];
+   MpResVec res;
 
    ps[0] = ps[1] = ps[2] = ps[3] = 0;
 
@@ -52,9 +75,7 @@ void  KBBWorker::TestMegaPrimeChunk(void)
       // which will speed up testing for the next range of p.
       if (ps[0] > il_NextBaseBuild)
       {
-         memset(ip_Bases, 0, ii_BaseCount * sizeof(uint32_t));
-         
-         ip_KBBApp->GetBases(ip_Bases);
+         BuildBaseList();
          
          il_NextBaseBuild = (ps[3] << 1);
       }
@@ -65,15 +86,54 @@ void  KBBWorker::TestMegaPrimeChunk(void)
       
       const MpResVec pOne = mp.one();
       const MpResVec mOne = mp.sub(mp.zero(), pOne);
+      
+      // step[sIdx] is (q^q)^m for the last m used with q
+      for (sIdx=0; sIdx<KBB_SMALL_PRIMES; sIdx++)
+      {
+         q = smallPrimes[sIdx];
+         
+         qToQ[sIdx] = mp.pow(mp.nToRes(q), q);
+         stepM[sIdx] = 0;
+      }
    
       for (idx=0; idx<ii_BaseCount; idx++)
       {
          if (ip_Bases[idx] == 0)
             break;
          
-         MpResVec res = mp.nToRes(ip_Bases[idx]);
+         b = ip_Bases[idx];
          
-         res = mp.pow(res, ip_Bases[idx]);
+         for (sIdx=0; sIdx<KBB_SMALL_PRIMES; sIdx++)
+         {
+            q = smallPrimes[sIdx];
+            m = b / q;
+            
+            if (m * q == b && m >= minB && ip_InList[m - minB])
+               break;
+         }
+         
+         if (sIdx < KBB_SMALL_PRIMES)
+         {
+            if (stepM[sIdx] == 0)
+               step[sIdx] = mp.pow(qToQ[sIdx], m);
+            else if (m - stepM[sIdx] == 1)
+               step[sIdx] = mp.mul(step[sIdx], qToQ[sIdx]);
+            else
+               step[sIdx] = mp.mul(step[sIdx], mp.pow(qToQ[sIdx], m - stepM[sIdx]));
+            
+            stepM[sIdx] = m;
+            
+            res = mp.pow(ip_BToB[m - minB], q);
+            res = mp.mul(res, step[sIdx]);
+         }
+         else
+         {
+            res = mp.nToRes(b);
+            res = mp.pow(res, b);
+         }
+         
+         if (b - minB < ii_SavedCount)
+            ip_BToB[b - minB] = res;
          
          res = mp.mul(res, resK);
                   
@@ -82,7 +142,7 @@ void  KBBWorker::TestMegaPrimeChunk(void)
             for (size_t k = 0; k < VECTOR_SIZE; ++k)
             {
                if (res[k] == pOne[k])
-                  ip_KBBApp->ReportFactor(ps[k], ip_Bases[idx], -1);
+                  ip_KBBApp->ReportFactor(ps[k], b, -1);
             }
          }
          
@@ -91,16 +151,32 @@ void  KBBWorker::TestMegaPrimeChunk(void)
             for (size_t k = 0; k < VECTOR_SIZE; ++k)
             {
                if (res[k] == mOne[k]) 
-                  ip_KBBApp->ReportFactor(ps[k], ip_Bases[idx], +1);
+                  ip_KBBApp->ReportFactor(ps[k], b, +1);
             }
          }
       }
       
+      SetLargestPrimeTested(ps[3], 4);
+      
       if (ps[3] > maxPrime)
          break;
    }
+}
+
+// The bases are in ascending order, so when b^b is computed m^m has already been
+// computed for every m in the list that is less than b.
+void  KBBWorker::BuildBaseList(void)
+{
+   uint32_t minB = ip_KBBApp->GetMinB();
+   
+   memset(ip_Bases, 0, ii_BaseCount * sizeof(uint32_t));
+   memset(ip_InList, 0, ii_SavedCount * sizeof(bool));
+   
+   ip_KBBApp->GetBases(ip_Bases);
    
-   SetLargestPrimeTested(ps[3], 4);
+   for (uint32_t idx=0; idx<ii_BaseCount && ip_Bases[idx] > 0; idx++)
+      if (ip_Bases[idx] - minB < ii_SavedCount)
+         ip_InList[ip_Bases[idx] - minB] = true;
 }
 
 void  KBBWorker::TestMiniPrimeChunk(uint64_t *miniPrimeChunk)
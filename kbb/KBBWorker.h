@@ -11,6 +11,7 @@
 
 #include "KBBApp.h"
 #include "../core/Worker.h"
+#include "../core/MpArithVector.h"
 
 using namespace std;
 
@@ -29,12 +30,20 @@ protected:
    void              NotifyPrimeListAllocated(uint32_t primesInList) {}
 
 private:
+   void              BuildBaseList(void);
+   
    KBBApp           *ip_KBBApp;
 
    uint64_t          il_NextBaseBuild;
    uint32_t          ii_BaseCount;
    uint32_t         *ip_Bases;
    
+   // b^b is saved for each b <= bmax/2 in the list so that it can be used for the
+   // multiples of b.  ip_InList is true for those b that are in the list.
+   uint32_t          ii_SavedCount;
+   bool             *ip_InList;
+   MpResVec         *ip_BToB;
+   
    uint64_t          il_K;
 };
 
@@ -35,6 +35,12 @@ int sortByXY(const void *a, const void *b)
    return (aPtr->x - bPtr->x);
 }
 
+// These are run by -0 (--selftest).  The factors were found with one worker.
+static const selftest_t selfTests[] = {
+   { "-x 20 -X 200 -y 20 -Y 200 -s b -P 1e6", 11953, 0x643d01512c2333f1ULL },
+   { NULL, 0, 0 }
+};
+
 // This is declared in App.h, but implemented here.  This means that App.h
 // can remain unchanged if using the GPUSieve framework for other applications.
 App *get_app(void)
@@ -46,6 +52,7 @@ LifchitzApp::LifchitzApp(void) : FactorApp()
 {
    SetBanner(APP_NAME " v" APP_VERSION ", a program to find factors numbers of the form x^x+y^y and x^x-y^y");
    SetLogFileName("lifsieve.log");
+   SetSelfTests(selfTests);
 
    ii_MinX = 0;
    ii_MaxX = 0;
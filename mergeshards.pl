@@ -0,0 +1,162 @@
+#!/usr/bin/perl
+# mergeshards.pl -- (C) Mark Rodenkirch, October 2026
+#
+# Combine the terms files written by twinsieve, fbncsieve, sgsieve, ccsieve, and
+# dmdsieve when they are run with -z i/m into one terms file.  Each shard writes
+# its own terms file (for example k_b2_n1000_s1of4.pfgw), so run this with every
+# shard's terms file:
+#
+#    perl mergeshards.pl k_b2_n1000.pfgw k_b2_n1000_s*of4.pfgw
+#
+# The merged file is sorted by k and its "Sieved to" is the smallest of the shards.
+# A shard without terms writes an empty terms file, which is skipped.  If every file
+# is empty, then the merged file is empty too.  ABC, ABCD, CC, and NewPGen files are
+# supported.  The factors files of the shards do not need to be merged.  They can
+# simply be concatenated.
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+use strict;
+use warnings;
+
+die "Usage: perl mergeshards.pl output_file shard_file1 shard_file2 ...\n" if (scalar(@ARGV) < 2);
+
+my $output_file = shift @ARGV;
+
+my $format;
+my $min_sieved_to;
+my @block_keys;
+my %block_headers;
+my %block_terms;
+my $sequence = 0;
+
+foreach my $input_file (@ARGV) {
+   die "$input_file cannot be both an input file and the output file\n" if ($input_file eq $output_file);
+
+   open(my $in, '<', $input_file) or die "Unable to open $input_file: $!\n";
+
+   my $header = <$in>;
+   next if (!defined($header));
+   $header =~ s/[\r\n]*$//;
+
+   my ($file_format, $sieved_to);
+
+   if ($header =~ /^ABCD /) { $file_format = 'ABCD'; }
+   elsif ($header =~ /^ABC /) { $file_format = 'ABC'; }
+   elsif ($header =~ /^CC /) { $file_format = 'CC'; }
+   elsif ($header =~ /^(\d+):/) { $file_format = 'NPG'; }
+   else { die "$input_file has an unknown format\n"; }
+
+   die "$input_file is $file_format, but the other files are $format\n" if (defined($format) && $format ne $file_format);
+   $format = $file_format;
+
+   my $block_key;
+   my $k = 0;
+
+   while (defined($header)) {
+      my $line;
+
+      if ($format eq 'NPG') {
+         ($sieved_to) = ($header =~ /^(\d+):/);
+         ($block_key = $header) =~ s/^\d+//;
+      }
+      else {
+         ($sieved_to) = ($header =~ /Sieved to (\d+)/);
+         die "$input_file does not have Sieved to in its header\n" if (!defined($sieved_to));
+
+         # The first k of an ABCD block is not part of the key
+         ($block_key = $header) =~ s/Sieved to \d+/Sieved to %s/;
+         $k = $1 if ($format eq 'ABCD' && $block_key =~ s/\[(\d+)\]/[%s]/);
+      }
+
+      $min_sieved_to = $sieved_to if (!defined($min_sieved_to) || $sieved_to < $min_sieved_to);
+
+      if (!exists($block_headers{$block_key})) {
+         die "$input_file was not sieved with the same options as $ARGV[0]\n" if ($format ne 'ABCD' && scalar(@block_keys) > 0);
+
+         push @block_keys, $block_key;
+         $block_headers{$block_key} = $block_key;
+         $block_terms{$block_key} = [];
+      }
+
+      # For ABCD the header has the first term
+      push @{$block_terms{$block_key}}, [$k, '', $sequence++] if ($format eq 'ABCD');
+
+      $header = undef;
+
+      while (defined($line = <$in>)) {
+         $line =~ s/[\r\n]*$//;
+         next if ($line eq '');
+
+         if ($line =~ /^ABCD /) {
+            $header = $line;
+            last;
+         }
+
+         my ($value, $rest) = ($line =~ /^(\d+)(.*)$/);
+         die "Line $line in $input_file is malformed\n" if (!defined($value));
+
+         # For ABCD the first value is the difference from the previous k
+         $k = ($format eq 'ABCD') ? $k + $value : $value;
+
+         push @{$block_terms{$block_key}}, [$k, $rest, $sequence++];
+      }
+   }
+
+   close($in);
+}
+
+open(my $out, '>', $output_file) or die "Unable to open $output_file: $!\n";
+
+if (!defined($format)) {
+   close($out);
+   print "None of the " . scalar(@ARGV) . " files have terms, so $output_file is empty\n";
+   exit(0);
+}
+
+my $term_count = 0;
+
+foreach my $block_key (@block_keys) {
+   # Terms for the same k, such as +1 and -1 in an ABC file, keep their order
+   my @terms = sort { $a->[0] <=> $b->[0] || $a->[2] <=> $b->[2] } @{$block_terms{$block_key}};
+   my $prev_k;
+
+   foreach my $term (@terms) {
+      my ($k, $rest) = @$term;
+
+      if ($format eq 'ABCD') {
+         if (!defined($prev_k)) {
+            my $header = $block_headers{$block_key};
+            $header =~ s/\[%s\]/[$k]/;
+            $header =~ s/Sieved to %s/Sieved to $min_sieved_to/;
+            print $out "$header\n";
+         }
+         else {
+            print $out ($k - $prev_k) . "$rest\n";
+         }
+      }
+      else {
+         if ($term_count == 0) {
+            if ($format eq 'NPG') {
+               print $out "$min_sieved_to$block_key\n";
+            }
+            else {
+               my $header = $block_headers{$block_key};
+               $header =~ s/Sieved to %s/Sieved to $min_sieved_to/;
+               print $out "$header\n";
+            }
+         }
+
+         print $out "$k$rest\n";
+      }
+
+      $prev_k = $k;
+      $term_count++;
+   }
+}
+
+close($out);
+
+print "Merged $term_count terms from " . scalar(@ARGV) . " files into $output_file sieved to $min_sieved_to\n";
@@ -29,6 +29,13 @@
 
 #define BIT(n)          ((n) - ii_MinN)
 
+// These are run by -0 (--selftest).  The factors were found with one worker.
+static const selftest_t selfTests[] = {
+   { "-n 100 -N 5000 -m 1 -P 1e6",  5374, 0x606d7d216a6b6c14ULL },
+   { "-n 100 -N 10000 -m 2 -P 1e6", 5704, 0xc59d9d3e94ea6c3aULL },
+   { NULL, 0, 0 }
+};
+
 // This is declared in App.h, but implemented here.  This means that App.h
 // can remain unchanged if using the CPUSieve framework for other applications.
 App *get_app(void)
@@ -40,6 +47,7 @@ MultiFactorialApp::MultiFactorialApp() : FactorApp()
 {
    SetBanner(APP_NAME " v" APP_VERSION ", a program to find factors of multi-factorials");
    SetLogFileName("mfsieve.log");
+   SetSelfTests(selfTests);
 
    ii_MultiFactorial = 1;
    ii_MinN = 0;
@@ -27,10 +27,22 @@
 #define APP_NAME        "pixsieve"
 #endif
 
-#define APP_VERSION     "2.5"
+#define APP_VERSION     "2.6"
 
 #define BIT(l)          ((l) - ii_MinLength)
 
+#define SELFTEST_STRING_FILE    "selftest_string.txt"
+#define SELFTEST_STRING_LENGTH  5000
+
+// These are run by -0 (--selftest).  The factors were found with one worker.
+// The string is written by RunSelfTests.
+static const selftest_t selfTests[] = {
+   { "-s selftest_string.txt -l 10 -L 2000 -P 1e6",       1892, 0x68940bf56607ef3fULL },
+   { "-s selftest_string.txt -l 10 -L 2000 -P 1e6 -m 8",  1892, 0x68940bf56607ef3fULL },
+   { "-s selftest_string.txt -l 10 -L 2000 -P 1e6 -m 16", 1892, 0x68940bf56607ef3fULL },
+   { NULL, 0, 0 }
+};
+
 // This is declared in App.h, but implemented here.  This means that App.h
 // can remain unchanged if using the CPUSieve framework for other applications.
 App *get_app(void)
@@ -42,9 +54,16 @@ PrimesInXApp::PrimesInXApp() : FactorApp()
 {
    SetBanner(APP_NAME " v" APP_VERSION ", a program to find factors of substrings of a decimal string");
    SetLogFileName("pixsieve.log");
+   SetSelfTests(selfTests);
 
-   // This is because the assembly code is using SSE to do the mulmods
-   SetAppMaxPrime(PMAX_MAX_52BIT);
+   // The assembly code is limited to p < 2^52, but the Montgomery logic is not.
+   SetAppMaxPrime(PMAX_MAX_62BIT);
+   
+#ifdef USE_X86
+   ii_MontgomeryLanes = 0;
+#else
+   ii_MontgomeryLanes = 8;
+#endif
    
    ii_MinLength = 0;
    ii_MinLengthRemaining = 0;
@@ -79,6 +98,12 @@ void PrimesInXApp::Help(void)
    printf("-L --maxlength=L      maximum length to search\n");
    printf("-s --stringfile=s     file containing a decimal representation of any number\n");
    printf("-S --searchstring=S   starting point of substring to start factoring\n");
+#ifdef USE_X86
+   printf("-m --montgomery=m     use Montgomery logic with m (8 or 16) primes per vector\n");
+   printf("                      (default is x86 asm for p < 2^52 and Montgomery for p > 2^52)\n");
+#else
+   printf("-m --montgomery=m     use Montgomery logic with m (8 or 16) primes per vector (default %u)\n", ii_MontgomeryLanes);
+#endif
    
 #if defined(USE_OPENCL) || defined(USE_METAL)
    printf("-N --step=N           max steps iterated per call to GPU (default %d)\n", ii_MaxGpuSteps);
@@ -90,7 +115,7 @@ void  PrimesInXApp::AddCommandLineOptions(string &shortOpts, struct option *long
 {
    FactorApp::ParentAddCommandLineOptions(shortOpts, longOpts);
 
-   shortOpts += "l:L:s:S:i:o:N:M:";
+   shortOpts += "l:L:s:S:i:o:N:M:m:";
 
    AppendLongOpt(longOpts, "minlength",     required_argument, 0, 'l');
    AppendLongOpt(longOpts, "maxlength",     required_argument, 0, 'L');
@@ -98,6 +123,7 @@ void  PrimesInXApp::AddCommandLineOptions(string &shortOpts, struct option *long
    AppendLongOpt(longOpts, "searchstring",  required_argument, 0, 'S');
    AppendLongOpt(longOpts, "inputfile",     required_argument, 0, 'i');
    AppendLongOpt(longOpts, "outputfile",    required_argument, 0, 'o');
+   AppendLongOpt(longOpts, "montgomery",    required_argument, 0, 'm');
    
 #if defined(USE_OPENCL) || defined(USE_METAL)
    AppendLongOpt(longOpts, "steps",         required_argument, 0, 'N');
@@ -133,6 +159,13 @@ parse_t PrimesInXApp::ParseOption(int opt, char *arg, const char *source)
          status = P_SUCCESS;
          break;
          
+      case 'm':
+         status = Parser::Parse(arg, 8, 16, ii_MontgomeryLanes);
+         
+         if (status == P_SUCCESS && ii_MontgomeryLanes != 8 && ii_MontgomeryLanes != 16)
+            status = P_OUT_OF_RANGE;
+         break;
+         
 #if defined(USE_OPENCL) || defined(USE_METAL)
       case 'N':
          status = Parser::Parse(arg, 100, 1000000000, ii_MaxGpuSteps);
@@ -184,11 +217,45 @@ void PrimesInXApp::ValidateOptions(void)
 
    FactorApp::ParentValidateOptions();
 
-   // We want worksize to be divisible by 4
-   while (ii_CpuWorkSize % 4 != 0)
+   // We want worksize to be divisible by 16 as that is the largest vector size
+   while (ii_CpuWorkSize % 16 != 0)
       ii_CpuWorkSize++;
 }
 
+// The tests need a string of digits.  It is built by a linear congruential generator
+// so that it is the same on every computer.
+bool PrimesInXApp::RunSelfTests(const char *programName)
+{
+   FILE     *fPtr;
+   uint64_t  x = 1;
+   bool      passed;
+
+   fPtr = fopen(SELFTEST_STRING_FILE, "w");
+
+   if (fPtr == NULL)
+      FatalError("Unable to open output file %s", SELFTEST_STRING_FILE);
+
+   for (uint32_t idx=0; idx<SELFTEST_STRING_LENGTH; idx++)
+   {
+      x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+
+      // The string cannot start with 0
+      if (idx == 0 && (x >> 33) % 10 == 0)
+         fputc('1', fPtr);
+      else
+         fputc('0' + (int) ((x >> 33) % 10), fPtr);
+   }
+
+   fputc('\n', fPtr);
+   fclose(fPtr);
+
+   passed = FactorApp::RunSelfTests(programName);
+
+   remove(SELFTEST_STRING_FILE);
+
+   return passed;
+}
+
 Worker *PrimesInXApp::CreateWorker(uint32_t id, bool gpuWorker, uint64_t largestPrimeTested)
 {
    Worker *theWorker;
@@ -507,9 +574,6 @@ void PrimesInXApp::ReportPrime(uint64_t thePrime, uint32_t n)
 
 void  PrimesInXApp::VerifyFactor(uint64_t theFactor, uint32_t termLength)
 {
-   // Note that p is limited to 2^52, so we are not using extended precision
-   // in this function.
-
    MpArith  mp(theFactor);
    MpRes    mpDigits[10];
    MpRes    mpRem = mp.zero();
@@ -25,6 +25,7 @@ public:
    void              AddCommandLineOptions(std::string &shortOpts, struct option *longOpts);
    parse_t           ParseOption(int opt, char *arg, const char *source);
    void              ValidateOptions(void);
+   bool              RunSelfTests(const char *programName);
    bool              ApplyFactor(uint64_t theFactor, const char *term);
    void              GetExtraTextForSieveStartedMessage(char *extraText, uint32_t maxTextLength);
    
@@ -36,6 +37,7 @@ public:
    uint32_t          GetMinLength(void) { return ii_MinLength; };
    uint32_t          GetMinLengthRemaining(void) { return ii_MinLengthRemaining; };
    uint32_t          GetMaxLength(void) { return ii_MaxLength; };
+   uint32_t          GetMontgomeryLanes(void) { return ii_MontgomeryLanes; };
 
    uint32_t         *Get1DigitTerms(void) { return ii_e1Terms; };
    uint32_t         *Get3DigitTermsCopy(void);
@@ -74,6 +76,8 @@ private:
    uint32_t          ii_MaxGpuFactors;
 #endif
 
+   uint32_t          ii_MontgomeryLanes;
+   
    uint32_t          ii_MinLength;
    uint32_t          ii_MinLengthRemaining;
    uint32_t          ii_MaxLength;
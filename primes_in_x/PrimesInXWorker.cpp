@@ -11,8 +11,12 @@
 
 #include <cinttypes>
 #include "PrimesInXWorker.h"
+#include "../core/MpArith.h"
+#include "../core/MpArithVector.h"
 
+#ifdef USE_X86
 extern "C" int   pixsieve(const uint32_t *N1, const uint32_t *N2, const uint64_t *P, const uint64_t mult) __attribute__ ((pure));
+#endif
 
 PrimesInXWorker::PrimesInXWorker(uint32_t myId, App *theApp) : Worker(myId, theApp)
 {
@@ -23,6 +27,10 @@ PrimesInXWorker::PrimesInXWorker(uint32_t myId, App *theApp) : Worker(myId, theA
    ii_e6Terms = ip_PrimesInXApp->Get6DigitTermsCopy();
    ii_e9Terms = ip_PrimesInXApp->Get9DigitTermsCopy();
    
+   ii_e1Terms = ip_PrimesInXApp->Get1DigitTerms();
+   ii_MaxLength = ip_PrimesInXApp->GetMaxLength();
+   ii_MontgomeryLanes = ip_PrimesInXApp->GetMontgomeryLanes();
+   
    ib_Initialized = true;
 }
 
@@ -35,75 +43,189 @@ void  PrimesInXWorker::CleanUp(void)
 
 void  PrimesInXWorker::TestMegaPrimeChunk(void)
 {
-   uint64_t  ps[4];
-   uint32_t  saveTerm;
-   int32_t   gotFactor, index = 0, power;
-   uint32_t  lminRemaining = ip_PrimesInXApp->GetMinLengthRemaining();
-   uint32_t *n1, *n2 = ip_PrimesInXApp->Get1DigitTerms();
-   uint32_t  multiplier;
    uint64_t  maxPrime = ip_PrimesInXApp->GetMaxPrime();
+   uint32_t  primesPerVector = (ii_MontgomeryLanes == 16 ? 16 : 8);
+   uint64_t *ps;
 
-   for (uint32_t pIdx=0; pIdx<ii_PrimesInList; pIdx+=4)
+   for (uint32_t pIdx=0; pIdx<ii_PrimesInList; pIdx+=primesPerVector)
    {
-      ps[0] = il_PrimeList[pIdx+0];
-      ps[1] = il_PrimeList[pIdx+1];
-      ps[2] = il_PrimeList[pIdx+2];
-      ps[3] = il_PrimeList[pIdx+3];
-            
-      if (lminRemaining > 9 && ps[0] > 1000000000)
-      {
-         power = 9;
-         
-         // Can only use this after reaching p=1e9
-         index = (lminRemaining / power) - 1;
-         n1 = ii_e9Terms;
-         multiplier = 1000000000;
-      }
-      else if (lminRemaining > 6 && ps[0] > 1000000)
-      {
-         power = 6;
-         
-         // Can only use this after reaching p=1e6
-         index = (lminRemaining / power) - 1;
-         n1 = ii_e6Terms;
-         multiplier = 1000000;
-      }
-      else if (lminRemaining > 3 && ps[0] > 1000)
+      ps = &il_PrimeList[pIdx];
+
+#ifdef USE_X86
+      // The assembly code is limited to p < 2^52.
+      if (ii_MontgomeryLanes == 0 && ps[primesPerVector-1] < PMAX_MAX_52BIT)
       {
-         power = 3;
-         
-         // Can only use this after reaching p=1e3
-         index = (lminRemaining / power) - 1;
-         n1 = ii_e3Terms;
-         multiplier = 1000;
+         for (uint32_t idx=0; idx<primesPerVector; idx+=4)
+            TestPrimesAsm(&ps[idx]);
       }
+      else
+#endif
+      if (primesPerVector == 16)
+         TestPrimesMp<16>(ps);
+      else
+         TestPrimesMp<8>(ps);
+      
+      SetLargestPrimeTested(ps[primesPerVector-1], primesPerVector);
 
-      if (index > 0)
-      {
-         // Set the "end of list" dynamically
-         saveTerm = n1[index];
-         n1[index] = multiplier;
+      if (ps[0] > maxPrime)
+         break;
+   }
+}
+
+#ifdef USE_X86
+void  PrimesInXWorker::TestPrimesAsm(uint64_t *ps)
+{
+   uint32_t  saveTerm;
+   int32_t   gotFactor, index = 0, power;
+   uint32_t  lminRemaining = ip_PrimesInXApp->GetMinLengthRemaining();
+   uint32_t *n1, *n2 = ii_e1Terms;
+   uint32_t  multiplier;
+
+   if (lminRemaining > 9 && ps[0] > 1000000000)
+   {
+      power = 9;
       
-         gotFactor = pixsieve(n1, &n2[index*power], ps, multiplier);
+      // Can only use this after reaching p=1e9
+      index = (lminRemaining / power) - 1;
+      n1 = ii_e9Terms;
+      multiplier = 1000000000;
+   }
+   else if (lminRemaining > 6 && ps[0] > 1000000)
+   {
+      power = 6;
       
-         // Restore the "end of list"
-         n1[index] = saveTerm;
-      }
-      else
-         gotFactor = pixsieve(n2, 0, ps, 10);
+      // Can only use this after reaching p=1e6
+      index = (lminRemaining / power) - 1;
+      n1 = ii_e6Terms;
+      multiplier = 1000000;
+   }
+   else if (lminRemaining > 3 && ps[0] > 1000)
+   {
+      power = 3;
+      
+      // Can only use this after reaching p=1e3
+      index = (lminRemaining / power) - 1;
+      n1 = ii_e3Terms;
+      multiplier = 1000;
+   }
+
+   if (index > 0)
+   {
+      // Set the "end of list" dynamically
+      saveTerm = n1[index];
+      n1[index] = multiplier;
+   
+      gotFactor = pixsieve(n1, &n2[index*power], ps, multiplier);
    
-      if (gotFactor)
+      // Restore the "end of list"
+      n1[index] = saveTerm;
+   }
+   else
+      gotFactor = pixsieve(n2, 0, ps, 10);
+
+   if (gotFactor)
+   {
+      ExtractFactors(ps[0]);
+      ExtractFactors(ps[1]);
+      ExtractFactors(ps[2]);
+      ExtractFactors(ps[3]);
+   }
+}
+#endif
+
+// The remainder is kept in normal form rather than Montgomery form.  Multiplying a
+// normal residue by the Montgomery form of 10 yields a normal residue, so each digit
+// can be added without conversion.  Unlike the assembly code, factors are reported
+// as they are found, so there is no need to extract them afterwards.
+template <size_t N>
+void  PrimesInXWorker::TestPrimesMp(uint64_t *ps)
+{
+   uint64_t          vps[N];
+   MpResVector<N>    digits[10];
+   uint32_t          lminRemaining = ip_PrimesInXApp->GetMinLengthRemaining();
+   uint32_t          i, k, firstLane = 0, firstDigit = 0;
+   uint32_t         *chunks = NULL, power = 0, multiplier = 0;
+
+   for (k=0; k<N; k++)
+      vps[k] = ps[k];
+   
+   // Montgomery arithmetic needs an odd modulus.  Since 2 is the first prime, the first
+   // lane repeats the next prime and is not reported.  A term is divisible by 2 if its
+   // last digit is even.
+   if (vps[0] == 2)
+   {
+      vps[0] = vps[1];
+      firstLane = 1;
+      
+      for (i=0; i<ii_MaxLength; i++)
+         if ((ii_e1Terms[i] & 1) == 0)
+            ReportFactorOrPrime(2, i+1);
+   }
+   
+   MpArithVector<N>  mp(vps);
+   MpResVector<N>    ten = mp.nToRes(10);
+   MpResVector<N>    rem = mp.zero();
+   
+   for (uint32_t d=0; d<10; d++)
+      for (k=0; k<N; k++)
+         digits[d][k] = d % vps[k];
+   
+   // As in the assembly code, the terms shorter than the shortest remaining term are not
+   // checked, so those digits are added 3, 6, or 9 at a time.  Each chunk of digits is
+   // less than the smallest p, so it does not need to be reduced.
+   if (lminRemaining > 9 && ps[0] > 1000000000)
+   {
+      power = 9;
+      chunks = ii_e9Terms;
+      multiplier = 1000000000;
+   }
+   else if (lminRemaining > 6 && ps[0] > 1000000)
+   {
+      power = 6;
+      chunks = ii_e6Terms;
+      multiplier = 1000000;
+   }
+   else if (lminRemaining > 3 && ps[0] > 1000)
+   {
+      power = 3;
+      chunks = ii_e3Terms;
+      multiplier = 1000;
+   }
+   
+   if (power > 0)
+   {
+      MpResVector<N> resMultiplier = mp.nToRes(multiplier);
+      MpResVector<N> chunk;
+      uint32_t       chunkCount = (lminRemaining / power) - 1;
+      
+      for (uint32_t c=0; c<chunkCount; c++)
       {
-         ExtractFactors(ps[0]);
-         ExtractFactors(ps[1]);
-         ExtractFactors(ps[2]);
-         ExtractFactors(ps[3]);
+         for (k=0; k<N; k++)
+            chunk[k] = chunks[c];
+         
+         rem = mp.mul(rem, resMultiplier);
+         rem = mp.add(rem, chunk);
       }
       
-      SetLargestPrimeTested(ps[3], 4);
+      firstDigit = chunkCount * power;
+   }
+   
+   for (i=firstDigit; i<ii_MaxLength; i++)
+   {
+      rem = mp.mul(rem, ten);
+      rem = mp.add(rem, digits[ii_e1Terms[i]]);
 
-      if (ps[0] > maxPrime)
-         break;
+      uint64_t allNonZero = 1;
+      
+      for (k=0; k<N; k++)
+         allNonZero &= (rem[k] != 0);
+
+      if (allNonZero)
+         continue;
+      
+      for (k=firstLane; k<N; k++)
+         if (rem[k] == 0)
+            ReportFactorOrPrime(vps[k], i+1);
    }
 }
 
@@ -112,6 +234,7 @@ void  PrimesInXWorker::TestMiniPrimeChunk(uint64_t *miniPrimeChunk)
    FatalError("PrimesInXWorker::TestMiniPrimeChunk not implemented");
 }
 
+#ifdef USE_X86
 void  PrimesInXWorker::ExtractFactors(uint64_t p)
 {
    // Note that p is limited to 2^52, so we are not using extended precision
@@ -121,25 +244,16 @@ void  PrimesInXWorker::ExtractFactors(uint64_t p)
    // doesn't tell us the term or the p for it, so we will use
    // the long way to find it.
    double   inverse, qd;
-   uint64_t rem;
-   uint32_t i, n, plength, firstDigit;
+   int64_t  rem;
+   uint32_t i, n;
    int64_t  q;
 
-   uint32_t *terms = ip_PrimesInXApp->Get1DigitTerms();
+   uint32_t *terms = ii_e1Terms;
 
-   plength = 1;
-   rem = p;
-   while (rem > 10)
-   {
-      plength++;
-      rem /= 10;
-   }
-   firstDigit = rem;
-   
    inverse = 1.0/p;
    rem = 0;
 
-   for (i=0; i<=ip_PrimesInXApp->GetMaxLength(); i++)
+   for (i=0; i<ii_MaxLength; i++)
    {
 #if defined(__GNUC__) && defined(PREFETCH)
       __builtin_prefetch(&terms[i+PREFETCH], 0, 0);
@@ -154,15 +268,28 @@ void  PrimesInXWorker::ExtractFactors(uint64_t p)
 
       if (rem < 0)
          rem += p;
-      else if (rem >= p)
+      else if (rem >= (int64_t) p)
          rem -= p;
 
       if (rem == 0)
-      {
-         if (plength == i+1 && terms[0] == firstDigit)
-            ip_PrimesInXApp->ReportPrime(p, i+1);
-         else 
-            ip_PrimesInXApp->ReportFactor(p, i+1);
-      }
+         ReportFactorOrPrime(p, i+1);
    }
 }
+#endif
+
+// If the term is p, then the term is prime.
+void  PrimesInXWorker::ReportFactorOrPrime(uint64_t p, uint32_t length)
+{
+   uint64_t term = 0;
+
+   if (length <= 19)
+   {
+      for (uint32_t i=0; i<length; i++)
+         term = (term * 10) + ii_e1Terms[i];
+   }
+   
+   if (term == p)
+      ip_PrimesInXApp->ReportPrime(p, length);
+   else 
+      ip_PrimesInXApp->ReportFactor(p, length);
+}
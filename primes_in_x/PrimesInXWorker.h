@@ -32,10 +32,22 @@ protected:
    void              NotifyPrimeListAllocated(uint32_t primesInList) {};
    
 private:
+#ifdef USE_X86
+   void              TestPrimesAsm(uint64_t *ps);
    void              ExtractFactors(uint64_t p);
+#endif
+
+   template <size_t N>
+   void              TestPrimesMp(uint64_t *ps);
+   
+   void              ReportFactorOrPrime(uint64_t p, uint32_t length);
 
    PrimesInXApp     *ip_PrimesInXApp;
 
+   uint32_t          ii_MontgomeryLanes;
+   uint32_t          ii_MaxLength;
+   uint32_t         *ii_e1Terms;
+
    uint32_t         *ii_e3Terms;                        // The string as an array of terms < 1000
    uint32_t         *ii_e6Terms;                        // The string as an array of terms < 1000000 
    uint32_t         *ii_e9Terms;                        // The string as an array of trems < 1000000000
@@ -36,6 +36,12 @@
 
 #define BIT(primorial)  ((primorial) - ii_MinPrimorial)
 
+// These are run by -0 (--selftest).  The factors were found with one worker.
+static const selftest_t selfTests[] = {
+   { "-n 100 -N 10000 -P 1e6", 1022, 0xe746f6d0d844de95ULL },
+   { NULL, 0, 0 }
+};
+
 // This is declared in App.h, but implemented here.  This means that App.h
 // can remain unchanged if using the CPUSieve framework for other applications.
 App *get_app(void)
@@ -47,6 +53,7 @@ PrimorialApp::PrimorialApp() : FactorApp()
 {
    SetBanner(APP_NAME " v" APP_VERSION ", a program to find factors of primorials");
    SetLogFileName("psieve.log");
+   SetSelfTests(selfTests);
 
    ii_MinPrimorial = 100;
    ii_MaxPrimorial = 0;
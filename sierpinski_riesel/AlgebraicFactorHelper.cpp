@@ -14,14 +14,10 @@
 #include "AlgebraicFactorHelper.h"
 
 #include "../core/inline.h"
-#include "../primesieve/include/primesieve.hpp"
-
-#define SMALL_PRIME_COUNT  100000
 
 AlgebraicFactorHelper::AlgebraicFactorHelper(App *theApp, uint32_t base, uint32_t minN, uint32_t maxN)
 {
-   // Generate primes for this worker
-   primesieve::generate_n_primes(SMALL_PRIME_COUNT, 1, &iv_SmallPrimes);
+   ip_FactorIndex = new SmallFactorIndex();
 
    ip_App = theApp;
    
@@ -36,6 +32,39 @@ AlgebraicFactorHelper::AlgebraicFactorHelper(App *theApp, uint32_t base, uint32_
 
 AlgebraicFactorHelper::~AlgebraicFactorHelper(void)
 {
+   delete ip_FactorIndex;
+}
+
+// Besides k, CheckBase2() factors k without its factors of 2 and CheckPower4() factors k/4.
+void  AlgebraicFactorHelper::FactorAllK(seq_t *firstSequence, uint32_t threadCount)
+{
+   std::vector<uint64_t> numbers;
+   seq_t   *seqPtr = firstSequence;
+   uint64_t k;
+   
+   do
+   {
+      if (seqPtr->c >= -1 && seqPtr->c <= 1 && seqPtr->d == 1)
+      {
+         numbers.push_back(seqPtr->k);
+         
+         if (seqPtr->c == 1 && seqPtr->k > 1 && seqPtr->k % 2 == 0)
+         {
+            k = seqPtr->k;
+            while (k % 2 == 0)
+               k >>= 1;
+
+            numbers.push_back(k);
+            
+            if (seqPtr->k % 4 == 0)
+               numbers.push_back(seqPtr->k / 4);
+         }
+      }
+      
+      seqPtr = (seq_t *) seqPtr->next;
+   } while (seqPtr != NULL);
+   
+   ip_FactorIndex->FactorNumbers(numbers, threadCount);
 }
 
 uint64_t AlgebraicFactorHelper::RemoveTermsWithAlgebraicFactors(seq_t *seqPtr)
@@ -787,46 +816,16 @@ uint32_t   AlgebraicFactorHelper::CheckAndLogAlgebraicFactor(seq_t *seqPtr, uint
    return 1;
 }
 
+// Note that some numbers might not get fully factored.
 uint32_t AlgebraicFactorHelper::GetFactorList(uint64_t theNumber, uint32_t *factorList, uint32_t *powerList)
 {
-   uint32_t  distinctFactors = 0;
-   uint32_t  power;
-   uint64_t  thePrime;
+   uint64_t  factors[SFI_MAX_FACTORS];
+   uint32_t  idx, distinctFactors;
 
-   std::vector<uint64_t>::iterator it = iv_SmallPrimes.begin(); 
-         
-   // Get the prime factorization of the input number.  Note that since the vector only has
-   // 100000 primes, some numbers might not get fully factored.
-   while (it != iv_SmallPrimes.end())
-   {
-      thePrime = *it;
-      it++;
-      
-      power = 0;
-      while (theNumber % thePrime == 0)
-      {
-         theNumber /= thePrime;
-         power++;
-      }
-
-      if (power > 0)
-      {
-         factorList[distinctFactors] = thePrime;
-         powerList[distinctFactors] = power;
-         distinctFactors++;
-         
-         if (theNumber < thePrime * thePrime)
-            break;
-      }
-   }
-
-   // If then number wasn't fully factored, that's fine.
-   if (theNumber > 1)
-   {
-      factorList[distinctFactors] = theNumber;
-      powerList[distinctFactors] = 1;
-      distinctFactors++;
-   }
+   distinctFactors = ip_FactorIndex->Factor(theNumber, factors, powerList);
+   
+   for (idx=0; idx<distinctFactors; idx++)
+      factorList[idx] = (uint32_t) factors[idx];
 
    return distinctFactors;
 }
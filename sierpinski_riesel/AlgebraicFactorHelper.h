@@ -11,6 +11,7 @@
 
 #include <stdio.h>
 #include "SierpinskiRieselApp.h"
+#include "../core/SmallFactorIndex.h"
 
 class AlgebraicFactorHelper
 {  
@@ -18,6 +19,10 @@ public:
    AlgebraicFactorHelper(App *theApp, uint32_t base, uint32_t minN, uint32_t maxN);
    ~AlgebraicFactorHelper(void);
 
+   // Factor k for all sequences at once using multiple threads.  This is optional, but
+   // with many sequences it is much faster than factoring k for one sequence at a time.
+   void              FactorAllK(seq_t *firstSequence, uint32_t threadCount);
+   
    // This can only search for all algebraic factors for a single k/c per call.
    uint64_t          RemoveTermsWithAlgebraicFactors(seq_t *seqPtr);
    
@@ -33,12 +38,11 @@ private:
    uint32_t          ii_KRoot;
    uint32_t          ii_KPower;
    
-   // These variables are used by this class when looking for algebraic factors.
-   std::vector<uint64_t>  iv_SmallPrimes;
+   // This is used by this class when looking for algebraic factors.
+   SmallFactorIndex *ip_FactorIndex;
    
    FILE             *ip_AlgebraicFactorFile;
 
-   void              GetSmallPrimes(void);
    uint32_t          GetFactorList(uint64_t the_number, uint32_t *factor_list, uint32_t *power_list);
    
    void              CheckForGFNForm(seq_t *seqPtr);
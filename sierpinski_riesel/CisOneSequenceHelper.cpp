@@ -94,6 +94,14 @@ void   CisOneSequenceHelper::CleanUp(void)
 
    if (ip_LegendreTable != NULL)
       xfree(ip_LegendreTable);
+
+   for (uint32_t node=1; node<iv_NodeLegendre.size(); node++)
+   {
+      xfree(iv_NodeLegendre[node]);
+
+      if (iv_NodeLegendreTable[node] != NULL)
+         xfree(iv_NodeLegendreTable[node]);
+   }
 }
 
 uint32_t    CisOneSequenceHelper::FindBestQ(uint32_t &expectedSubsequences)
@@ -209,6 +217,8 @@ void  CisOneSequenceHelper::LastChanceLogicBeforeSieving(void)
 
    BuildLegendreTables();
    
+   ReplicateLegendreTables();
+   
    BuildCongruenceTables();
 }
 
@@ -358,6 +368,63 @@ void   CisOneSequenceHelper::BuildLegendreTables()
    ip_App->WriteToConsole(COT_OTHER, "  %8u required building of the Legendre tables", seqsWithLegendreMemory - seqsWithLegendreFromFile);
 }
 
+// The Legendre tables are read for every prime by every worker, so with -2 each NUMA
+// node gets a copy that is allocated and written by a thread on that node.
+void   CisOneSequenceHelper::ReplicateLegendreTables(void)
+{
+   uint32_t     nodeCount = ip_App->GetNumaNodeCount();
+   legendre_t  *nodeLegendre, *legendrePtr;
+   uint8_t     *nodeLegendreTable;
+
+   if (nodeCount < 2)
+      return;
+
+   iv_NodeLegendre.push_back(ip_Legendre);
+   iv_NodeLegendreTable.push_back(ip_LegendreTable);
+
+   for (uint32_t node=1; node<nodeCount; node++)
+   {
+      ip_App->MoveThreadToNumaNode(node);
+
+      nodeLegendre = (legendre_t *) xmalloc((ii_SequenceCount+1), sizeof(legendre_t), "legendre");
+      nodeLegendreTable = NULL;
+
+      memcpy(nodeLegendre, ip_Legendre, (ii_SequenceCount+1) * sizeof(legendre_t));
+
+      if (ip_LegendreTable != NULL)
+      {
+         nodeLegendreTable = (uint8_t *) xmalloc(ii_LegendreBytes, sizeof(uint8_t), "legendre");
+
+         memcpy(nodeLegendreTable, ip_LegendreTable, ii_LegendreBytes);
+
+         // The maps point into the table, so point them into this node's copy
+         for (uint32_t legIdx=1; legIdx<=ii_SequenceCount; legIdx++)
+         {
+            legendrePtr = &nodeLegendre[legIdx];
+
+            if (!legendrePtr->haveMap)
+               continue;
+
+            if (legendrePtr->oneParityMap != NULL)
+               legendrePtr->oneParityMap = nodeLegendreTable + (legendrePtr->oneParityMap - ip_LegendreTable);
+
+            if (legendrePtr->dualParityMapM1 != NULL)
+               legendrePtr->dualParityMapM1 = nodeLegendreTable + (legendrePtr->dualParityMapM1 - ip_LegendreTable);
+
+            if (legendrePtr->dualParityMapP1 != NULL)
+               legendrePtr->dualParityMapP1 = nodeLegendreTable + (legendrePtr->dualParityMapP1 - ip_LegendreTable);
+         }
+      }
+
+      iv_NodeLegendre.push_back(nodeLegendre);
+      iv_NodeLegendreTable.push_back(nodeLegendreTable);
+   }
+
+   ip_App->RestoreThreadPlacement();
+
+   ip_App->WriteToConsole(COT_OTHER, "Copied Legendre tables to %u NUMA nodes", nodeCount);
+}
+
 void   CisOneSequenceHelper::LoadLegendreTablesFromFile(legendre_t *legendrePtr)
 {
    SierpinskiRieselApp *srApp = (SierpinskiRieselApp *) ip_App;
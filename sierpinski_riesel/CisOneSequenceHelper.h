@@ -11,6 +11,7 @@
 #ifndef _CisOneSequenceHelper_H
 #define _CisOneSequenceHelper_H
 
+#include <vector>
 #include "AbstractSequenceHelper.h"
 
 #define L_BYTES(x) (((1+x)>>3)+1)
@@ -83,8 +84,9 @@ public:
    int16_t          *GetDivisorShifts(void) { return ip_DivisorShifts; };
    uint16_t         *GetPowerResidueIndices(void) { return ip_PowerResidueIndices; };
    
-   legendre_t       *GetLegendre(void) { return ip_Legendre; };
-   uint8_t          *GetLegendreTable(void) { return ip_LegendreTable; };
+   // With -2 each NUMA node has its own copy of the Legendre tables
+   legendre_t       *GetLegendre(uint32_t node = 0) { return (node < iv_NodeLegendre.size() ? iv_NodeLegendre[node] : ip_Legendre); };
+   uint8_t          *GetLegendreTable(uint32_t node = 0) { return (node < iv_NodeLegendreTable.size() ? iv_NodeLegendreTable[node] : ip_LegendreTable); };
    
    void              BuildLegendreTables();
 
@@ -102,6 +104,7 @@ protected:
    bool              ValidateLegendreFile(v1_header_t *headerPtr, legendre_t *legendrePtr);
    bool              ReadLegendreTableFromFile(FILE *fPtr, uint8_t *map, uint32_t mapSize, uint64_t offset);
    void              WriteLegendreTableToFile(legendre_t *legendrePtr);
+   void              ReplicateLegendreTables(void);
    
    uint32_t          FindBestQ(uint32_t &expectedSubsequences);
    virtual double    RateQ(uint32_t Q, uint32_t s) = 0;
@@ -136,6 +139,10 @@ protected:
    legendre_t       *ip_Legendre;
    uint8_t          *ip_LegendreTable;
    uint64_t          ii_LegendreBytes;
+   
+   // These are indexed by NUMA node.  Index 0 is ip_Legendre and ip_LegendreTable.
+   std::vector<legendre_t *>  iv_NodeLegendre;
+   std::vector<uint8_t *>     iv_NodeLegendreTable;
 
 };
 
@@ -171,8 +171,9 @@ void  CisOneWithMultipleSequencesHelper::BuildCongruenceTables(void)
    tempSubseqLengths = (uint32_t *) xmalloc(ii_PowerResidueLcm, sizeof(uint32_t), "tempSubseqLengths");
    congruentTerms = (uint8_t *) xmalloc(ii_PowerResidueLcm, sizeof(uint8_t), "congruentTerms");
    
+   // Each list can have every subsequence of a sequence
    for (h=0; h<ii_PowerResidueLcm; h++)
-      tempSubseqs[h] = (uint32_t *) xmalloc(ii_PowerResidueLcm, sizeof(uint16_t), "tempSubseq");
+      tempSubseqs[h] = (uint32_t *) xmalloc(ii_SubsequenceCount, sizeof(uint32_t), "tempSubseq");
    
    // Build tables sc_lists[i][r] of pointers to lists of subsequences
    // whose terms k*b^m+c satisfy m = j (mod r)
@@ -185,10 +186,7 @@ void  CisOneWithMultipleSequencesHelper::BuildCongruenceTables(void)
       
       while (seqPtr != NULL)
       {
-         for (h=0; h<ii_PowerResidueLcm; h++)
-            memset(tempSubseqs[h], 0, ii_PowerResidueLcm);
-         
-         memset(tempSubseqLengths, 0, ii_PowerResidueLcm);
+         memset(tempSubseqLengths, 0, ii_PowerResidueLcm * sizeof(uint32_t));
          memset(congruentTerms, 0xff, ii_PowerResidueLcm);
       
          for (ssIdx=seqPtr->ssIdxFirst; ssIdx<=seqPtr->ssIdxLast; ssIdx++)
@@ -198,10 +196,10 @@ void  CisOneWithMultipleSequencesHelper::BuildCongruenceTables(void)
             for (h=0; h<r; h++)
                if (congruentTerms[h] == 1)
                {
-                  idx = tempSubseqLengths[h] + 1;
+                  idx = tempSubseqLengths[h];
                   
                   tempSubseqs[h][idx] = ssIdx;
-                  tempSubseqLengths[h] = idx;
+                  tempSubseqLengths[h] = idx + 1;
                }
          }
          
@@ -210,14 +208,14 @@ void  CisOneWithMultipleSequencesHelper::BuildCongruenceTables(void)
             
          seqPtr = (seq_t *) seqPtr->next;
       }
-      
-      printf("%u\n", r);
    }
    
    for (h=0; h<ii_PowerResidueLcm; h++)
       xfree(tempSubseqs[h]);
    
    xfree(tempSubseqs);
+   xfree(tempSubseqLengths);
+   xfree(congruentTerms);
    
    bytesNeeded = ii_Dim1 * sizeof(uint32_t);
    ip_App->WriteToConsole(COT_OTHER, "%" PRIu64" bytes used for congruent subseq indices", bytesNeeded);
@@ -235,10 +233,8 @@ void  CisOneWithMultipleSequencesHelper::CopySubseqs(seq_t *seqPtr, uint32_t r,
    if (ssListLen == 0)
       return;
 
-   // Theres seems to be a memory leak in the compiler/linker on Windows, so use static
-   // until that memory leak is fixed.
-   static uint32_t rIdx = ip_PowerResidueIndices[r];
-   static uint32_t cssIdx = CSS_INDEX(seqPtr->seqIdx, rIdx, h);
+   uint32_t rIdx = ip_PowerResidueIndices[r];
+   uint32_t cssIdx = CSS_INDEX(seqPtr->seqIdx, rIdx, h);
       
    ip_CongruentSubseqIndices[cssIdx] = ii_UsedSubseqEntries;
 
@@ -490,7 +486,6 @@ void  CisOneWithMultipleSequencesHelper::BuildLegendreTableForSequence(legendre_
 void  CisOneWithMultipleSequencesHelper::GetCongruentTerms(uint32_t ssIdx, uint32_t a, uint8_t *congruentTerms)
 {
    uint32_t b, g, m;
-   MpArith mp(a);
    
    g = gcd32(a, ii_BestQ);
 
@@ -502,8 +497,7 @@ void  CisOneWithMultipleSequencesHelper::GetCongruentTerms(uint32_t ssIdx, uint3
    {
       if (ip_Subsequences[ssIdx].mTerms[m-ii_MinM])
       {
-         MpRes res = mp.nToRes(m*ii_BestQ + ip_Subsequences[ssIdx].q);
-         b = mp.resToN(res);
+         b = (m*ii_BestQ + ip_Subsequences[ssIdx].q) % a;
          
          if (congruentTerms[b] == 0)
             congruentTerms[b] = 1;
@@ -68,8 +68,8 @@ void  CisOneWithMultipleSequencesWorker::Prepare(uint64_t largestPrimeTested, ui
    ip_CongruentSubseqs = ip_CisOneHelper->GetAllSubseqs();
    ip_AllLadders = ip_CisOneHelper->GetAllLadders();   
    
-   ip_Legendre = ip_CisOneHelper->GetLegendre();
-   ip_LegendreTable = ip_CisOneHelper->GetLegendreTable();
+   ip_Legendre = ip_CisOneHelper->GetLegendre(ip_App->GetNumaNodeForWorker(ii_MyId));
+   ip_LegendreTable = ip_CisOneHelper->GetLegendreTable(ip_App->GetNumaNodeForWorker(ii_MyId));
    
    if (ii_MaxBabySteps < TINY_HASH_MAX_ELTS)
       ip_HashTable = new TinyHashTable(ii_MaxBabySteps);
@@ -144,6 +144,8 @@ void  CisOneWithMultipleSequencesWorker::TestSinglePrime(uint64_t p)
    uint32_t babySteps, giantSteps;
    uint32_t i, j;
    
+   PROFILE_SCOPE(PP_PRIME_SETUP);
+   
    MpArith mp(p);
 
    // compute 1/base (mod p)
@@ -152,15 +154,21 @@ void  CisOneWithMultipleSequencesWorker::TestSinglePrime(uint64_t p)
    MpRes resBase = mp.nToRes(ii_Base);
    MpRes resInvBase = mp.nToRes(invBase);
 
+   PROFILE_SWITCH(PP_POWMOD);
+   
    // -ckb^d is an r-th power residue for at least one term (k*b^d)*(b^Q)^(n/Q)+c of this subsequence
    ClimbLadder(mp, resBase);
 
+   PROFILE_SWITCH(PP_PRIME_SETUP);
+   
    ssCount = SetupDiscreteLog(mp, resBase, resInvBase);
 
    // If no subsequences for this p, then no factors, so return
    if (ssCount == 0)
       return;
    
+   PROFILE_SWITCH(PP_BABY_STEPS);
+   
    ip_HashTable->Clear();
    
    babySteps = ip_Subsequences[ssCount-1].babySteps;
@@ -168,6 +176,8 @@ void  CisOneWithMultipleSequencesWorker::TestSinglePrime(uint64_t p)
 
    orderOfB = BabySteps(mp, resBase, resInvBase, babySteps);
       
+   PROFILE_SWITCH(PP_HASH_LOOKUP);
+   
    if (orderOfB > 0)
    {
       // If orderOfB > 0, then this is all the information we need to
@@ -198,8 +208,12 @@ void  CisOneWithMultipleSequencesWorker::TestSinglePrime(uint64_t p)
       // Remaining giant steps
       if (giantSteps > 1)
       {
+         PROFILE_SWITCH(PP_POWMOD);
+         
          MpRes resBQM = mp.pow(resBexpQ, babySteps);
   
+         PROFILE_SWITCH(PP_GIANT_STEPS);
+         
          for (i=1; i<giantSteps; i++)
          {
             for (ussIdx=0; ussIdx<ssCount; ussIdx++)
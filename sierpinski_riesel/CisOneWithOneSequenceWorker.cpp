@@ -63,8 +63,8 @@ void  CisOneWithOneSequenceWorker::Prepare(uint64_t largestPrimeTested, uint32_t
    ip_AllQs = ip_CisOneHelper->GetAllQs();
    ip_AllLadders = ip_CisOneHelper->GetAllLadders();
    
-   ip_Legendre = ip_CisOneHelper->GetLegendre();
-   ip_LegendreTable = ip_CisOneHelper->GetLegendreTable();
+   ip_Legendre = ip_CisOneHelper->GetLegendre(ip_App->GetNumaNodeForWorker(ii_MyId));
+   ip_LegendreTable = ip_CisOneHelper->GetLegendreTable(ip_App->GetNumaNodeForWorker(ii_MyId));
 
    uint32_t maxBabySteps = ip_CisOneHelper->GetMaxBabySteps();
    
@@ -191,6 +191,8 @@ void  CisOneWithOneSequenceWorker::TestSinglePrime(uint64_t p, sp_t parity)
    uint32_t   cqIdx, qIdx;
    uint16_t  *seqQs;
    
+   PROFILE_SCOPE(PP_PRIME_SETUP);
+   
    MpArith mp(p);
 
    // compute 1/base (mod p)
@@ -222,9 +224,13 @@ void  CisOneWithOneSequenceWorker::TestSinglePrime(uint64_t p, sp_t parity)
    // Skip the count since we have already copied it
    seqQs++;
       
+   PROFILE_SWITCH(PP_POWMOD);
+   
    // -ckb^d is an r-th power residue for at least one term (k*b^d)*(b^Q)^(n/Q)+c of this subsequence
    BuildLookupsAndClimbLadder(mp, resBase, resNegCK, cqIdx, ssCount, seqQs);
    
+   PROFILE_SWITCH(PP_BABY_STEPS);
+   
    ip_HashTable->Clear();
 
    babySteps = ip_Subsequences[ssCount-1].babySteps;
@@ -232,6 +238,8 @@ void  CisOneWithOneSequenceWorker::TestSinglePrime(uint64_t p, sp_t parity)
 
    orderOfB = BabySteps(mp, resBase, resInvBase, babySteps);
       
+   PROFILE_SWITCH(PP_HASH_LOOKUP);
+   
    if (orderOfB > 0)
    {
       // If orderOfB > 0, then this is all the information we need to
@@ -262,8 +270,12 @@ void  CisOneWithOneSequenceWorker::TestSinglePrime(uint64_t p, sp_t parity)
       // Remaining giant steps
       if (giantSteps > 1)
       {
+         PROFILE_SWITCH(PP_POWMOD);
+         
          MpRes resBQM = mp.pow(resBexpQ, babySteps);
          
+         PROFILE_SWITCH(PP_GIANT_STEPS);
+         
          for (i=1; i<giantSteps; i++)
          {
             for (k=0; k<ssCount; k++)
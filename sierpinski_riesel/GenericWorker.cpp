@@ -259,10 +259,14 @@ void  GenericWorker::DiscreteLogSmallPrimes(uint32_t *b, uint64_t *p)
    
    BabySteps(mp, mb, orderOfB);
    
+   PROFILE_SCOPE(PP_POWMOD);
+   
    // b <- 1/b^m (mod p)
    if (ii_GiantSteps > 1)
       mBM = mp.pow(mBM, ii_BabySteps);
 
+   PROFILE_SWITCH(PP_GIANT_STEPS);
+
    for (pIdx=0; pIdx<4; pIdx++)
    {      
       solutionCount = 0;
@@ -405,6 +409,8 @@ void  GenericWorker::DiscreteLogLargePrimes(uint32_t *b, uint64_t *p)
       
    BabySteps(mp, mb, orderOfB);
 
+   PROFILE_SCOPE(PP_HASH_LOOKUP);
+   
    for (pIdx=0; pIdx<4; pIdx++)
    {
       if (orderOfB[pIdx] > 0)
@@ -437,9 +443,13 @@ void  GenericWorker::DiscreteLogLargePrimes(uint32_t *b, uint64_t *p)
    if (ii_GiantSteps < 2)
       return;
 
+   PROFILE_SWITCH(PP_POWMOD);
+   
    // b <- 1/b^m (mod p)
    mBM = mp.pow(mBM, ii_BabySteps);
    
+   PROFILE_SWITCH(PP_GIANT_STEPS);
+   
    for (i=1; i<ii_GiantSteps; i++)
    {
       for (ssIdx=0; ssIdx<ii_SubsequenceCount; ssIdx++)
@@ -481,6 +491,8 @@ void  GenericWorker::SetupDiscreteLog(uint32_t *b, uint64_t *p, MpArithVec mp, M
    uint64_t   imod[4], umod[4], temp[4];
    seq_t     *seqPtr;
 
+   PROFILE_SCOPE(PP_PRIME_SETUP);
+   
    imod[0] = invmod64(b[0], p[0]);
    imod[1] = invmod64(b[1], p[1]);
    imod[2] = invmod64(b[2], p[2]);
@@ -539,9 +551,13 @@ void  GenericWorker::BabySteps(MpArithVec mp, MpResVec mb, uint32_t *orderOfB)
    uint32_t j, pIdx;
    uint64_t resBJ;
    
+   PROFILE_SCOPE(PP_POWMOD);
+   
    const MpResVec mBexpQ = mp.pow(mb, ii_BestQ);
    const MpResVec mBJ = mp.pow(mBexpQ, ii_SieveLow);
       
+   PROFILE_SWITCH(PP_BABY_STEPS);
+   
    for (pIdx=0; pIdx<4; pIdx++)
    {
       ip_HashTable[pIdx]->Clear();
@@ -22,7 +22,7 @@
 #include "CisOneWithOneSequenceHelper.h"
 #include "CisOneWithMultipleSequencesHelper.h"
 
-#define APP_VERSION     "1.8.8"
+#define APP_VERSION     "1.8.9"
 
 #if defined(USE_OPENCL)
 #define APP_NAME        "srsieve2cl"
@@ -34,6 +34,17 @@
 
 #define NBIT(n)         ((n) - ii_MinN)
 
+// These are run by -0 (--selftest).  The factors were found with one worker.
+static const selftest_t selfTests[] = {
+   { "-n 1000 -N 5000 -s 3*2^n-1 -P 1e6",                       3471, 0xdd6f4a096e526794ULL },
+   { "-n 1000 -N 4000 -s 7*2^n+3 -P 1e6",                       2706, 0x4be4165b6bcfdf23ULL },
+   { "-n 1000 -N 5000 -s 3*2^n-1 -s 5*2^n+1 -P 1e6",            7311, 0xd5928d7531d466f7ULL },
+   { "-n 1000 -N 5000 -s 3*2^n-1 -s 5*2^n+1 -P 1e6 -c",         7311, 0xd5928d7531d466f7ULL },
+   { "-n 1000 -N 4000 -s 2*3^n+1 -s 4*3^n+1 -s 8*3^n-1 -P 3e5", 6207, 0x3ddb750f9d73d6a6ULL },
+   { "-n 1000 -N 4000 -s 3*2^n+7 -s 5*2^n-7 -P 1e6",            5438, 0x105b9ca72e4f6bf1ULL },
+   { NULL, 0, 0 }
+};
+
 // This is declared in App.h, but implemented here.  This means that App.h
 // can remain unchanged if using the mtsieve framework for other applications.
 App *get_app(void)
@@ -45,6 +56,7 @@ SierpinskiRieselApp::SierpinskiRieselApp() : FactorApp()
 {
    SetBanner(APP_NAME " v" APP_VERSION ", a program to find factors of k*b^n+c numbers for fixed b and variable k and n");
    SetLogFileName("srsieve2.log");
+   SetSelfTests(selfTests);
    
    SetAppMinPrime(3);
    SetAppMaxPrime(PMAX_MAX_62BIT);
@@ -338,6 +350,8 @@ void SierpinskiRieselApp::ValidateOptions(void)
          
       AlgebraicFactorHelper *afh = new AlgebraicFactorHelper(this, ii_Base, ii_MinN, ii_MaxN);
       
+      afh->FactorAllK(ip_FirstSequence, GetCpuWorkerCount());
+      
       seqPtr = ip_FirstSequence;
       if ((seq_t *) seqPtr->next == NULL)
       {
@@ -1170,6 +1184,9 @@ uint32_t SierpinskiRieselApp::WriteOutputTermsFile(uint64_t largestPrime, uint32
    else
       snprintf(fileName, sizeof(fileName), "q%03u_%s", q, is_OutputTermsFileName.c_str());
    
+   if (it_Format == FF_ABCD)
+      return WriteABCDTermsFile(largestPrime, q, fileName);
+   
    FILE    *termsFile = fopen(fileName, "w");
 
    if (!termsFile)
@@ -1214,9 +1231,6 @@ uint32_t SierpinskiRieselApp::WriteOutputTermsFile(uint64_t largestPrime, uint32
       {
          sequenceCount++;
 
-         if (it_Format == FF_ABCD)
-            termsCounted += WriteABCDTermsFile(seqPtr, largestPrime, termsFile);
-         
          if (it_Format == FF_ABC)
             termsCounted += WriteABCTermsFile(seqPtr, largestPrime, termsFile);
          
@@ -1246,65 +1260,131 @@ uint32_t SierpinskiRieselApp::WriteOutputTermsFile(uint64_t largestPrime, uint32
    return termsCounted;
 }
 
-uint32_t SierpinskiRieselApp::WriteABCDTermsFile(seq_t *seqPtr, uint64_t maxPrime, FILE *termsFile)
+// The terms are copied while holding the lock so that the workers are not blocked
+// while the file is formatted and written.  Each chunk has one or more sequences.
+uint32_t SierpinskiRieselApp::WriteABCDTermsFile(uint64_t largestPrime, uint32_t q, const char *fileName)
 {
-   uint32_t n, nCount = 0, previousN;
-   uint32_t bit;
-
-   double dCalc = 1.781 * log((double) maxPrime);
-   double dBase = (double) log((double) ii_Base);
-   double dK = (double) log((double) seqPtr->k);
-   double dD = (double) log((double) seqPtr->d);
-   double dLength, dTemp;
-  
-   n = ii_MinN;
+   TermsFileWriter writer(GetCpuWorkerCount());
+   uint64_t termsCounted, expectedTerms, chunkBits = 0;
+   uint32_t chunk, chunkCount, sequenceCount = 0;
+   seq_t   *seqPtr;
    
-   bit = NBIT(n);
-   for (; n<=ii_MaxN; n++)
-   {      
-      if (seqPtr->nTerms[bit])
-         break;
-      
-      bit++;
-   }
-
-   if (n > ii_MaxN)
-      return 0;
+   iv_SnapshotSequences.clear();
+   iv_SnapshotChunkStarts.clear();
    
-   if (seqPtr->d == 1)
-      fprintf(termsFile, "ABCD %" PRIu64"*%u^$a%+" PRId64" [%u] // Sieved to %" PRIu64"\n", seqPtr->k, ii_Base, seqPtr->c, n, maxPrime);
-   else
-      fprintf(termsFile, "ABCD (%" PRIu64"*%u^$a%+" PRId64")/%u [%u] // Sieved to %" PRIu64"\n", seqPtr->k, ii_Base, seqPtr->c, seqPtr->d, n, maxPrime);
+   ip_FactorAppLock->Lock();
    
-   if (n > 1)
+   seqPtr = ip_FirstSequence;
+   do
    {
-      dLength = dBase * (double) n + dK - dD;
-      dTemp = dCalc / dLength;
-      id_EstimatedPrimes += (dTemp > 1.0 ? 1.0 : dTemp);
-   }
+      if (q == 0 || seqPtr->bestQ == q)
+      {
+         if (sequenceCount == 0 || chunkBits >= TFW_CHUNK_BITS)
+         {
+            iv_SnapshotChunkStarts.push_back(sequenceCount);
+            chunkBits = 0;
+         }
+         
+         iv_SnapshotSequences.push_back(seq_snapshot_t());
+         
+         seq_snapshot_t &snapshot = iv_SnapshotSequences.back();
+         
+         snapshot.k = seqPtr->k;
+         snapshot.c = seqPtr->c;
+         snapshot.d = seqPtr->d;
+         snapshot.nTerms = seqPtr->nTerms;
+         
+         chunkBits += seqPtr->nTerms.size();
+         sequenceCount++;
+      }
+            
+      seqPtr = (seq_t *) seqPtr->next;
+   } while (seqPtr != NULL);
    
-   previousN = n;
-   nCount = 1;
-   n++;
+   expectedTerms = il_TermCount;
    
-   bit = NBIT(n);
-   for (; n<=ii_MaxN; n++)
+   ip_FactorAppLock->Release();
+   
+   chunkCount = (uint32_t) iv_SnapshotChunkStarts.size();
+   iv_SnapshotChunkStarts.push_back(sequenceCount);
+   
+   iv_SnapshotEstimatedPrimes.assign(chunkCount, 0.0);
+   il_SnapshotPrime = largestPrime;
+   
+   termsCounted = writer.WriteFile(fileName, chunkCount, FormatABCDChunk, this);
+
+   for (chunk=0; chunk<chunkCount; chunk++)
+      id_EstimatedPrimes += iv_SnapshotEstimatedPrimes[chunk];
+
+   // Release the memory used by the copy of the terms
+   std::vector<seq_snapshot_t>().swap(iv_SnapshotSequences);
+   
+   if (q == 0 && termsCounted != expectedTerms)
+      FatalError("Something is wrong.  Counted terms (%" PRIu64") != expected terms (%" PRIu64")", termsCounted, expectedTerms);
+
+   if (q > 0 && sequenceCount > 0)
+      WriteToConsole(COT_OTHER, "%5u sequences with %8" PRIu64" terms written to %s", sequenceCount, termsCounted, fileName);
+   
+   return (uint32_t) termsCounted;
+}
+
+// This is called by multiple threads at the same time for different chunks
+uint64_t SierpinskiRieselApp::FormatABCDChunk(void *owner, uint64_t chunk, TermsBuffer *buffer)
+{
+   SierpinskiRieselApp *app = (SierpinskiRieselApp *) owner;
+   uint32_t n, previousN = 0;
+   uint32_t bit, bitCount = app->ii_MaxN - app->ii_MinN + 1;
+   uint64_t termCount = 0;
+   double   estimatedPrimes = 0.0;
+
+   double dCalc = 1.781 * log((double) app->il_SnapshotPrime);
+   double dBase = (double) log((double) app->ii_Base);
+   double dLength, dTemp;
+   
+   for (uint32_t seqIdx=app->iv_SnapshotChunkStarts[chunk]; seqIdx<app->iv_SnapshotChunkStarts[chunk+1]; seqIdx++)
    {
-      if (seqPtr->nTerms[bit])
+      seq_snapshot_t &snapshot = app->iv_SnapshotSequences[seqIdx];
+      
+      double dK = (double) log((double) snapshot.k);
+      double dD = (double) log((double) snapshot.d);
+      bool   haveHeader = false;
+      
+      for (bit=0; bit<bitCount; bit++)
       {
-         fprintf(termsFile, "%u\n", n - previousN);
-         previousN = n;
-         nCount++;
+         if (!snapshot.nTerms[bit])
+            continue;
+         
+         n = app->ii_MinN + bit;
          
-         dLength = dBase * (double) n + dK - dD;
-         dTemp = dCalc / dLength;
-         id_EstimatedPrimes += (dTemp > 1.0 ? 1.0 : dTemp);
+         if (haveHeader)
+            buffer->AppendU64(n - previousN);
+         else
+         {
+            if (snapshot.d == 1)
+               buffer->AppendFormat("ABCD %" PRIu64"*%u^$a%+" PRId64" [%u] // Sieved to %" PRIu64"", snapshot.k, app->ii_Base, snapshot.c, n, app->il_SnapshotPrime);
+            else
+               buffer->AppendFormat("ABCD (%" PRIu64"*%u^$a%+" PRId64")/%u [%u] // Sieved to %" PRIu64"", snapshot.k, app->ii_Base, snapshot.c, snapshot.d, n, app->il_SnapshotPrime);
+            
+            haveHeader = true;
+         }
+         
+         buffer->AppendChar('\n');
+         
+         if (n > 1)
+         {
+            dLength = dBase * (double) n + dK - dD;
+            dTemp = dCalc / dLength;
+            estimatedPrimes += (dTemp > 1.0 ? 1.0 : dTemp);
+         }
+         
+         previousN = n;
+         termCount++;
       }
-      
-      bit++;
    }
+   
+   app->iv_SnapshotEstimatedPrimes[chunk] = estimatedPrimes;
 
-   return nCount;
+   return termCount;
 }
 
 uint32_t SierpinskiRieselApp::WriteABCTermsFile(seq_t *seqPtr, uint64_t maxPrime, FILE *termsFile)
@@ -1832,6 +1912,8 @@ void     SierpinskiRieselApp::ReportFactor(uint64_t theFactor, seq_t *seqPtr, ui
    char     buffer[200];
    bool     needToLock = (theFactor > GetMaxPrimeForSingleWorker());
                
+   PROFILE_SCOPE(PP_FACTORS);
+   
    if (n < ii_MinN || n > ii_MaxN)
       return;
 
@@ -16,11 +16,20 @@
 #include "../core/FactorApp.h"
 #include "AbstractSequenceHelper.h"
 #include "../core/BigHashTable.h"
+#include "../core/TermsFileWriter.h"
 
 #define NMAX_MAX (1 << 31)
 
 typedef enum { FF_UNKNOWN = 1, FF_ABCD, FF_ABC, FF_BOINC, FF_NUMBER_PRIMES, FF_MFAKT } format_t;
 
+// This is a copy of a sequence that is made when writing the terms file
+typedef struct {
+   uint64_t          k;
+   int64_t           c;
+   uint32_t          d;
+   std::vector<bool> nTerms;
+} seq_snapshot_t;
+
 class SierpinskiRieselApp : public FactorApp
 {
 public:
@@ -119,7 +128,8 @@ private:
    void              WriteOutputTermsFilesByQ(void);
    void              WriteSequenceFilesByQ(uint32_t q);
    uint32_t          WriteOutputTermsFile(uint64_t largestPrime, uint32_t q);
-   uint32_t          WriteABCDTermsFile(seq_t *seqPtr, uint64_t maxPrime, FILE *termsFile);
+   uint32_t          WriteABCDTermsFile(uint64_t largestPrime, uint32_t q, const char *fileName);
+   static uint64_t   FormatABCDChunk(void *owner, uint64_t chunk, TermsBuffer *buffer);
    uint32_t          WriteABCTermsFile(seq_t *seqPtr, uint64_t maxPrime, FILE *termsFile);
    uint32_t          WriteBoincTermsFile(seq_t *seqPtr, uint64_t maxPrime, FILE *termsFile);
    uint32_t          WriteABCNumberPrimesTermsFile(seq_t *seqPtr, uint64_t maxPrime, FILE *termsFile, bool allSequencesHaveDEqual1);
@@ -145,6 +155,11 @@ private:
    format_t          it_Format;
    double            id_EstimatedPrimes;
    
+   std::vector<seq_snapshot_t>  iv_SnapshotSequences;
+   std::vector<uint32_t>        iv_SnapshotChunkStarts;
+   std::vector<double>          iv_SnapshotEstimatedPrimes;
+   uint64_t                     il_SnapshotPrime;
+   
    uint32_t          ii_Base;
    uint32_t          ii_SquareFreeB;    // product of squery free factors of the base
    
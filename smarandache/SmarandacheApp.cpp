@@ -21,10 +21,17 @@
 #define APP_NAME        "smsieve"
 #endif
 
-#define APP_VERSION     "1.0"
+#define APP_VERSION     "1.1"
 
 #define BIT(n)          ((n) - ii_MinN)
 
+// These are run by -0 (--selftest).  The factors were found with one worker.
+static const selftest_t selfTests[] = {
+   { "-n 100000 -N 101000 -P 1e6",   49, 0x9e5372d8103fe0a7ULL },
+   { "-n 1000000 -N 1001000 -P 3e5", 50, 0x15c3375aef88333dULL },
+   { NULL, 0, 0 }
+};
+
 // This is declared in App.h, but implemented here.  This means that App.h
 // can remain unchanged if using the CPUSieve framework for other applications.
 App *get_app(void)
@@ -36,6 +43,7 @@ SmarandacheApp::SmarandacheApp() : FactorApp()
 {
    SetBanner(APP_NAME " v" APP_VERSION ", a program to find factors of Smarandache numbers");
    SetLogFileName("smsieve.log");
+   SetSelfTests(selfTests);
 
    ii_MinN = 0;
    ii_MaxN = 0;
@@ -140,9 +148,20 @@ void SmarandacheApp::ValidateOptions(void)
          FatalError("The value for -N must be greater than the value for -n");
 
       iv_Terms.resize(ii_MaxN - ii_MinN + 1);
-      std::fill(iv_Terms.begin(), iv_Terms.end(), true);
+      std::fill(iv_Terms.begin(), iv_Terms.end(), false);
+      
+      il_TermCount = 0;
       
-      il_TermCount = (ii_MaxN - ii_MinN + 1);
+      // Sm(n) is divisible by 2 or 3 unless n = 1 (mod 6).  The workers also
+      // rely on this since they step from one term to the next by 6.
+      for (uint32_t n=ii_MinN; n<=ii_MaxN; n++)
+      {
+         if (n % 6 == 1)
+         {
+            iv_Terms[BIT(n)] = true;
+            il_TermCount++;
+         }
+      }
    }
 
    SetMinGpuPrime(ii_MaxN + 1);
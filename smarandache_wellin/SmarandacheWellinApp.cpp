@@ -21,12 +21,18 @@
 #define APP_NAME        "smwsieve"
 #endif
 
-#define APP_VERSION     "1.0"
+#define APP_VERSION     "1.1"
 
 #define BIT(n)          ((n) - ii_MinN)
 
 #define MAX_SUPPORTED_PRIME   1000000000
 
+// These are run by -0 (--selftest).  The factors were found with one worker.
+static const selftest_t selfTests[] = {
+   { "-n 10000 -N 11000 -P 1e6", 100, 0xbbeb57e855cdea44ULL },
+   { NULL, 0, 0 }
+};
+
 // This is declared in App.h, but implemented here.  This means that App.h
 // can remain unchanged if using the CPUSieve framework for other applications.
 App *get_app(void)
@@ -38,6 +44,7 @@ SmarandacheWellinApp::SmarandacheWellinApp() : FactorApp()
 {
    SetBanner(APP_NAME " v" APP_VERSION ", a program to find factors of Smarandache-Wellin numbers");
    SetLogFileName("smwsieve.log");
+   SetSelfTests(selfTests);
 
    ii_MinN = 0;
    ii_MaxN = 0;
@@ -164,6 +171,8 @@ void SmarandacheWellinApp::ValidateOptions(void)
 
    ip_Primes[ii_NumberOfPrimes] = 0;
    
+   BuildDigitGroups();
+   
    if (is_OutputTermsFileName.length() == 0)
    {
       char fileName[50];
@@ -205,11 +214,39 @@ void SmarandacheWellinApp::ValidateOptions(void)
 
    FactorApp::ParentValidateOptions();
 
-   // The testing routine is optimized to test 4 primes at a time.
-   while (ii_CpuWorkSize % 4 > 0)
+   // The testing routine is optimized to test 8 primes at a time.
+   while (ii_CpuWorkSize % 8 > 0)
       ii_CpuWorkSize++;
 }
 
+void  SmarandacheWellinApp::BuildDigitGroups(void)
+{
+   uint64_t powerOf10 = 100;
+   uint32_t idx = 0;
+   
+   ii_DigitGroups = 0;
+   
+   // Since the first prime is 11, the first group is for two digit primes.
+   while (idx < ii_NumberOfPrimes)
+   {
+      if (ii_DigitGroups == MAX_DIGIT_GROUPS)
+         FatalError("How did this happen?  n is too large");
+
+      ir_DigitGroups[ii_DigitGroups].startIdx = idx;
+      ir_DigitGroups[ii_DigitGroups].powerOf10 = powerOf10;
+
+      while (idx < ii_NumberOfPrimes && ip_Primes[idx] < powerOf10)
+         idx++;
+      
+      ir_DigitGroups[ii_DigitGroups].endIdx = idx;
+      
+      if (idx > ir_DigitGroups[ii_DigitGroups].startIdx)
+         ii_DigitGroups++;
+      
+      powerOf10 *= 10;
+   }
+}
+
 Worker *SmarandacheWellinApp::CreateWorker(uint32_t id, bool gpuWorker, uint64_t largestPrimeTested)
 {
 #if defined(USE_OPENCL) || defined(USE_METAL)
@@ -377,39 +414,21 @@ void  SmarandacheWellinApp::VerifyFactor(uint64_t theFactor, uint32_t n)
 {   
    MpArith mp(theFactor);
    MpRes   res = mp.nToRes(2357);
-   MpRes   mp1e2 = mp.nToRes(100);
-   MpRes   mp1e3 = mp.nToRes(1000);
-   MpRes   mp1e4 = mp.nToRes(10000);
-   MpRes   mp1e5 = mp.nToRes(100000);
-   MpRes   mp1e6 = mp.nToRes(1000000);
-   MpRes   mp1e7 = mp.nToRes(10000000);
-   MpRes   mp1e8 = mp.nToRes(100000000);
-   MpRes   mp1e9 = mp.nToRes(1000000000);
-
-   for (uint32_t i=0; i<ii_NumberOfPrimes; i++)
+
+   for (uint32_t g=0; g<ii_DigitGroups; g++)
    {
-      if (ip_Primes[i] < 100)
-         res = mp.mul(res, mp1e2);
-      else if (ip_Primes[i] < 1000)
-         res = mp.mul(res, mp1e3);
-      else if (ip_Primes[i] < 10000)
-         res = mp.mul(res, mp1e4);
-      else if (ip_Primes[i] < 100000)
-         res = mp.mul(res, mp1e5);
-      else if (ip_Primes[i] < 1000000)
-         res = mp.mul(res, mp1e6);
-      else if (ip_Primes[i] < 10000000)
-         res = mp.mul(res, mp1e7);
-      else if (ip_Primes[i] < 100000000)
-         res = mp.mul(res, mp1e8);
-      else if (ip_Primes[i] < 1000000000)
-         res = mp.mul(res, mp1e9);
-      else
-         FatalError("How did this happen?  n is too large");
+      MpRes multiplier = mp.nToRes(ir_DigitGroups[g].powerOf10);
       
-      res = mp.add(res, mp.nToRes(ip_Primes[i]));
+      for (uint32_t i=ir_DigitGroups[g].startIdx; i<ir_DigitGroups[g].endIdx; i++)
+      {
+         res = mp.mul(res, multiplier);
+         res = mp.add(res, mp.nToRes(ip_Primes[i]));
+         
+         if (ip_Primes[i] == n)
+            break;
+      }
       
-      if (ip_Primes[i] == n)
+      if (ip_Primes[ir_DigitGroups[g].endIdx - 1] >= n)
          break;
    }
    
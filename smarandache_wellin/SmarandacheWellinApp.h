@@ -20,6 +20,17 @@ typedef struct {
    uint32_t *termList;
 } terms_t;
 
+// The primes are sorted so all primes with the same number of decimal digits
+// are contiguous in the list of primes.  Appending any of them to a term
+// requires a multiplication by the same power of 10.
+typedef struct {
+   uint32_t  startIdx;
+   uint32_t  endIdx;
+   uint32_t  powerOf10;
+} digitgroup_t;
+
+#define MAX_DIGIT_GROUPS   10
+
 class SmarandacheWellinApp : public FactorApp
 {
 public:
@@ -39,6 +50,7 @@ public:
 
    uint32_t         *GetPrimes(uint32_t &numberOfPrimes) { numberOfPrimes = ii_NumberOfPrimes; return ip_Primes; };
    uint16_t         *GetPrimeGaps(uint16_t &biggestGap) { biggestGap = ii_BiggestGap; return ip_PrimeGaps; };   
+   digitgroup_t     *GetDigitGroups(uint32_t &digitGroups) { digitGroups = ii_DigitGroups; return ir_DigitGroups; };
    
 #if defined(USE_OPENCL) || defined(USE_METAL)
    uint32_t          GetMaxGpuSteps(void) { return ii_MaxGpuSteps; };
@@ -63,6 +75,7 @@ protected:
    Worker           *CreateWorker(uint32_t id, bool gpuWorker, uint64_t largestPrimeTested);
    
 private:
+   void              BuildDigitGroups(void);
    void              VerifyFactor(uint64_t theFactor, uint32_t n);
    
    std::vector<bool> iv_Terms;
@@ -76,6 +89,9 @@ private:
    uint16_t         *ip_PrimeGaps;
    uint16_t          ii_BiggestGap;
    
+   digitgroup_t      ir_DigitGroups[MAX_DIGIT_GROUPS];
+   uint32_t          ii_DigitGroups;
+   
 #if defined(USE_OPENCL) || defined(USE_METAL)
    uint32_t          ii_MaxGpuSteps;
    uint32_t          ii_MaxGpuFactors;
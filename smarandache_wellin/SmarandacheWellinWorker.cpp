@@ -8,7 +8,6 @@
 
 #include <math.h>
 #include "SmarandacheWellinWorker.h"
-#include "../core/MpArithVector.h"
 
 extern "C" int mfsieve(uint32_t start, uint32_t mf, uint32_t minmax, uint64_t *P);
 extern "C" int SmarandacheWellin(uint32_t start, uint32_t mf, uint32_t minmax, uint64_t *P);
@@ -21,6 +20,7 @@ SmarandacheWellinWorker::SmarandacheWellinWorker(uint32_t myId, App *theApp) : W
    ii_MaxN = ip_SmarandacheWellinApp->GetMaxN();
 
    ip_Primes = ip_SmarandacheWellinApp->GetPrimes(ii_NumberOfPrimes);
+   ip_DigitGroups = ip_SmarandacheWellinApp->GetDigitGroups(ii_DigitGroups);
    
    ib_Initialized = true;
 }
@@ -31,68 +31,88 @@ void  SmarandacheWellinWorker::CleanUp(void)
 
 void  SmarandacheWellinWorker::TestMegaPrimeChunk(void)
 {
-   uint64_t  ps[4], maxPrime = ip_App->GetMaxPrime();
-   uint32_t  i;
+   uint64_t  maxPrime = ip_App->GetMaxPrime();
+   uint64_t  largestN = MAX(ip_Primes[ii_NumberOfPrimes - 1], 2357);
+   uint64_t *ps;
      
-   for (uint32_t pIdx=0; pIdx<ii_PrimesInList; pIdx+=4)
+   for (uint32_t pIdx=0; pIdx<ii_PrimesInList; pIdx+=WIDE_VECTOR_SIZE)
    {
-      ps[0] = il_PrimeList[pIdx+0];
-      ps[1] = il_PrimeList[pIdx+1];
-      ps[2] = il_PrimeList[pIdx+2];
-      ps[3] = il_PrimeList[pIdx+3];
+      ps = &il_PrimeList[pIdx];
 
-      MpArithVec mp(ps);
-      MpResVec   zero = mp.zero();
-      MpResVec   res = mp.nToRes(2357);
-      MpResVec   mp1e2 = mp.nToRes(100);
-      MpResVec   mp1e3 = mp.nToRes(1000);
-      MpResVec   mp1e4 = mp.nToRes(10000);
-      MpResVec   mp1e5 = mp.nToRes(100000);
-      MpResVec   mp1e6 = mp.nToRes(1000000);
-      MpResVec   mp1e7 = mp.nToRes(10000000);
-      MpResVec   mp1e8 = mp.nToRes(100000000);
-      MpResVec   mp1e9 = mp.nToRes(1000000000);
+      MpArithVec8 mp(ps);
+      
+      if (ps[0] > largestN)
+         TestLargePrimes(mp);
+      else
+         TestSmallPrimes(mp);
+      
+      SetLargestPrimeTested(ps[WIDE_VECTOR_SIZE-1], WIDE_VECTOR_SIZE);
+   
+      if (ps[WIDE_VECTOR_SIZE-1] >= maxPrime)
+         break;
+   }
+}
 
-      for (i=0; i<ii_NumberOfPrimes; i++)
+// This is used when at least one p is not larger than the largest term.  The terms
+// must be converted to Montgomery form because n can be larger than p.
+void  SmarandacheWellinWorker::TestSmallPrimes(MpArithVec8 &mp)
+{
+   MpResVec8 res = mp.nToRes(2357);
+   
+   for (uint32_t g=0; g<ii_DigitGroups; g++)
+   {
+      MpResVec8 multiplier = mp.nToRes(ip_DigitGroups[g].powerOf10);
+      
+      for (uint32_t i=ip_DigitGroups[g].startIdx; i<ip_DigitGroups[g].endIdx; i++)
       {
-         if (ip_Primes[i] < 100)
-            res = mp.mul(res, mp1e2);
-         else if (ip_Primes[i] < 1000)
-            res = mp.mul(res, mp1e3);
-         else if (ip_Primes[i] < 10000)
-            res = mp.mul(res, mp1e4);
-         else if (ip_Primes[i] < 100000)
-            res = mp.mul(res, mp1e5);
-         else if (ip_Primes[i] < 1000000)
-            res = mp.mul(res, mp1e6);
-         else if (ip_Primes[i] < 10000000)
-            res = mp.mul(res, mp1e7);
-         else if (ip_Primes[i] < 100000000)
-            res = mp.mul(res, mp1e8);
-         else if (ip_Primes[i] < 1000000000)
-            res = mp.mul(res, mp1e9);
-         else
-            FatalError("How did this happen?  n is too large");
-         
+         res = mp.mul(res, multiplier);
          res = mp.add(res, mp.nToRes(ip_Primes[i]));
-         
-         if (res[0] == zero[0])
-            ip_SmarandacheWellinApp->ReportFactor(ps[0], ip_Primes[i]);
-         if (res[1] == zero[1])
-            ip_SmarandacheWellinApp->ReportFactor(ps[1], ip_Primes[i]);
-         if (res[2] == zero[2])
-            ip_SmarandacheWellinApp->ReportFactor(ps[2], ip_Primes[i]);
-         if (res[3] == zero[3])
-            ip_SmarandacheWellinApp->ReportFactor(ps[3], ip_Primes[i]);         
+
+         CheckForFactors(mp, res, ip_Primes[i]);
       }
-      
-      SetLargestPrimeTested(ps[3], 4);
+   }
+}
+
+// When all p are larger than the largest term, the residue is kept in normal form
+// rather than Montgomery form.  Multiplying a normal residue by the Montgomery form
+// of 10^d yields a normal residue, so each term can be added without conversion.
+void  SmarandacheWellinWorker::TestLargePrimes(MpArithVec8 &mp)
+{
+   MpResVec8 res;
    
-      if (ps[3] >= maxPrime)
-         break;
+   for (uint32_t k=0; k<WIDE_VECTOR_SIZE; k++)
+      res[k] = 2357;
+   
+   for (uint32_t g=0; g<ii_DigitGroups; g++)
+   {
+      MpResVec8 multiplier = mp.nToRes(ip_DigitGroups[g].powerOf10);
+      
+      for (uint32_t i=ip_DigitGroups[g].startIdx; i<ip_DigitGroups[g].endIdx; i++)
+      {
+         res = mp.mul(res, multiplier);
+         res = mp.add(res, ip_Primes[i]);
+
+         CheckForFactors(mp, res, ip_Primes[i]);
+      }
    }
 }
 
+// Zero is the same in normal and Montgomery form.
+inline void  SmarandacheWellinWorker::CheckForFactors(MpArithVec8 &mp, MpResVec8 &res, uint32_t n)
+{
+   uint64_t allNonZero = 1;
+   
+   for (uint32_t k=0; k<WIDE_VECTOR_SIZE; k++)
+      allNonZero &= (res[k] != 0);
+   
+   if (allNonZero)
+      return;
+   
+   for (uint32_t k=0; k<WIDE_VECTOR_SIZE; k++)
+      if (res[k] == 0)
+         ip_SmarandacheWellinApp->ReportFactor(mp.p(k), n);
+}
+
 void  SmarandacheWellinWorker::TestMiniPrimeChunk(uint64_t *miniPrimeChunk)
 {
    FatalError("SmarandacheWellinWorker::TestMiniPrimeChunk not implemented");
@@ -11,6 +11,7 @@
 
 #include "SmarandacheWellinApp.h"
 #include "../core/Worker.h"
+#include "../core/MpArithVector.h"
 
 using namespace std;
 
@@ -28,6 +29,10 @@ public:
 protected:
    void              NotifyPrimeListAllocated(uint32_t primesInList) {}
    
+   void              TestSmallPrimes(MpArithVec8 &mp);
+   void              TestLargePrimes(MpArithVec8 &mp);
+   void              CheckForFactors(MpArithVec8 &mp, MpResVec8 &res, uint32_t n);
+   
    SmarandacheWellinApp   *ip_SmarandacheWellinApp;
    
    uint32_t          ii_MinN;
@@ -35,6 +40,9 @@ protected:
    
    uint32_t         *ip_Primes;
    uint32_t          ii_NumberOfPrimes;
+   
+   digitgroup_t     *ip_DigitGroups;
+   uint32_t          ii_DigitGroups;
 };
 
 #endif
@@ -16,11 +16,18 @@
 #include "SophieGermainWorker.h"
 
 #define APP_NAME        "sgsieve"
-#define APP_VERSION     "1.3"
+#define APP_VERSION     "1.4"
 
 #define NMAX_MAX        (1 << 31)
 
-#define BIT(k)          (((k) - il_MinK) >> 1)
+
+// These are run by -0 (--selftest).  The factors were found with one worker.
+static const selftest_t selfTests[] = {
+   { "-k 1 -K 100000 -b 2 -n 1000 -P 1e6",    49720, 0xfff64cb67db73e31ULL },
+   { "-k 1 -K 100000 -b 2 -n 1000 -P 1e6 -x",  5564, 0x79ddb56c0616493cULL },
+   { "-k 1 -K 100000 -b 6 -n 1000 -P 1e6 -g", 49327, 0xf0797b6889958adcULL },
+   { NULL, 0, 0 }
+};
 
 // This is declared in App.h, but implemented here.  This means that App.h
 // can remain unchanged if using the mtsieve framework for other applications.
@@ -33,6 +40,7 @@ SophieGermainApp::SophieGermainApp() : FactorApp()
 {
    SetBanner(APP_NAME " v" APP_VERSION ", a program to eliminate terms for Sophie-Germain prime searches for k*b^n-1 with variable k and fixed b and n");
    SetLogFileName("sgsieve.log");
+   SetSelfTests(selfTests);
    
    it_Format = FF_ABCD;
    
@@ -40,13 +48,23 @@ SophieGermainApp::SophieGermainApp() : FactorApp()
    il_MaxK = 0;
    ii_Base = 0;
    ii_N = 0;
+   ii_MaxN = 0;
+   ii_NCount = 1;
    ib_GeneralizedSearch = false;
+   ib_UseWheel = false;
+   ip_Wheel = NULL;
  
    SetAppMinPrime(3);
    
    iv_Terms.clear();
 }
 
+SophieGermainApp::~SophieGermainApp(void)
+{
+   if (ip_Wheel != NULL)
+      delete ip_Wheel;
+}
+
 void SophieGermainApp::Help(void)
 {
    FactorApp::ParentHelp();
@@ -55,22 +73,28 @@ void SophieGermainApp::Help(void)
    printf("-K --kmax=K           Maximum k to search\n");
    printf("-b --base=b           Base to search\n");
    printf("-n --exp=n            Exponent to search\n");
+   printf("-N --nmax=N           Maximum exponent to search, one output file per n\n");
    printf("-g --generalized      Multiply second term by b instead of by 2\n");
    printf("-f --format=f         Format of output file (D=ABCD (default), N=NEWPGEN)\n");
+   printf("-x --wheel            Use a wheel to exclude k where 3, 5, 7, or 11 divides a term\n");
+   printf("-z --shard=i/m        Sieve only shard i of m (m is a power of 2)\n");
 }
 
 void  SophieGermainApp::AddCommandLineOptions(std::string &shortOpts, struct option *longOpts)
 {
    FactorApp::ParentAddCommandLineOptions(shortOpts, longOpts);
 
-   shortOpts += "k:K:b:n:gf:";
+   shortOpts += "k:K:b:n:N:gxf:z:";
 
    AppendLongOpt(longOpts, "kmin",           required_argument, 0, 'k');
    AppendLongOpt(longOpts, "kmax",           required_argument, 0, 'K');
    AppendLongOpt(longOpts, "base",           required_argument, 0, 'b');
    AppendLongOpt(longOpts, "exp",            required_argument, 0, 'n');
+   AppendLongOpt(longOpts, "nmax",           required_argument, 0, 'N');
    AppendLongOpt(longOpts, "generalized",    no_argument,       0, 'g');
    AppendLongOpt(longOpts, "format",         required_argument, 0, 'f');
+   AppendLongOpt(longOpts, "wheel",          no_argument,       0, 'x');
+   AppendLongOpt(longOpts, "shard",          required_argument, 0, 'z');
 }
 
 parse_t SophieGermainApp::ParseOption(int opt, char *arg, const char *source)
@@ -98,8 +122,22 @@ parse_t SophieGermainApp::ParseOption(int opt, char *arg, const char *source)
          status = Parser::Parse(arg, 1, NMAX_MAX, ii_N);
          break;
       
+      case 'N':
+         status = Parser::Parse(arg, 1, NMAX_MAX, ii_MaxN);
+         break;
+      
       case 'g':
          ib_GeneralizedSearch = true;
+         status = P_SUCCESS;
+         break;
+         
+      case 'x':
+         ib_UseWheel = true;
+         status = P_SUCCESS;
+         break;
+         
+      case 'z':
+         status = ParseShardOption(arg);
          break;
          
       case 'f':
@@ -130,10 +168,16 @@ void SophieGermainApp::ValidateOptions(void)
          
       ib_GeneralizedSearch = false;
       
+      if (ii_MaxN > 0)
+         FatalError("-N cannot be used with -i");
+      
       ProcessInputTermsFile(false);
+      
+      ii_MaxN = ii_N;
 
-      iv_Terms.resize(((il_MaxK - il_MinK) >> 1) + 1);
-      std::fill(iv_Terms.begin(), iv_Terms.end(), false);
+      CreateWheel();
+      
+      iv_Terms.assign(1, std::vector<bool>(ip_Wheel->GetBitCount(), false));
 
       ProcessInputTermsFile(true);
    }
@@ -151,8 +195,20 @@ void SophieGermainApp::ValidateOptions(void)
       if (ii_Base == 0)
          FatalError("base must be specified");
 
+      // For odd b the first term is odd, so b*t+1 is even
+      if (ib_GeneralizedSearch && (ii_Base & 1))
+         FatalError("-g requires an even base");
+
       if (ii_N == 0)
          FatalError("exponent must be specified");
+      
+      if (ii_MaxN == 0)
+         ii_MaxN = ii_N;
+      
+      if (ii_MaxN < ii_N)
+         FatalError("nmax must be greater than or equal to n");
+      
+      ii_NCount = ii_MaxN - ii_N + 1;
 
       if (ii_Base & 1)
       {
@@ -183,10 +239,11 @@ void SophieGermainApp::ValidateOptions(void)
          }
       }
     
-      il_TermCount = ((il_MaxK - il_MinK) >> 1) + 1;
+      CreateWheel();
       
-      iv_Terms.resize(il_TermCount);
-      std::fill(iv_Terms.begin(), iv_Terms.end(), true);      
+      il_TermCount = ip_Wheel->GetBitCount() * ii_NCount;
+      
+      iv_Terms.assign(ii_NCount, std::vector<bool>(ip_Wheel->GetBitCount(), true));
 
    }
          
@@ -203,6 +260,8 @@ void SophieGermainApp::ValidateOptions(void)
       }
    }
 
+   ValidateShardOption();
+   
    FactorApp::ParentValidateOptions();
 
    // Since the worker wants primes in groups of 4
@@ -268,10 +327,11 @@ void SophieGermainApp::ProcessInputTermsFile(bool haveBitMap)
 
       if (haveBitMap)
       {
-         bit = BIT(k);
-
-         iv_Terms[bit] = true;
-         il_TermCount++;
+         if (ip_Wheel->GetBit(k, bit))
+         {
+            iv_Terms[0][bit] = true;
+            il_TermCount++;
+         }
       }
       else 
          il_MinK = il_MaxK = k;
@@ -299,10 +359,12 @@ void SophieGermainApp::ProcessInputTermsFile(bool haveBitMap)
 
          if (haveBitMap)
          {
-            bit = BIT(k);
-
-            iv_Terms[bit] = true;
-            il_TermCount++;
+            // Skip k that were excluded by the wheel
+            if (ip_Wheel->GetBit(k, bit))
+            {
+               iv_Terms[0][bit] = true;
+               il_TermCount++;
+            }
          }
          else
          {
@@ -329,10 +391,12 @@ void SophieGermainApp::ProcessInputTermsFile(bool haveBitMap)
 
          if (haveBitMap)
          {
-            bit = BIT(k);
-
-            iv_Terms[bit] = true;
-            il_TermCount++;
+            // Skip k that were excluded by the wheel
+            if (ip_Wheel->GetBit(k, bit))
+            {
+               iv_Terms[0][bit] = true;
+               il_TermCount++;
+            }
          }
          else
          {
@@ -345,6 +409,57 @@ void SophieGermainApp::ProcessInputTermsFile(bool haveBitMap)
    fclose(fPtr);
 }
 
+// This is called after kmin and kmax are known.  Without -x the wheel is empty
+// and the bit for k is just its position in the range of k.
+void SophieGermainApp::CreateWheel(void)
+{
+   double   minTerm = (double) il_MinK * pow((double) ii_Base, (double) ii_N) - 1.0;
+   uint64_t minK = il_MinK;
+   uint32_t kShift = 1;
+   uint32_t idx, prime, bPowN;
+
+   ApplyShardToK(minK, il_MaxK, kShift);
+   
+   ip_Wheel = new KWheel(minK, il_MaxK, kShift);
+
+   if (!ib_UseWheel)
+      return;
+
+   // The k that are excluded depend upon n
+   if (ii_NCount > 1)
+   {
+      WriteToConsole(COT_OTHER, "Ignoring -x since it is not supported when using -N");
+      return;
+   }
+
+   // A term could be one of the primes in the wheel
+   if (minTerm <= (double) KW_MAX_PRIME)
+   {
+      WriteToConsole(COT_OTHER, "Ignoring -x since the smallest term is too small");
+      return;
+   }
+
+   for (idx=0; KWheel::GetPrime(idx) > 0; idx++)
+   {
+      prime = KWheel::GetPrime(idx);
+      bPowN = KWheel::PowMod(ii_Base, ii_N, prime);
+
+      // k*b^n-1
+      ip_Wheel->ExcludeTerm(prime, bPowN, -1);
+
+      // 2*(k*b^n-1)+1 = 2*k*b^n-1 or b*(k*b^n-1)+1 = b*k*b^n-b+1
+      if (ib_GeneralizedSearch)
+         ip_Wheel->ExcludeTerm(prime, (uint64_t) bPowN * ii_Base, 1 - (int64_t) ii_Base);
+      else
+         ip_Wheel->ExcludeTerm(prime, bPowN * 2, -1);
+   }
+
+   ip_Wheel->Build();
+
+   WriteToConsole(COT_OTHER, "Wheel of size %u removed %" PRIu64" of %" PRIu64" k", ip_Wheel->GetModulus(),
+                  ip_Wheel->GetPositionCount() - ip_Wheel->GetBitCount(), ip_Wheel->GetPositionCount());
+}
+
 bool SophieGermainApp::ApplyFactor(uint64_t theFactor, const char *term)
 {
    uint64_t k;
@@ -365,18 +480,24 @@ bool SophieGermainApp::ApplyFactor(uint64_t theFactor, const char *term)
    if (b != ii_Base)
       FatalError("Expected base %u in factor but found %u", ii_Base, b);
    
-   if (n != ii_N && n != ii_N+1)
-      FatalError("Expected n %u in factor but found %u", ii_N, n);
+   if (ii_NCount == 1 && n == ii_N+1)
+      n = ii_N;
+   
+   if (n < ii_N || n > ii_MaxN)
+      FatalError("Expected n between %u and %u in factor but found %u", ii_N, ii_MaxN, n);
         
    if (k < il_MinK || k > il_MaxK)
       return false;
   
-   uint64_t bit = k - il_MinK;
+   uint64_t bit;
+   
+   if (!ip_Wheel->GetBit(k, bit))
+      return false;
    
    // No locking is needed because the Workers aren't running yet
-   if (iv_Terms[bit])
+   if (iv_Terms[n - ii_N][bit])
    {
-      iv_Terms[bit] = false;
+      iv_Terms[n - ii_N][bit] = false;
       il_TermCount--;
 
       return true;
@@ -389,55 +510,76 @@ void SophieGermainApp::WriteOutputTermsFile(uint64_t largestPrime)
 {
    uint64_t termsCounted = 0;
    
-   FILE    *termsFile = fopen(is_OutputTermsFileName.c_str(), "w");
+   ip_FactorAppLock->Lock();
+   
+   if (ii_NCount == 1)
+      termsCounted = WriteTermsFile(largestPrime, 0, is_OutputTermsFileName.c_str());
+   else
+   {
+      for (uint32_t nIdx=0; nIdx<ii_NCount; nIdx++)
+         termsCounted += WriteTermsFile(largestPrime, nIdx, GetOutputTermsFileNameForN(ii_N + nIdx).c_str());
+   }
+   
+   if (termsCounted != il_TermCount)
+      FatalError("Something is wrong.  Counted terms (%" PRIu64") != expected terms (%" PRIu64")", termsCounted, il_TermCount);
+
+   ip_FactorAppLock->Release();
+}
+
+uint64_t SophieGermainApp::WriteTermsFile(uint64_t maxPrime, uint32_t nIdx, const char *fileName)
+{
+   uint64_t termsCounted = 0;
+   
+   FILE    *termsFile = fopen(fileName, "w");
 
    if (!termsFile)
-      FatalError("Unable to open output file %s", is_OutputTermsFileName.c_str());
-   
-   ip_FactorAppLock->Lock();
+      FatalError("Unable to open output file %s", fileName);
       
    if (it_Format == FF_ABCD)
-      termsCounted = WriteABCDTermsFile(largestPrime, termsFile);
+      termsCounted = WriteABCDTermsFile(maxPrime, termsFile, nIdx);
    
    if (it_Format == FF_NEWPGEN)
-      termsCounted = WriteNewPGenTermsFile(largestPrime, termsFile);
+      termsCounted = WriteNewPGenTermsFile(maxPrime, termsFile, nIdx);
    
    fclose(termsFile);
    
-   if (termsCounted != il_TermCount)
-      FatalError("Something is wrong.  Counted terms (%" PRIu64") != expected terms (%" PRIu64")", termsCounted, il_TermCount);
-
-   ip_FactorAppLock->Release();
+   return termsCounted;
 }
 
-uint64_t SophieGermainApp::WriteABCDTermsFile(uint64_t largestPrime, FILE *termsFile)
+uint64_t SophieGermainApp::WriteABCDTermsFile(uint64_t largestPrime, FILE *termsFile, uint32_t nIdx)
 {
+   uint32_t n = ii_N + nIdx;
    uint64_t k, kCount = 0, previousK;
-   uint64_t bit;
+   uint64_t bit, bitCount = ip_Wheel->GetBitCount();
    
-   for (k=il_MinK; k<=il_MaxK; k+=2)
+   for (bit=0; bit<bitCount; bit++)
    {
-      bit = BIT(k);
-   
-      if (iv_Terms[bit])
+      if (iv_Terms[nIdx][bit])
          break;
    }
    
-   if (k > il_MaxK)
+   // The file stays empty for a shard without terms for this n
+   if (bit >= bitCount)
+   {
+      if (IsSharded())
+         return 0;
+      
       FatalError("No remaining terms");
+   }
+   
+   k = ip_Wheel->GetK(bit);
    
-   fprintf(termsFile, "ABCD $a*%u^%u-1 & %u*($a*%u^%u-1)+1 [%" SCNu64"] // Sieved to %" SCNu64"\n", ii_Base, ii_N, (ib_GeneralizedSearch ? ii_Base : 2), ii_Base, ii_N, k, largestPrime);
+   fprintf(termsFile, "ABCD $a*%u^%u-1 & %u*($a*%u^%u-1)+1 [%" SCNu64"] // Sieved to %" SCNu64"\n", ii_Base, n, (ib_GeneralizedSearch ? ii_Base : 2), ii_Base, n, k, largestPrime);
    
    previousK = k;
    kCount = 1;
-   k += 2;
    
-   for (; k<=il_MaxK; k+=2)
+   for (bit++; bit<bitCount; bit++)
    {
-      bit = BIT(k);
-      
-      if (iv_Terms[bit])
+      if (iv_Terms[nIdx][bit])
       {
+         k = ip_Wheel->GetK(bit);
+         
          fprintf(termsFile, "%" PRIu64"\n", k - previousK);
          previousK = k;
          kCount++;
@@ -447,24 +589,21 @@ uint64_t SophieGermainApp::WriteABCDTermsFile(uint64_t largestPrime, FILE *terms
    return kCount;
 }
 
-uint64_t SophieGermainApp::WriteNewPGenTermsFile(uint64_t maxPrime, FILE *termsFile)
+uint64_t SophieGermainApp::WriteNewPGenTermsFile(uint64_t maxPrime, FILE *termsFile, uint32_t nIdx)
 {
-   uint64_t k, kCount = 0;
-   uint64_t bit;
+   uint32_t n = ii_N + nIdx;
+   uint64_t kCount = 0;
+   uint64_t bit, bitCount = ip_Wheel->GetBitCount();
 
    //   10 = k*2^n-1 & k*2^(n-1)+1 (per pfgw file newpgenformats.txt)
    // 1034 = k*2^n-1 & k*b^(n-1)+1 (per pfgw file newpgenformats.txt)
    fprintf(termsFile, "%" PRIu64":S:0:%u:%u\n", maxPrime, ii_Base, (ii_Base == 2 ? 10 : 1034));
       
-   k = il_MinK;
-   
-   for (; k<=il_MaxK; k+=2)
+   for (bit=0; bit<bitCount; bit++)
    {
-      bit = BIT(k);
-      
-      if (iv_Terms[bit])
+      if (iv_Terms[nIdx][bit])
       {
-         fprintf(termsFile, "%" PRIu64" %u\n", k, ii_N);
+         fprintf(termsFile, "%" PRIu64" %u\n", ip_Wheel->GetK(bit), n);
          kCount++;
       }
    }
@@ -474,30 +613,38 @@ uint64_t SophieGermainApp::WriteNewPGenTermsFile(uint64_t maxPrime, FILE *termsF
 
 void  SophieGermainApp::GetExtraTextForSieveStartedMessage(char *extraText, uint32_t maxTextLength)
 {
-   snprintf(extraText, maxTextLength, "%" PRIu64 " < k < %" PRIu64", first term t = k*%u^%u-1, next term is %u*t+1", il_MinK, il_MaxK, ii_Base, ii_N, (ib_GeneralizedSearch ? ii_Base : 2));
+   if (ii_NCount > 1)
+      snprintf(extraText, maxTextLength, "%" PRIu64 " < k < %" PRIu64", first term t = k*%u^n-1, %u <= n <= %u, next term is %u*t+1", il_MinK, il_MaxK, ii_Base, ii_N, ii_MaxN, (ib_GeneralizedSearch ? ii_Base : 2));
+   else
+      snprintf(extraText, maxTextLength, "%" PRIu64 " < k < %" PRIu64", first term t = k*%u^%u-1, next term is %u*t+1", il_MinK, il_MaxK, ii_Base, ii_N, (ib_GeneralizedSearch ? ii_Base : 2));
 }
 
-void  SophieGermainApp::ReportFactor(uint64_t theFactor, uint64_t k, bool firstOfPair, bool verifyFactor)
+void  SophieGermainApp::ReportFactor(uint64_t theFactor, uint64_t k, bool firstOfPair, bool verifyFactor, uint32_t nIdx)
 {
+   uint32_t n = ii_N + nIdx;
+   uint64_t bit;
+   
    if (ii_Base % theFactor == 0)
       return;
    
+   // k was excluded by the wheel
+   if (!ip_Wheel->GetBit(k, bit))
+      return;
+   
    if (verifyFactor)
-      VerifyFactor(theFactor, k, firstOfPair);
+      VerifyFactor(theFactor, k, firstOfPair, n);
    
    if (theFactor > GetMaxPrimeForSingleWorker())
       ip_FactorAppLock->Lock();
-      
-   uint64_t bit = BIT(k);
 
-   if (iv_Terms[bit])
+   if (iv_Terms[nIdx][bit])
    {
-      iv_Terms[bit] = false;
+      iv_Terms[nIdx][bit] = false;
       
       if (firstOfPair)
-         LogFactor(theFactor, "%" PRIu64"*%u^%u-1", k, ii_Base, ii_N);
+         LogFactor(theFactor, "%" PRIu64"*%u^%u-1", k, ii_Base, n);
       else
-         LogFactor(theFactor, "%u*(%" PRIu64"*%u^%u-1)+1", (ib_GeneralizedSearch ? ii_Base : 2), k, ii_Base, ii_N);
+         LogFactor(theFactor, "%u*(%" PRIu64"*%u^%u-1)+1", (ib_GeneralizedSearch ? ii_Base : 2), k, ii_Base, n);
       
       il_FactorCount++;
       il_TermCount--;
@@ -507,12 +654,63 @@ void  SophieGermainApp::ReportFactor(uint64_t theFactor, uint64_t k, bool firstO
       ip_FactorAppLock->Release();
 }
 
-void  SophieGermainApp::VerifyFactor(uint64_t theFactor, uint64_t k, bool firstOfPair)
+// This is used for p <= il_MaxK.  The bitmap is sieved one segment at a time so that
+// other workers can report factors between segments.
+void  SophieGermainApp::ReportFactors(KSegmentSieve *kSieve)
+{
+   std::vector<std::vector<bool> *> bitmaps(ii_NCount);
+   std::vector<ksieve_entry_t>::const_iterator it;
+   const ksieve_entry_t *entry;
+   uint32_t idx, nIdx, segment;
+   
+   // The bitmap index is nIdx
+   for (nIdx=0; nIdx<ii_NCount; nIdx++)
+      bitmaps[nIdx] = &iv_Terms[nIdx];
+   
+   // If the first term is valid, then the rest are valid.
+   for (idx=0; idx<kSieve->GetPrimeCount(); idx++)
+   {
+      entry = kSieve->GetPrime(idx);
+      
+      VerifyFactor(entry->prime, kSieve->GetPrimeK(idx), (entry->tag == 1), ii_N + entry->bitmapIdx);
+   }
+   
+   for (segment=0; segment<kSieve->GetSegmentCount(); segment++)
+   {
+      if (!kSieve->HasSegmentPrimes(segment))
+         continue;
+      
+      ip_FactorAppLock->Lock();
+      
+      kSieve->SieveSegment(segment, &bitmaps[0]);
+      
+      const std::vector<ksieve_entry_t> &hits = kSieve->GetHits();
+      
+      StartFactorBatch();
+      
+      for (it=hits.begin(); it!=hits.end(); it++)
+      {
+         if (it->tag == 1)
+            LogFactor(it->prime, "%" PRIu64"*%u^%u-1", kSieve->GetK(it->bit), ii_Base, ii_N + it->bitmapIdx);
+         else
+            LogFactor(it->prime, "%u*(%" PRIu64"*%u^%u-1)+1", (ib_GeneralizedSearch ? ii_Base : 2), kSieve->GetK(it->bit), ii_Base, ii_N + it->bitmapIdx);
+      }
+      
+      EndFactorBatch();
+      
+      il_FactorCount += hits.size();
+      il_TermCount -= hits.size();
+      
+      ip_FactorAppLock->Release();
+   }
+}
+
+void  SophieGermainApp::VerifyFactor(uint64_t theFactor, uint64_t k, bool firstOfPair, uint32_t n)
 {
    MpArith  mp(theFactor);
    MpRes    pOne = mp.one();
    
-   MpRes    resRem = mp.pow(mp.nToRes(ii_Base), ii_N);
+   MpRes    resRem = mp.pow(mp.nToRes(ii_Base), n);
    
    resRem = mp.mul(resRem, mp.nToRes(k));
    resRem = mp.sub(resRem, pOne);
@@ -520,7 +718,7 @@ void  SophieGermainApp::VerifyFactor(uint64_t theFactor, uint64_t k, bool firstO
    if (firstOfPair) 
    {
       if (resRem != mp.zero())
-         FatalError("Invalid factor: %" PRIu64" is not a factor of not a factor of %" PRIu64"*%u^%u-1", theFactor, k, ii_Base, ii_N);
+         FatalError("Invalid factor: %" PRIu64" is not a factor of not a factor of %" PRIu64"*%u^%u-1", theFactor, k, ii_Base, n);
       
       return;
    }
@@ -533,6 +731,6 @@ void  SophieGermainApp::VerifyFactor(uint64_t theFactor, uint64_t k, bool firstO
    resRem = mp.add(resRem, pOne);
       
    if (resRem != mp.zero())
-      FatalError("Invalid factor: %" PRIu64" is not a factor of not a factor of %u*(%" PRIu64"*%u^%u-1)+1", theFactor, (ib_GeneralizedSearch ? ii_Base : 2), k, ii_Base, ii_N);
+      FatalError("Invalid factor: %" PRIu64" is not a factor of not a factor of %u*(%" PRIu64"*%u^%u-1)+1", theFactor, (ib_GeneralizedSearch ? ii_Base : 2), k, ii_Base, n);
    
 }
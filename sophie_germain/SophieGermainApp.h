@@ -12,6 +12,7 @@
 #define _SophieGermainApp_H
 
 #include "../core/FactorApp.h"
+#include "../core/KSegmentSieve.h"
 
 #define KMAX_MAX (UINT64_C(1)<<62)
 #define NMAX_MAX (1 << 31)
@@ -23,7 +24,7 @@ class SophieGermainApp : public FactorApp
 public:
    SophieGermainApp(void);
 
-   ~SophieGermainApp(void) {};
+   ~SophieGermainApp(void);
 
    void              Help(void);
    void              AddCommandLineOptions(std::string &shortOpts, struct option *longOpts);
@@ -36,9 +37,12 @@ public:
    uint64_t          GetMaxK(void) { return il_MaxK; };
    uint32_t          GetBase(void) { return ii_Base; };
    uint32_t          GetN(void) { return ii_N; };
+   uint32_t          GetNCount(void) { return ii_NCount; };
    bool              IsGeneralizedSearch(void) { return ib_GeneralizedSearch; };
+   KWheel           *GetWheel(void) { return ip_Wheel; };
 
-   void              ReportFactor(uint64_t theFactor, uint64_t k, bool firstOfPair, bool verifyFactor);
+   void              ReportFactor(uint64_t theFactor, uint64_t k, bool firstOfPair, bool verifyFactor, uint32_t nIdx);
+   void              ReportFactors(KSegmentSieve *kSieve);
 
 protected:
    void              PreSieveHook(void) {};
@@ -54,14 +58,20 @@ protected:
    Worker           *CreateWorker(uint32_t id, bool gpuWorker, uint64_t largestPrimeTested);
 
 private:
-   uint64_t          WriteABCDTermsFile(uint64_t maxPrime, FILE *termsFile);
-   uint64_t          WriteNewPGenTermsFile(uint64_t maxPrime, FILE *termsFile);
+   uint64_t          WriteTermsFile(uint64_t maxPrime, uint32_t nIdx, const char *fileName);
+   uint64_t          WriteABCDTermsFile(uint64_t maxPrime, FILE *termsFile, uint32_t nIdx);
+   uint64_t          WriteNewPGenTermsFile(uint64_t maxPrime, FILE *termsFile, uint32_t nIdx);
    
-   void              VerifyFactor(uint64_t theFactor, uint64_t k, bool firstOfPair);
+   void              CreateWheel(void);
+   void              VerifyFactor(uint64_t theFactor, uint64_t k, bool firstOfPair, uint32_t n);
    
-   std::vector<bool> iv_Terms;
+   // There is one bitmap for each n from ii_N to ii_MaxN
+   std::vector<std::vector<bool>> iv_Terms;
    
    bool              ib_GeneralizedSearch;
+   bool              ib_UseWheel;
+   
+   KWheel           *ip_Wheel;
    format_t          it_Format;
    
    std::string       is_InputFileName;
@@ -71,6 +81,8 @@ private:
    uint64_t          il_MaxK;
    uint32_t          ii_Base;
    uint32_t          ii_N;
+   uint32_t          ii_MaxN;
+   uint32_t          ii_NCount;
 };
 
 #endif
@@ -21,7 +21,10 @@ SophieGermainWorker::SophieGermainWorker(uint32_t myId, App *theApp) : Worker(my
    il_MaxK = ip_SophieGermainApp->GetMaxK();
    ii_Base = ip_SophieGermainApp->GetBase();
    ii_N = ip_SophieGermainApp->GetN();
+   ii_NCount = ip_SophieGermainApp->GetNCount();
    ib_GeneralizedSearch = ip_SophieGermainApp->IsGeneralizedSearch();
+   
+   ip_KSieve = new KSegmentSieve(ip_SophieGermainApp->GetWheel());
      
    // The thread can't start until initialization is done
    ib_Initialized = true;
@@ -29,6 +32,7 @@ SophieGermainWorker::SophieGermainWorker(uint32_t myId, App *theApp) : Worker(my
 
 void  SophieGermainWorker::CleanUp(void)
 {
+   delete ip_KSieve;
 }
 
 void  SophieGermainWorker::TestMegaPrimeChunk(void)
@@ -73,49 +77,73 @@ void  SophieGermainWorker::TestMegaPrimeChunkSmall(void)
       MpArithVec mp(ps);
       
       MpResVec resInvs = mp.nToRes(invs);
+      MpResVec resMult = resInvs;
       MpResVec res = mp.pow(resInvs, ii_N);
-      MpResVec resKs = mp.resToN(res);
-
-      if (resKs[0] <= il_MaxK) RemoveTermsSmallPrime(resKs[0], true, ps[0]);
-      if (resKs[1] <= il_MaxK) RemoveTermsSmallPrime(resKs[1], true, ps[1]);
-      if (resKs[2] <= il_MaxK) RemoveTermsSmallPrime(resKs[2], true, ps[2]);
-      if (resKs[3] <= il_MaxK) RemoveTermsSmallPrime(resKs[3], true, ps[3]);
+      MpResVec resKs;
 
-      if (ii_Base == 2)
+      if (ib_GeneralizedSearch)
       {
-         res = mp.mul(res, resInvs);
+         // b*(k*b^n-1)+1 = 0 (mod p) --> k = (b-1)*inv(b)^(n+1) = (1-inv(b))*inv(b)^n (mod p)
+         invs[0] = (invs[0] == 1 ? 0 : ps[0] + 1 - invs[0]);
+         invs[1] = (invs[1] == 1 ? 0 : ps[1] + 1 - invs[1]);
+         invs[2] = (invs[2] == 1 ? 0 : ps[2] + 1 - invs[2]);
+         invs[3] = (invs[3] == 1 ? 0 : ps[3] + 1 - invs[3]);
+         
+         resMult = mp.nToRes(invs);
       }
-      else
+      else if (ii_Base != 2)
       {
-         if (ib_GeneralizedSearch)
-         {
-            // Multipley by inv(ii_Base)
-            res = mp.mul(res, resInvs);
-         }
-         else
-         {
-            // Multipley by inv(2)
-            invs[0] = (1+ps[0]) >> 1;
-            invs[1] = (1+ps[1]) >> 1;
-            invs[2] = (1+ps[2]) >> 1;
-            invs[3] = (1+ps[3]) >> 1;
-            
-            res = mp.mul(res, mp.nToRes(invs));
-         }
+         // Multipley by inv(2)
+         invs[0] = (1+ps[0]) >> 1;
+         invs[1] = (1+ps[1]) >> 1;
+         invs[2] = (1+ps[2]) >> 1;
+         invs[3] = (1+ps[3]) >> 1;
+         
+         resMult = mp.nToRes(invs);
       }
       
-      resKs = mp.resToN(res);
-      
-      if (resKs[0] <= il_MaxK) RemoveTermsSmallPrime(resKs[0], false, ps[0]);
-      if (resKs[1] <= il_MaxK) RemoveTermsSmallPrime(resKs[1], false, ps[1]);
-      if (resKs[2] <= il_MaxK) RemoveTermsSmallPrime(resKs[2], false, ps[2]);
-      if (resKs[3] <= il_MaxK) RemoveTermsSmallPrime(resKs[3], false, ps[3]);
+      for (uint32_t nIdx=0; nIdx<ii_NCount; nIdx++)
+      {
+         // k for n+1 is k for n multiplied by inv(b)
+         if (nIdx > 0)
+            res = mp.mul(res, resInvs);
+         
+         resKs = mp.resToN(res);
+
+         if (resKs[0] <= il_MaxK) RemoveTermsSmallPrime(resKs[0], true, ps[0], nIdx);
+         if (resKs[1] <= il_MaxK) RemoveTermsSmallPrime(resKs[1], true, ps[1], nIdx);
+         if (resKs[2] <= il_MaxK) RemoveTermsSmallPrime(resKs[2], true, ps[2], nIdx);
+         if (resKs[3] <= il_MaxK) RemoveTermsSmallPrime(resKs[3], true, ps[3], nIdx);
+         
+         resKs = mp.resToN(mp.mul(res, resMult));
+         
+         if (resKs[0] <= il_MaxK) RemoveTermsSmallPrime(resKs[0], false, ps[0], nIdx);
+         if (resKs[1] <= il_MaxK) RemoveTermsSmallPrime(resKs[1], false, ps[1], nIdx);
+         if (resKs[2] <= il_MaxK) RemoveTermsSmallPrime(resKs[2], false, ps[2], nIdx);
+         if (resKs[3] <= il_MaxK) RemoveTermsSmallPrime(resKs[3], false, ps[3], nIdx);
+      }
       
-      SetLargestPrimeTested(ps[3], 4);
+      ip_KSieve->AddPendingPrimes(ps[3], 4);
    
       if (ps[3] >= maxPrime)
          break;
    }
+   
+   ApplySmallPrimes();
+}
+
+// The factors for the small primes are not applied until the end of the chunk,
+// so don't report them as tested until then.
+void  SophieGermainWorker::ApplySmallPrimes(void)
+{
+   if (ip_KSieve->GetPendingPrimeCount() == 0)
+      return;
+   
+   ip_SophieGermainApp->ReportFactors(ip_KSieve);
+   
+   SetLargestPrimeTested(ip_KSieve->GetLargestPendingPrime(), ip_KSieve->GetPendingPrimeCount());
+   
+   ip_KSieve->Clear();
 }
 
 void  SophieGermainWorker::TestMegaPrimeChunkLarge(void)
@@ -155,33 +183,49 @@ void  SophieGermainWorker::TestMegaPrimeChunkLarge(void)
       MpArithVec mp(ps);
 
       MpResVec resInvs = mp.nToRes(invs);
+      MpResVec resMult = resInvs;
       MpResVec res = mp.pow(resInvs, ii_N);
-      MpResVec resKs = mp.resToN(res);
-
-      if (resKs[0] >= il_MinK && resKs[0] <= il_MaxK) RemoveTermsLargePrime(resKs[0], true, ps[0]);
-      if (resKs[1] >= il_MinK && resKs[1] <= il_MaxK) RemoveTermsLargePrime(resKs[1], true, ps[1]);
-      if (resKs[2] >= il_MinK && resKs[2] <= il_MaxK) RemoveTermsLargePrime(resKs[2], true, ps[2]);
-      if (resKs[3] >= il_MinK && resKs[3] <= il_MaxK) RemoveTermsLargePrime(resKs[3], true, ps[3]);
+      MpResVec resKs;
       
-      if (ii_Base == 2)
+      if (ib_GeneralizedSearch)
       {
-         res = mp.mul(res, resInvs);
+         // b*(k*b^n-1)+1 = 0 (mod p) --> k = (b-1)*inv(b)^(n+1) = (1-inv(b))*inv(b)^n (mod p)
+         invs[0] = (invs[0] == 1 ? 0 : ps[0] + 1 - invs[0]);
+         invs[1] = (invs[1] == 1 ? 0 : ps[1] + 1 - invs[1]);
+         invs[2] = (invs[2] == 1 ? 0 : ps[2] + 1 - invs[2]);
+         invs[3] = (invs[3] == 1 ? 0 : ps[3] + 1 - invs[3]);
+         
+         resMult = mp.nToRes(invs);
       }
-      else 
+      else if (ii_Base != 2)
       {
          invs[0] = (1+ps[0]) >> 1;
          invs[1] = (1+ps[1]) >> 1;
          invs[2] = (1+ps[2]) >> 1;
          invs[3] = (1+ps[3]) >> 1;
-         res = mp.mul(res, mp.nToRes(invs));
+         resMult = mp.nToRes(invs);
       }
       
-      resKs = mp.resToN(res);
-      
-      RemoveTermsLargePrime(resKs[0], false, ps[0]);
-      RemoveTermsLargePrime(resKs[1], false, ps[1]);
-      RemoveTermsLargePrime(resKs[2], false, ps[2]);
-      RemoveTermsLargePrime(resKs[3], false, ps[3]);
+      for (uint32_t nIdx=0; nIdx<ii_NCount; nIdx++)
+      {
+         // k for n+1 is k for n multiplied by inv(b)
+         if (nIdx > 0)
+            res = mp.mul(res, resInvs);
+         
+         resKs = mp.resToN(res);
+
+         if (resKs[0] >= il_MinK && resKs[0] <= il_MaxK) RemoveTermsLargePrime(resKs[0], true, ps[0], nIdx);
+         if (resKs[1] >= il_MinK && resKs[1] <= il_MaxK) RemoveTermsLargePrime(resKs[1], true, ps[1], nIdx);
+         if (resKs[2] >= il_MinK && resKs[2] <= il_MaxK) RemoveTermsLargePrime(resKs[2], true, ps[2], nIdx);
+         if (resKs[3] >= il_MinK && resKs[3] <= il_MaxK) RemoveTermsLargePrime(resKs[3], true, ps[3], nIdx);
+         
+         resKs = mp.resToN(mp.mul(res, resMult));
+         
+         RemoveTermsLargePrime(resKs[0], false, ps[0], nIdx);
+         RemoveTermsLargePrime(resKs[1], false, ps[1], nIdx);
+         RemoveTermsLargePrime(resKs[2], false, ps[2], nIdx);
+         RemoveTermsLargePrime(resKs[3], false, ps[3], nIdx);
+      }
 
       SetLargestPrimeTested(ps[3], 4);
    
@@ -196,7 +240,7 @@ void  SophieGermainWorker::TestMiniPrimeChunk(uint64_t *miniPrimeChunk)
 }
 
 // This must be used when prime <= il_MaxK.
-void    SophieGermainWorker::RemoveTermsSmallPrime(uint64_t k, bool firstOfPair, uint64_t prime)
+void    SophieGermainWorker::RemoveTermsSmallPrime(uint64_t k, bool firstOfPair, uint64_t prime, uint32_t nIdx)
 {
    // Make sure that k >= il_MinK
    if (k < il_MinK)
@@ -223,86 +267,81 @@ void    SophieGermainWorker::RemoveTermsSmallPrime(uint64_t k, bool firstOfPair,
          k += prime;
    }
 
-   if (k > il_MaxK)
+   // When sharded, this also moves k into this shard's residue class
+   if (!ip_SophieGermainApp->GetWheel()->AlignK(prime, k))
       return;
-
-   uint32_t verifiedCount = 0;
    
-   do
-	{
-      verifiedCount++;
-      
-      // If the first few are valid, then assume that the rest are valid.  This will
-      // speed up testing of small primes.
-      ip_SophieGermainApp->ReportFactor(prime, k, firstOfPair, (verifiedCount < 5));
+   // This primes will yield no factor because b^n = 0 (mod p)
+   if (ii_Base % prime == 0)
+      return;
 
-		k += (prime << 1); 
-	} while (k <= il_MaxK);
+   ip_KSieve->AddPrime(prime, k, nIdx, (firstOfPair ? 1 : 0));
 }
 
 
 // Using this bypasses a number of if checks that can be done when prime > il_MaxK.
 // Do not report k/n combinations if the k*2^n+1 is divisible by any p < 50
-void    SophieGermainWorker::RemoveTermsLargePrime(uint64_t k, bool firstOfPair, uint64_t prime)
+void    SophieGermainWorker::RemoveTermsLargePrime(uint64_t k, bool firstOfPair, uint64_t prime, uint32_t nIdx)
 {   
+   uint32_t n = ii_N + nIdx;
    uint32_t smallN;
    uint64_t smallK;
 
    if (ii_Base == 2)
    {
-      smallN = ii_N % (2);
+      smallN = n % (2);
       smallK = k % (3);
       if ((smallK << smallN) % (3) == 2) return;
         
-      smallN = ii_N % (4);
+      smallN = n % (4);
       smallK = k % (5);
       if ((smallK << smallN) % (5) == 4) return;
       
-      smallN = ii_N % (6);
+      smallN = n % (6);
       smallK = k % (7);
       if ((smallK << smallN) % (7) == 6) return;
       
-      smallN = ii_N % (10);
+      smallN = n % (10);
       smallK = k % (11);
       if ((smallK << smallN) % (11) == 10) return;
       
-      smallN = ii_N % (12);
+      smallN = n % (12);
       smallK = k % (13);
       if ((smallK << smallN) % (13) == 12) return;
       
-      smallN = ii_N % (16);
+      smallN = n % (16);
       smallK = k % (17);
       if ((smallK << smallN) % (17) == 16) return;
       
-      smallN = ii_N % (18);
+      smallN = n % (18);
       smallK = k % (19);
       if ((smallK << smallN) % (19) == 18) return;
       
-      smallN = ii_N % (22);
+      smallN = n % (22);
       smallK = k % (23);
       if ((smallK << smallN) % (23) == 22) return;
       
-      smallN = ii_N % (28);
+      smallN = n % (28);
       smallK = k % (29);
       if ((smallK << smallN) % (29) == 28) return;
       
-      smallN = ii_N % (30);
+      smallN = n % (30);
       smallK = k % (31);
       if ((smallK << smallN) % (31) == 30) return;
 
-      smallN = ii_N % (36);
+      smallN = n % (36);
       smallK = k % (37);
       if ((smallK << smallN) % (37) == 36) return;
       
-      smallN = ii_N % (40);
+      smallN = n % (40);
       smallK = k % (41);
       if ((smallK << smallN) % (41) == 40) return;
       
-      smallN = ii_N % (42);
+      smallN = n % (42);
       smallK = k % (43);
       if ((smallK << smallN) % (43) == 42) return;
       
-      smallN = ii_N % (46);
+      smallN = n % (46);
       smallK = k % (47);
       if ((smallK << smallN) % (47) == 46) return;
    }
@@ -322,5 +361,5 @@ void    SophieGermainWorker::RemoveTermsLargePrime(uint64_t k, bool firstOfPair,
 
    if (k < il_MinK || k > il_MaxK) return;
 
-   ip_SophieGermainApp->ReportFactor(prime, k, firstOfPair, true);
+   ip_SophieGermainApp->ReportFactor(prime, k, firstOfPair, true, nIdx);
 }
@@ -31,15 +31,18 @@ protected:
 private:
    void              TestMegaPrimeChunkSmall(void);
    void              TestMegaPrimeChunkLarge(void);
-   void              RemoveTermsSmallPrime(uint64_t prime, bool firstOfPair, uint64_t k);
-   void              RemoveTermsLargePrime(uint64_t prime, bool firstOfPair, uint64_t k);
+   void              RemoveTermsSmallPrime(uint64_t prime, bool firstOfPair, uint64_t k, uint32_t nIdx);
+   void              RemoveTermsLargePrime(uint64_t prime, bool firstOfPair, uint64_t k, uint32_t nIdx);
+   void              ApplySmallPrimes(void);
    
    SophieGermainApp *ip_SophieGermainApp;
+   KSegmentSieve    *ip_KSieve;
 
    uint64_t          il_MinK;
    uint64_t          il_MaxK;
    uint32_t          ii_Base;
    uint32_t          ii_N;
+   uint32_t          ii_NCount;
    bool              ib_GeneralizedSearch;
 };
 
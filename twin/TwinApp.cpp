@@ -16,13 +16,20 @@
 #include "TwinWorker.h"
 
 #define APP_NAME        "twinsieve"
-#define APP_VERSION     "1.6.5"
+#define APP_VERSION     "1.7"
 
 #define NMAX_MAX        (1 << 31)
 #define BMAX_MAX        (1 << 31)
 
-#define BIT_HK(k)       (((k) - il_MinK) >> 1)
-#define BIT_AK(k)       ((k) - il_MinK)
+// These are run by -0 (--selftest).  The factors were found with one worker.
+static const selftest_t selfTests[] = {
+   { "-k 1 -K 100000 -t 1 -b 2 -n 1000 -P 1e6",    49793, 0xa0d0b3afc09df1aaULL },
+   { "-k 1 -K 100000 -t 1 -b 2 -n 1000 -P 1e6 -s", 91947, 0x92de3e87b76b9860ULL },
+   { "-k 1 -K 100000 -t 1 -b 2 -n 1000 -P 1e6 -x",  5639, 0xc763119250d05402ULL },
+   { "-k 1 -K 100000 -t 2 -n 1009 -P 1e6",         30778, 0xf9fe94a3f974ce0cULL },
+   { "-k 1 -K 100000 -t 3 -n 500 -P 1e6",          30818, 0x5199ceb2a4e16ed2ULL },
+   { NULL, 0, 0 }
+};
 
 // This is declared in App.h, but implemented here.  This means that App.h
 // can remain unchanged if using the mtsieve framework for other applications.
@@ -35,11 +42,14 @@ TwinApp::TwinApp() : FactorApp()
 {
    SetBanner(APP_NAME " v" APP_VERSION ", a program to find factors of k*b^n+1/-1 numbers for fixed b and n and variable k");
    SetLogFileName("twinsieve.log");
+   SetSelfTests(selfTests);
    
    il_MinK = 0;
    il_MaxK = 0;
    ii_Base = 0;
    ii_N    = 0;
+   ii_MaxN = 0;
+   ii_NCount = 1;
    ib_OnlyTwins = true;
    it_Format = FF_ABCD;
    ib_Remove = false;
@@ -47,6 +57,8 @@ TwinApp::TwinApp() : FactorApp()
    il_Terms = NULL;
    ii_Primes = NULL;
    ib_HalfK = false;
+   ib_UseWheel = false;
+   ip_Wheel = NULL;
    
    il_MaxPrimeForValidFactor = PMAX_MAX_62BIT;
    
@@ -62,6 +74,9 @@ TwinApp::~TwinApp()
    
    if (il_Terms != 0)
       xfree(il_Terms);
+   
+   if (ip_Wheel != NULL)
+      delete ip_Wheel;
 }
 
 void TwinApp::Help(void)
@@ -72,26 +87,32 @@ void TwinApp::Help(void)
    printf("-K --kmax=K           Maximum k to search\n");
    printf("-b --base=b           Base to search\n");
    printf("-n --n=n              n of b^n, n# for primorial, n! for factorial\n");
+   printf("-N --nmax=N           Maximum n to search for b^n, one output file per n\n");
    printf("-t --termtype=t       1 = b^n, 2 = primorial, 3 = factorial\n");
    printf("-f --format=f         Format of output file (A=ABC, D=ABCD (default), N=NEWPGEN)\n");
    printf("-r --remove           Remove k where k %% base = 0\n");
    printf("-s --independent      Sieve +1 and -1 independently\n");       
+   printf("-x --wheel            Use a wheel to exclude k where 3, 5, 7, or 11 divides a term\n");
+   printf("-z --shard=i/m        Sieve only shard i of m (m is a power of 2)\n");
 }
 
 void  TwinApp::AddCommandLineOptions(std::string &shortOpts, struct option *longOpts)
 {
    FactorApp::ParentAddCommandLineOptions(shortOpts, longOpts);
 
-   shortOpts += "srk:K:b:n:t:f:";
+   shortOpts += "srxk:K:b:n:N:t:f:z:";
 
    AppendLongOpt(longOpts, "kmin",           required_argument, 0, 'k');
    AppendLongOpt(longOpts, "kmax",           required_argument, 0, 'K');
    AppendLongOpt(longOpts, "base",           required_argument, 0, 'b');
    AppendLongOpt(longOpts, "exp",            required_argument, 0, 'n');
+   AppendLongOpt(longOpts, "nmax",           required_argument, 0, 'N');
    AppendLongOpt(longOpts, "termtype",       required_argument, 0, 't');
    AppendLongOpt(longOpts, "format",         required_argument, 0, 'f');
    AppendLongOpt(longOpts, "remove",         no_argument, 0, 'r');
    AppendLongOpt(longOpts, "independent",    no_argument, 0, 's');
+   AppendLongOpt(longOpts, "wheel",          no_argument, 0, 'x');
+   AppendLongOpt(longOpts, "shard",          required_argument, 0, 'z');
 }
 
 parse_t TwinApp::ParseOption(int opt, char *arg, const char *source)
@@ -120,6 +141,10 @@ parse_t TwinApp::ParseOption(int opt, char *arg, const char *source)
          status = Parser::Parse(arg, 1, NMAX_MAX, ii_N);
          break;
 
+      case 'N':
+         status = Parser::Parse(arg, 1, NMAX_MAX, ii_MaxN);
+         break;
+
       case 't':
          status = Parser::Parse(arg, "123", value);
          
@@ -155,6 +180,15 @@ parse_t TwinApp::ParseOption(int opt, char *arg, const char *source)
          ib_Remove = true;
          status = P_SUCCESS;
          break;
+         
+      case 'x':
+         ib_UseWheel = true;
+         status = P_SUCCESS;
+         break;
+         
+      case 'z':
+         status = ParseShardOption(arg);
+         break;
    }
 
    return status;
@@ -167,8 +201,13 @@ void TwinApp::ValidateOptions(void)
 
    if (is_InputTermsFileName.length() > 0)
    {
+      if (ii_MaxN > 0)
+         FatalError("-N cannot be used with -i");
+      
       ProcessInputTermsFile(false);
       
+      ii_MaxN = ii_N;
+      
       // We only care about odd k or even k, but not both
       if (it_TermType == TT_BN && (ii_Base == 2 || ii_Base & 1))
          ib_HalfK = true;
@@ -179,23 +218,16 @@ void TwinApp::ValidateOptions(void)
       if (it_TermType == TT_FACTORIAL)
          BuildFactorialTerms();
       
-      uint64_t termSize = (il_MaxK - il_MinK) + 1;
+      CreateWheel();
       
-      if (ib_HalfK)
-         termSize = (il_MaxK - il_MinK)/2 + 1;
+      uint64_t termSize = ip_Wheel->GetBitCount();
             
       if (ib_OnlyTwins)
-      {
-         iv_TwinTerms.resize(termSize);
-         std::fill(iv_TwinTerms.begin(), iv_TwinTerms.end(), false);
-      }
+         iv_TwinTerms.assign(1, std::vector<bool>(termSize, false));
       else 
       {
-         iv_MinusTerms.resize(termSize);
-         std::fill(iv_MinusTerms.begin(), iv_MinusTerms.end(), false);
-         
-         iv_PlusTerms.resize(termSize);         
-         std::fill(iv_PlusTerms.begin(), iv_PlusTerms.end(), false);
+         iv_MinusTerms.assign(1, std::vector<bool>(termSize, false));
+         iv_PlusTerms.assign(1, std::vector<bool>(termSize, false));
       }
       
       ProcessInputTermsFile(true);
@@ -219,12 +251,18 @@ void TwinApp::ValidateOptions(void)
       
       if (ii_N == 0)
          FatalError("exponent must be specified");
+      
+      if (ii_MaxN == 0)
+         ii_MaxN = ii_N;
+      
+      if (ii_MaxN < ii_N)
+         FatalError("nmax must be greater than or equal to n");
+      
+      if (ii_MaxN > ii_N && it_TermType != TT_BN)
+         FatalError("-N is only supported for b^n");
+      
+      ii_NCount = ii_MaxN - ii_N + 1;
 
-      if (ib_OnlyTwins)
-         il_TermCount = (il_MaxK - il_MinK) + 1;
-      else
-         il_TermCount = 2*((il_MaxK - il_MinK) + 1);
-         
       if (it_TermType == TT_BN)
       {
          if (il_MaxK < ii_Base)
@@ -241,11 +279,6 @@ void TwinApp::ValidateOptions(void)
             
             if (!(il_MaxK & 1))
                il_MaxK--;
-
-            if (ib_OnlyTwins)
-               il_TermCount = (il_MaxK - il_MinK)/2 + 1;
-            else
-               il_TermCount = 2*((il_MaxK - il_MinK)/2 + 1);
          }
          
          if (ii_Base & 1)
@@ -259,11 +292,6 @@ void TwinApp::ValidateOptions(void)
             
             if (il_MaxK & 1)
                il_MaxK--;
-         
-            if (ib_OnlyTwins)
-               il_TermCount = (il_MaxK - il_MinK)/2 + 1;
-            else
-               il_TermCount = 2*((il_MaxK - il_MinK)/2 + 1);
          }
       }
       else
@@ -281,18 +309,22 @@ void TwinApp::ValidateOptions(void)
          }
       }
       
+      CreateWheel();
+      
+      uint64_t termSize = ip_Wheel->GetBitCount();
+      
       if (ib_OnlyTwins)
       {
-         iv_TwinTerms.resize(il_TermCount);
-         std::fill(iv_TwinTerms.begin(), iv_TwinTerms.end(), true);
+         il_TermCount = termSize * ii_NCount;
+         
+         iv_TwinTerms.assign(ii_NCount, std::vector<bool>(termSize, true));
       }
       else 
       {
-         iv_MinusTerms.resize(il_TermCount);
-         std::fill(iv_MinusTerms.begin(), iv_MinusTerms.end(), true);
+         il_TermCount = 2*termSize * ii_NCount;
          
-         iv_PlusTerms.resize(il_TermCount);
-         std::fill(iv_PlusTerms.begin(), iv_PlusTerms.end(), true);
+         iv_MinusTerms.assign(ii_NCount, std::vector<bool>(termSize, true));
+         iv_PlusTerms.assign(ii_NCount, std::vector<bool>(termSize, true));
       } 
    }
    
@@ -319,28 +351,34 @@ void TwinApp::ValidateOptions(void)
       // Remvoe k that are divisible by the base
       for ( ; k<=il_MaxK; k+=ii_Base)
       {
-         uint64_t bit = (ib_HalfK ? BIT_HK(k) : BIT_AK(k));
+         uint64_t bit;
          
-         if (ib_OnlyTwins)
-         {
-            if (iv_TwinTerms[bit])
-            {
-               il_TermCount--;
-               iv_TwinTerms[bit] = false;
-            }
-         }
-         else
+         if (!ip_Wheel->GetBit(k, bit))
+            continue;
+         
+         for (uint32_t nIdx=0; nIdx<ii_NCount; nIdx++)
          {
-            if (iv_MinusTerms[bit])
+            if (ib_OnlyTwins)
             {
-               il_TermCount--;
-               iv_MinusTerms[bit] = false;
+               if (iv_TwinTerms[nIdx][bit])
+               {
+                  il_TermCount--;
+                  iv_TwinTerms[nIdx][bit] = false;
+               }
             }
-            
-            if (iv_PlusTerms[bit])
+            else
             {
-               il_TermCount--;
-               iv_PlusTerms[bit] = false;
+               if (iv_MinusTerms[nIdx][bit])
+               {
+                  il_TermCount--;
+                  iv_MinusTerms[nIdx][bit] = false;
+               }
+               
+               if (iv_PlusTerms[nIdx][bit])
+               {
+                  il_TermCount--;
+                  iv_PlusTerms[nIdx][bit] = false;
+               }
             }
          }
       }
@@ -350,7 +388,15 @@ void TwinApp::ValidateOptions(void)
    {
       char  fileName[50];
       
-      if (it_TermType == TT_BN)
+      // With more than one n, _n<n> is added to the name of each file
+      if (it_TermType == TT_BN && ii_NCount > 1)
+      {
+         if (it_Format == FF_NEWPGEN)
+            snprintf(fileName, sizeof(fileName), "k_b%u.npg", ii_Base);
+         else
+            snprintf(fileName, sizeof(fileName), "k_b%u.pfgw", ii_Base);
+      }
+      else if (it_TermType == TT_BN)
       {
          if (it_Format == FF_NEWPGEN)
             snprintf(fileName, sizeof(fileName), "k_b%u_n%u.npg", ii_Base, ii_N);
@@ -367,9 +413,11 @@ void TwinApp::ValidateOptions(void)
       is_OutputTermsFileName = fileName;
    }
 
-   if (ib_HalfK)
+   if (ib_HalfK && GetMinPrime() < 3)
       SetAppMinPrime(3);
 
+   ValidateShardOption();
+   
    FactorApp::ParentValidateOptions();
 
    // Since the worker wants primes in groups of 4
@@ -449,8 +497,11 @@ void TwinApp::ProcessInputTermsFile(bool haveBitMap)
 
       if (haveBitMap)
       {
-         iv_TwinTerms[k-il_MinK] = true;
-         il_TermCount++;
+         if (ip_Wheel->GetBit(k, bit))
+         {
+            iv_TwinTerms[0][bit] = true;
+            il_TermCount++;
+         }
       }
       else
          il_MinK = il_MaxK = k;
@@ -556,19 +607,21 @@ void TwinApp::ProcessInputTermsFile(bool haveBitMap)
             
       if (haveBitMap)
       {
-         bit = (ib_HalfK ? BIT_HK(k) : BIT_AK(k));
+         // Skip k that were excluded by the wheel
+         if (!ip_Wheel->GetBit(k, bit))
+            continue;
 
          if (ib_OnlyTwins)
          {
-            iv_TwinTerms[bit] = true;
+            iv_TwinTerms[0][bit] = true;
             il_TermCount++;
          }
          else
          {
             if (c == -1)
-               iv_MinusTerms[bit] = true;
+               iv_MinusTerms[0][bit] = true;
             else
-               iv_PlusTerms[bit] = true;
+               iv_PlusTerms[0][bit] = true;
             il_TermCount++;
          }
       }
@@ -582,6 +635,78 @@ void TwinApp::ProcessInputTermsFile(bool haveBitMap)
    fclose(fPtr);
 }
 
+// This is called after kmin, kmax, and ib_HalfK are known.  Without -x the wheel
+// is empty and the bit for k is just its position in the range of k.
+void TwinApp::CreateWheel(void)
+{
+   double   minTerm = (double) il_MinK;
+   uint64_t minK = il_MinK;
+   uint32_t kShift = (ib_HalfK ? 1 : 0);
+   uint32_t idx, prime, multiplier;
+   
+   ApplyShardToK(minK, il_MaxK, kShift);
+   
+   ip_Wheel = new KWheel(minK, il_MaxK, kShift);
+   
+   if (!ib_UseWheel)
+      return;
+   
+   if (!ib_OnlyTwins)
+   {
+      WriteToConsole(COT_OTHER, "Ignoring -x since it is not supported when using -s");
+      return;
+   }
+   
+   // The k that are excluded depend upon n
+   if (ii_NCount > 1)
+   {
+      WriteToConsole(COT_OTHER, "Ignoring -x since it is not supported when using -N");
+      return;
+   }
+   
+   if (it_TermType == TT_BN)
+      minTerm *= pow((double) ii_Base, (double) ii_N);
+   
+   if (it_TermType == TT_PRIMORIAL || it_TermType == TT_FACTORIAL)
+      minTerm *= (double) il_Terms[0];
+   
+   // A term could be one of the primes in the wheel
+   if (minTerm <= (double) (KW_MAX_PRIME + 1))
+   {
+      WriteToConsole(COT_OTHER, "Ignoring -x since the smallest term is too small");
+      return;
+   }
+   
+   for (idx=0; KWheel::GetPrime(idx) > 0; idx++)
+   {
+      prime = KWheel::GetPrime(idx);
+      multiplier = GetMultiplierModP(prime);
+      
+      ip_Wheel->ExcludeTerm(prime, multiplier, -1);
+      ip_Wheel->ExcludeTerm(prime, multiplier, +1);
+   }
+   
+   ip_Wheel->Build();
+   
+   WriteToConsole(COT_OTHER, "Wheel of size %u removed %" PRIu64" of %" PRIu64" k", ip_Wheel->GetModulus(), 
+                  ip_Wheel->GetPositionCount() - ip_Wheel->GetBitCount(), ip_Wheel->GetPositionCount());
+}
+
+// Compute b^n, n#, or n! mod a small prime
+uint32_t TwinApp::GetMultiplierModP(uint32_t prime)
+{
+   uint64_t multiplier = 1;
+   uint32_t idx;
+   
+   if (it_TermType == TT_BN)
+      return KWheel::PowMod(ii_Base, ii_N, prime);
+   
+   for (idx=0; il_Terms[idx] > 0; idx++)
+      multiplier = (multiplier * (il_Terms[idx] % prime)) % prime;
+   
+   return (uint32_t) multiplier;
+}
+
 void TwinApp::BuildPrimorialTerms(void)
 {
    primesieve::iterator   primeIterator;
@@ -667,8 +792,8 @@ bool TwinApp::ApplyFactor(uint64_t theFactor,  const char *term)
    if (b != ii_Base)
       FatalError("Expected base %u in factor but found base %u", ii_Base, b);
    
-   if (n != ii_N)
-      FatalError("Expected n %u in factor but found %d", ii_N, n);
+   if (n < ii_N || n > ii_MaxN)
+      FatalError("Expected n between %u and %u in factor but found %d", ii_N, ii_MaxN, n);
    
    if (c != +1 && c != -1)
       FatalError("Expected c of +1 or -1 in factor but found %d", c);
@@ -676,14 +801,18 @@ bool TwinApp::ApplyFactor(uint64_t theFactor,  const char *term)
    if (k < il_MinK || k > il_MaxK)
       return false;
    
-   uint64_t bit = k - il_MinK;
+   uint64_t bit;
+   uint32_t nIdx = n - ii_N;
+   
+   if (!ip_Wheel->GetBit(k, bit))
+      return false;
    
    // No locking is needed because the Workers aren't running yet
    if (ib_OnlyTwins)
    {
-      if (iv_TwinTerms[bit])
+      if (iv_TwinTerms[nIdx][bit])
       {
-         iv_TwinTerms[bit] = false;
+         iv_TwinTerms[nIdx][bit] = false;
          il_TermCount--;
 
          return true;
@@ -691,17 +820,17 @@ bool TwinApp::ApplyFactor(uint64_t theFactor,  const char *term)
    }
    else
    {
-      if (c == -1 && iv_MinusTerms[bit])
+      if (c == -1 && iv_MinusTerms[nIdx][bit])
       {
-         iv_MinusTerms[bit] = false;
+         iv_MinusTerms[nIdx][bit] = false;
          il_TermCount--;
 
          return true;
       }
 
-      if (c == +1 && iv_PlusTerms[bit])
+      if (c == +1 && iv_PlusTerms[nIdx][bit])
       {
-         iv_PlusTerms[bit] = false;
+         iv_PlusTerms[nIdx][bit] = false;
          il_TermCount--;
 
          return true;
@@ -711,173 +840,120 @@ bool TwinApp::ApplyFactor(uint64_t theFactor,  const char *term)
    return false;
 }
 
+// The terms are copied while holding the lock so that the workers are not
+// blocked while the files are formatted and written.
 void TwinApp::WriteOutputTermsFile(uint64_t largestPrime)
 {
-   uint64_t termsCounted = 0;
-   
-   FILE    *termsFile = fopen(is_OutputTermsFileName.c_str(), "w");
-
-   if (!termsFile)
-      FatalError("Unable to open output file %s", is_OutputTermsFileName.c_str());
+   std::vector<KTermsFileWriter *> writers;
+   uint64_t termsCounted = 0, expectedTerms;
    
    ip_FactorAppLock->Lock();
-      
-   if (it_Format == FF_ABCD)
-      termsCounted = WriteABCDTermsFile(largestPrime, termsFile);
-   
-   if (it_Format == FF_ABC)
-      termsCounted = WriteABCTermsFile(largestPrime, termsFile);
    
-   if (it_Format == FF_NEWPGEN)
-      termsCounted = WriteNewPGenTermsFile(largestPrime, termsFile);
+   for (uint32_t nIdx=0; nIdx<ii_NCount; nIdx++)
+      writers.push_back(CreateTermsFileWriter(nIdx));
    
-   fclose(termsFile);
-   
-   if (termsCounted != il_TermCount)
-      FatalError("Something is wrong.  Counted terms (%" PRIu64") != expected terms (%" PRIu64")", termsCounted, il_TermCount);
+   expectedTerms = il_TermCount;
 
    ip_FactorAppLock->Release();
-}
-
-uint64_t TwinApp::WriteABCDTermsFile(uint64_t maxPrime, FILE *termsFile)
-{
-   uint64_t k, kCount = 0, previousK;
-   uint64_t bit, adder = (ib_HalfK ? 2 : 1);
-
-   k = il_MinK;
-
-   bit = (ib_HalfK ? BIT_HK(k) : BIT_AK(k));
-
-   for (; k<=il_MaxK; k+=adder)
-   {      
-      if (iv_TwinTerms[bit])
-         break;
-      
-      bit++;
-   }
-
-   if (k > il_MaxK)
-      return 0;
    
-   if (it_TermType == TT_BN)
-      fprintf(termsFile, "ABCD $a*%u^%d+1 & $a*%u^%d-1  [%" SCNu64"] // Sieved to %" SCNu64"\n", ii_Base, ii_N, ii_Base, ii_N, k, maxPrime);
-
-   if (it_TermType == TT_PRIMORIAL)
-      fprintf(termsFile, "ABCD $a*%u#+1 & $a*%u#-1  [%" SCNu64"] // Sieved to %" SCNu64"\n", ii_N, ii_N, k, maxPrime);
-
-   if (it_TermType == TT_FACTORIAL)
-      fprintf(termsFile, "ABCD $a*%u!+1 & $a*%u!-1  [%" SCNu64"] // Sieved to %" SCNu64"\n", ii_N, ii_N, k, maxPrime);
+   if (ii_NCount == 1)
+      termsCounted = WriteTermsFile(writers[0], largestPrime, 0, is_OutputTermsFileName.c_str());
+   else
+   {
+      for (uint32_t nIdx=0; nIdx<ii_NCount; nIdx++)
+         termsCounted += WriteTermsFile(writers[nIdx], largestPrime, nIdx, GetOutputTermsFileNameForN(ii_N + nIdx).c_str());
+   }
    
-   previousK = k;
-   kCount = 1;
-   k += adder;
+   for (uint32_t nIdx=0; nIdx<ii_NCount; nIdx++)
+      delete writers[nIdx];
    
-   bit = (ib_HalfK ? BIT_HK(k) : BIT_AK(k));
+   if (termsCounted != expectedTerms)
+      FatalError("Something is wrong.  Counted terms (%" PRIu64") != expected terms (%" PRIu64")", termsCounted, expectedTerms);
+}
+
+KTermsFileWriter *TwinApp::CreateTermsFileWriter(uint32_t nIdx)
+{
+   KTermsFileWriter *writer = new KTermsFileWriter(ip_Wheel, GetCpuWorkerCount());
    
-   for (; k<=il_MaxK; k+=adder)
+   if (it_Format == FF_ABC && !ib_OnlyTwins)
    {
-      if (iv_TwinTerms[bit])
-      {
-         fprintf(termsFile, "%" PRIu64"\n", k - previousK);
-         previousK = k;
-         kCount++;
-      }
+      writer->AddBitmap(iv_PlusTerms[nIdx], " +1");
+      writer->AddBitmap(iv_MinusTerms[nIdx], " -1");
+   }
+   else if (it_Format == FF_NEWPGEN)
+   {
+      char suffix[20];
+      
+      // Each line of a NewPGen file has n after k
+      snprintf(suffix, sizeof(suffix), " %u", ii_N + nIdx);
       
-      bit++;
+      writer->AddBitmap(iv_TwinTerms[nIdx], suffix);
    }
-
-   return kCount;
+   else
+      writer->AddBitmap(iv_TwinTerms[nIdx], "");
+   
+   return writer;
 }
 
-uint64_t TwinApp::WriteABCTermsFile(uint64_t maxPrime, FILE *termsFile)
+uint64_t TwinApp::WriteTermsFile(KTermsFileWriter *writer, uint64_t maxPrime, uint32_t nIdx, const char *fileName)
 {
-   uint64_t k, kCount = 0;
-   uint64_t bit, adder = (ib_HalfK ? 2 : 1);
-
-   if (ib_OnlyTwins)
-   {
-      if (it_TermType == TT_BN)
-         fprintf(termsFile, "ABC $a*%u^%d+1 & $a*%u^%d-1 // Sieved to %" SCNu64"\n", ii_Base, ii_N, ii_Base, ii_N, maxPrime);
-
-      if (it_TermType == TT_PRIMORIAL)
-         fprintf(termsFile, "ABC $a*%u#+1 & $a*%u#-1 // Sieved to %" SCNu64"\n", ii_N, ii_N, maxPrime);
-
-      if (it_TermType == TT_FACTORIAL)
-         fprintf(termsFile, "ABC $a*%u!+1 & $a*%u!-1 // Sieved to %" SCNu64"\n", ii_N, ii_N, maxPrime);
-   }
-   else
+   uint32_t n = ii_N + nIdx;
+   char     header[200], suffix[100];
+   
+   if (it_Format == FF_ABCD)
    {
       if (it_TermType == TT_BN)
-         fprintf(termsFile, "ABC $a*%u^%d$b // Sieved to %" SCNu64"\n", ii_Base, ii_N, maxPrime);
+         snprintf(header, sizeof(header), "ABCD $a*%u^%d+1 & $a*%u^%d-1  ", ii_Base, n, ii_Base, n);
 
       if (it_TermType == TT_PRIMORIAL)
-         fprintf(termsFile, "ABC $a*%u#$b // Sieved to %" SCNu64"\n", ii_N, maxPrime);
+         snprintf(header, sizeof(header), "ABCD $a*%u#+1 & $a*%u#-1  ", n, n);
 
       if (it_TermType == TT_FACTORIAL)
-         fprintf(termsFile, "ABC $a*%u!$b // Sieved to %" SCNu64"\n", ii_N, maxPrime);
-   }
+         snprintf(header, sizeof(header), "ABCD $a*%u!+1 & $a*%u!-1  ", n, n);
       
-   k = il_MinK;
-   bit = (ib_HalfK ? BIT_HK(k) : BIT_AK(k));
-
-   for ( ; k<=il_MaxK; k+=adder)
+      snprintf(suffix, sizeof(suffix), " // Sieved to %" PRIu64"", maxPrime);
+   
+      return writer->WriteABCD(fileName, header, suffix);
+   }
+   
+   if (it_Format == FF_ABC)
    {
       if (ib_OnlyTwins)
       {
-         if (iv_TwinTerms[bit])
-         {
-            fprintf(termsFile, "%" PRIu64"\n", k);
-            kCount++;
-         }
+         if (it_TermType == TT_BN)
+            snprintf(header, sizeof(header), "ABC $a*%u^%d+1 & $a*%u^%d-1 // Sieved to %" PRIu64"", ii_Base, n, ii_Base, n, maxPrime);
+
+         if (it_TermType == TT_PRIMORIAL)
+            snprintf(header, sizeof(header), "ABC $a*%u#+1 & $a*%u#-1 // Sieved to %" PRIu64"", n, n, maxPrime);
+
+         if (it_TermType == TT_FACTORIAL)
+            snprintf(header, sizeof(header), "ABC $a*%u!+1 & $a*%u!-1 // Sieved to %" PRIu64"", n, n, maxPrime);
       }
       else
       {
-         if (iv_PlusTerms[bit])
-         {
-            fprintf(termsFile, "%" PRIu64" +1\n", k);
-            kCount++;
-         }
-         
-         if (iv_MinusTerms[bit])
-         {
-            fprintf(termsFile, "%" PRIu64" -1\n", k);
-            kCount++;
-         }
-      }
-      
-      bit++;
-   }
-   
-   return kCount;
-}
+         if (it_TermType == TT_BN)
+            snprintf(header, sizeof(header), "ABC $a*%u^%d$b // Sieved to %" PRIu64"", ii_Base, n, maxPrime);
 
-uint64_t TwinApp::WriteNewPGenTermsFile(uint64_t maxPrime, FILE *termsFile)
-{
-   uint64_t k, kCount = 0;
-   uint64_t bit, adder = (ib_HalfK ? 2 : 1);
+         if (it_TermType == TT_PRIMORIAL)
+            snprintf(header, sizeof(header), "ABC $a*%u#$b // Sieved to %" PRIu64"", n, maxPrime);
 
-   fprintf(termsFile, "%" PRIu64":T:0:%u:3\n", maxPrime, ii_Base);
-      
-   k = il_MinK;
-   bit = (ib_HalfK ? BIT_HK(k) : BIT_AK(k));
-   
-   for ( ; k<=il_MaxK; k+=adder)
-   {
-      if (iv_TwinTerms[bit])
-      {
-         fprintf(termsFile, "%" PRIu64" %u\n", k, ii_N);
-         kCount++;
+         if (it_TermType == TT_FACTORIAL)
+            snprintf(header, sizeof(header), "ABC $a*%u!$b // Sieved to %" PRIu64"", n, maxPrime);
       }
       
-      bit++;
+      return writer->WriteList(fileName, header);
    }
    
-   return kCount;
+   snprintf(header, sizeof(header), "%" PRIu64":T:0:%u:3", maxPrime, ii_Base);
+   
+   return writer->WriteList(fileName, header);
 }
 
 void  TwinApp::GetExtraTextForSieveStartedMessage(char *extraText, uint32_t maxTextLength)
 {
-   if (it_TermType == TT_BN)
+   if (it_TermType == TT_BN && ii_NCount > 1)
+      snprintf(extraText, maxTextLength, "%" PRIu64 " < k < %" PRIu64", k*%u^n, %u <= n <= %u", il_MinK, il_MaxK, ii_Base, ii_N, ii_MaxN);
+   else if (it_TermType == TT_BN)
       snprintf(extraText, maxTextLength, "%" PRIu64 " < k < %" PRIu64", k*%u^%u", il_MinK, il_MaxK, ii_Base, ii_N);
    
    if (it_TermType == TT_PRIMORIAL)
@@ -887,12 +963,11 @@ void  TwinApp::GetExtraTextForSieveStartedMessage(char *extraText, uint32_t maxT
       snprintf(extraText, maxTextLength, "%" PRIu64" < k < %" PRIu64", k*%u!", il_MinK, il_MaxK, ii_N);
 }
 
-void  TwinApp::ReportFactor(uint64_t theFactor, uint64_t k, int32_t c)
+// Adjust k so that it is in the bitmap.  This returns false if there is no such k.
+bool  TwinApp::GetFirstK(uint64_t theFactor, uint64_t &k)
 {
-   char     kStr[50];
-
    if (theFactor > il_MaxPrimeForValidFactor)
-      return;
+      return false;
    
    if (ib_HalfK)
    {
@@ -906,30 +981,47 @@ void  TwinApp::ReportFactor(uint64_t theFactor, uint64_t k, int32_t c)
          if (k & 1)
             k += theFactor;
       }
-      
-      if (k >= il_MaxK)
-         return;
    }
    
+   return ip_Wheel->AlignK(theFactor, k);
+}
+
+void  TwinApp::ReportFactor(uint64_t theFactor, uint64_t k, int32_t c, uint32_t nIdx)
+{
+   uint32_t n = ii_N + nIdx;
+   char     kStr[50];
+
+   PROFILE_SCOPE(PP_FACTORS);
+   
+   if (!GetFirstK(theFactor, k))
+      return;
+   
    // If the first term is valid, then the rest are valid.  In other words 
    // k*x (mod p) = (k+p)*x (mod p) = ... = (k+n*p)*x (mod p)
-   VerifyFactor(theFactor, k, c);
+   VerifyFactor(theFactor, k, c, n);
    
    ip_FactorAppLock->Lock();
 
    do
    {
-      uint64_t bit = (ib_HalfK ? BIT_HK(k) : BIT_AK(k));
+      uint64_t bit;
+      
+      // k was excluded by the wheel
+      if (!ip_Wheel->GetBit(k, bit))
+      {
+         k += (theFactor << ip_Wheel->GetKShift());
+         continue;
+      }
 
       snprintf(kStr, sizeof(kStr), "%" PRIu64"", k);
 
       if (ib_OnlyTwins)
       {
-         if (iv_TwinTerms[bit])
+         if (iv_TwinTerms[nIdx][bit])
          {
-            iv_TwinTerms[bit] = false;
+            iv_TwinTerms[nIdx][bit] = false;
             
-            LogFactor(theFactor, "%s*%u^%u%+d", kStr, ii_Base, ii_N, c);
+            LogFactor(theFactor, "%s*%u^%u%+d", kStr, ii_Base, n, c);
             
             il_FactorCount++;
             il_TermCount--;
@@ -940,11 +1032,11 @@ void  TwinApp::ReportFactor(uint64_t theFactor, uint64_t k, int32_t c)
       }
       else
       {
-         if (c == -1 && iv_MinusTerms[bit])
+         if (c == -1 && iv_MinusTerms[nIdx][bit])
          {
-            iv_MinusTerms[bit] = false;
+            iv_MinusTerms[nIdx][bit] = false;
             
-            LogFactor(theFactor, "%s*%u^%u-1", kStr, ii_Base, ii_N);
+            LogFactor(theFactor, "%s*%u^%u-1", kStr, ii_Base, n);
             
             il_FactorCount++;
             il_TermCount--;
@@ -953,11 +1045,11 @@ void  TwinApp::ReportFactor(uint64_t theFactor, uint64_t k, int32_t c)
                Interrupt("All terms have factors");
          }
 
-         if (c == +1 && iv_PlusTerms[bit])
+         if (c == +1 && iv_PlusTerms[nIdx][bit])
          {
-            iv_PlusTerms[bit] = false;
+            iv_PlusTerms[nIdx][bit] = false;
             
-            LogFactor(theFactor, "%s*%u^%u+1", kStr, ii_Base, ii_N);
+            LogFactor(theFactor, "%s*%u^%u+1", kStr, ii_Base, n);
             
             il_FactorCount++;
             il_TermCount--;
@@ -966,19 +1058,68 @@ void  TwinApp::ReportFactor(uint64_t theFactor, uint64_t k, int32_t c)
                Interrupt("All terms have factors");
          }
       }
-      if (ib_HalfK)
-      {
-         // We only care about every other k
-         k += (theFactor << 1);
-      }
-      else
-         k += theFactor; 
+      // This is the next k in the bitmap that p divides
+      k += (theFactor << ip_Wheel->GetKShift());
    } while (k <= il_MaxK);
    
    ip_FactorAppLock->Release();
 }
 
-// Don't sieve beyond sqrt(maxk*b^n+c).  The worker will not
+// This is used for p <= il_MaxK.  The bitmap is sieved one segment at a time so that
+// other workers can report factors between segments.
+void  TwinApp::ReportFactors(KSegmentSieve *kSieve)
+{
+   std::vector<std::vector<bool> *> bitmaps(2 * ii_NCount);
+   std::vector<ksieve_entry_t>::const_iterator it;
+   const ksieve_entry_t *entry;
+   uint32_t idx, nIdx, segment;
+   
+   PROFILE_SCOPE(PP_FACTORS);
+   
+   // The bitmap index is 2*nIdx for -1 and 2*nIdx+1 for +1
+   for (nIdx=0; nIdx<ii_NCount; nIdx++)
+   {
+      bitmaps[2*nIdx+0] = (ib_OnlyTwins ? &iv_TwinTerms[nIdx] : &iv_MinusTerms[nIdx]);
+      bitmaps[2*nIdx+1] = (ib_OnlyTwins ? &iv_TwinTerms[nIdx] : &iv_PlusTerms[nIdx]);
+   }
+   
+   // If the first term is valid, then the rest are valid.
+   for (idx=0; idx<kSieve->GetPrimeCount(); idx++)
+   {
+      entry = kSieve->GetPrime(idx);
+      
+      VerifyFactor(entry->prime, kSieve->GetPrimeK(idx), (int32_t) entry->tag, ii_N + entry->bitmapIdx/2);
+   }
+   
+   for (segment=0; segment<kSieve->GetSegmentCount(); segment++)
+   {
+      if (!kSieve->HasSegmentPrimes(segment))
+         continue;
+      
+      ip_FactorAppLock->Lock();
+      
+      kSieve->SieveSegment(segment, &bitmaps[0]);
+      
+      const std::vector<ksieve_entry_t> &hits = kSieve->GetHits();
+      
+      StartFactorBatch();
+      
+      for (it=hits.begin(); it!=hits.end(); it++)
+         LogFactor(it->prime, "%" PRIu64"*%u^%u%+d", kSieve->GetK(it->bit), ii_Base, ii_N + it->bitmapIdx/2, (int32_t) it->tag);
+      
+      EndFactorBatch();
+      
+      il_FactorCount += hits.size();
+      il_TermCount -= hits.size();
+      
+      if (hits.size() > 0 && il_TermCount == 0)
+         Interrupt("All terms have factors");
+      
+      ip_FactorAppLock->Release();
+   }
+}
+
+// Don't sieve beyond sqrt(maxk*b^maxn+c).  The worker will not
 // remove terms that are prime, so this means that all remaining
 // terms will be prime when we reach p = sqrt(maxk*b^n+c).
 void  TwinApp::AdjustMaxPrime(void)
@@ -992,7 +1133,7 @@ void  TwinApp::AdjustMaxPrime(void)
    
    toobig *= toobig;
    
-   for (uint32_t i=0; i<ii_N; i++)
+   for (uint32_t i=0; i<ii_MaxN; i++)
    {
       bpown *= b;
 
@@ -1024,7 +1165,7 @@ void  TwinApp::AdjustMaxPrime(void)
    }
 }
 
-void  TwinApp::VerifyFactor(uint64_t theFactor, uint64_t k, int32_t c)
+void  TwinApp::VerifyFactor(uint64_t theFactor, uint64_t k, int32_t c, uint32_t n)
 {
    MpArith  mp(theFactor);
    MpRes    pOne = mp.one();
@@ -1032,7 +1173,7 @@ void  TwinApp::VerifyFactor(uint64_t theFactor, uint64_t k, int32_t c)
    
    if (it_TermType == TT_BN)
    {
-      resRem = mp.pow(mp.nToRes(ii_Base), ii_N);
+      resRem = mp.pow(mp.nToRes(ii_Base), n);
    }
    else
    {   
@@ -1057,7 +1198,7 @@ void  TwinApp::VerifyFactor(uint64_t theFactor, uint64_t k, int32_t c)
       char     term[50];
 
       if (it_TermType == TT_BN)
-         snprintf(term, sizeof(term), "%" PRIu64"*%u^%u%+d", k, ii_Base, ii_N, c);
+         snprintf(term, sizeof(term), "%" PRIu64"*%u^%u%+d", k, ii_Base, n, c);
          
       if (it_TermType == TT_PRIMORIAL)
          snprintf(term, sizeof(term), "%" PRIu64"*%u#%+d", k, ii_N, c);
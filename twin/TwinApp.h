@@ -12,6 +12,8 @@
 #define _TwinApp_H
 
 #include "../core/FactorApp.h"
+#include "../core/KSegmentSieve.h"
+#include "../core/TermsFileWriter.h"
 
 #define KMAX_MAX (UINT64_C(1)<<62)
 #define NMAX_MAX (1 << 31)
@@ -35,12 +37,17 @@ public:
    
    uint64_t          GetMinK(void) { return il_MinK; };
    uint64_t          GetMaxK(void) { return il_MaxK; };
+   bool              IsHalfK(void) { return ib_HalfK; };
    uint32_t          GetBase(void) { return ii_Base; };
    uint32_t          GetN(void) { return ii_N; };
+   uint32_t          GetNCount(void) { return ii_NCount; };
    termtype_t        GetTermType(void) { return it_TermType; };
    uint64_t         *GetTerms(void) { return il_Terms; };
+   KWheel           *GetWheel(void) { return ip_Wheel; };
    
-   void              ReportFactor(uint64_t theFactor, uint64_t k, int32_t c);
+   bool              GetFirstK(uint64_t theFactor, uint64_t &k);
+   void              ReportFactor(uint64_t theFactor, uint64_t k, int32_t c, uint32_t nIdx);
+   void              ReportFactors(KSegmentSieve *kSieve);
 
 protected:
    void              PreSieveHook(void) {};
@@ -58,15 +65,17 @@ protected:
    Worker           *CreateWorker(uint32_t id, bool gpuWorker, uint64_t largestPrimeTested);
 
 private:
-   uint64_t          WriteABCDTermsFile(uint64_t maxPrime, FILE *termsFile);
-   uint64_t          WriteABCTermsFile(uint64_t maxPrime, FILE *termsFile);
-   uint64_t          WriteNewPGenTermsFile(uint64_t maxPrime, FILE *termsFile);
+   KTermsFileWriter *CreateTermsFileWriter(uint32_t nIdx);
+   uint64_t          WriteTermsFile(KTermsFileWriter *writer, uint64_t maxPrime, uint32_t nIdx, const char *fileName);
    void              AdjustMaxPrime(void);
-   void              VerifyFactor(uint64_t theFactor, uint64_t k, int32_t c);
+   void              CreateWheel(void);
+   uint32_t          GetMultiplierModP(uint32_t prime);
+   void              VerifyFactor(uint64_t theFactor, uint64_t k, int32_t c, uint32_t n);
 
-   std::vector<bool> iv_TwinTerms;
-   std::vector<bool> iv_MinusTerms;
-   std::vector<bool> iv_PlusTerms;
+   // There is one bitmap for each n from ii_N to ii_MaxN
+   std::vector<std::vector<bool>> iv_TwinTerms;
+   std::vector<std::vector<bool>> iv_MinusTerms;
+   std::vector<std::vector<bool>> iv_PlusTerms;
    termtype_t        it_TermType;
    
    std::string       is_InputFileName;
@@ -74,12 +83,17 @@ private:
 
    format_t          it_Format;
    bool              ib_HalfK;
+   bool              ib_UseWheel;
+   
+   KWheel           *ip_Wheel;
 
    uint64_t          il_MaxPrimeForValidFactor;
    uint64_t          il_MinK;
    uint64_t          il_MaxK;
    uint32_t          ii_Base;
    uint32_t          ii_N;
+   uint32_t          ii_MaxN;
+   uint32_t          ii_NCount;
    bool              ib_OnlyTwins;
    bool              ib_Remove;
    
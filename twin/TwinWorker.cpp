@@ -21,20 +21,29 @@ TwinWorker::TwinWorker(uint32_t myId, App *theApp) : Worker(myId, theApp)
    il_MaxK = ip_TwinApp->GetMaxK();
    ii_Base = ip_TwinApp->GetBase();
    ii_N = ip_TwinApp->GetN();
+   ii_NCount = ip_TwinApp->GetNCount();
    it_TermType = ip_TwinApp->GetTermType();
    
    ii_BaseInverses = NULL;
    il_MyPrimeList = NULL;
    ii_InverseList = NULL;
+   ip_PowerChain = NULL;
    
    il_Terms = ip_TwinApp->GetTerms();
    
+   ip_KSieve = new KSegmentSieve(ip_TwinApp->GetWheel());
+   
    DeterminePrimeTermRange();
    
    // This limit comes from newpgen, but is not documented why it exists.
    // I do know that larger bases yield incorrect factors if we use the wrong logic.
    if (ii_Base < 255256 && it_TermType == TT_BN)
+   {
       BuildBaseInverses();
+      
+      // n is the same for every prime so the chain for (1/b)^n is only built once
+      ip_PowerChain = new MpPowerChain(ii_N);
+   }
    
    // The thread can't start until initialization is done
    ib_Initialized = true;
@@ -42,6 +51,8 @@ TwinWorker::TwinWorker(uint32_t myId, App *theApp) : Worker(myId, theApp)
 
 void  TwinWorker::CleanUp(void)
 {
+   delete ip_KSieve;
+   
    if (il_MyPrimeList != NULL)
    {
       xfree(il_MyPrimeList);
@@ -50,6 +61,9 @@ void  TwinWorker::CleanUp(void)
    
    if (ii_BaseInverses != NULL)
       xfree(ii_BaseInverses);
+   
+   if (ip_PowerChain != NULL)
+      delete ip_PowerChain;
 }
 
 void  TwinWorker::NotifyPrimeListAllocated(uint32_t primesInList)
@@ -84,11 +98,13 @@ void  TwinWorker::TestMiniPrimeChunk(uint64_t *miniPrimeChunk)
 void  TwinWorker::TestSmallB(void)
 {
    uint64_t p1 = 0, p2, p3, p4;
-   uint64_t k1, k2, k3, k4, ks[4];
+   uint64_t ks[4], invB[4];
    uint64_t maxPrime = ip_App->GetMaxPrime();
    int32_t  svb = 0;
    int32_t  pmb, count, idx;
    
+   PROFILE_SCOPE(PP_PRIME_SETUP);
+   
    // Evaluate primes in the vector to determine if can yield a factor.  Only
    // put primes that can yield a factor into an array for the second loop.
    count = 0;
@@ -129,63 +145,44 @@ void  TwinWorker::TestSmallB(void)
       p2 = il_MyPrimeList[idx+1];
       p3 = il_MyPrimeList[idx+2];
       p4 = il_MyPrimeList[idx+3];
+
+      // Apply the factors for the small primes before any larger prime can remove a term
+      if (p1 > il_MaxK)
+         ApplySmallPrimes();
+      
+      PROFILE_SWITCH(PP_PRIME_SETUP);
+      
+      invB[0] = ks[0] = (1+ii_InverseList[idx+0]*p1)/ii_Base;
+      invB[1] = ks[1] = (1+ii_InverseList[idx+1]*p2)/ii_Base;
+      invB[2] = ks[2] = (1+ii_InverseList[idx+2]*p3)/ii_Base;
+      invB[3] = ks[3] = (1+ii_InverseList[idx+3]*p4)/ii_Base;
       
-      ks[0] = k1 = (1+ii_InverseList[idx+0]*p1)/ii_Base;
-      ks[1] = k2 = (1+ii_InverseList[idx+1]*p2)/ii_Base;
-      ks[2] = k3 = (1+ii_InverseList[idx+2]*p3)/ii_Base;
-      ks[3] = k4 = (1+ii_InverseList[idx+3]*p4)/ii_Base;
+      PROFILE_SWITCH(PP_POWMOD);
       
       // Starting with k*2^n = 1 (mod p) 
       //           --> k = (1/2)^n (mod p)
       //           --> k = inverse^n (mod p)
-      fpu_powmod_4b_1n_4p(ks, ii_N, &il_MyPrimeList[idx+0]);
-            
-      k1 = ks[0];
-      k2 = ks[1];
-      k3 = ks[2];
-      k4 = ks[3];
-
-      if (p1 <= il_MaxK)
-      {
-         // This function allows for multiple terms to be removed
-         if (k1 <= il_MaxK) RemoveTermsSmallPrime(p1, k1, -1);
-         if (k2 <= il_MaxK) RemoveTermsSmallPrime(p2, k2, -1);
-         if (k3 <= il_MaxK) RemoveTermsSmallPrime(p3, k3, -1);
-         if (k4 <= il_MaxK) RemoveTermsSmallPrime(p4, k4, -1);
-      }
-      else
-      {
-         // This function allows for a single term to be removed
-         if (k1 <= il_MaxK) RemoveTermsBigPrime(p1, k1, -1);
-         if (k2 <= il_MaxK) RemoveTermsBigPrime(p2, k2, -1);
-         if (k3 <= il_MaxK) RemoveTermsBigPrime(p3, k3, -1);
-         if (k4 <= il_MaxK) RemoveTermsBigPrime(p4, k4, -1);
-      }
+      MpArithVec mp(&il_MyPrimeList[idx+0]);
+      MpResVec   resK = mp.resToN(ip_PowerChain->pow(mp, mp.nToRes(ks)));
       
-      k1 = p1 - ks[0];
-      k2 = p2 - ks[1];
-      k3 = p3 - ks[2];
-      k4 = p4 - ks[3];
-         
+      PROFILE_SWITCH(PP_OTHER);
+      
+      ks[0] = resK[0];
+      ks[1] = resK[1];
+      ks[2] = resK[2];
+      ks[3] = resK[3];
+      
+      RemoveTermsForEachN(&il_MyPrimeList[idx+0], ks, invB);
+
       if (p1 <= il_MaxK)
-      {
-         // This function allows for multiple terms to be removed
-         if (k1 <= il_MaxK) RemoveTermsSmallPrime(p1, k1, +1);
-         if (k2 <= il_MaxK) RemoveTermsSmallPrime(p2, k2, +1);
-         if (k3 <= il_MaxK) RemoveTermsSmallPrime(p3, k3, +1);
-         if (k4 <= il_MaxK) RemoveTermsSmallPrime(p4, k4, +1);
-      }
+         ip_KSieve->AddPendingPrimes(p4, 4);
       else
       {
-         // This function allows for a single term to be removed
-         if (k1 <= il_MaxK) RemoveTermsBigPrime(p1, k1, +1);
-         if (k2 <= il_MaxK) RemoveTermsBigPrime(p2, k2, +1);
-         if (k3 <= il_MaxK) RemoveTermsBigPrime(p3, k3, +1);
-         if (k4 <= il_MaxK) RemoveTermsBigPrime(p4, k4, +1);
+         SetLargestPrimeTested(p4, 4);
       }
-
-      SetLargestPrimeTested(p4, 4);
    }
+   
+   ApplySmallPrimes();
          
    // Adjust for the possibility that we tested the same prime
    // more than once at the end of the list.
@@ -199,7 +196,7 @@ void  TwinWorker::TestSmallB(void)
 
 void  TwinWorker::TestLargeB(void)
 {
-   uint64_t ks[4], ps[4];
+   uint64_t ks[4], ps[4], invB[4];
    uint32_t idx;
          
    for (uint32_t pIdx=0; pIdx<ii_PrimesInList; pIdx+=4)
@@ -208,20 +205,30 @@ void  TwinWorker::TestLargeB(void)
       ps[1] = il_PrimeList[pIdx+1];
       ps[2] = il_PrimeList[pIdx+2];
       ps[3] = il_PrimeList[pIdx+3];
+
+      // Apply the factors for the small primes before any larger prime can remove a term
+      if (ps[0] > il_MaxK)
+         ApplySmallPrimes();
    
    
       if (it_TermType == TT_BN)
       {
-         ks[0] = InvMod32(ii_Base, ps[0]);
-         ks[1] = InvMod32(ii_Base, ps[1]);
-         ks[2] = InvMod32(ii_Base, ps[2]);
-         ks[3] = InvMod32(ii_Base, ps[3]);
+         PROFILE_SCOPE(PP_PRIME_SETUP);
+         
+         invB[0] = ks[0] = InvMod32(ii_Base, ps[0]);
+         invB[1] = ks[1] = InvMod32(ii_Base, ps[1]);
+         invB[2] = ks[2] = InvMod32(ii_Base, ps[2]);
+         invB[3] = ks[3] = InvMod32(ii_Base, ps[3]);
+         
+         PROFILE_SWITCH(PP_POWMOD);
          
          // ks = (1/b)^n (mod p)
          fpu_powmod_4b_1n_4p(ks, ii_N, ps);
       }
       else
       {
+         PROFILE_SCOPE(PP_POWMOD);
+         
          MpArithVec mp(ps);
 
          MpResVec resRem = mp.one();
@@ -236,57 +243,120 @@ void  TwinWorker::TestLargeB(void)
       
          resRem = mp.resToN(resRem);
 
+         PROFILE_SWITCH(PP_PRIME_SETUP);
+         
          ks[0] = InvMod64(resRem[0], ps[0]);
          ks[1] = InvMod64(resRem[1], ps[1]);
          ks[2] = InvMod64(resRem[2], ps[2]);
          ks[3] = InvMod64(resRem[3], ps[3]);
       }
 
+      RemoveTermsForEachN(ps, ks, invB);
+
       if (ps[0] <= il_MaxK)
-      {
-         // This function allows for multiple terms to be removed
-         if (ks[0] <= il_MaxK) RemoveTermsSmallPrime(ps[0], ks[0], -1);
-         if (ks[1] <= il_MaxK) RemoveTermsSmallPrime(ps[1], ks[1], -1);
-         if (ks[2] <= il_MaxK) RemoveTermsSmallPrime(ps[2], ks[2], -1);
-         if (ks[3] <= il_MaxK) RemoveTermsSmallPrime(ps[3], ks[3], -1);
-      }
+         ip_KSieve->AddPendingPrimes(ps[3], 4);
       else
       {
-         // This function allows for a single term to be removed
-         if (ks[0] <= il_MaxK) RemoveTermsBigPrime(ps[0], ks[0], -1);
-         if (ks[1] <= il_MaxK) RemoveTermsBigPrime(ps[1], ks[1], -1);
-         if (ks[2] <= il_MaxK) RemoveTermsBigPrime(ps[2], ks[2], -1);
-         if (ks[3] <= il_MaxK) RemoveTermsBigPrime(ps[3], ks[3], -1);
+         SetLargestPrimeTested(ps[3], 4);
       }
+   }
+   
+   ApplySmallPrimes();
+}
 
-      ks[0] = ps[0] - ks[0];
-      ks[1] = ps[1] - ks[1];
-      ks[2] = ps[2] - ks[2];
-      ks[3] = ps[3] - ks[3];
+// ks = (1/b)^n (mod p) for the first n.  Each subsequent n only needs one more
+// multiplication by 1/b (mod p).
+void  TwinWorker::RemoveTermsForEachN(uint64_t *ps, uint64_t *ks, uint64_t *invB)
+{
+   RemoveTerms(ps, ks, 0);
+   
+   if (ii_NCount == 1)
+      return;
+   
+   MpArithVec mp(ps);
+   
+   // Multiplying a number by a residue in Montgomery form yields a number
+   MpResVec   resInvB = mp.nToRes(invB);
+   MpResVec   resK;
+   
+   resK[0] = ks[0];
+   resK[1] = ks[1];
+   resK[2] = ks[2];
+   resK[3] = ks[3];
+   
+   for (uint32_t nIdx=1; nIdx<ii_NCount; nIdx++)
+   {
+      resK = mp.mul(resK, resInvB);
       
-      if (ps[0] <= il_MaxK)
-      {
-         // This function allows for multiple terms to be removed
-         if (ks[0] <= il_MaxK) RemoveTermsSmallPrime(ps[0], ks[0], +1);
-         if (ks[1] <= il_MaxK) RemoveTermsSmallPrime(ps[1], ks[1], +1);
-         if (ks[2] <= il_MaxK) RemoveTermsSmallPrime(ps[2], ks[2], +1);
-         if (ks[3] <= il_MaxK) RemoveTermsSmallPrime(ps[3], ks[3], +1);
-      }
-      else
-      {
-         // This function allows for a single term to be removed
-         if (ks[0] <= il_MaxK) RemoveTermsBigPrime(ps[0], ks[0], +1);
-         if (ks[1] <= il_MaxK) RemoveTermsBigPrime(ps[1], ks[1], +1);
-         if (ks[2] <= il_MaxK) RemoveTermsBigPrime(ps[2], ks[2], +1);
-         if (ks[3] <= il_MaxK) RemoveTermsBigPrime(ps[3], ks[3], +1);
-      }
+      ks[0] = resK[0];
+      ks[1] = resK[1];
+      ks[2] = resK[2];
+      ks[3] = resK[3];
+      
+      RemoveTerms(ps, ks, nIdx);
+   }
+}
+
+void  TwinWorker::RemoveTerms(uint64_t *ps, uint64_t *ks, uint32_t nIdx)
+{
+   uint64_t kp[4];
+   
+   if (ps[0] <= il_MaxK)
+   {
+      // This function allows for multiple terms to be removed
+      if (ks[0] <= il_MaxK) RemoveTermsSmallPrime(ps[0], ks[0], -1, nIdx);
+      if (ks[1] <= il_MaxK) RemoveTermsSmallPrime(ps[1], ks[1], -1, nIdx);
+      if (ks[2] <= il_MaxK) RemoveTermsSmallPrime(ps[2], ks[2], -1, nIdx);
+      if (ks[3] <= il_MaxK) RemoveTermsSmallPrime(ps[3], ks[3], -1, nIdx);
+   }
+   else
+   {
+      // This function allows for a single term to be removed
+      if (ks[0] <= il_MaxK) RemoveTermsBigPrime(ps[0], ks[0], -1, nIdx);
+      if (ks[1] <= il_MaxK) RemoveTermsBigPrime(ps[1], ks[1], -1, nIdx);
+      if (ks[2] <= il_MaxK) RemoveTermsBigPrime(ps[2], ks[2], -1, nIdx);
+      if (ks[3] <= il_MaxK) RemoveTermsBigPrime(ps[3], ks[3], -1, nIdx);
+   }
 
-      SetLargestPrimeTested(ps[3], 4);
+   kp[0] = ps[0] - ks[0];
+   kp[1] = ps[1] - ks[1];
+   kp[2] = ps[2] - ks[2];
+   kp[3] = ps[3] - ks[3];
+   
+   if (ps[0] <= il_MaxK)
+   {
+      // This function allows for multiple terms to be removed
+      if (kp[0] <= il_MaxK) RemoveTermsSmallPrime(ps[0], kp[0], +1, nIdx);
+      if (kp[1] <= il_MaxK) RemoveTermsSmallPrime(ps[1], kp[1], +1, nIdx);
+      if (kp[2] <= il_MaxK) RemoveTermsSmallPrime(ps[2], kp[2], +1, nIdx);
+      if (kp[3] <= il_MaxK) RemoveTermsSmallPrime(ps[3], kp[3], +1, nIdx);
+   }
+   else
+   {
+      // This function allows for a single term to be removed
+      if (kp[0] <= il_MaxK) RemoveTermsBigPrime(ps[0], kp[0], +1, nIdx);
+      if (kp[1] <= il_MaxK) RemoveTermsBigPrime(ps[1], kp[1], +1, nIdx);
+      if (kp[2] <= il_MaxK) RemoveTermsBigPrime(ps[2], kp[2], +1, nIdx);
+      if (kp[3] <= il_MaxK) RemoveTermsBigPrime(ps[3], kp[3], +1, nIdx);
    }
 }
 
+// The factors for the small primes are not applied until the end of the chunk,
+// so don't report them as tested until then.
+void  TwinWorker::ApplySmallPrimes(void)
+{
+   if (ip_KSieve->GetPendingPrimeCount() == 0)
+      return;
+   
+   ip_TwinApp->ReportFactors(ip_KSieve);
+   
+   SetLargestPrimeTested(ip_KSieve->GetLargestPendingPrime(), ip_KSieve->GetPendingPrimeCount());
+   
+   ip_KSieve->Clear();
+}
+
 // This must be used when prime <= il_MaxK.
-void    TwinWorker::RemoveTermsSmallPrime(uint64_t prime, uint64_t k, int32_t c)
+void    TwinWorker::RemoveTermsSmallPrime(uint64_t prime, uint64_t k, int32_t c, uint32_t nIdx)
 {
    // This primes will yield no factor because b^n = 0 (mod p)
    if (ii_Base % prime == 0)
@@ -304,21 +374,21 @@ void    TwinWorker::RemoveTermsSmallPrime(uint64_t prime, uint64_t k, int32_t c)
       }
    }
    
-   if (k > il_MaxK)
+   if (!ip_TwinApp->GetFirstK(prime, k))
       return;
    
-   ip_TwinApp->ReportFactor(prime, k, c);
+   ip_KSieve->AddPrime(prime, k, 2*nIdx + (c == -1 ? 0 : 1), (uint32_t) c);
 }
 
 
 // Using this bypasses a number of if checks that can be done when prime > il_MaxK.
-void    TwinWorker::RemoveTermsBigPrime(uint64_t prime, uint64_t k, int32_t c)
+void    TwinWorker::RemoveTermsBigPrime(uint64_t prime, uint64_t k, int32_t c, uint32_t nIdx)
 {   
    // Make sure that k >= il_MinK
    if (k < il_MinK)
       return;
    
-   ip_TwinApp->ReportFactor(prime, k, c);
+   ip_TwinApp->ReportFactor(prime, k, c, nIdx);
 }
 
 void    TwinWorker::BuildBaseInverses(void)
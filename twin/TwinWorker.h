@@ -11,6 +11,7 @@
 
 #include "TwinApp.h"
 #include "../core/Worker.h"
+#include "../core/MpPowerChain.h"
 
 using namespace std;
 
@@ -34,8 +35,11 @@ private:
    void              TestSmallB(void);
    void              TestLargeB(void);
    
-   void              RemoveTermsSmallPrime(uint64_t prime, uint64_t k, int32_t c);
-   void              RemoveTermsBigPrime(uint64_t prime, uint64_t k, int32_t c);
+   void              RemoveTermsForEachN(uint64_t *ps, uint64_t *ks, uint64_t *invB);
+   void              RemoveTerms(uint64_t *ps, uint64_t *ks, uint32_t nIdx);
+   void              RemoveTermsSmallPrime(uint64_t prime, uint64_t k, int32_t c, uint32_t nIdx);
+   void              ApplySmallPrimes(void);
+   void              RemoveTermsBigPrime(uint64_t prime, uint64_t k, int32_t c, uint32_t nIdx);
    void              VerifyFactor(uint64_t prime, uint64_t k, int32_t c, uint64_t bPowNModP);
    
    void              BuildBaseInverses(void);
@@ -43,10 +47,12 @@ private:
    void              DeterminePrimeTermRange(void);
 
    TwinApp          *ip_TwinApp;
+   KSegmentSieve    *ip_KSieve;
    
    uint32_t         *ii_BaseInverses;
    uint64_t         *il_MyPrimeList;
    uint32_t         *ii_InverseList;
+   MpPowerChain     *ip_PowerChain;
    
    termtype_t        it_TermType;
    uint64_t          il_BpowN;
@@ -54,6 +60,7 @@ private:
    uint64_t          il_MaxK;
    uint32_t          ii_Base;
    uint32_t          ii_N;
+   uint32_t          ii_NCount;
    uint64_t         *il_Terms;
 };
 
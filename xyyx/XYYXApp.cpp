@@ -24,10 +24,20 @@
 #endif
 
 #define APP_NAME        "xyyxsieve"
-#define APP_VERSION     "2.2"
+#define APP_VERSION     "2.3"
 
 #define BIT(x, y)       ((((x) - ii_MinX) * GetYCount()) + ((y) - ii_MinY))
 
+// These are run by -0 (--selftest).  The factors were found with one worker.
+static const selftest_t selfTests[] = {
+   { "-x 10 -X 200 -y 10 -Y 200 -s + -P 1e6",    7158, 0x490261fad5932a95ULL },
+   { "-x 10 -X 200 -y 10 -Y 200 -s + -P 1e6 -m", 7158, 0x490261fad5932a95ULL },
+   { "-x 10 -X 200 -y 10 -Y 200 -s + -P 1e6 -V", 7158, 0x490261fad5932a95ULL },
+   { "-x 10 -X 200 -y 10 -Y 200 -s + -P 1e6 -Z", 7158, 0x490261fad5932a95ULL },
+   { "-x 10 -X 200 -y 10 -Y 200 -s - -P 1e6",    6600, 0xd12646967e4dc7c5ULL },
+   { NULL, 0, 0 }
+};
+
 // This is declared in App.h, but implemented here.  This means that App.h
 // can remain unchanged if using the GPUSieve framework for other applications.
 App *get_app(void)
@@ -39,6 +49,7 @@ XYYXApp::XYYXApp(void) : FactorApp()
 {
    SetBanner(APP_NAME " v" APP_VERSION ", a program to find factors numbers of the form x^y+y^x or x^y-y^x");
    SetLogFileName("xyyxsieve.log");
+   SetSelfTests(selfTests);
 
    ii_MinX = 0;
    ii_MaxX = 0;
@@ -49,7 +60,10 @@ XYYXApp::XYYXApp(void) : FactorApp()
    ib_IsMinus = false;
    SetAppMinPrime(3);
    ib_UseAvx = true;
+   ib_UseMontgomery = false;
    ib_Sparse = false;
+   ib_CanSwitchToSparse = true;
+   ib_SwitchToSparse = false;
    il_InitialSparseTermCount = 0;
    
 #if defined(USE_OPENCL) || defined(USE_METAL)
@@ -68,7 +82,10 @@ void XYYXApp::Help(void)
    printf("-Y --maxy=Y           maximum y to search\n");
    printf("-s --sign=+/-         sign to sieve for\n");
    printf("-V --disableavx       disableavx\n");
+   printf("-m --montgomery       always use Montgomery logic.  By default it is only used\n");
+   printf("                      when it is faster than the FPU/AVX logic\n");
    printf("-Z --sparselogic      use sparse logic\n");
+   printf("-D --noswitch         do not switch from dense to sparse logic when sparse logic becomes faster\n");
 #if defined(USE_OPENCL) || defined(USE_METAL)
    printf("-S --step=S           max steps iterated per call to GPU (default %d)\n", ii_MaxGpuSteps);
    printf("-M --maxfactors=M     max number of factors to support per GPU worker chunk (default %u)\n", ii_MaxGpuFactors);
@@ -79,14 +96,16 @@ void  XYYXApp::AddCommandLineOptions(string &shortOpts, struct option *longOpts)
 {
    FactorApp::ParentAddCommandLineOptions(shortOpts, longOpts);
 
-   shortOpts += "x:X:y:Y:s:S:M:VZ";
+   shortOpts += "x:X:y:Y:s:S:M:VmZD";
 
    AppendLongOpt(longOpts, "minx",              required_argument, 0, 'x');
    AppendLongOpt(longOpts, "maxx",              required_argument, 0, 'X');
    AppendLongOpt(longOpts, "miny",              required_argument, 0, 'y');
    AppendLongOpt(longOpts, "sign",              required_argument, 0, 's');
    AppendLongOpt(longOpts, "disableavx",        no_argument, 0, 'V');
+   AppendLongOpt(longOpts, "montgomery",        no_argument, 0, 'm');
    AppendLongOpt(longOpts, "sparselogic",       no_argument, 0, 'Z');
+   AppendLongOpt(longOpts, "noswitch",          no_argument, 0, 'D');
    AppendLongOpt(longOpts, "sign",              required_argument, 0, 's');
    
 #if defined(USE_OPENCL) || defined(USE_METAL)
@@ -125,12 +144,22 @@ parse_t XYYXApp::ParseOption(int opt, char *arg, const char *source)
          ib_UseAvx = false;
          status = P_SUCCESS;
          break;
+         
+      case 'm':
+         ib_UseMontgomery = true;
+         status = P_SUCCESS;
+         break;
      
       case 'Z':
          ib_Sparse = true;
          status = P_SUCCESS;
          break;
          
+      case 'D':
+         ib_CanSwitchToSparse = false;
+         status = P_SUCCESS;
+         break;
+         
       case 's':
          char value;
          
@@ -222,12 +251,89 @@ void XYYXApp::ValidateOptions(void)
       std::fill(iv_Terms.begin(), iv_Terms.end(), false);
 
       SetInitialTerms();
+      
+      // With -Z the sparse workers are used from the start, so they need the list of terms
+      if (ib_Sparse)
+         ConvertTermsToSparse();
    }
    
    if (ib_IsPlus && ib_IsMinus)
       FatalError("cannot support both + and - forms concurrently");
       
    FactorApp::ParentValidateOptions();
+   
+   // The GPU workers are not timed so only switch when all workers are CPU workers
+   if (GetGpuWorkerCount() > 0)
+      ib_CanSwitchToSparse = false;
+}
+
+bool  XYYXApp::CanSwitchToSparse(void)
+{
+   return (ib_CanSwitchToSparse && !ib_Sparse);
+}
+
+// This is called by a dense worker when it has determined that the sparse logic
+// is faster for the remaining terms.  As terms are only removed, the sparse logic
+// will remain faster, so there is no need to switch back.
+void  XYYXApp::SwitchToSparse(uint64_t thePrime, double denseUSPerPrime, double sparseUSPerPrime)
+{
+   ip_FactorAppLock->Lock();
+
+   if (!ib_SwitchToSparse)
+   {
+      ib_SwitchToSparse = true;
+      
+      WriteToConsole(COT_OTHER, "Switching to sparse logic at p=%" PRIu64" with %" PRIu64" terms remaining (dense %.2f us/prime, sparse %.2f us/prime)", 
+         thePrime, il_TermCount, denseUSPerPrime, sparseUSPerPrime);
+                     
+      WriteToLog("Switching to sparse logic at p=%" PRIu64" with %" PRIu64" terms remaining (dense %.2f us/prime, sparse %.2f us/prime)", 
+         thePrime, il_TermCount, denseUSPerPrime, sparseUSPerPrime);
+      
+      SetRebuildNeeded();
+   }
+   
+   ip_FactorAppLock->Release();
+}
+
+void  XYYXApp::NotifyAppToRebuild(uint64_t largestPrimeTested)
+{
+   // The workers have been stopped so we can change the term structures.  The new
+   // workers will be XYYXSparseWorkers.
+   if (ib_SwitchToSparse && !ib_Sparse)
+      ConvertTermsToSparse();
+}
+
+void  XYYXApp::ConvertTermsToSparse(void)
+{
+   uint32_t x, y;
+   uint64_t idx = 0;
+   
+   // The extra entry has x = 0 to signify the end of the list
+   ip_Terms = (term_t *) xmalloc(1 + il_TermCount, sizeof(term_t), "terms");
+   
+   for (x=ii_MinX; x<=ii_MaxX; x++)
+   {
+      for (y=ii_MinY; y<=ii_MaxY; y++)
+      {
+         if (iv_Terms[BIT(x, y)])
+         {
+            ip_Terms[idx].x = x;
+            ip_Terms[idx].y = y;
+            ip_Terms[idx].haveFactor = false;
+            idx++;
+         }
+      }
+   }
+   
+   if (idx != il_TermCount)
+      FatalError("Something is wrong.  Counted terms (%" PRIu64") != expected terms (%" PRIu64")", idx, il_TermCount);
+   
+   il_InitialSparseTermCount = il_TermCount;
+   
+   iv_Terms.clear();
+   iv_Terms.shrink_to_fit();
+
+   ib_Sparse = true;
 }
 
 Worker *XYYXApp::CreateWorker(uint32_t id, bool gpuWorker, uint64_t largestPrimeTested)
@@ -443,6 +549,8 @@ bool XYYXApp::ReportFactor(uint64_t theFactor, uint32_t x, uint32_t y)
    bool     removedTerm = false;
    uint32_t idx = 0;
    
+   PROFILE_SCOPE(PP_FACTORS);
+   
    if (x < ii_MinX || x > ii_MaxX)
       return false;
    
@@ -79,6 +79,9 @@ public:
    uint32_t          GetYCount(void) { return (ii_MaxY - ii_MinY + 1); };
 
    bool              UseAvxIfAvailable(void) { return ib_UseAvx; };
+   bool              UseMontgomery(void) { return ib_UseMontgomery; };
+   bool              CanSwitchToSparse(void);
+   void              SwitchToSparse(uint64_t thePrime, double denseUSPerPrime, double sparseUSPerPrime);
    bool              IsPlus(void) { return ib_IsPlus; };
    bool              IsMinus(void) { return ib_IsMinus; };
 
@@ -98,7 +101,7 @@ protected:
    void              PreSieveHook(void) {};
    bool              PostSieveHook(void) { return true; };
    
-   void              NotifyAppToRebuild(uint64_t largestPrimeTested) {};
+   void              NotifyAppToRebuild(uint64_t largestPrimeTested);
    
    Worker           *CreateWorker(uint32_t id, bool gpuWorker, uint64_t largestPrimeTested);
    
@@ -109,13 +112,17 @@ protected:
 
 private:
    void              SetInitialTerms(void);
+   void              ConvertTermsToSparse(void);
    void              VerifyFactor(uint64_t theFactor, uint32_t x, uint32_t y);
    
    std::vector<bool>  iv_Terms;
    term_t            *ip_Terms;
    
    bool              ib_Sparse;
+   bool              ib_CanSwitchToSparse;
+   bool              ib_SwitchToSparse;
    bool              ib_UseAvx;
+   bool              ib_UseMontgomery;
    bool              ib_IsPlus;
    bool              ib_IsMinus;
    uint32_t          ii_MinX;
@@ -65,6 +65,8 @@ void  XYYXSparseWorker::TestMegaPrimeChunk(void)
 
       const MpResVec zero = mp.zero();
 
+      PROFILE_SCOPE(PP_POWMOD);
+      
       for (uint32_t idx=0; ; idx++)
       {
          if (ip_Terms[idx].x == 0)
@@ -10,6 +10,7 @@
 #include <time.h>
 
 #include "XYYXWorker.h"
+#include "../core/Clock.h"
 #include "../x86_asm/fpu-asm-x86.h"
 #include "../x86_asm/avx-asm-x86.h"
 
@@ -34,10 +35,16 @@ XYYXWorker::XYYXWorker(uint32_t myId, App *theApp) : Worker(myId, theApp)
    ip_xyTerms = ip_yxTerms = 0;  
    il_NextTermsBuild = 0;
    
+   ib_CanSwitchToSparse = ip_XYYXApp->CanSwitchToSparse();
+   ib_AlwaysUseMontgomery = ip_XYYXApp->UseMontgomery();
+   ib_UseMontgomery = ib_AlwaysUseMontgomery;
+   
+   ResetCostSamples();
+   
    ib_Initialized = true;
 
    for (uint32_t i=0; i<=MAX_POWERS; i++)
-      ip_FpuPowers[i] = (uint64_t *) malloc(4 * sizeof(uint64_t));
+      ip_FpuPowers[i] = (uint64_t *) xmalloc(4, sizeof(uint64_t), "fpuPowers");
             
    if (ip_XYYXApp->UseAvxIfAvailable() && CpuSupportsAvx())
    {
@@ -130,12 +137,26 @@ void  XYYXWorker::TestMegaPrimeChunk(void)
          ip_yxTerms = bases.yPowX;
       
          il_NextTermsBuild = (ps[3] << 2);
+         
+         ResetCostSamples();
       }
       
-      // Compute x^y for y
-      BuildFpuXYRemainders(ps);
+      xyyxengine_t engine = SelectEngine();
+      uint64_t startUS = Clock::GetCurrentMicrosecond();
+
+      if (engine == XE_SPARSE)
+         TestPrimesSparse(ps, 4);
+      else if (engine == XE_MONTGOMERY)
+         TestPrimesMp(ps);
+      else
+      {
+         // Compute x^y for y
+         BuildFpuXYRemainders(ps);
 
-      CheckFpuXYRemainders(ps);
+         CheckFpuXYRemainders(ps);
+      }
+      
+      AddCostSample(engine, startUS, 4, ps[3]);
 
       SetLargestPrimeTested(ps[3], 4);
       
@@ -152,6 +173,8 @@ void  XYYXWorker::BuildFpuXYRemainders(uint64_t *ps)
    uint32_t  maxPowers;
    base_t   *xyPtr;
    
+   PROFILE_SCOPE(PP_POWMOD);
+   
    // If the range of y is only 50, then we only want to generate
    // up to y^50 instead of y^100  (assuming MAX_POWERS = 50).
    if (ii_YCount < MAX_POWERS * 2)
@@ -227,6 +250,8 @@ void  XYYXWorker::CheckFpuXYRemainders(uint64_t *ps)
    base_t     *yxPtr;
    powerofx_t *powerOfX;
 
+   PROFILE_SCOPE(PP_POWMOD);
+   
    // If the range of x is only 50, then we only want to generate
    // up to x^50 instead of x^100  (assuming MAX_POWERS = 50).   
    if (ii_XCount < MAX_POWERS * 2)
@@ -353,6 +378,166 @@ void  XYYXWorker::CheckFpuResult(uint32_t x, uint32_t y, uint64_t *ps, uint64_t
    }
 }
 
+// Same as BuildFpuXYRemainders and CheckFpuXYRemainders, but using Montgomery
+// arithmetic, which is not limited to p < 2^52.  x^y (mod p) is stored in the
+// FPU remainders for each term.
+void  XYYXWorker::TestPrimesMp(uint64_t *ps)
+{
+   MpArithVec mp(ps);
+   
+   BuildMpXYRemainders(ps, mp);
+   
+   CheckMpXYRemainders(ps, mp);
+}
+
+void  XYYXWorker::BuildMpXYRemainders(uint64_t *ps, MpArithVec &mp) 
+{  
+   uint32_t  x, y, prevY;
+   uint32_t  yIndex, powIndex;
+   uint32_t  maxPowers;
+   base_t   *xyPtr;
+   MpResVec  powers[MAX_POWERS+1];
+   MpResVec  res;
+   
+   PROFILE_SCOPE(PP_POWMOD);
+   
+   if (ii_YCount < MAX_POWERS * 2)
+      maxPowers = (ii_YCount / 2);
+   else
+      maxPowers = MAX_POWERS;
+   
+   for (x=ii_MinX; x<=ii_MaxX; x++)
+   {
+      xyPtr = &ip_xyTerms[x-ii_MinX];
+      
+      if (xyPtr->powerCount == 0)
+         continue;
+
+      BuildMpListOfPowers(x, mp, maxPowers, powers);
+
+      y = xyPtr->powersOfX[0].y;
+      
+      res = mp.pow(mp.nToRes(x), y);
+      
+      for (size_t k = 0; k < VECTOR_SIZE; ++k)
+         xyPtr->powersOfX[0].fpuRemainders[k] = res[k];
+      
+      prevY = y;
+         
+      for (yIndex=1; yIndex<xyPtr->powerCount; yIndex++)
+      {
+         y = xyPtr->powersOfX[yIndex].y;
+      
+         powIndex = (y - prevY) >> 1;
+         
+         while (powIndex > maxPowers) 
+         {
+            res = mp.mul(res, powers[maxPowers]);
+            powIndex -= maxPowers;
+         };
+         
+         if (powIndex > 0)
+            res = mp.mul(res, powers[powIndex]);
+         
+         for (size_t k = 0; k < VECTOR_SIZE; ++k)
+            xyPtr->powersOfX[yIndex].fpuRemainders[k] = res[k];
+         
+         prevY = y;
+      }
+   }
+}
+
+void  XYYXWorker::CheckMpXYRemainders(uint64_t *ps, MpArithVec &mp) 
+{
+   uint32_t    x, y, prevX;
+   uint32_t    xIndex, powIndex;
+   uint32_t    maxPowers;
+   base_t     *yxPtr;
+   powerofx_t *powerOfX;
+   MpResVec    powers[MAX_POWERS+1];
+   MpResVec    res, xPowY;
+   
+   const MpResVec zero = mp.zero();
+
+   PROFILE_SCOPE(PP_POWMOD);
+
+   if (ii_XCount < MAX_POWERS * 2)
+      maxPowers = (ii_XCount / 2);
+   else
+      maxPowers = MAX_POWERS;
+
+   for (y=ii_MinY; y<=ii_MaxY; y++)
+   {
+      yxPtr = &ip_yxTerms[y-ii_MinY];
+      
+      if (yxPtr->powerCount == 0)
+         continue;
+
+      BuildMpListOfPowers(y, mp, maxPowers, powers);
+      
+      prevX = yxPtr->powersOfY[0].x;
+      
+      res = mp.pow(mp.nToRes(y), prevX);
+      
+      for (xIndex=0; xIndex<yxPtr->powerCount; xIndex++)
+      {
+         x = yxPtr->powersOfY[xIndex].x;
+         
+         powIndex = (x - prevX) >> 1;
+         
+         while (powIndex > maxPowers) 
+         {
+            res = mp.mul(res, powers[maxPowers]);
+            powIndex -= maxPowers;
+         };
+         
+         if (powIndex > 0)
+            res = mp.mul(res, powers[powIndex]);
+                  
+         powerOfX = yxPtr->powersOfY[xIndex].powerOfX;
+         
+         for (size_t k = 0; k < VECTOR_SIZE; ++k)
+            xPowY[k] = powerOfX->fpuRemainders[k];
+      
+         // For x^y-y^x we need x^y = y^x.  For x^y+y^x we need x^y+y^x = 0.
+         if (ib_IsPlus)
+         {
+            MpResVec sum = mp.add(xPowY, res);
+            
+            if (MpArithVec::at_least_one_is_equal(sum, zero))
+            {
+               for (size_t k = 0; k < VECTOR_SIZE; ++k)
+                  if (sum[k] == zero[k])
+                     ip_XYYXApp->ReportFactor(ps[k], x, y);
+            }
+         }
+         else
+         {
+            if (MpArithVec::at_least_one_is_equal(xPowY, res))
+            {
+               for (size_t k = 0; k < VECTOR_SIZE; ++k)
+                  if (xPowY[k] == res[k])
+                     ip_XYYXApp->ReportFactor(ps[k], x, y);
+            }
+         }
+         
+         prevX = x;
+      }
+   }
+}
+
+// Build a list of powers of base^(2*i) for i = 1 to count.
+void  XYYXWorker::BuildMpListOfPowers(uint32_t base, MpArithVec &mp, uint32_t count, MpResVec *powers)
+{
+   MpResVec resBase = mp.nToRes(base);
+   
+   powers[0] = mp.one();
+   powers[1] = mp.mul(resBase, resBase);
+   
+   for (uint32_t idx=2; idx<=count; idx++)
+      powers[idx] = mp.mul(powers[idx-1], powers[1]);
+}
+
 void  XYYXWorker::TestMiniPrimeChunk(uint64_t *miniPrimeChunk)
 {
    double __attribute__((aligned(32))) dps[AVX_ARRAY_SIZE];
@@ -366,26 +551,165 @@ void  XYYXWorker::TestMiniPrimeChunk(uint64_t *miniPrimeChunk)
       
       FreeTerms();
       
-      ib_HaveFpuRemainders = false;
+      // The FPU remainders are used by the Montgomery logic
+      ib_HaveFpuRemainders = true;
       ib_HaveAvxRemainders = true;
       
-      ip_XYYXApp->GetTerms(0, AVX_ARRAY_SIZE, &bases);
+      ip_XYYXApp->GetTerms(VECTOR_SIZE, AVX_ARRAY_SIZE, &bases);
             
       ip_xyTerms = bases.xPowY;
       ip_yxTerms = bases.yPowX;
       
       il_NextTermsBuild = (miniPrimeChunk[AVX_ARRAY_SIZE-1] << 1);
+      
+      ResetCostSamples();
    }
    
-   // compute the inverse of b (mod p)
-   for (int i=0; i<AVX_ARRAY_SIZE; i++)
-      dps[i] = (double) miniPrimeChunk[i];
+   xyyxengine_t engine = SelectEngine();
+   uint64_t startUS = Clock::GetCurrentMicrosecond();
+   
+   if (engine == XE_SPARSE)
+      TestPrimesSparse(miniPrimeChunk, AVX_ARRAY_SIZE);
+   else if (engine == XE_MONTGOMERY)
+   {
+      for (uint32_t idx=0; idx<AVX_ARRAY_SIZE; idx+=VECTOR_SIZE)
+         TestPrimesMp(&miniPrimeChunk[idx]);
+   }
+   else
+   {
+      PROFILE_SCOPE(PP_PRIME_SETUP);
+      
+      // compute the inverse of b (mod p)
+      for (int i=0; i<AVX_ARRAY_SIZE; i++)
+         dps[i] = (double) miniPrimeChunk[i];
+         
+      avx_compute_reciprocal(dps, reciprocals);
+
+      BuildAvxXYRemainders(miniPrimeChunk, dps, reciprocals);
+
+      CheckAvxXYRemainders(miniPrimeChunk, dps, reciprocals);
+   }
+   
+   AddCostSample(engine, startUS, AVX_ARRAY_SIZE, miniPrimeChunk[AVX_ARRAY_SIZE-1]);
+}
+
+// After the term lists are rebuilt, primes are tested with each engine in turn (FPU/AVX,
+// then Montgomery, then sparse) until each has been timed for COST_SAMPLE_US.  Once all
+// have been timed, the faster of FPU/AVX and Montgomery is used until the next rebuild.
+// If the sparse logic is faster than both, the app is told to switch to it.
+xyyxengine_t  XYYXWorker::SelectEngine(void)
+{
+   bool canUseNative = !ib_AlwaysUseMontgomery;
+   
+   if (canUseNative && il_SampleUS[XE_NATIVE] < COST_SAMPLE_US)
+      return XE_NATIVE;
+   
+   if ((canUseNative || ib_CanSwitchToSparse) && il_SampleUS[XE_MONTGOMERY] < COST_SAMPLE_US)
+      return XE_MONTGOMERY;
+   
+   if (ib_CanSwitchToSparse && il_SampleUS[XE_SPARSE] < COST_SAMPLE_US)
+      return XE_SPARSE;
+   
+   if (canUseNative && !ib_UseMontgomery)
+      return XE_NATIVE;
+   
+   return XE_MONTGOMERY;
+}
+
+void  XYYXWorker::ResetCostSamples(void)
+{
+   for (uint32_t idx=0; idx<XE_COUNT; idx++)
+   {
+      ii_SamplePrimes[idx] = 0;
+      il_SampleUS[idx] = 0;
+   }
+}
+
+void  XYYXWorker::AddCostSample(xyyxengine_t engine, uint64_t startUS, uint32_t primeCount, uint64_t largestPrime)
+{
+   uint64_t elapsedUS = Clock::GetCurrentMicrosecond() - startUS;
+   
+   if (il_SampleUS[engine] >= COST_SAMPLE_US)
+      return;
+   
+   il_SampleUS[engine] += elapsedUS;
+   ii_SamplePrimes[engine] += primeCount;
+   
+   if (il_SampleUS[engine] < COST_SAMPLE_US)
+      return;
+   
+   double usPerPrime[XE_COUNT];
+   
+   for (uint32_t idx=0; idx<XE_COUNT; idx++)
+      usPerPrime[idx] = (ii_SamplePrimes[idx] == 0 ? 0.0 : (double) il_SampleUS[idx] / (double) ii_SamplePrimes[idx]);
+   
+   if (engine == XE_MONTGOMERY && ii_SamplePrimes[XE_NATIVE] > 0)
+      ib_UseMontgomery = (ib_AlwaysUseMontgomery || usPerPrime[XE_MONTGOMERY] < usPerPrime[XE_NATIVE]);
+   
+   if (engine == XE_SPARSE)
+   {
+      double denseUSPerPrime = usPerPrime[XE_MONTGOMERY];
+      
+      if (ii_SamplePrimes[XE_NATIVE] > 0 && usPerPrime[XE_NATIVE] < denseUSPerPrime)
+         denseUSPerPrime = usPerPrime[XE_NATIVE];
+      
+      // Require the sparse logic to be at least 10% faster so that timing noise
+      // does not cause a premature switch.
+      if (usPerPrime[XE_SPARSE] < denseUSPerPrime * 0.9)
+      {
+         ip_XYYXApp->SwitchToSparse(largestPrime, denseUSPerPrime, usPerPrime[XE_SPARSE]);
       
-   avx_compute_reciprocal(dps, reciprocals);
+         ib_CanSwitchToSparse = false;
+      }
+   }
+}
 
-   BuildAvxXYRemainders(miniPrimeChunk, dps, reciprocals);
+// Test these primes against the remaining terms the same way that XYYXSparseWorker does.
+void  XYYXWorker::TestPrimesSparse(uint64_t *ps, uint32_t primeCount)
+{
+   uint32_t  x, y, yIndex;
+   base_t   *xyPtr;
+   
+   PROFILE_SCOPE(PP_POWMOD);
+   
+   for (uint32_t pIdx=0; pIdx<primeCount; pIdx+=VECTOR_SIZE)
+   {
+      MpArithVec mp(&ps[pIdx]);
+      MpResVec resXexpY;
+      MpResVec resYexpX;
+
+      const MpResVec zero = mp.zero();
 
-   CheckAvxXYRemainders(miniPrimeChunk, dps, reciprocals);
+      for (x=ii_MinX; x<=ii_MaxX; x++)
+      {
+         xyPtr = &ip_xyTerms[x-ii_MinX];
+         
+         if (xyPtr->powerCount == 0)
+            continue;
+         
+         MpResVec resBaseX = mp.nToRes(x);
+         
+         for (yIndex=0; yIndex<xyPtr->powerCount; yIndex++)
+         {
+            y = xyPtr->powersOfX[yIndex].y;
+            
+            resXexpY = mp.pow(resBaseX, y);
+            resYexpX = mp.pow(mp.nToRes(y), x);
+            
+            if (ib_IsPlus)
+            {
+               resYexpX = mp.add(resXexpY, resYexpX);
+               resXexpY = zero;
+            }
+            
+            for (size_t k = 0; k < VECTOR_SIZE; ++k)
+            {
+               if (resXexpY[k] == resYexpX[k])
+                  ip_XYYXApp->ReportFactor(ps[pIdx+k], x, y);
+            }
+         }
+      }
+   }
 }
 
 // Build a table of x^y mod p for all remaining terms
@@ -397,6 +721,8 @@ void  XYYXWorker::BuildAvxXYRemainders(uint64_t *ps, double *dps, double *recipr
    uint32_t  maxPowers;
    base_t   *xyPtr;
    
+   PROFILE_SCOPE(PP_POWMOD);
+   
    // If the range of y is only 50, then we only want to generate
    // up to y^50 instead of y^100  (assuming MAX_POWERS = 50).
    if (ii_YCount < MAX_POWERS * 2)
@@ -463,6 +789,8 @@ void  XYYXWorker::CheckAvxXYRemainders(uint64_t *ps, double *dps, double *recipr
    base_t     *yxPtr;
    powerofx_t *powerOfX;
 
+   PROFILE_SCOPE(PP_POWMOD);
+
    // If the range of x is only 50, then we only want to generate
    // up to x^50 instead of x^100  (assuming MAX_POWERS = 50).   
    if (ii_XCount < MAX_POWERS * 2)
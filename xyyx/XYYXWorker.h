@@ -11,11 +11,17 @@
 
 #include "XYYXApp.h"
 #include "../core/Worker.h"
+#include "../core/MpArithVector.h"
 
 using namespace std;
 
 #define MAX_POWERS   50
 
+// Number of microseconds to time each engine for after the term lists are rebuilt
+#define COST_SAMPLE_US        10000
+
+typedef enum { XE_NATIVE = 0, XE_MONTGOMERY, XE_SPARSE, XE_COUNT } xyyxengine_t;
+
 class XYYXWorker : public Worker
 {
 public:
@@ -33,6 +39,16 @@ protected:
 private:         
    void           FreeTerms(void);
    
+   xyyxengine_t   SelectEngine(void);
+   void           ResetCostSamples(void);
+   void           AddCostSample(xyyxengine_t engine, uint64_t startUS, uint32_t primeCount, uint64_t largestPrime);
+   void           TestPrimesSparse(uint64_t *ps, uint32_t primeCount);
+   
+   void           TestPrimesMp(uint64_t *ps);
+   void           BuildMpXYRemainders(uint64_t *ps, MpArithVec &mp);
+   void           CheckMpXYRemainders(uint64_t *ps, MpArithVec &mp);
+   void           BuildMpListOfPowers(uint32_t base, MpArithVec &mp, uint32_t count, MpResVec *powers);
+   
    void           TestPrimeChunkFPU(uint64_t &largestPrimeTested, uint64_t &primesTested);   
    void           BuildFpuXYRemainders(uint64_t *ps);
    void           CheckFpuXYRemainders(uint64_t *ps);
@@ -59,6 +75,12 @@ private:
    bool           ib_HaveFpuRemainders;
    bool           ib_HaveAvxRemainders;
    uint64_t       il_NextTermsBuild;
+   
+   bool           ib_CanSwitchToSparse;
+   bool           ib_AlwaysUseMontgomery;
+   bool           ib_UseMontgomery;
+   uint32_t       ii_SamplePrimes[XE_COUNT];
+   uint64_t       il_SampleUS[XE_COUNT];
 
    base_t        *ip_xyTerms;
    base_t        *ip_yxTerms;